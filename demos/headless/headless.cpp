@@ -0,0 +1,286 @@
+#include <iostream>
+#include <cassert>
+#include <chrono>
+#include "VulkanDriverInstance.h"
+#include "VulkanBuffer.h"
+#include "VulkanOffscreenTarget.h"
+#include "VulkanFramePacer.h"
+#include "VulkanReadbackQueue.h"
+#include "VulkanPipelineCache.h"
+#include "VulkanPipelineState.h"
+#include "VulkanResidencyManager.h"
+
+#define FRAMES_IN_FLIGHT 2
+#define DEFAULT_FRAME_COUNT 100
+#define MILLISECONDS_TO_SECONDS 1000
+#define BYTES_PER_MEGABYTE (1024 * 1024)
+#define MESH_COUNT 8
+#define MESH_SIZE (40 * BYTES_PER_MEGABYTE)     // Over half a 64 MB block, so each mesh gets memory of its own
+#define MESH_FRAMES 10
+#define PATCH_IMAGE_SIZE 256
+#define PATCH_SIZE 32
+
+// A streamable mesh, loaded when first drawn and dropped again when its heap runs out of budget
+struct StreamedMesh{
+    VulkanBuffer *  buffer;
+    uint64_t        residencyId;
+};
+
+// Renders the Test1 triangle without a window, surface or swapchain, then reads the
+// last frame back. With a capture interval, every Nth frame is also captured without
+// stalling the render loop. With a memory budget, every heap's budget is capped to it and
+// the triangle is drawn from a rotating set of large mesh buffers that don't all fit, so
+// the least recently drawn ones get evicted. With a patch interval, every Nth frame a small
+// square of an image the graphics queue already owns is uploaded again, and the patched
+// image is saved to patched.png so every patch and the untouched rest can be checked.
+// Usage: headless [frame count] [output image] [capture interval] [memory budget MB] [patch interval]
+int main(int argc, char **argv){
+    uint32_t framesToRender     = (argc > 1) ? (uint32_t)std::stoul(argv[1]) : DEFAULT_FRAME_COUNT;
+    std::string outputFileName  = (argc > 2) ? argv[2] : "headless.png";
+    uint32_t captureInterval    = (argc > 3) ? (uint32_t)std::stoul(argv[3]) : 0;
+    VkDeviceSize memoryBudget   = (argc > 4) ? (VkDeviceSize)std::stoull(argv[4]) * BYTES_PER_MEGABYTE : 0;
+    uint32_t patchInterval      = (argc > 5) ? (uint32_t)std::stoul(argv[5]) : 0;
+    assert(framesToRender > 0);
+
+    VulkanDriverInstance instance("Headless", true);
+
+    if(instance.loader == nullptr){
+        std::cout << "Vulkan library not found!" << std::endl;
+        return 1;
+    }
+
+    // Set up instance variables and functions
+    VulkanDevice * deviceContext = new VulkanDevice(&instance, 0); // Create device for device #0
+    if (deviceContext == nullptr){
+        std::cout << "Could not create a Vulkan Device!" << std:: endl;
+        return 1;
+    }
+
+    // Set buffer data
+    float vertexBufferData[18] = {-0.5,  0.5, 0.0, 0.0, 0.0, 1.0,  // x, y, z, r, g, b [0]
+                                   0.5,  0.5, 0.0, 0.0, 1.0, 0.0,  // x, y, z, r, g, b [1]
+                                   0.0, -0.5, 0.0, 1.0, 0.0, 0.0}; // x, y, z, r, g, b [2]
+
+    VulkanBuffer vertexBuffer(deviceContext, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBufferData, sizeof(float) * 18, false);
+    const VkDeviceSize vertexOffset = 0;
+
+    // Streamed meshes start out unloaded; the triangle is at the front of each, the rest is padding
+    std::vector<StreamedMesh> meshes(MESH_COUNT, {nullptr, 0});
+    uint32_t meshLoads      = 0;
+    uint32_t meshEvictions  = 0;
+    if(memoryBudget > 0){
+        deviceContext->residencyManager->budgetLimit = memoryBudget;
+        deviceContext->residencyManager->updateBudgets();
+        deviceContext->residencyManager->printBudgets();
+    }
+
+    // Patched image starts out grey, each patch is a square in a new colour on the next grid cell
+    VulkanImage * patchImage    = nullptr;
+    VulkanUploadToken patchToken = 0;
+    uint64_t patchAcquiredFrame = 0;        // Frame that took the last upload back
+    bool patchUploading         = false;
+    uint32_t patchUploads       = 0;
+    std::vector<uint8_t> patchTexels(PATCH_SIZE * PATCH_SIZE * 4);
+    if(patchInterval > 0){
+        patchImage = new VulkanImage(deviceContext, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, {PATCH_IMAGE_SIZE, PATCH_IMAGE_SIZE, 1});
+        std::vector<uint8_t> greyTexels(PATCH_IMAGE_SIZE * PATCH_IMAGE_SIZE * 4, 128);
+        for(uint32_t texel = 0; texel < PATCH_IMAGE_SIZE * PATCH_IMAGE_SIZE; texel++){
+            greyTexels[texel * 4 + 3] = 255;
+        }
+        patchImage->loadImageData(&greyTexels[0], (uint32_t)greyTexels.size(), {PATCH_IMAGE_SIZE, PATCH_IMAGE_SIZE, 1});
+        patchUploading = true;
+    }
+
+    // Target geometry
+    const uint32_t targetWidth  = 512;
+    const uint32_t targetHeight = 512;
+    VulkanOffscreenTarget target(deviceContext, {targetWidth, targetHeight}, FRAMES_IN_FLIGHT);
+
+    VulkanPipelineState vps(deviceContext);
+
+    VkVertexInputBindingDescription vertexBindingDescription;
+    vertexBindingDescription.binding    = 0;
+    vertexBindingDescription.stride     = 6 * sizeof(float);
+    vertexBindingDescription.inputRate  = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkVertexInputAttributeDescription positionInputDescription;
+    positionInputDescription.binding    = 0;
+    positionInputDescription.format     = VK_FORMAT_R32G32B32_SFLOAT;
+    positionInputDescription.location   = 0;
+    positionInputDescription.offset     = 0;
+
+    VkVertexInputAttributeDescription colorInputDescription;
+    colorInputDescription.binding   = 0;
+    colorInputDescription.format    = VK_FORMAT_R32G32B32_SFLOAT;
+    colorInputDescription.location  = 1;
+    colorInputDescription.offset    = 3 * sizeof(float);
+
+    std::vector<VkVertexInputBindingDescription> bindingDescriptions     = { vertexBindingDescription };
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions = { positionInputDescription, colorInputDescription };
+    vps.setPrimitiveState(bindingDescriptions, attributeDescriptions, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+
+    VkRect2D scissorRect = { { 0, 0 }, target.extent };
+    vps.setViewportState(target.extent, scissorRect);
+    target.setPipelineState(&vps);
+
+    // Do rendering, recording each frame while the GPU is still working on the previous one
+    VulkanFramePacer framePacer(deviceContext, target.queueFamilyIndex, FRAMES_IN_FLIGHT);
+    VulkanReadbackQueue readbackQueue(&framePacer);
+
+    target.createRenderpass();
+
+    // Pipeline layout setup
+    VkPipelineLayout layout;
+    VkPipelineLayoutCreateInfo layoutInfo;
+    layoutInfo.sType                    = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext                    = nullptr;
+    layoutInfo.flags                    = 0;
+    layoutInfo.setLayoutCount           = 0;        // No descriptor sets enabled
+    layoutInfo.pSetLayouts              = nullptr;  // No descriptor sets enabled
+    layoutInfo.pushConstantRangeCount   = 0;
+    layoutInfo.pPushConstantRanges      = nullptr;
+    assert(deviceContext->vkCreatePipelineLayout(deviceContext->device, &layoutInfo, nullptr, &layout) == VK_SUCCESS);
+    vps.pipelineInfo.layout = layout;
+
+    vps.addShaderStage("vert.spv", VK_SHADER_STAGE_VERTEX_BIT, "main");
+    vps.addShaderStage("frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT, "main");
+    vps.complete();
+
+    VkQueue renderQueue;
+    deviceContext->vkGetDeviceQueue(deviceContext->device, target.queueFamilyIndex, 0, &renderQueue);
+
+    // Send off uploads recorded during setup in a single submit; the first frame draws with them
+    deviceContext->stagingRing->wait(deviceContext->stagingRing->submit());
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for(uint32_t frameCount = 0; frameCount < framesToRender; frameCount++){
+        VulkanFrame& frame = framePacer.beginFrame();
+        target.acquireNextImage(frame);
+
+        if(target.dirtyFramebuffers){
+            target.setupFramebuffers(frame.commandBuffer);
+        }
+
+        // Begin the render pass
+        std::array<VkClearValue, 2> clearValues;
+        clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
+        clearValues[1].depthStencil = {1.0f, 0};
+
+        VkRenderPassBeginInfo renderPassBegin;
+        renderPassBegin.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassBegin.pNext           = nullptr;
+        renderPassBegin.renderPass      = target.renderPass->renderPass;
+        renderPassBegin.framebuffer     = target.getCurrentFramebuffer();
+        renderPassBegin.renderArea      = {{0,0}, target.extent};
+        renderPassBegin.clearValueCount = clearValues.size();
+        renderPassBegin.pClearValues    = &clearValues[0];
+
+        // Cycle through the meshes, loading the current one if it was never loaded or got evicted
+        VkBuffer drawBuffer = vertexBuffer.bufferHandle;
+        if(memoryBudget > 0){
+            uint32_t meshIndex  = (frameCount / MESH_FRAMES) % MESH_COUNT;
+            StreamedMesh& mesh  = meshes[meshIndex];
+            if(mesh.buffer == nullptr){
+                // Creating the buffer is what evicts older meshes once the heap is over budget
+                mesh.buffer = new VulkanBuffer(deviceContext, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, nullptr, MESH_SIZE, false);
+                mesh.buffer->copyHostData(vertexBufferData, 0, sizeof(vertexBufferData));
+                deviceContext->stagingRing->wait(deviceContext->stagingRing->submit());
+                mesh.residencyId = deviceContext->residencyManager->registerResource(mesh.buffer->bufferAllocation, [&meshes, &meshEvictions, meshIndex](){
+                    delete meshes[meshIndex].buffer;
+                    meshes[meshIndex].buffer        = nullptr;
+                    meshes[meshIndex].residencyId   = 0;
+                    meshEvictions++;
+                });
+                meshLoads++;
+            }
+
+            // Drawn this frame, so it stays until the frame has finished
+            deviceContext->residencyManager->touch(mesh.residencyId);
+            drawBuffer = mesh.buffer->bufferHandle;
+        }
+
+        // Only patch the image again once the frame that took the last upload back has finished,
+        // the graphics queue has to own it before handing it over for the next one
+        if(patchImage != nullptr){
+            if(!patchUploading && frameCount % patchInterval == 0 && framePacer.isFrameComplete(patchAcquiredFrame)){
+                static const uint8_t patchColors[3][4] = {{192, 48, 48, 255}, {48, 192, 48, 255}, {48, 48, 192, 255}};
+                const uint8_t * patchColor = patchColors[patchUploads % 3];
+                for(uint32_t texel = 0; texel < PATCH_SIZE * PATCH_SIZE; texel++){
+                    memcpy(&patchTexels[texel * 4], patchColor, 4);
+                }
+                uint32_t cellsPerRow    = PATCH_IMAGE_SIZE / PATCH_SIZE;
+                uint32_t cell           = patchUploads % (cellsPerRow * cellsPerRow);
+                VkOffset3D patchOffset  = {(int32_t)((cell % cellsPerRow) * PATCH_SIZE), (int32_t)((cell / cellsPerRow) * PATCH_SIZE), 0};
+                patchToken = patchImage->loadImageData(&patchTexels[0], (uint32_t)patchTexels.size(), {PATCH_SIZE, PATCH_SIZE, 1}, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, patchOffset);
+                deviceContext->stagingRing->submit();
+                patchUploading = true;
+                patchUploads++;
+            }
+
+            // The last frame saves the image, so it can't go without the last patch
+            if(patchUploading && frameCount == framesToRender - 1){
+                deviceContext->stagingRing->wait(patchToken);
+            }
+
+            // Checked before acquireUploads, so the acquire of a finished upload is recorded in this frame
+            if(patchUploading && deviceContext->stagingRing->isComplete(patchToken)){
+                patchUploading      = false;
+                patchAcquiredFrame  = frame.frameNumber;
+            }
+        }
+
+        // Take ownership of finished uploads before drawing with them
+        deviceContext->stagingRing->acquireUploads(frame.commandBuffer);
+        deviceContext->vkCmdBindPipeline(frame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vps.pipeline);
+        deviceContext->vkCmdBeginRenderPass(frame.commandBuffer, &renderPassBegin, VK_SUBPASS_CONTENTS_INLINE);
+        deviceContext->vkCmdBindVertexBuffers(frame.commandBuffer, 0, 1, &drawBuffer, &vertexOffset);
+        deviceContext->vkCmdDraw(frame.commandBuffer, 3, 1, 0, 0);
+        deviceContext->vkCmdEndRenderPass(frame.commandBuffer);
+
+        // Capture into the frame's own command buffer; encoding happens once the frame has finished
+        if(frameCount == framesToRender - 1){
+            readbackQueue.captureImage(*target.colorImages[target.imageIndex], outputFileName);
+            if(patchImage != nullptr){
+                readbackQueue.captureImage(*patchImage, "patched.png");
+            }
+        }else if(captureInterval > 0 && frameCount % captureInterval == 0){
+            readbackQueue.captureImage(*target.colorImages[target.imageIndex], "capture_" + std::to_string(frameCount) + ".png");
+        }
+
+        // Dispatch, nothing to present
+        framePacer.endFrame(renderQueue, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, false);
+
+        // Hand finished captures to the encoder threads
+        readbackQueue.update();
+    }
+
+    // Wait for the last frame
+    framePacer.waitIdle();
+    auto end = std::chrono::high_resolution_clock::now();
+    double elapsedMilliseconds = (double)std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    std::cout << "Rendered " << std::dec << framesToRender << " frames in " << elapsedMilliseconds / MILLISECONDS_TO_SECONDS << " seconds (" << (elapsedMilliseconds / framesToRender) << " ms/frame)" << std::endl;
+
+    readbackQueue.flush();
+    std::cout << "Saved last frame to " << outputFileName << " (" << readbackQueue.droppedCaptures << " captures dropped)" << std::endl;
+    if(memoryBudget > 0){
+        std::cout << "Loaded " << std::dec << meshLoads << " meshes, evicted " << meshEvictions << " to stay within " << (memoryBudget / BYTES_PER_MEGABYTE) << " MB" << std::endl;
+    }
+    if(patchImage != nullptr){
+        std::cout << "Patched the image " << std::dec << patchUploads << " times, saved to patched.png" << std::endl;
+    }
+    deviceContext->memoryAllocator->printStats();
+
+    assert(deviceContext->vkDeviceWaitIdle(deviceContext->device) == VK_SUCCESS);
+
+    // The device is never deleted, so write compiled pipelines out for the next run here
+    deviceContext->pipelineCache->save();
+    deviceContext->vkDestroyPipelineLayout(deviceContext->device, layout, nullptr);
+    for(auto& mesh : meshes){
+        deviceContext->residencyManager->unregisterResource(mesh.residencyId);
+        delete mesh.buffer;
+    }
+    delete patchImage;
+
+    return 0;
+}
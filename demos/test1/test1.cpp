@@ -4,8 +4,12 @@
 #include "VulkanBuffer.h"
 #include "VulkanRenderPass.h"
 #include "VulkanSwapchain.h"
+#include "VulkanFramePacer.h"
+#include "VulkanPipelineCache.h"
 #include "VulkanPipelineState.h"
 
+#define FRAMES_IN_FLIGHT 2
+
 #if defined (_WIN32) || defined (_WIN64)
 #include "win32Window.h"
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
@@ -99,13 +103,14 @@ int main(){
     std::vector<VkVertexInputAttributeDescription> attributeDescriptions = { positionInputDescription, colorInputDescription };
     vps.setPrimitiveState(bindingDescriptions, attributeDescriptions, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
 
+    // Viewport and scissor are set per frame, so resizing never rebuilds the pipeline
+    vps.setDynamicState({ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR });
     VkRect2D scissorRect = { { 0, 0 }, window->swapchain->extent };
     vps.setViewportState(window->swapchain->extent, scissorRect);
     window->swapchain->setPipelineState(&vps);
 
-    // Do rendering
-    VulkanCommandPool * renderPool      = deviceContext->getCommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, window->swapchain->queueFamilyIndices[0]);
-    VkCommandBuffer * cmdBuffers         = renderPool->getCommandBuffers(VK_COMMAND_BUFFER_LEVEL_PRIMARY, window->swapchain->imageCount);
+    // Do rendering, recording each frame while the GPU is still working on the previous one
+    VulkanFramePacer framePacer(deviceContext, window->swapchain->queueFamilyIndices[0], FRAMES_IN_FLIGHT);
 
     window->swapchain->createRenderpass();
 
@@ -126,46 +131,22 @@ int main(){
 	vps.addShaderStage("frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT, "main");
     vps.complete();
 
-    VkCommandBufferBeginInfo cmdBufferBeginInfo;
-    cmdBufferBeginInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmdBufferBeginInfo.pNext            = nullptr;
-    cmdBufferBeginInfo.flags            = 0;
-    cmdBufferBeginInfo.pInheritanceInfo = nullptr;
-    
-    // Set up submit fences
-    std::vector<VkFence> submitFences;
-    submitFences.resize(window->swapchain->imageCount);
-    
-    for (int i = 0; i < window->swapchain->imageCount; i++) {
-        VkFenceCreateInfo submitFenceInfo;
-        submitFenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        submitFenceInfo.pNext = nullptr;
-        submitFenceInfo.flags = 0; // Unsignaled state
-        assert(deviceContext->vkCreateFence(deviceContext->device, &submitFenceInfo, nullptr, &submitFences[i]) == VK_SUCCESS);
-    }
-
-    assert( deviceContext->vkBeginCommandBuffer(cmdBuffers[0], &cmdBufferBeginInfo) == VK_SUCCESS);
-
     uint32_t frameCount = 0;
     VkQueue presentQueue;
     deviceContext->vkGetDeviceQueue(deviceContext->device, window->swapchain->queueFamilyIndices[0], 0, &presentQueue);
 
-    window->swapchain->setupFramebuffers(cmdBuffers[0]);
+    // Send off uploads recorded during setup in a single submit; the first frame draws with them
+    deviceContext->stagingRing->wait(deviceContext->stagingRing->submit());
 
-    while(true){
-        int cmdBufferIndex = frameCount % window->swapchain->imageCount;
-        int nextCmdBufferIndex = (frameCount + 1) % window->swapchain->imageCount;
+    // Runs until the window is closed, then shuts down so the pipeline cache gets saved
+    bool running = true;
+    while(running){
+        VulkanFrame& frame = framePacer.beginFrame();
+        window->swapchain->acquireNextImage(frame);
 
         if(window->swapchain->dirtyFramebuffers){
-            // Reset command buffers
-            for(int i = 0; i < window->swapchain->imageCount; i++){
-                renderPool->resetCommandBuffer(cmdBuffers[i], VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
-            }
-
             std::cout << "Recreating Framebuffers" << std::endl;
-            assert(deviceContext->vkDeviceWaitIdle(deviceContext->device) == VK_SUCCESS);
-            assert( deviceContext->vkBeginCommandBuffer(cmdBuffers[cmdBufferIndex], &cmdBufferBeginInfo) == VK_SUCCESS);
-            window->swapchain->setupFramebuffers(cmdBuffers[cmdBufferIndex]);
+            window->swapchain->setupFramebuffers(frame.commandBuffer);
         }
 
         // Begin the render pass
@@ -182,48 +163,28 @@ int main(){
         renderPassBegin.clearValueCount = clearValues.size();
         renderPassBegin.pClearValues    = &clearValues[0];
 
-        deviceContext->vkQueueWaitIdle(presentQueue);
-        deviceContext->vkCmdBindPipeline(cmdBuffers[cmdBufferIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, vps.pipeline);
-        deviceContext->vkCmdBeginRenderPass(cmdBuffers[cmdBufferIndex], &renderPassBegin, VK_SUBPASS_CONTENTS_INLINE);
-        deviceContext->vkCmdBindVertexBuffers(cmdBuffers[cmdBufferIndex], 0, 1, &vertexBuffer.bufferHandle, &vertexOffset);
-        deviceContext->vkCmdDraw(cmdBuffers[cmdBufferIndex], 3, 1, 0, 0);
-
-        // Dispatch
-        /*VkQueue presentQueue;
-        deviceContext->vkGetDeviceQueue(deviceContext->device, queueFamilyIndices[0], 0, &presentQueue);*/
-        const VkPipelineStageFlags stageFlags[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        VkSubmitInfo presentSubmitInfo;
-        presentSubmitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        presentSubmitInfo.pNext                = nullptr;
-        presentSubmitInfo.waitSemaphoreCount   = 1;
-        presentSubmitInfo.pWaitSemaphores      = &window->swapchain->presentationSemaphore;
-        presentSubmitInfo.pWaitDstStageMask    = stageFlags;
-        presentSubmitInfo.commandBufferCount   = 1;
-        presentSubmitInfo.pCommandBuffers      = &cmdBuffers[cmdBufferIndex];
-        presentSubmitInfo.signalSemaphoreCount = 1;
-        presentSubmitInfo.pSignalSemaphores    = &window->swapchain->renderingDoneSemaphore;
+        // Take ownership of finished uploads before drawing with them
+        deviceContext->stagingRing->acquireUploads(frame.commandBuffer);
+        deviceContext->vkCmdBindPipeline(frame.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vps.pipeline);
+        vps.recordDynamicState(frame.commandBuffer);
+        deviceContext->vkCmdBeginRenderPass(frame.commandBuffer, &renderPassBegin, VK_SUBPASS_CONTENTS_INLINE);
+        deviceContext->vkCmdBindVertexBuffers(frame.commandBuffer, 0, 1, &vertexBuffer.bufferHandle, &vertexOffset);
+        deviceContext->vkCmdDraw(frame.commandBuffer, 3, 1, 0, 0);
 
         // End render pass
-        deviceContext->vkCmdEndRenderPass(cmdBuffers[cmdBufferIndex]);
-        window->swapchain->setImageLayout(cmdBuffers[cmdBufferIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-        deviceContext->vkEndCommandBuffer(cmdBuffers[cmdBufferIndex]);
-        assert(deviceContext->vkQueueSubmit(presentQueue, 1, &presentSubmitInfo, submitFences[cmdBufferIndex]) == VK_SUCCESS);
-        // assert(deviceContext->vkQueueSubmit(presentQueue, 1, &presentSubmitInfo, VK_NULL_HANDLE) == VK_SUCCESS);
+        deviceContext->vkCmdEndRenderPass(frame.commandBuffer);
+        window->swapchain->setImageLayout(frame.commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+
+        // Dispatch
+        framePacer.endFrame(presentQueue);
 
         // Present
         try{
-            window->swapchain->present(presentQueue);
+            window->swapchain->present(presentQueue, frame);
         }catch(std::runtime_error err){
             std::cout << "Present error: " << err.what() << std::endl;
         }
-        // deviceContext->vkWaitForFences(deviceContext->device, 1, &submitFences[nextCmdBufferIndex], VK_TRUE, 0x1000000);
-        // deviceContext->vkResetFences(deviceContext->device, 1, &submitFences[nextCmdBufferIndex]);
-        if (frameCount >= window->swapchain->imageCount-1){
-            deviceContext->vkResetFences(deviceContext->device, 1, &submitFences[nextCmdBufferIndex]);
-            renderPool->resetCommandBuffer(cmdBuffers[nextCmdBufferIndex], VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
-        }
         frameCount = (frameCount + 1) % (std::numeric_limits<uint32_t>::max)();
-        assert( deviceContext->vkBeginCommandBuffer(cmdBuffers[nextCmdBufferIndex], &cmdBufferBeginInfo) == VK_SUCCESS);
 
         // std::cout << "Frame #" << frameCount << std::endl;
 
@@ -231,17 +192,31 @@ int main(){
             MSG message;
 
             while( PeekMessage(&message, nullptr, 0, 0, PM_REMOVE)){
+                if(message.message == WM_QUIT){
+                    running = false;
+                }
                 TranslateMessage(&message);
                 DispatchMessage(&message);  
             }
+        #elif defined (__linux__)
+            xcb_generic_event_t *event;
+
+            while((event = xcb_poll_for_event(window->windowInstance))){
+                // Closing the window ends the loop
+                if((event->response_type & ~0x80) == XCB_CLIENT_MESSAGE && ((xcb_client_message_event_t*)event)->data.data32[0] == window->deleteWindowAtom){
+                    running = false;
+                }
+                free(event);
+            }
         #endif
     }
 
     // Wait
     // std::cin.get();
     assert(deviceContext->vkDeviceWaitIdle(deviceContext->device) == VK_SUCCESS);
-    renderPool->freeCommandBuffers(window->swapchain->imageCount, &cmdBuffers);
-    delete renderPool;
+
+    // The device is never deleted, so write compiled pipelines out for the next run here
+    deviceContext->pipelineCache->save();
 
     return 0;
 }
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <cassert>
 #include <chrono>
+#include <fstream>
 #include <regex>
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -10,15 +11,16 @@
 #include <glm/gtc/matrix_transform.hpp> // glm::translate, glm::rotate, glm::scale, glm::perspective
 #include <glm/gtc/constants.hpp> // glm::pi
 #include <glm/gtc/type_ptr.hpp>
-#ifndef STB_IMAGE_IMPLEMENTATION
-    #define STB_IMAGE_IMPLEMENTATION
-    #include <stb/stb_image.h>
-#endif
 #include "VulkanDriverInstance.h"
 #include "VulkanBuffer.h"
+#include "VulkanTextureStreamer.h"
 #include "VulkanRenderPass.h"
 #include "VulkanSwapchain.h"
+#include "VulkanFramePacer.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanPipelineCache.h"
 #include "VulkanPipelineState.h"
+#include "VulkanRenderGraph.h"
 
 struct uniformLayoutStruct{
     glm::mat4 MVP;
@@ -35,6 +37,7 @@ struct Vertex{
 #define VERTICAL_FOV 0.25
 #define MILLISECONDS_TO_SECONDS 1000
 #define FRAME_RATE_UPDATE_INTERVAL 5
+#define FRAMES_IN_FLIGHT 2
 
 #if defined (_WIN32) || defined (_WIN64)
 #include "win32Window.h"
@@ -228,19 +231,12 @@ int main(int argc, char **argv){
     window = new XcbWindow(windowWidth, windowHeight, &instance, deviceContext, instance.physicalDevices[0], "Linux XCB Vulkan - Textured Cube", sampleCountFlag);
 #endif
 
-    // Load image data
-    int x, y, numChannels;
-    stbi_uc* imageData = stbi_load("blkmarbl.png", &x, &y, &numChannels, STBI_rgb_alpha);
-    assert(x > 0);
-    assert(y > 0);
-    assert(numChannels > 0);
-    uint32_t width = (uint32_t)x;
-    uint32_t height = (uint32_t)y;
-    uint32_t imageSize = (uint32_t)x*y*numChannels;
+    // Frames are recorded while the GPU is still working on the previous one
+    VulkanFramePacer framePacer(deviceContext, window->swapchain->queueFamilyIndices[0], FRAMES_IN_FLIGHT);
 
-    VulkanImage cubeImage(deviceContext, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, {width, height, 1});
-    VkImageView cubeView = cubeImage.createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
-    cubeImage.loadImageData(imageData, imageSize, {width, height, 1});
+    // Stream the mip levels of the cooked, block-compressed texture when it has been built, otherwise decode the PNG in the background
+    VulkanTextureStreamer textureStreamer(&framePacer);
+    VulkanTextureHandle cubeTextureHandle = textureStreamer.requestTexture(std::ifstream("blkmarbl.ktx2").good() ? "blkmarbl.ktx2" : "blkmarbl.png");
 
     // Create Sampler
     VkSampler sampler;
@@ -260,19 +256,13 @@ int main(int argc, char **argv){
     samplerInfo.compareEnable           = VK_FALSE;
     samplerInfo.compareOp               = VK_COMPARE_OP_ALWAYS;
     samplerInfo.minLod                  = 0.0f;
-    samplerInfo.maxLod                  = 1.0f;
+    samplerInfo.maxLod                  = VK_LOD_CLAMP_NONE;    // Streamed textures change their mip count
     samplerInfo.borderColor             = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
     samplerInfo.unnormalizedCoordinates = VK_FALSE;
 
     assert(deviceContext->vkCreateSampler(deviceContext->device, &samplerInfo, nullptr, &sampler) == VK_SUCCESS);
 
-    // Add sample uniform
-    VkDescriptorPoolSize samplerPoolSize;
-    samplerPoolSize.type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerPoolSize.descriptorCount = 1;
-
     // Generate descriptor
-    VkDescriptorPool * samplerPool = deviceContext->getDescriptorPool({samplerPoolSize});
     VkDescriptorSetLayoutBinding samplerLayoutBinding;
     samplerLayoutBinding.binding            = 0;
     samplerLayoutBinding.descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -280,26 +270,9 @@ int main(int argc, char **argv){
     samplerLayoutBinding.stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;
     samplerLayoutBinding.pImmutableSamplers = nullptr;
     vps.addDescriptorSetLayoutBindings(0, {samplerLayoutBinding});
-    std::vector<VkDescriptorSet> samplerDescriptorVector = vps.generateDescriptorSets(*samplerPool);
-
-    // Write descriptor
-    VkDescriptorImageInfo samplerImageInfo;
-    samplerImageInfo.sampler        = sampler;
-    samplerImageInfo.imageView      = cubeImage.imageViewHandle;
-    samplerImageInfo.imageLayout    = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    VkWriteDescriptorSet samplerDescriptorWrite;
-    samplerDescriptorWrite.sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    samplerDescriptorWrite.pNext            = nullptr;
-    samplerDescriptorWrite.dstSet           =  samplerDescriptorVector[0];
-    samplerDescriptorWrite.dstBinding       = 0;
-    samplerDescriptorWrite.dstArrayElement  = 0;
-    samplerDescriptorWrite.descriptorCount  = 1;
-    samplerDescriptorWrite.descriptorType   = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    samplerDescriptorWrite.pImageInfo       = &samplerImageInfo;
-    samplerDescriptorWrite.pBufferInfo      = nullptr;
-    samplerDescriptorWrite.pTexelBufferView = nullptr;
-    deviceContext->vkUpdateDescriptorSets(deviceContext->device, 1, &samplerDescriptorWrite, 0, nullptr);
+    // Only the layout is kept; the texture's view changes as it streams, so its set is written every frame
+    vps.generateDescriptorSets();
+    VulkanDescriptorWriter descriptorWriter(deviceContext);
 
     VkVertexInputBindingDescription vertexBindingDescription;
     vertexBindingDescription.binding    = 0;
@@ -328,14 +301,12 @@ int main(int argc, char **argv){
     std::vector<VkVertexInputAttributeDescription> attributeDescriptions = { positionInputDescription, normalInputDescription, texCoordBindingDescription };
     vps.setPrimitiveState(bindingDescriptions, attributeDescriptions, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
 
+    // Viewport and scissor are set per frame, so resizing never rebuilds the pipeline
+    vps.setDynamicState({ VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR });
     VkRect2D scissorRect = { { 0, 0 }, window->swapchain->extent };
     vps.setViewportState(window->swapchain->extent, scissorRect);
     window->swapchain->setPipelineState(&vps);
 
-    // Do rendering
-    VulkanCommandPool * renderPool      = deviceContext->getCommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, window->swapchain->queueFamilyIndices[0]);
-    VkCommandBuffer * cmdBuffers         = renderPool->getCommandBuffers(VK_COMMAND_BUFFER_LEVEL_PRIMARY, window->swapchain->imageCount);
-
     window->swapchain->createRenderpass();
 
     // Pipeline layout setup
@@ -360,23 +331,16 @@ int main(int argc, char **argv){
     vps.addShaderStage("frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT, "main");
     vps.complete();
 
-    VkCommandBufferBeginInfo cmdBufferBeginInfo;
-    cmdBufferBeginInfo.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cmdBufferBeginInfo.pNext            = nullptr;
-    cmdBufferBeginInfo.flags            = 0;
-    cmdBufferBeginInfo.pInheritanceInfo = nullptr;
-    
-    // Set up submit fences
-    std::vector<VkFence> submitFences;
-    submitFences.resize(window->swapchain->imageCount);
-    
-    for (uint32_t i = 0; i < window->swapchain->imageCount; i++) {
-        VkFenceCreateInfo submitFenceInfo;
-        submitFenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        submitFenceInfo.pNext = nullptr;
-        submitFenceInfo.flags = 0; // Unsignaled state
-        assert(deviceContext->vkCreateFence(deviceContext->device, &submitFenceInfo, nullptr, &submitFences[i]) == VK_SUCCESS);
-    }
+    // The main pass runs through the render graph, which derives its barriers, load and store ops and the
+    // transition to present. It is rebuilt whenever the swapchain is, since its attachments follow the extent.
+    // Depth and multisampled colour belong to the graph, the swapchain only creates its own in setupFramebuffers.
+    VulkanRenderGraph renderGraph(deviceContext);
+    VulkanGraphResource backbuffer = 0;
+    VkDescriptorSet samplerDescriptorSet = VK_NULL_HANDLE;
+    VkClearValue colorClearValue;
+    colorClearValue.color = {0.7f, 0.7f, 0.7f, 1.0f};
+    VkClearValue depthClearValue;
+    depthClearValue.depthStencil = {1.0f, 0};
 
     uint32_t frameCount = 0;
     VkQueue presentQueue;
@@ -388,22 +352,44 @@ int main(int argc, char **argv){
     double accumulatedTime = 0.0;
     uint32_t frameCountStart = 0;
 
-    // Render loop
-    while(true){
-        int cmdBufferIndex = (int)frameCount % window->swapchain->imageCount;
-        int nextCmdBufferIndex = (cmdBufferIndex == (window->swapchain->imageCount - 1)) ? 0 : (cmdBufferIndex + 1);
-        int prevCmdBufferIndex = (cmdBufferIndex == 0) ? (window->swapchain->imageCount - 1) : (cmdBufferIndex - 1);
-
-        assert( deviceContext->vkBeginCommandBuffer(cmdBuffers[cmdBufferIndex], &cmdBufferBeginInfo) == VK_SUCCESS);
+    // Send off uploads recorded during setup in a single submit; the first frame draws with them
+    deviceContext->stagingRing->wait(deviceContext->stagingRing->submit());
 
-        if(frameCount == 0){
-            window->swapchain->setupFramebuffers(cmdBuffers[0]);
-        }
+    // Render loop
+    // Runs until the window is closed, then shuts down so the pipeline cache gets saved
+    bool running = true;
+    while(running){
+        VulkanFrame& frame = framePacer.beginFrame();
+        window->swapchain->acquireNextImage(frame);
 
         if(window->swapchain->dirtyFramebuffers){
-            std::cout << "Recreating Framebuffers" << std::endl;
-            assert(deviceContext->vkDeviceWaitIdle(deviceContext->device) == VK_SUCCESS);
-            window->swapchain->setupFramebuffers(cmdBuffers[cmdBufferIndex]);
+            std::cout << "Recreating Render Graph" << std::endl;
+            window->swapchain->dirtyFramebuffers = false;
+            renderGraph.reset();
+
+            // Attachments are declared in the swapchain render pass's order, so the pipeline built against it stays compatible
+            // The acquire semaphore is waited on at colour attachment output, so the old contents are dropped and the transition out of present starts there
+            backbuffer = renderGraph.importImage("backbuffer", window->swapchain->swapchainImages[window->swapchain->swapchainImageIndex], VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+            VulkanGraphResource depth = renderGraph.createImage("depth", window->swapchain->swapchainDepthFormat, window->swapchain->extent, sampleCountFlag);
+            VulkanGraphPass mainPass = renderGraph.addPass("main", true, [&](VkCommandBuffer commandBuffer){
+                deviceContext->vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &samplerDescriptorSet, 0, nullptr);
+                deviceContext->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vps.pipeline);
+                vps.recordDynamicState(commandBuffer);
+                deviceContext->vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.bufferHandle, &vertexOffset);
+                deviceContext->vkCmdBindIndexBuffer(commandBuffer, indexBuffer.bufferHandle, 0, VK_INDEX_TYPE_UINT16);
+                deviceContext->vkCmdDrawIndexed(commandBuffer, numIndices, 1, 0, 0, 0);
+            });
+            if(sampleCountFlag != VK_SAMPLE_COUNT_1_BIT){
+                // Render multisampled and resolve into the swapchain image
+                VulkanGraphResource multisampleColor = renderGraph.createImage("multisampleColor", window->swapchain->swapchainFormat, window->swapchain->extent, sampleCountFlag);
+                renderGraph.resolve(mainPass, multisampleColor, backbuffer);
+                renderGraph.writeDepth(mainPass, depth, &depthClearValue);
+                renderGraph.writeColor(mainPass, multisampleColor, &colorClearValue);
+            }else{
+                renderGraph.writeColor(mainPass, backbuffer, &colorClearValue);
+                renderGraph.writeDepth(mainPass, depth, &depthClearValue);
+            }
+            renderGraph.compile();
 
             // Update Projection Matrix
             float fWidth = (float)window->swapchain->extent.width;
@@ -442,58 +428,31 @@ int main(int argc, char **argv){
             start = end;
         }
 
-        // Begin the render pass
-        uint32_t numClearValues = (sampleCountFlag != VK_SAMPLE_COUNT_1_BIT) ? 4 : 2;
-        std::vector<VkClearValue> clearValues(numClearValues);
-        clearValues[0].color = {0.7f, 0.7f, 0.7f, 1.0f};
-        clearValues[1].depthStencil = {1.0f, 0};
-        if(sampleCountFlag != VK_SAMPLE_COUNT_1_BIT){
-            clearValues[2].color = {0.7f, 0.7f, 0.7f, 1.0f};
-            clearValues[3].depthStencil = {1.0f, 0};
-        }
+        // Each face maps the whole texture, so ask for the level a face-on face would need at the cube's distance
+        float cubeDistance  = glm::length(glm::vec3(glm::inverse(View)[3]));
+        float faceExtent    = window->swapchain->extent.height / (cubeDistance * std::tan(glm::pi<float>() * ((float)VERTICAL_FOV) * 0.5f));  // Faces are 2 units across
+        textureStreamer.requestFootprint(cubeTextureHandle, faceExtent * faceExtent);
+
+        // Upload textures decoded since the last frame, then take ownership of finished uploads before drawing with them
+        textureStreamer.update();
+        deviceContext->stagingRing->acquireUploads(frame.commandBuffer);
 
-        VkRenderPassBeginInfo renderPassBegin;
-        renderPassBegin.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassBegin.pNext           = nullptr;
-        renderPassBegin.renderPass      = window->swapchain->renderPass;
-        renderPassBegin.framebuffer     = window->swapchain->getCurrentFramebuffer();
-        renderPassBegin.renderArea      = {{0,0}, window->swapchain->extent};
-        renderPassBegin.clearValueCount = clearValues.size();
-        renderPassBegin.pClearValues    = &clearValues[0];
-
-        deviceContext->vkQueueWaitIdle(presentQueue);
-		// Bind Descriptor Sets
-		deviceContext->vkCmdBindDescriptorSets(cmdBuffers[cmdBufferIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0, 1, &samplerDescriptorVector[0], 0, nullptr);
+        // Sample the placeholder or whichever levels are resident through a set that only lives this frame
+        deviceContext->descriptorAllocator->allocateTransientSets(frame, vps.descriptorSetLayouts.at(0), 1, &samplerDescriptorSet);
+        descriptorWriter.writeImage(samplerDescriptorSet, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, sampler, textureStreamer.getImageView(cubeTextureHandle), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        descriptorWriter.update();
         // Update Push Constants
-        // deviceContext->vkCmdPushConstants(cmdBuffers[cmdBufferIndex], layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uniformStruct), &uniformStruct);
-        deviceContext->vkCmdBindPipeline(cmdBuffers[cmdBufferIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, vps.pipeline);
-        deviceContext->vkCmdBeginRenderPass(cmdBuffers[cmdBufferIndex], &renderPassBegin, VK_SUBPASS_CONTENTS_INLINE);
-        deviceContext->vkCmdBindVertexBuffers(cmdBuffers[cmdBufferIndex], 0, 1, &vertexBuffer.bufferHandle, &vertexOffset);
-        deviceContext->vkCmdBindIndexBuffer(cmdBuffers[cmdBufferIndex], indexBuffer.bufferHandle, 0, VK_INDEX_TYPE_UINT16);
-        deviceContext->vkCmdDrawIndexed(cmdBuffers[cmdBufferIndex], numIndices, 1, 0, 0, 0);
+        // deviceContext->vkCmdPushConstants(frame.commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uniformStruct), &uniformStruct);
+
+        renderGraph.setImportedImage(backbuffer, window->swapchain->swapchainImages[window->swapchain->swapchainImageIndex]);
+        renderGraph.execute(frame.commandBuffer);
 
         // Dispatch
-        const VkPipelineStageFlags stageFlags[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        VkSubmitInfo presentSubmitInfo;
-        presentSubmitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        presentSubmitInfo.pNext                = nullptr;
-        presentSubmitInfo.waitSemaphoreCount   = 1;
-        presentSubmitInfo.pWaitSemaphores      = &window->swapchain->presentationSemaphore;
-        presentSubmitInfo.pWaitDstStageMask    = stageFlags;
-        presentSubmitInfo.commandBufferCount   = 1;
-        presentSubmitInfo.pCommandBuffers      = &cmdBuffers[cmdBufferIndex];
-        presentSubmitInfo.signalSemaphoreCount = 1;
-        presentSubmitInfo.pSignalSemaphores    = &window->swapchain->renderingDoneSemaphore;
-
-        // End render pass
-        deviceContext->vkCmdEndRenderPass(cmdBuffers[cmdBufferIndex]);
-        window->swapchain->setImageLayout(cmdBuffers[cmdBufferIndex], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
-        deviceContext->vkEndCommandBuffer(cmdBuffers[cmdBufferIndex]);
-        assert(deviceContext->vkQueueSubmit(presentQueue, 1, &presentSubmitInfo, submitFences[cmdBufferIndex]) == VK_SUCCESS);
+        framePacer.endFrame(presentQueue);
 
         // Present
         try{
-            window->swapchain->present(presentQueue);
+            window->swapchain->present(presentQueue, frame);
         }catch(std::runtime_error err){
             std::cout << "Present error: " << err.what() << std::endl;
         }
@@ -501,10 +460,6 @@ int main(int argc, char **argv){
         // Update timer
         end = std::chrono::high_resolution_clock::now();
 
-        if( frameCount > 0){
-            deviceContext->vkResetFences(deviceContext->device, 1, &submitFences[prevCmdBufferIndex]);
-            renderPool->resetCommandBuffer(cmdBuffers[prevCmdBufferIndex], VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
-        }
         frameCount = (frameCount == (std::numeric_limits<uint32_t>::max)()) ? 0 : (frameCount + 1);
 
         // std::cout << "Frame #" << frameCount << std::endl;
@@ -513,6 +468,9 @@ int main(int argc, char **argv){
             MSG message;
 
             while( PeekMessage(&message, nullptr, 0, 0, PM_REMOVE)){
+                if(message.message == WM_QUIT){
+                    running = false;
+                }
                 TranslateMessage(&message);
                 DispatchMessage(&message);  
             }
@@ -533,6 +491,12 @@ int main(int argc, char **argv){
                             }
                         }
                         break;
+                    case XCB_CLIENT_MESSAGE:
+                        // Closing the window ends the loop
+                        if(((xcb_client_message_event_t*)event)->data.data32[0] == window->deleteWindowAtom){
+                            running = false;
+                        }
+                        break;
                     default:
                         break;
                 }
@@ -543,11 +507,12 @@ int main(int argc, char **argv){
         #endif
     }
 
-    delete window;
+    // The swapchain goes with the window, so wait for the frames still using it
     assert(deviceContext->vkDeviceWaitIdle(deviceContext->device) == VK_SUCCESS);
-    renderPool->freeCommandBuffers(window->swapchain->imageCount, &cmdBuffers);
-    delete[] cmdBuffers;
-    delete renderPool;
+    delete window;
+
+    // The device is never deleted, so write compiled pipelines out for the next run here
+    deviceContext->pipelineCache->save();
 
     return 0;
 }
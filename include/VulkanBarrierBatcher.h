@@ -0,0 +1,38 @@
+#ifndef __VULKAN_BARRIER_BATCHER_H__
+#define __VULKAN_BARRIER_BATCHER_H__
+
+#include <set>
+#include "VulkanDriverInstance.h"
+
+struct VulkanDevice;
+class VulkanImage;
+
+// Collects image transitions for one command buffer and records them as a single
+// vkCmdPipelineBarrier. Each transition is checked against the layout and last access
+// the image tracks for every mip level and array layer, so subresources already in the
+// right state cost nothing, and neighbouring subresources coming from the same state
+// share one barrier. Transitions that touch a subresource already waiting in the batch
+// flush it first, since one barrier can't order two layout changes of the same texels.
+class VulkanBarrierBatcher{
+public:
+    VulkanBarrierBatcher(VulkanDevice * __deviceContext, VkCommandBuffer __commandBuffer);
+    ~VulkanBarrierBatcher();
+
+    static VkAccessFlags getLayoutAccess(VkImageLayout layout);
+    static VkPipelineStageFlags getLayoutStages(VkImageLayout layout);
+    static bool isWriteAccess(VkAccessFlags access);
+    void flush();
+    void transition(VulkanImage& image, VkImageLayout newLayout, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess, bool discard = false);
+    void transition(VulkanImage& image, const VkImageSubresourceRange& subresourceRange, VkImageLayout newLayout, VkPipelineStageFlags dstStages, VkAccessFlags dstAccess, bool discard = false);
+
+    VulkanDevice *                          deviceContext;
+    VkCommandBuffer                         commandBuffer;
+
+private:
+    std::vector<VkImageMemoryBarrier>       imageBarriers;
+    std::set< std::pair<VkImage, uint32_t> > pendingSubresources;   // Subresources with a barrier in the batch
+    VkPipelineStageFlags                    srcStages;
+    VkPipelineStageFlags                    dstStages;
+};
+
+#endif
@@ -12,29 +12,70 @@
 #include <cstring>
 #include "VulkanCommandPool.h"
 #include "VulkanDriverInstance.h"
+#include "VulkanStagingRing.h"
+
+// Typed view of part of a mapped buffer, writes become GPU-visible on VulkanBuffer::flush
+template<typename T>
+struct VulkanWriteSpan{
+    T *         data;
+    uint32_t    count;
+
+    T& operator[](uint32_t index){ return data[index]; }
+    T * begin(){ return data; }
+    T * end(){ return data + count; }
+};
 
 class VulkanBuffer{
 private:
+    void markDirty(VkDeviceSize offset, VkDeviceSize dataSize);
+
+    VkDeviceSize dirtyBegin;    // Range written through spans since the last flush
+    VkDeviceSize dirtyEnd;
 
 public:
     VulkanBuffer(VulkanDevice * __deviceContext, VkBufferUsageFlags usage, const void * data, const uint32_t dataSize, const bool __hostVisible );
     ~VulkanBuffer();
-    void copyBuffer(const VulkanBuffer& srcBuffer, uint32_t offset, uint32_t dataSize);
-    void copyHostData(const void * data, uint32_t offset, uint32_t size);
+    VulkanUploadToken copyBuffer(const VulkanBuffer& srcBuffer, uint32_t offset, uint32_t dataSize);
+    VulkanUploadToken copyHostData(const void * data, uint32_t offset, uint32_t size);
+    void flush();
+
+    // Host-visible buffers stay mapped, so many small writes cost no more than the
+    // stores themselves; one flush afterwards covers them all
+    template<typename T>
+    VulkanWriteSpan<T> getWriteSpan(uint32_t offset, uint32_t count){
+        assert((hostVisible || directWrite) && bufferAllocation.mappedData != nullptr);
+        assert(offset % alignof(T) == 0);
+        assert(offset + (VkDeviceSize)count * sizeof(T) <= payloadSize);
+        markDirty(offset, (VkDeviceSize)count * sizeof(T));
+
+        VulkanWriteSpan<T> span;
+        span.data   = reinterpret_cast<T *>(static_cast<char *>(bufferAllocation.mappedData) + offset);
+        span.count  = count;
+        return span;
+    }
 
     VkBuffer bufferHandle;
     VkBufferCreateInfo bufferInfo;
     VulkanDevice * deviceContext;
-    VkDeviceMemory bufferMemory;
-    VkMemoryAllocateInfo bufferAllocateInfo;
+    VulkanMemoryAllocation bufferAllocation;
     bool hostVisible;
+    bool directWrite;   // Device-local memory the host writes directly, no staging
     VkMemoryRequirements memoryRequirements;
     uint32_t payloadSize;
-    static std::shared_ptr<VulkanCommandPool> copyCommandPool; 
+};
+
+// Last known state of one mip level of one array layer
+struct VulkanSubresourceState{
+    VkImageLayout               layout;
+    VkPipelineStageFlags        stages;             // Stages that accessed it since the last barrier
+    VkAccessFlags               access;
 };
 
 class VulkanImage{
 private:
+    void resetSubresourceStates(VkImageLayout initialLayout);
+    VulkanUploadToken uploadRegions(const void * data, const uint32_t dataSize, const std::vector<VkBufferImageCopy>& imageCopies, VkImageLayout releaseLayout);
+
     bool                        externalImage;
     VkImageCreateInfo           imageCreateInfo;
 
@@ -73,20 +114,34 @@ public:
 
     static bool isRGBAOrder(VkFormat format);
     static uint32_t bytesPerPixel(VkFormat format);
+    static VkExtent3D blockExtent(VkFormat format);
+    static uint32_t bytesPerBlock(VkFormat format);
+    static VkDeviceSize imageDataSize(VkFormat format, VkExtent3D extent);
+    static VkImageAspectFlags formatAspect(VkFormat format);
+    static uint32_t mipLevelCount(VkExtent3D extent);
     void blitImage(VkCommandBuffer commandBuffer, VulkanImage& destImage, VkImageBlit *blitPtr = nullptr, VkFilter filter = VK_FILTER_LINEAR);
+    bool canBlitMipmaps();
     VkImageView createImageView(VkImageViewType __imageViewType, VkImageAspectFlags __imageAspect, uint32_t __baseMipLevel = 0, uint32_t __baseArrayLayer = 0);
     void copyImageToBuffer(VkCommandBuffer commandBuffer, VulkanBuffer& destBuffer, VkBufferImageCopy *imageCopyPtr = nullptr);
+    void generateMipmaps(VkCommandBuffer commandBuffer, uint32_t baseArrayLayer = 0, uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS);
     const VkImageCreateInfo& getImageCreateInfo(){return imageCreateInfo;};
-    void loadImageData(const void * data, const uint32_t dataSize, VkExtent3D copyExtent, VkImageSubresourceLayers copySubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, VkOffset3D copyOffset = {0, 0, 0});
+    VkImageLayout getLayout(uint32_t mipLevel = 0, uint32_t arrayLayer = 0);
+    VkImageSubresourceRange getSubresourceRange();
+    VulkanSubresourceState& getSubresourceState(uint32_t mipLevel, uint32_t arrayLayer);
+    VulkanUploadToken loadImageData(const void * data, const uint32_t dataSize, VkExtent3D copyExtent, VkImageSubresourceLayers copySubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1}, VkOffset3D copyOffset = {0, 0, 0});
+    VulkanUploadToken loadImageDataWithMips(const void * data, const uint32_t dataSize, uint32_t baseArrayLayer = 0, uint32_t layerCount = 1);
+    VulkanUploadToken loadImageMipChain(const void * data, const uint32_t dataSize, const std::vector<VkBufferImageCopy>& mipCopies);
     void saveImage(const std::string& imageFileName);
     void setImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout);
+    void setSubresourceState(const VkImageSubresourceRange& subresourceRange, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access);
+    static void writeImageFile(const std::string& imageFileName, const void * data, uint32_t width, uint32_t height, uint32_t rowPitch, bool raw = false);
 
     VulkanDevice *              deviceContext;
     VkImage                     imageHandle;
-    VkDeviceMemory              imageMemory;
+    VulkanMemoryAllocation      imageAllocation;
     VkImageView                 imageViewHandle;
     VkImageViewCreateInfo       imageViewCreateInfo;
-    VkImageLayout               layout;
+    std::vector<VulkanSubresourceState> subresourceStates;  // Mip levels of layer 0, then of layer 1, ...
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,68 @@
+#ifndef __VULKAN_COMMAND_RECORDER_H__
+#define __VULKAN_COMMAND_RECORDER_H__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "VulkanDriverInstance.h"
+#include "VulkanCommandPool.h"
+#include "VulkanFramePacer.h"
+
+struct VulkanDevice;
+class VulkanCommandPool;
+
+// Records draws [firstDraw, firstDraw + drawCount) into a secondary command buffer.
+// Secondary buffers inherit no bound state, so the job binds its own pipeline,
+// descriptor sets, vertex buffers and dynamic state.
+typedef std::function<void(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t drawCount)> VulkanRecordJob;
+
+// Command buffers one worker owns for one frame slot. Only that worker touches the
+// pool, and it is reset as a whole the first time the slot is used in a new frame.
+struct VulkanWorkerCommands{
+    VulkanCommandPool *             commandPool;
+    std::vector<VkCommandBuffer>    commandBuffers;     // Allocated on demand, reused after a reset
+    uint32_t                        usedCount;          // Handed out since the last reset
+    uint64_t                        frameNumber;        // Frame the pool was last reset for
+};
+
+struct VulkanRecordTask{
+    const VulkanRecordJob *                 job;
+    const VkCommandBufferInheritanceInfo *  inheritanceInfo;
+    uint32_t                                frameIndex;
+    uint64_t                                frameNumber;
+    uint32_t                                firstDraw;
+    uint32_t                                drawCount;
+    VkCommandBuffer *                       result;     // Where the recorded secondary buffer goes
+};
+
+// Parallel command recording. recordParallel splits a draw list across a pool of
+// worker threads, each recording into secondary command buffers from its own pool,
+// and executes the results in draw order from the frame's primary command buffer.
+class VulkanCommandRecorder{
+public:
+    VulkanCommandRecorder(VulkanFramePacer * __framePacer, uint32_t __workerCount = 0, uint32_t __minDrawsPerTask = 256);
+    ~VulkanCommandRecorder();
+    void recordParallel(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, uint32_t drawCount, const VulkanRecordJob& job);
+
+    VulkanDevice *                      deviceContext;
+    VulkanFramePacer *                  framePacer;
+    uint32_t                            workerCount;
+    uint32_t                            minDrawsPerTask;
+
+private:
+    VkCommandBuffer getCommandBuffer(uint32_t workerIndex, uint32_t frameIndex, uint64_t frameNumber);
+    void workerLoop(uint32_t workerIndex);
+
+    std::vector<VulkanWorkerCommands>   workerCommands;     // framesInFlight * workerCount, indexed by frame then worker
+    std::vector<std::thread>            workers;
+    std::deque<VulkanRecordTask>        taskQueue;
+    std::mutex                          queueMutex;
+    std::condition_variable             queueCondition;     // Signaled when tasks are queued or on shutdown
+    std::condition_variable             doneCondition;      // Signaled when the last pending task finishes
+    uint32_t                            pendingTasks;
+    bool                                stopping;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef __VULKAN_DESCRIPTOR_ALLOCATOR_H__
+#define __VULKAN_DESCRIPTOR_ALLOCATOR_H__
+
+#include <deque>
+#include <mutex>
+#include "VulkanDriverInstance.h"
+
+struct VulkanDevice;
+struct VulkanFrame;
+
+// Pools sized for one set layout. Each pool holds setsPerPool sets of that layout, so
+// allocation never fails part way; when the last pool is full a bigger one is added.
+struct VulkanDescriptorPoolChain{
+    std::vector<VkDescriptorPool>       pools;
+    std::vector<uint32_t>               poolCapacities;     // Sets each pool was created for
+    uint32_t                            currentPool;        // First pool that may still have room
+    uint32_t                            currentPoolUsed;    // Sets handed out from currentPool
+    std::vector<VkDescriptorSet>        freeSets;           // Released sets waiting to be reused
+};
+
+// Everything needed to size a pool for a set layout
+struct VulkanDescriptorSetLayoutInfo{
+    std::vector<VkDescriptorPoolSize>   poolSizes;          // Descriptors of each type in one set
+    VulkanDescriptorPoolChain           chain;              // Long-lived sets, recycled on release
+};
+
+// Set handed back while a frame in flight may still be using it
+struct VulkanReleasedDescriptorSet{
+    VkDescriptorSetLayout               layout;
+    VkDescriptorSet                     set;
+    uint64_t                            frameNumber;        // Frame being recorded when the set was released
+};
+
+// Per-frame pools for sets that only live one frame
+struct VulkanDescriptorFrame{
+    uint64_t                                                frameNumber;    // Frame the pools were last reset for
+    std::map<VkDescriptorSetLayout, VulkanDescriptorPoolChain>  chains;
+};
+
+// Device-wide descriptor allocator. Set layouts are cached by binding signature, so
+// pipelines with matching layouts share both the layout and its pool chain. Long-lived
+// sets are recycled through a free list instead of vkFreeDescriptorSets, once every frame
+// that could still bind them has finished; transient sets come from per-frame pools that
+// are reset as a whole once the frame slot is reused.
+class VulkanDescriptorAllocator{
+public:
+    VulkanDescriptorAllocator(VulkanDevice * __deviceContext, uint32_t __initialSetsPerPool = 16, uint32_t __maxSetsPerPool = 1024);
+    ~VulkanDescriptorAllocator();
+    void allocateSets(VkDescriptorSetLayout layout, uint32_t setCount, VkDescriptorSet * sets);
+    void allocateSets(const std::vector<VkDescriptorSetLayout>& layouts, VkDescriptorSet * sets);
+    void allocateTransientSets(const VulkanFrame& frame, VkDescriptorSetLayout layout, uint32_t setCount, VkDescriptorSet * sets);
+    void beginFrame(uint64_t frameNumber, uint32_t framesInFlight);
+    VkDescriptorSetLayout getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+    void releaseSets(VkDescriptorSetLayout layout, uint32_t setCount, const VkDescriptorSet * sets);
+
+    VulkanDevice *                      deviceContext;
+    uint32_t                            initialSetsPerPool;
+    uint32_t                            maxSetsPerPool;
+
+private:
+    void allocateFromChain(VulkanDescriptorPoolChain& chain, const VulkanDescriptorSetLayoutInfo& layoutInfo, VkDescriptorSetLayout layout, uint32_t setCount, VkDescriptorSet * sets);
+    void resetChain(VulkanDescriptorPoolChain& chain);
+
+    std::map<std::vector<uint64_t>, VkDescriptorSetLayout>          layoutCache;    // Binding signature to layout
+    std::map<VkDescriptorSetLayout, VulkanDescriptorSetLayoutInfo>  layoutInfos;
+    std::vector<VulkanDescriptorFrame>                              frames;         // Indexed by frame slot
+    std::deque<VulkanReleasedDescriptorSet>                         releasedSets;   // Oldest release first
+    uint64_t                                                        currentFrame;
+    uint32_t                                                        framesInFlight;
+    std::mutex                                                      allocatorMutex;
+};
+
+// Collects descriptor writes so a batch of sets is updated with one vkUpdateDescriptorSets.
+// Image and buffer infos are kept in deques so the pointers in the writes stay valid.
+class VulkanDescriptorWriter{
+public:
+    VulkanDescriptorWriter(VulkanDevice * __deviceContext);
+    void update();
+    void writeBuffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range, uint32_t arrayElement = 0);
+    void writeImage(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout, uint32_t arrayElement = 0);
+
+    VulkanDevice *                      deviceContext;
+
+private:
+    std::deque<VkDescriptorBufferInfo>  bufferInfos;
+    std::deque<VkDescriptorImageInfo>   imageInfos;
+    std::vector<VkWriteDescriptorSet>   writes;
+};
+
+#endif
@@ -44,6 +44,7 @@
 #include <memory>
 #include <fstream>
 #include "VulkanCommandPool.h"
+#include "VulkanMemoryAllocator.h"
 
 #define VK_EXPORTED_FUNCTION(function) PFN_##function function
 #define VK_GLOBAL_FUNCTION(function) PFN_##function function
@@ -57,35 +58,54 @@
 typedef VkQueueFamilyProperties * VkQueueFamilyPropertiesPtr;
 
 class VulkanCommandPool;
+class VulkanDescriptorAllocator;
 class VulkanDriverInstance;
+class VulkanMemoryAllocator;
+class VulkanPipelineCache;
+class VulkanResidencyManager;
+class VulkanStagingRing;
+struct VulkanMemoryAllocation;
 
 struct VulkanDevice{
     VulkanDevice(VulkanDriverInstance * __instance, uint32_t __deviceNumber, const VkPhysicalDeviceFeatures * requestedFeatures = nullptr, const VkPhysicalDeviceFeatures * requiredFeatures = nullptr, bool debugPrint = true);
     ~VulkanDevice();
     static bool                         comparePhysicalDeviceFeatureSets(const VkPhysicalDeviceFeatures * featureSetA, const VkPhysicalDeviceFeatures * featureSetB);
     static VkPhysicalDeviceFeatures     filterPhysicalDeviceFeatures(const VkPhysicalDeviceFeatures * featureSetA, const VkPhysicalDeviceFeatures * featureSetB);
-    VkDescriptorPool *                  getDescriptorPool(const std::vector<VkDescriptorPoolSize>& descriptorSizes);
+    uint32_t                            findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags requiredProperties, VkMemoryPropertyFlags preferredProperties = 0, VkMemoryPropertyFlags avoidedProperties = 0, VkDeviceSize allocationSize = 0);
+    VkDescriptorPool                    getDescriptorPool(const std::vector<VkDescriptorPoolSize>& descriptorSizes, uint32_t maxSets, VkDescriptorPoolCreateFlags flags = 0);
     VkPhysicalDevice                    getPhysicalDevice();
     uint32_t                            getUsableMemoryType(uint32_t memoryTypeBits, const VkMemoryPropertyFlags requiredProperties);
-    uint32_t                            getUsableDeviceQueueFamily(const VkQueueFlags requiredProperties);
+    uint32_t                            getUsableDeviceQueueFamily(const VkQueueFlags requiredProperties, const VkQueueFlags excludedProperties = 0);
     VulkanCommandPool *                 getCommandPool(VkCommandPoolCreateFlags flags, uint32_t queueFamilyIndex);
-    //void                                allocateAndBindMemory(VkBuffer buffer, bool hostVisible);
-    VkDeviceMemory                      allocateAndBindMemory(VkImage image, bool hostVisible);
+    VulkanMemoryAllocation              allocateMemory(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags requiredProperties, VkMemoryPropertyFlags preferredProperties, VkMemoryPropertyFlags avoidedProperties, VulkanAllocationType allocationType, bool ignoreBudget = false);
+    VulkanMemoryAllocation              allocateAndBindBufferMemory(VkBuffer buffer, bool hostVisible);
+    VulkanMemoryAllocation              allocateAndBindImageMemory(VkImage image, VkImageTiling tiling, bool hostVisible, bool lazilyAllocated = false);
+    void                                freeMemory(VulkanMemoryAllocation& allocation);
+    void                                flushMappedRange(const VulkanMemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+    void                                invalidateMappedRange(const VulkanMemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size);
     VkFormat                            getSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
     VkSampleCountFlagBits               requestSupportedSampleFlags(uint32_t sampleCount);
 
+    VulkanDescriptorAllocator *         descriptorAllocator;
     VkDevice                            device;
     VulkanDriverInstance *              instance;
     std::vector<VkDescriptorPool>       descriptorPools;
     VkPhysicalDeviceFeatures            deviceFeatures;
+    VkPhysicalDeviceFeatures            enabledFeatures;    // Subset of deviceFeatures the device was created with
     VkFormatProperties                  deviceFormatProperties;
     VkImageFormatProperties             deviceImageFormatProperties;
     VkPhysicalDeviceMemoryProperties    deviceMemoryProperties;
+    bool                                memoryBudgetSupport;
     uint32_t                            deviceNumber;
     VkPhysicalDeviceProperties          deviceProperties;
     uint32_t                            deviceQueueFamilyPropertyCount;
     VkQueueFamilyPropertiesPtr          deviceQueueProperties;
     VkSparseImageFormatProperties       deviceSparseImageFormatProperties;
+    VulkanMemoryAllocator *             memoryAllocator;
+    VulkanPipelineCache *               pipelineCache;
+    VulkanResidencyManager *            residencyManager;
+    VulkanStagingRing *                 stagingRing;
+    bool                                swapchainSupport;
 
     // Device-level Function Pointers
     VK_DEVICE_FUNCTION(vkAllocateCommandBuffers);
@@ -141,6 +161,7 @@ struct VulkanDevice{
     VK_DEVICE_FUNCTION(vkCmdWaitEvents);
     VK_DEVICE_FUNCTION(vkCmdWriteTimestamp);
     VK_DEVICE_FUNCTION(vkEndCommandBuffer);
+    VK_DEVICE_FUNCTION(vkQueueBindSparse);
     VK_DEVICE_FUNCTION(vkQueueSubmit);
 
     // Creation
@@ -234,7 +255,7 @@ struct VulkanDevice{
 
 class VulkanDriverInstance{
 public:
-    VulkanDriverInstance(std::string applicationName);
+    VulkanDriverInstance(std::string applicationName, bool headless = false);
     ~VulkanDriverInstance();
     void enumeratePhysicalDevices(bool debugPrint = true);
 
@@ -247,6 +268,8 @@ public:
     VkInstance                      instance;
     uint32_t                        numPhysicalDevices;
     std::vector<VkPhysicalDevice>   physicalDevices;
+    bool                            properties2Support;
+    bool                            surfaceSupport;
 
     // Exported Function Pointers
     VK_EXPORTED_FUNCTION(vkEnumerateInstanceLayerProperties);
@@ -269,6 +292,9 @@ public:
     VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceQueueFamilyProperties);
     VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceSparseImageFormatProperties);
 
+    // Extensions
+    VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceMemoryProperties2KHR);
+
     // Window System Integration
     VK_INSTANCE_FUNCTION(vkCreateSurfaceKHR);
     VK_INSTANCE_FUNCTION(vkDestroySurfaceKHR);
@@ -0,0 +1,263 @@
+#ifndef __VULKAN_FORMAT_TRAITS_H__
+#define __VULKAN_FORMAT_TRAITS_H__
+
+#include <vulkan/vulkan.h>
+
+enum VulkanChannelOrder{
+    VULKAN_CHANNEL_ORDER_NONE   = 0, // Block, depth/stencil and shared exponent formats
+    VULKAN_CHANNEL_ORDER_RGBA   = 1, // R first, including R, RG and RGB formats
+    VULKAN_CHANNEL_ORDER_BGRA   = 2, // B first, including BGR formats
+    VULKAN_CHANNEL_ORDER_ARGB   = 3,
+    VULKAN_CHANNEL_ORDER_ABGR   = 4
+};
+
+enum VulkanComponentType{
+    VULKAN_COMPONENT_TYPE_NONE      = 0,
+    VULKAN_COMPONENT_TYPE_UNORM     = 1,
+    VULKAN_COMPONENT_TYPE_SNORM     = 2,
+    VULKAN_COMPONENT_TYPE_USCALED   = 3,
+    VULKAN_COMPONENT_TYPE_SSCALED   = 4,
+    VULKAN_COMPONENT_TYPE_UINT      = 5,
+    VULKAN_COMPONENT_TYPE_SINT      = 6,
+    VULKAN_COMPONENT_TYPE_UFLOAT    = 7,
+    VULKAN_COMPONENT_TYPE_SFLOAT    = 8,
+    VULKAN_COMPONENT_TYPE_SRGB      = 9
+};
+
+struct VulkanFormatInfo{
+    VkFormat                    format;
+    uint8_t                     blockSize;          // Bytes per block, a block is one texel for uncompressed formats
+    uint8_t                     blockWidth;         // Texels
+    uint8_t                     blockHeight;        // Texels
+    uint8_t                     channelCount;       // Including alpha, excluding padding and shared exponents
+    uint8_t                     channelBits;        // Width of every channel, 0 when widths differ or for block formats
+    VulkanChannelOrder          channelOrder;       // As named, most significant bits first for packed formats
+    VulkanComponentType         componentType;      // Of the first component; depth for combined depth/stencil
+    VkImageAspectFlags          aspect;
+    VkFormat                    srgbPair;           // The SRGB format of a UNORM format and the other way round, or undefined
+};
+
+// Compile-time traits for every core format, indexed by VkFormat. Lookups are a single
+// array index, so they work in constant expressions, templates and static_asserts.
+// Formats past the core range, such as extension formats, get the VK_FORMAT_UNDEFINED
+// row: no size, one texel blocks and the colour aspect.
+class VulkanFormatTraits{
+public:
+    static constexpr uint32_t formatCount = VK_FORMAT_ASTC_12x12_SRGB_BLOCK + 1;
+
+    static constexpr const VulkanFormatInfo& getInfo(VkFormat format){
+        return (uint32_t)format < formatCount ? formatInfos[format] : formatInfos[VK_FORMAT_UNDEFINED];
+    }
+    static constexpr bool isBlockCompressed(VkFormat format){
+        return getInfo(format).blockWidth > 1;
+    }
+    static constexpr bool isDepthStencil(VkFormat format){
+        return (getInfo(format).aspect & (VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT)) != 0;
+    }
+    static constexpr bool isSrgb(VkFormat format){
+        return getInfo(format).componentType == VULKAN_COMPONENT_TYPE_SRGB;
+    }
+    static constexpr VkFormat getSrgbFormat(VkFormat format){
+        return getInfo(format).componentType == VULKAN_COMPONENT_TYPE_UNORM && getInfo(format).srgbPair != VK_FORMAT_UNDEFINED ? getInfo(format).srgbPair : format;
+    }
+    static constexpr VkFormat getUnormFormat(VkFormat format){
+        return isSrgb(format) ? getInfo(format).srgbPair : format;
+    }
+    static constexpr VkDeviceSize imageDataSize(VkFormat format, VkExtent3D extent){
+        // Tightly packed, partial blocks at the edges take a whole block
+        return (VkDeviceSize)((extent.width + getInfo(format).blockWidth - 1) / getInfo(format).blockWidth) *
+               ((extent.height + getInfo(format).blockHeight - 1) / getInfo(format).blockHeight) * extent.depth * getInfo(format).blockSize;
+    }
+
+    static constexpr VulkanFormatInfo formatInfos[formatCount] = {
+        //                                    Size  Block  Ch Bits Order                       Component                       Aspect                                                    SRGB pair
+        {VK_FORMAT_UNDEFINED,                    0,  1,  1, 0,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_NONE,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R4G4_UNORM_PACK8,             1,  1,  1, 2,  4, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R4G4B4A4_UNORM_PACK16,        2,  1,  1, 4,  4, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B4G4R4A4_UNORM_PACK16,        2,  1,  1, 4,  4, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R5G6B5_UNORM_PACK16,          2,  1,  1, 3,  0, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B5G6R5_UNORM_PACK16,          2,  1,  1, 3,  0, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R5G5B5A1_UNORM_PACK16,        2,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B5G5R5A1_UNORM_PACK16,        2,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A1R5G5B5_UNORM_PACK16,        2,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ARGB,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8_UNORM,                     1,  1,  1, 1,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_R8_SRGB},
+        {VK_FORMAT_R8_SNORM,                     1,  1,  1, 1,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8_USCALED,                   1,  1,  1, 1,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8_SSCALED,                   1,  1,  1, 1,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8_UINT,                      1,  1,  1, 1,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8_SINT,                      1,  1,  1, 1,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8_SRGB,                      1,  1,  1, 1,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_R8_UNORM},
+        {VK_FORMAT_R8G8_UNORM,                   2,  1,  1, 2,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_R8G8_SRGB},
+        {VK_FORMAT_R8G8_SNORM,                   2,  1,  1, 2,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8_USCALED,                 2,  1,  1, 2,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8_SSCALED,                 2,  1,  1, 2,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8_UINT,                    2,  1,  1, 2,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8_SINT,                    2,  1,  1, 2,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8_SRGB,                    2,  1,  1, 2,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_R8G8_UNORM},
+        {VK_FORMAT_R8G8B8_UNORM,                 3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_R8G8B8_SRGB},
+        {VK_FORMAT_R8G8B8_SNORM,                 3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8B8_USCALED,               3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8B8_SSCALED,               3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8B8_UINT,                  3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8B8_SINT,                  3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8B8_SRGB,                  3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_R8G8B8_UNORM},
+        {VK_FORMAT_B8G8R8_UNORM,                 3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_B8G8R8_SRGB},
+        {VK_FORMAT_B8G8R8_SNORM,                 3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B8G8R8_USCALED,               3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B8G8R8_SSCALED,               3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B8G8R8_UINT,                  3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B8G8R8_SINT,                  3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B8G8R8_SRGB,                  3,  1,  1, 3,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_B8G8R8_UNORM},
+        {VK_FORMAT_R8G8B8A8_UNORM,               4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_R8G8B8A8_SRGB},
+        {VK_FORMAT_R8G8B8A8_SNORM,               4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8B8A8_USCALED,             4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8B8A8_SSCALED,             4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8B8A8_UINT,                4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8B8A8_SINT,                4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R8G8B8A8_SRGB,                4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_R8G8B8A8_UNORM},
+        {VK_FORMAT_B8G8R8A8_UNORM,               4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_B8G8R8A8_SRGB},
+        {VK_FORMAT_B8G8R8A8_SNORM,               4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B8G8R8A8_USCALED,             4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B8G8R8A8_SSCALED,             4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B8G8R8A8_UINT,                4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B8G8R8A8_SINT,                4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B8G8R8A8_SRGB,                4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_B8G8R8A8_UNORM},
+        {VK_FORMAT_A8B8G8R8_UNORM_PACK32,        4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_A8B8G8R8_SRGB_PACK32},
+        {VK_FORMAT_A8B8G8R8_SNORM_PACK32,        4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A8B8G8R8_USCALED_PACK32,      4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A8B8G8R8_SSCALED_PACK32,      4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A8B8G8R8_UINT_PACK32,         4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A8B8G8R8_SINT_PACK32,         4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A8B8G8R8_SRGB_PACK32,         4,  1,  1, 4,  8, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_A8B8G8R8_UNORM_PACK32},
+        {VK_FORMAT_A2R10G10B10_UNORM_PACK32,     4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ARGB,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2R10G10B10_SNORM_PACK32,     4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ARGB,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2R10G10B10_USCALED_PACK32,   4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ARGB,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2R10G10B10_SSCALED_PACK32,   4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ARGB,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2R10G10B10_UINT_PACK32,      4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ARGB,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2R10G10B10_SINT_PACK32,      4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ARGB,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2B10G10R10_UNORM_PACK32,     4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2B10G10R10_SNORM_PACK32,     4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2B10G10R10_USCALED_PACK32,   4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2B10G10R10_SSCALED_PACK32,   4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2B10G10R10_UINT_PACK32,      4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_A2B10G10R10_SINT_PACK32,      4,  1,  1, 4,  0, VULKAN_CHANNEL_ORDER_ABGR,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16_UNORM,                    2,  1,  1, 1, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16_SNORM,                    2,  1,  1, 1, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16_USCALED,                  2,  1,  1, 1, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16_SSCALED,                  2,  1,  1, 1, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16_UINT,                     2,  1,  1, 1, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16_SINT,                     2,  1,  1, 1, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16_SFLOAT,                   2,  1,  1, 1, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16_UNORM,                 4,  1,  1, 2, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16_SNORM,                 4,  1,  1, 2, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16_USCALED,               4,  1,  1, 2, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16_SSCALED,               4,  1,  1, 2, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16_UINT,                  4,  1,  1, 2, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16_SINT,                  4,  1,  1, 2, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16_SFLOAT,                4,  1,  1, 2, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16_UNORM,              6,  1,  1, 3, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16_SNORM,              6,  1,  1, 3, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16_USCALED,            6,  1,  1, 3, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16_SSCALED,            6,  1,  1, 3, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16_UINT,               6,  1,  1, 3, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16_SINT,               6,  1,  1, 3, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16_SFLOAT,             6,  1,  1, 3, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16A16_UNORM,           8,  1,  1, 4, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16A16_SNORM,           8,  1,  1, 4, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16A16_USCALED,         8,  1,  1, 4, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_USCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16A16_SSCALED,         8,  1,  1, 4, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SSCALED,  VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16A16_UINT,            8,  1,  1, 4, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16A16_SINT,            8,  1,  1, 4, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R16G16B16A16_SFLOAT,          8,  1,  1, 4, 16, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32_UINT,                     4,  1,  1, 1, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32_SINT,                     4,  1,  1, 1, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32_SFLOAT,                   4,  1,  1, 1, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32G32_UINT,                  8,  1,  1, 2, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32G32_SINT,                  8,  1,  1, 2, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32G32_SFLOAT,                8,  1,  1, 2, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32G32B32_UINT,              12,  1,  1, 3, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32G32B32_SINT,              12,  1,  1, 3, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32G32B32_SFLOAT,            12,  1,  1, 3, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32G32B32A32_UINT,           16,  1,  1, 4, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32G32B32A32_SINT,           16,  1,  1, 4, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R32G32B32A32_SFLOAT,         16,  1,  1, 4, 32, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64_UINT,                     8,  1,  1, 1, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64_SINT,                     8,  1,  1, 1, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64_SFLOAT,                   8,  1,  1, 1, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64G64_UINT,                 16,  1,  1, 2, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64G64_SINT,                 16,  1,  1, 2, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64G64_SFLOAT,               16,  1,  1, 2, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64G64B64_UINT,              24,  1,  1, 3, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64G64B64_SINT,              24,  1,  1, 3, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64G64B64_SFLOAT,            24,  1,  1, 3, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64G64B64A64_UINT,           32,  1,  1, 4, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64G64B64A64_SINT,           32,  1,  1, 4, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SINT,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_R64G64B64A64_SFLOAT,         32,  1,  1, 4, 64, VULKAN_CHANNEL_ORDER_RGBA,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_B10G11R11_UFLOAT_PACK32,      4,  1,  1, 3,  0, VULKAN_CHANNEL_ORDER_BGRA,  VULKAN_COMPONENT_TYPE_UFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_E5B9G9R9_UFLOAT_PACK32,       4,  1,  1, 3,  9, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_D16_UNORM,                    2,  1,  1, 1, 16, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_DEPTH_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_X8_D24_UNORM_PACK32,          4,  1,  1, 1, 24, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_DEPTH_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_D32_SFLOAT,                   4,  1,  1, 1, 32, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_DEPTH_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_S8_UINT,                      1,  1,  1, 1,  8, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UINT,     VK_IMAGE_ASPECT_STENCIL_BIT,                              VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_D16_UNORM_S8_UINT,            3,  1,  1, 2,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,  VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_D24_UNORM_S8_UINT,            4,  1,  1, 2,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,  VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_D32_SFLOAT_S8_UINT,           5,  1,  1, 2,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,  VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_BC1_RGB_UNORM_BLOCK,          8,  4,  4, 3,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_BC1_RGB_SRGB_BLOCK},
+        {VK_FORMAT_BC1_RGB_SRGB_BLOCK,           8,  4,  4, 3,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_BC1_RGB_UNORM_BLOCK},
+        {VK_FORMAT_BC1_RGBA_UNORM_BLOCK,         8,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_BC1_RGBA_SRGB_BLOCK},
+        {VK_FORMAT_BC1_RGBA_SRGB_BLOCK,          8,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_BC1_RGBA_UNORM_BLOCK},
+        {VK_FORMAT_BC2_UNORM_BLOCK,             16,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_BC2_SRGB_BLOCK},
+        {VK_FORMAT_BC2_SRGB_BLOCK,              16,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_BC2_UNORM_BLOCK},
+        {VK_FORMAT_BC3_UNORM_BLOCK,             16,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_BC3_SRGB_BLOCK},
+        {VK_FORMAT_BC3_SRGB_BLOCK,              16,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_BC3_UNORM_BLOCK},
+        {VK_FORMAT_BC4_UNORM_BLOCK,              8,  4,  4, 1,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_BC4_SNORM_BLOCK,              8,  4,  4, 1,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_BC5_UNORM_BLOCK,             16,  4,  4, 2,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_BC5_SNORM_BLOCK,             16,  4,  4, 2,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_BC6H_UFLOAT_BLOCK,           16,  4,  4, 3,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_BC6H_SFLOAT_BLOCK,           16,  4,  4, 3,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SFLOAT,   VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_BC7_UNORM_BLOCK,             16,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_BC7_SRGB_BLOCK},
+        {VK_FORMAT_BC7_SRGB_BLOCK,              16,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_BC7_UNORM_BLOCK},
+        {VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK,      8,  4,  4, 3,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK},
+        {VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK,       8,  4,  4, 3,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK},
+        {VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK,    8,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK},
+        {VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK,     8,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK},
+        {VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK,   16,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK},
+        {VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK,    16,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK},
+        {VK_FORMAT_EAC_R11_UNORM_BLOCK,          8,  4,  4, 1,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_EAC_R11_SNORM_BLOCK,          8,  4,  4, 1,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_EAC_R11G11_UNORM_BLOCK,      16,  4,  4, 2,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_EAC_R11G11_SNORM_BLOCK,      16,  4,  4, 2,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_UNDEFINED},
+        {VK_FORMAT_ASTC_4x4_UNORM_BLOCK,        16,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_4x4_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_4x4_SRGB_BLOCK,         16,  4,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_4x4_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_5x4_UNORM_BLOCK,        16,  5,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_5x4_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_5x4_SRGB_BLOCK,         16,  5,  4, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_5x4_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_5x5_UNORM_BLOCK,        16,  5,  5, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_5x5_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_5x5_SRGB_BLOCK,         16,  5,  5, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_5x5_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_6x5_UNORM_BLOCK,        16,  6,  5, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_6x5_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_6x5_SRGB_BLOCK,         16,  6,  5, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_6x5_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_6x6_UNORM_BLOCK,        16,  6,  6, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_6x6_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_6x6_SRGB_BLOCK,         16,  6,  6, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_6x6_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_8x5_UNORM_BLOCK,        16,  8,  5, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_8x5_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_8x5_SRGB_BLOCK,         16,  8,  5, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_8x5_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_8x6_UNORM_BLOCK,        16,  8,  6, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_8x6_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_8x6_SRGB_BLOCK,         16,  8,  6, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_8x6_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_8x8_UNORM_BLOCK,        16,  8,  8, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_8x8_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_8x8_SRGB_BLOCK,         16,  8,  8, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_8x8_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_10x5_UNORM_BLOCK,       16, 10,  5, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_10x5_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_10x5_SRGB_BLOCK,        16, 10,  5, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_10x5_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_10x6_UNORM_BLOCK,       16, 10,  6, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_10x6_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_10x6_SRGB_BLOCK,        16, 10,  6, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_10x6_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_10x8_UNORM_BLOCK,       16, 10,  8, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_10x8_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_10x8_SRGB_BLOCK,        16, 10,  8, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_10x8_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_10x10_UNORM_BLOCK,      16, 10, 10, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_10x10_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_10x10_SRGB_BLOCK,       16, 10, 10, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_10x10_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_12x10_UNORM_BLOCK,      16, 12, 10, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_12x10_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_12x10_SRGB_BLOCK,       16, 12, 10, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_12x10_UNORM_BLOCK},
+        {VK_FORMAT_ASTC_12x12_UNORM_BLOCK,      16, 12, 12, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_UNORM,    VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_12x12_SRGB_BLOCK},
+        {VK_FORMAT_ASTC_12x12_SRGB_BLOCK,       16, 12, 12, 4,  0, VULKAN_CHANNEL_ORDER_NONE,  VULKAN_COMPONENT_TYPE_SRGB,     VK_IMAGE_ASPECT_COLOR_BIT,                                VK_FORMAT_ASTC_12x12_UNORM_BLOCK}
+    };
+};
+
+#endif
+
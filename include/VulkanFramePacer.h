@@ -0,0 +1,66 @@
+#ifndef __VULKAN_FRAME_PACER_H__
+#define __VULKAN_FRAME_PACER_H__
+
+#include "VulkanDriverInstance.h"
+#include "VulkanCommandPool.h"
+#include "VulkanMemoryAllocator.h"
+
+struct VulkanDevice;
+class VulkanCommandPool;
+
+struct VulkanTransientAllocation{
+    VkBuffer                    buffer;         // Per-frame buffer the data lives in
+    VkDeviceSize                offset;         // Offset of the data within buffer
+    void *                      mappedData;     // Host pointer to the data
+};
+
+// Everything a single frame in flight owns. Only touched again once the GPU has
+// finished with it, so nothing here needs to be synchronized by hand.
+struct VulkanFrame{
+    uint32_t                    frameIndex;             // Slot index, [0, framesInFlight)
+    uint64_t                    frameNumber;            // Frames begun since creation
+    VulkanCommandPool *         commandPool;            // Reset as a whole when the frame begins
+    VkCommandBuffer             commandBuffer;          // Primary command buffer, already begun
+    VkSemaphore                 imageAcquiredSemaphore; // Signaled by the swapchain acquire
+    VkSemaphore                 renderingDoneSemaphore; // Signaled by the frame submit, waited on by present
+    VkFence                     fence;                  // Signaled when the frame submit finishes
+    VkDeviceSize                transientBase;          // Start of this frame's region of the pacer's transient buffer
+    VkDeviceSize                transientOffset;        // Next free byte, relative to transientBase
+};
+
+// Frames-in-flight driver. beginFrame waits only for the frame that last used the
+// slot, so the CPU can record frame N+1 while the GPU is still executing frame N.
+// Transient data lives in one persistently mapped buffer split into a region per
+// frame slot, so offsets handed out for different frames never alias and a single
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor can address any of them.
+class VulkanFramePacer{
+public:
+    VulkanFramePacer(VulkanDevice * __deviceContext, uint32_t __queueFamilyIndex, uint32_t __framesInFlight = 2, VkDeviceSize __transientBufferSize = 4 * 1024 * 1024);
+    ~VulkanFramePacer();
+    VulkanFrame& beginFrame();
+    VulkanFrame& getCurrentFrame();
+    bool isFrameComplete(uint64_t number);
+    VulkanTransientAllocation allocateTransient(VkDeviceSize dataSize, VkDeviceSize alignment);
+    VulkanTransientAllocation allocateUniform(VkDeviceSize dataSize);
+    void addWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags waitStageMask);
+    void endFrame(VkQueue queue, VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, bool presenting = true);
+    void waitIdle();
+
+    VulkanDevice *              deviceContext;
+    uint32_t                    queueFamilyIndex;
+    uint32_t                    framesInFlight;
+    VkDeviceSize                transientBufferSize;    // Bytes available to each frame
+    VkBuffer                    transientBuffer;        // Shared by every frame slot, bind with dynamic offsets
+
+private:
+    std::vector<VulkanFrame>    frames;
+    uint32_t                    currentFrame;
+    uint64_t                    frameNumber;
+    bool                        recording;
+    std::vector<VkSemaphore>    waitSemaphores;         // Extra waits for the frame being recorded, such as sparse binds
+    std::vector<VkPipelineStageFlags>   waitStageMasks;
+    VulkanMemoryAllocation      transientAllocation;
+    VkDeviceSize                transientRegionSize;    // transientBufferSize rounded up to every offset alignment
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef __VULKAN_KTX_TEXTURE_H__
+#define __VULKAN_KTX_TEXTURE_H__
+
+#include "VulkanDriverInstance.h"
+#include "VulkanStagingRing.h"
+
+struct VulkanDevice;
+class VulkanImage;
+
+// KTX2 file header, identifier included, as laid out on disk
+struct VulkanKtx2Header{
+    uint8_t                     identifier[12];
+    uint32_t                    vkFormat;           // VK_FORMAT_UNDEFINED for Basis Universal
+    uint32_t                    typeSize;
+    uint32_t                    pixelWidth;
+    uint32_t                    pixelHeight;        // 0 for 1D textures
+    uint32_t                    pixelDepth;         // 0 for anything but 3D textures
+    uint32_t                    layerCount;         // 0 when not an array
+    uint32_t                    faceCount;          // 6 for cube maps
+    uint32_t                    levelCount;         // 0 asks the loader to generate the mip chain
+    uint32_t                    supercompressionScheme;
+    uint32_t                    dfdByteOffset;
+    uint32_t                    dfdByteLength;
+    uint32_t                    kvdByteOffset;
+    uint32_t                    kvdByteLength;
+    uint64_t                    sgdByteOffset;
+    uint64_t                    sgdByteLength;
+};
+
+// Where one mip level lives in the file, every layer and face of it together
+struct VulkanKtx2Level{
+    uint64_t                    byteOffset;
+    uint64_t                    byteLength;
+    uint64_t                    uncompressedByteLength;
+};
+
+// Texture loaded from a KTX2 file. Every level, layer and face goes to the GPU in one
+// staged copy, in the stored format when the device can sample it. BC1 to BC5 files
+// are decoded to RGBA8 on devices without BC support; other block formats the device
+// can't sample, and supercompressed files, are rejected.
+class VulkanKtxTexture{
+public:
+    VulkanKtxTexture(VulkanDevice * __deviceContext, const std::string& __fileName, VkImageUsageFlags __usage = VK_IMAGE_USAGE_SAMPLED_BIT);
+    ~VulkanKtxTexture();
+
+    static bool canTranscode(VkFormat format);
+    static VkFormat getTranscodeFormat(VkFormat format);
+    static bool isFormatEnabled(VulkanDevice * deviceContext, VkFormat format);
+    static bool readHeader(const std::string& fileName, VulkanKtx2Header& header, std::vector<VulkanKtx2Level>& levels);
+    static void transcode(VkFormat format, const uint8_t * blocks, uint32_t width, uint32_t height, uint8_t * texels);
+
+    VulkanDevice *              deviceContext;
+    std::string                 fileName;
+    VulkanKtx2Header            header;
+    VkFormat                    fileFormat;         // As stored in the file
+    VkFormat                    format;             // As uploaded, differs from fileFormat when transcoded
+    VulkanImage *               image;
+    VkImageViewType             viewType;
+    VulkanUploadToken           uploadToken;
+
+private:
+    std::vector<char>           load();
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef __VULKAN_MEMORY_ALLOCATOR_H__
+#define __VULKAN_MEMORY_ALLOCATOR_H__
+
+#include <map>
+#include <mutex>
+
+// Resources of different classes must not share a bufferImageGranularity page,
+// so each class gets its own set of blocks
+enum VulkanAllocationType{
+    VULKAN_ALLOCATION_TYPE_LINEAR   = 0, // Buffers and linear-tiled images
+    VULKAN_ALLOCATION_TYPE_OPTIMAL  = 1, // Optimal-tiled images
+    VULKAN_ALLOCATION_TYPE_COUNT    = 2
+};
+
+// Declared ahead of the include, VulkanDevice's allocation functions take it
+#include "VulkanDriverInstance.h"
+
+struct VulkanDevice;
+class VulkanMemoryBlock;
+
+struct VulkanMemoryAllocation{
+    VkDeviceMemory              memory;             // Device memory the resource is bound to
+    VkDeviceSize                offset;             // Offset of the resource within memory
+    VkDeviceSize                size;               // Size reserved for the resource
+    uint32_t                    memoryTypeIndex;
+    void *                      mappedData;         // Host pointer to offset, nullptr if not host-visible
+    VulkanMemoryBlock *         block;              // Owning block
+};
+
+struct VulkanMemoryHeapStats{
+    uint32_t                    blockCount;         // Number of vkAllocateMemory allocations
+    uint32_t                    allocationCount;    // Number of resources sub-allocated
+    VkDeviceSize                blockBytes;         // Bytes allocated from the driver
+    VkDeviceSize                usedBytes;          // Bytes handed out to resources
+    VkDeviceSize                largestFreeRange;   // Largest contiguous free range in any block
+};
+
+class VulkanMemoryBlock{
+public:
+    VulkanMemoryBlock(VulkanDevice * __deviceContext, uint32_t __memoryTypeIndex, VkDeviceSize __size, VulkanAllocationType __allocationType, bool __dedicated);
+    ~VulkanMemoryBlock();
+    bool allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, VkDeviceSize& allocationOffset);
+    void free(VkDeviceSize allocationOffset, VkDeviceSize allocationSize);
+    VkDeviceSize largestFreeRange() const;
+
+    VulkanDevice *              deviceContext;
+    VkDeviceMemory              memory;
+    uint32_t                    memoryTypeIndex;
+    VulkanAllocationType        allocationType;
+    bool                        dedicated;
+    void *                      mappedData;
+    VkDeviceSize                size;
+    VkDeviceSize                usedBytes;
+    uint32_t                    allocationCount;
+
+private:
+    void insertFreeRange(VkDeviceSize rangeOffset, VkDeviceSize rangeSize);
+    void removeFreeRange(VkDeviceSize rangeOffset, VkDeviceSize rangeSize);
+
+    std::map<VkDeviceSize, VkDeviceSize>        freeRangesByOffset; // Offset -> size, used for coalescing
+    std::multimap<VkDeviceSize, VkDeviceSize>   freeRangesBySize;   // Size -> offset, used for best fit
+};
+
+class VulkanMemoryAllocator{
+public:
+    VulkanMemoryAllocator(VulkanDevice * __deviceContext, VkDeviceSize __preferredBlockSize = 64 * 1024 * 1024);
+    ~VulkanMemoryAllocator();
+    VulkanMemoryAllocation allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, VulkanAllocationType allocationType);
+    void free(VulkanMemoryAllocation& allocation);
+    VulkanMemoryHeapStats getHeapStats(uint32_t heapIndex);
+    void printStats();
+
+    VulkanDevice *              deviceContext;
+    VkDeviceSize                preferredBlockSize;
+
+private:
+    VkDeviceSize getBlockSize(uint32_t memoryTypeIndex);
+
+    std::vector<VulkanMemoryBlock *>    blocks[VK_MAX_MEMORY_TYPES][VULKAN_ALLOCATION_TYPE_COUNT];
+    std::mutex                          allocatorMutex;
+};
+
+#endif
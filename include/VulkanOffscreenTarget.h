@@ -0,0 +1,52 @@
+#ifndef __VULKAN_OFFSCREEN_TARGET__
+#define __VULKAN_OFFSCREEN_TARGET__
+
+#include "VulkanDriverInstance.h"
+#include "VulkanPipelineState.h"
+#include "VulkanRenderPass.h"
+#include "VulkanBuffer.h"
+#include "VulkanFramePacer.h"
+
+struct VulkanDevice;
+
+// Render target that needs no window, surface or swapchain. Owns imageCount colour and
+// depth attachments with the same render pass layout as VulkanSwapchain, and cycles
+// through them the way a swapchain would; finished images are read back with saveImage.
+struct VulkanOffscreenTarget{
+public:
+    VulkanOffscreenTarget(VulkanDevice * __deviceContext, VkExtent2D __extent, uint32_t __imageCount = 2, VkFormat __format = VK_FORMAT_R8G8B8A8_UNORM, VkSampleCountFlagBits __sampleCount = VK_SAMPLE_COUNT_1_BIT);
+    ~VulkanOffscreenTarget();
+    void acquireNextImage(const VulkanFrame& frame);
+    void cleanupTarget();
+    void createRenderpass();
+    VkFramebuffer getCurrentFramebuffer();
+    VkImage       getCurrentImage();
+    void initializeTarget();
+    void saveImage(const std::string& imageFileName);
+    void setImageLayout(VkCommandBuffer cmdBuffer, VkImageLayout oldLayout, VkImageLayout newLayout);
+    void setPipelineState(VulkanPipelineState *vps);
+    void setupFramebuffers(VkCommandBuffer cmdBuffer);
+
+    VulkanDevice *                      deviceContext;
+    VkPipelineColorBlendAttachmentState attachmentBlendState;
+    VkPipelineColorBlendStateCreateInfo blendState;
+    bool                                dirtyFramebuffers;
+    VkExtent2D                          extent;
+    uint32_t                            imageCount;
+    VkSampleCountFlagBits               sampleCount;
+    std::vector<VulkanImage*>           colorImages;
+    VulkanImage *                       depthImage;         // Shared by every colour image, contents never stored
+
+    // Multisampled resources
+    VulkanImage *                       multisampleImage;   // Shared, resolved into the colour image
+
+    std::vector<VkFramebuffer>          framebuffers;
+    uint32_t                            queueFamilyIndex;
+    VulkanPipelineState *               pipelineState;
+    VulkanRenderPass *                  renderPass;
+    VkFormat                            colorFormat;
+    VkFormat                            depthFormat;
+    uint32_t                            imageIndex;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __VULKAN_PIPELINE_CACHE_H__
+#define __VULKAN_PIPELINE_CACHE_H__
+
+#include "VulkanDriverInstance.h"
+
+#define VULKAN_PIPELINE_CACHE_FILE_NAME "pipeline_cache.bin"
+
+struct VulkanDevice;
+
+// Header Vulkan places at the front of the data returned by vkGetPipelineCacheData
+struct VulkanPipelineCacheHeader{
+    uint32_t                    headerSize;
+    uint32_t                    headerVersion;
+    uint32_t                    vendorID;
+    uint32_t                    deviceID;
+    uint8_t                     pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+// Device-level pipeline cache backed by a file on disk. The file is only handed to
+// the driver when its header matches this device and driver build; anything else is
+// discarded and the cache starts empty. The cache is written back on destruction, and
+// by save at any clean shutdown point where the device itself outlives the program.
+class VulkanPipelineCache{
+public:
+    VulkanPipelineCache(VulkanDevice * __deviceContext, std::string __fileName = VULKAN_PIPELINE_CACHE_FILE_NAME);
+    ~VulkanPipelineCache();
+    bool isCompatible(const std::vector<char>& cacheData);
+    void merge(const std::vector<VkPipelineCache>& sourceCaches);
+    bool save();
+
+    VulkanDevice *              deviceContext;
+    std::string                 fileName;
+    VkPipelineCache             cache;
+
+private:
+    std::vector<char>           load();
+};
+
+#endif
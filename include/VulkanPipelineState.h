@@ -3,7 +3,7 @@
 
 #include "VulkanDriverInstance.h"
 
-typedef std::map< VkDescriptorPool, std::vector< VkDescriptorSet> > DescriptorSetMap;
+typedef std::map< VkDescriptorSetLayout, std::vector< VkDescriptorSet> > DescriptorSetMap;
 typedef std::map< uint32_t, std::vector< VkDescriptorSetLayoutBinding> > DescriptorSetLayoutBindingMap;
 
 class VulkanPipelineState{
@@ -42,7 +42,10 @@ public:
           return "VK_DESCRIPTOR_TYPE_UNKNOWN";
       }
     };
-    std::vector<VkDescriptorSet>& generateDescriptorSets(VkDescriptorPool descriptorPool);
+    std::vector<VkDescriptorSet> generateDescriptorSets();
+    bool isDynamicState(VkDynamicState state);
+    void recordDynamicState(VkCommandBuffer cmdBuffer);
+    void setDynamicState(const std::vector<VkDynamicState>& states);
     void setMultisampleState(VkSampleCountFlagBits sampleCount, double minSampleShading = 1.0, const VkSampleMask* sampleMask = nullptr, VkBool32 alphaToCoverageEnable = VK_FALSE, VkBool32 alphaToOneEnable = VK_FALSE);
     void setPrimitiveState(std::vector<VkVertexInputBindingDescription>     &vertexInputBindingDescriptions,
                            std::vector<VkVertexInputAttributeDescription>   &vertexInputAttributeDescriptions,
@@ -66,13 +69,16 @@ public:
     void complete();
     bool completed();
 
-    DescriptorSetMap                                descriptorSets;
+    DescriptorSetMap                                descriptorSets;         // Sets handed out, returned to the allocator on destruction
     DescriptorSetLayoutBindingMap                   descriptorSetLayoutBindings;
-    std::map<uint32_t, VkDescriptorSetLayout>       descriptorSetLayouts;
+    std::map<uint32_t, VkDescriptorSetLayout>       descriptorSetLayouts;   // Owned by the device's descriptor allocator
     VulkanDevice *                                  deviceContext;
     bool                                            isComplete;
     VkGraphicsPipelineCreateInfo                    pipelineInfo;
     VkPipeline                                      pipeline;
+    std::vector<VkDynamicState>                     dynamicStates;
+    VkViewport                                      viewport;
+    VkRect2D                                        scissor;
     std::vector<VkPipelineShaderStageCreateInfo>    shaderStages;
     VkShaderStageFlags                              unusedStageFlags;
 };
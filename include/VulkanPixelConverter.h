@@ -0,0 +1,27 @@
+#ifndef __VULKAN_PIXEL_CONVERTER_H__
+#define __VULKAN_PIXEL_CONVERTER_H__
+
+#include <vulkan/vulkan.h>
+
+enum VulkanSimdLevel{
+    VULKAN_SIMD_LEVEL_SCALAR    = 0,
+    VULKAN_SIMD_LEVEL_SSE41     = 1,
+    VULKAN_SIMD_LEVEL_AVX2      = 2 // With F16C, which every AVX2 CPU has
+};
+
+// Host-side conversion between the pixel formats images are read back in, uploaded from
+// or encoded to, for when the GPU can't blit between them. Handles 8-bit RGBA, BGRA and
+// ABGR in UNORM or SRGB, 10:10:10:2 UNORM, and 16 and 32-bit float RGBA; SRGB formats are
+// decoded to linear and linear values encoded to SRGB on the way. Swizzles and 10:10:10:2
+// to 8-bit are direct, anything else goes through a row of linear float RGBA. Row kernels
+// have SSE4.1 and AVX2 versions picked from the CPU at first use, and a scalar fallback
+// for other CPUs. Stateless, so safe to call from any thread.
+class VulkanPixelConverter{
+public:
+    static bool canConvert(VkFormat srcFormat, VkFormat dstFormat);
+    static void convert(VkFormat srcFormat, const void * src, uint32_t srcRowPitch, VkFormat dstFormat, void * dst, uint32_t dstRowPitch, uint32_t width, uint32_t height);
+    static VkFormat getEncodeFormat(VkFormat format);
+    static VulkanSimdLevel getSimdLevel();
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef __VULKAN_READBACK_QUEUE_H__
+#define __VULKAN_READBACK_QUEUE_H__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "VulkanDriverInstance.h"
+#include "VulkanMemoryAllocator.h"
+#include "VulkanBuffer.h"
+#include "VulkanFramePacer.h"
+
+struct VulkanDevice;
+
+enum VulkanReadbackState{
+    VULKAN_READBACK_STATE_FREE      = 0, // Ready to take a new capture
+    VULKAN_READBACK_STATE_PENDING   = 1, // Copy recorded, waiting on the frame
+    VULKAN_READBACK_STATE_ENCODING  = 2  // Handed to a worker thread
+};
+
+struct VulkanReadbackSlot{
+    VkBuffer                    buffer;
+    VulkanMemoryAllocation      allocation;     // Persistently mapped, host-cached when available
+    VkDeviceSize                capacity;
+    VkDeviceSize                dataSize;       // Bytes written by the current capture
+    uint64_t                    frameNumber;    // Frame the copy was recorded into
+    std::string                 fileName;
+    uint32_t                    width;
+    uint32_t                    height;
+    VkFormat                    format;         // As copied, converted for the encoder by the worker
+    bool                        raw;            // Source has no encodable layout, dump as-is
+    VulkanReadbackState         state;
+};
+
+// Pipelined image capture. captureImage records a copy into the current frame's
+// command buffer; once the frame pacer reports that frame complete, update hands the
+// mapped data to worker threads for encoding. Nothing on the render thread waits on
+// the GPU, so capture can run at full frame rate. When every slot is busy the capture
+// is dropped rather than stalling.
+class VulkanReadbackQueue{
+public:
+    VulkanReadbackQueue(VulkanFramePacer * __framePacer, uint32_t __slotCount = 4, uint32_t __workerCount = 2);
+    ~VulkanReadbackQueue();
+    bool captureImage(VulkanImage& image, const std::string& imageFileName);
+    void flush();
+    void update();
+
+    VulkanDevice *              deviceContext;
+    VulkanFramePacer *          framePacer;
+    uint32_t                    droppedCaptures;
+
+private:
+    void encodeSlot(VulkanReadbackSlot& slot);
+    void reserveSlot(VulkanReadbackSlot& slot, VkDeviceSize dataSize);
+    void workerLoop();
+
+    std::vector<VulkanReadbackSlot>     slots;
+    std::vector<std::thread>            workers;
+    std::deque<VulkanReadbackSlot *>    encodeQueue;
+    std::mutex                          queueMutex;
+    std::condition_variable             queueCondition;     // Signaled when work is queued or on shutdown
+    std::condition_variable             idleCondition;      // Signaled when a slot finishes encoding
+    bool                                stopping;
+};
+
+#endif
@@ -0,0 +1,154 @@
+#ifndef __VULKAN_RENDER_GRAPH_H__
+#define __VULKAN_RENDER_GRAPH_H__
+
+#include <functional>
+#include "VulkanDriverInstance.h"
+#include "VulkanBuffer.h"
+
+struct VulkanDevice;
+class VulkanImage;
+
+typedef uint32_t VulkanGraphResource;
+typedef uint32_t VulkanGraphPass;
+
+// Records one pass. Graphics passes are recorded inside their render pass and subpass,
+// other passes outside any render pass.
+typedef std::function<void(VkCommandBuffer commandBuffer)> VulkanGraphRecordCallback;
+
+// How a pass touches a resource; each access implies a layout, stages and access mask
+enum VulkanGraphAccess{
+    VULKAN_GRAPH_ACCESS_COLOR_ATTACHMENT    = 0,
+    VULKAN_GRAPH_ACCESS_DEPTH_ATTACHMENT    = 1,
+    VULKAN_GRAPH_ACCESS_RESOLVE_ATTACHMENT  = 2,    // Target of a multisampled colour attachment
+    VULKAN_GRAPH_ACCESS_INPUT_ATTACHMENT    = 3,    // Read at the same pixel, keeps passes in one render pass
+    VULKAN_GRAPH_ACCESS_SAMPLED             = 4,    // Sampled by shaders, ends the render pass that wrote it
+    VULKAN_GRAPH_ACCESS_STORAGE_WRITE       = 5,
+    VULKAN_GRAPH_ACCESS_TRANSFER_SRC        = 6,
+    VULKAN_GRAPH_ACCESS_TRANSFER_DST        = 7,
+    VULKAN_GRAPH_ACCESS_COUNT               = 8
+};
+
+struct VulkanGraphResourceUse{
+    VulkanGraphResource         resource;
+    VulkanGraphAccess           access;
+    VkPipelineStageFlags        shaderStages;       // Stages that sample or store, for shader accesses
+    bool                        clear;              // Attachment is cleared to clearValue when first written
+    VkClearValue                clearValue;
+    VulkanGraphResource         resolveSource;      // Colour attachment a resolve attachment is resolved from
+};
+
+struct VulkanGraphPassInfo{
+    std::string                         name;
+    bool                                graphics;
+    bool                                sideEffects;    // Kept even when nothing reads its output
+    VulkanGraphRecordCallback           record;
+    std::vector<VulkanGraphResourceUse> uses;
+    bool                                culled;
+    uint32_t                            group;          // Render pass (or barrier batch) the pass executes in
+    uint32_t                            subpass;
+};
+
+struct VulkanGraphResourceInfo{
+    std::string                 name;
+    VkFormat                    format;
+    VkExtent2D                  extent;
+    VkSampleCountFlagBits       samples;
+    VkImageUsageFlags           usage;              // Accumulated from every use
+    bool                        imported;
+    VkImageLayout               finalLayout;        // Imported images are left in this layout
+    VkPipelineStageFlags        discardStages;      // Imported contents are dropped every execute once these stages are done
+    VulkanImage *               image;              // Imported, or created by compile
+    VkImage                     imageHandle;        // Created by compile, owned by the graph
+    uint32_t                    firstGroup;         // Lifetime in groups, for aliasing
+    uint32_t                    lastGroup;
+    uint32_t                    memorySlot;         // Aliased allocation the image is bound to
+    bool                        transientAttachment; // Never leaves one render pass, may be lazily allocated
+};
+
+// Memory shared by transient images whose lifetimes don't overlap
+struct VulkanGraphMemorySlot{
+    VkMemoryRequirements                memoryRequirements;
+    std::vector<VulkanGraphResource>    resources;
+    VulkanMemoryAllocation              allocation;
+    VkPipelineStageFlags                lastStages;
+    VkAccessFlags                       lastAccess;
+};
+
+// Everything the passes of a group do to one resource, folded into a single barrier
+struct VulkanGraphGroupResource{
+    VulkanGraphResource         resource;
+    VkImageLayout               initialLayout;      // Layout of the first use in the group
+    VkImageLayout               finalLayout;        // Layout of the last use in the group
+    VkPipelineStageFlags        stages;
+    VkAccessFlags               access;
+    bool                        write;
+    bool                        discard;            // Old contents aren't needed, transition from undefined
+};
+
+// Consecutive passes merged into one render pass, or a single non-graphics pass
+struct VulkanGraphGroup{
+    std::vector<VulkanGraphPass>            passes;
+    bool                                    graphics;
+    VkExtent2D                              extent;
+    VkRenderPass                            renderPass;
+    std::vector<VulkanGraphResource>        attachments;    // In attachment index order
+    std::vector<VkClearValue>               clearValues;
+    std::vector<VulkanGraphGroupResource>   resourceUses;
+    std::map<std::vector<VkImageView>, VkFramebuffer>   framebuffers;
+};
+
+// Frame graph. Passes declare how they use virtual resources; compile culls passes whose
+// output nobody reads, merges consecutive graphics passes that only exchange data through
+// attachments into subpasses of one render pass, picks load and store ops from how each
+// attachment is used before and after, and aliases transient images with disjoint
+// lifetimes in the same memory. execute records every pass with one batched barrier
+// before each render pass, starting from the layouts the images track themselves.
+// Imported images whose contents nothing needs, like a swapchain image that was just
+// acquired, are imported with the stages their first use has to wait for instead.
+class VulkanRenderGraph{
+public:
+    VulkanRenderGraph(VulkanDevice * __deviceContext);
+    ~VulkanRenderGraph();
+
+    VulkanGraphResource createImage(const std::string& name, VkFormat format, VkExtent2D extent, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+    VulkanGraphResource importImage(const std::string& name, VulkanImage * image, VkImageLayout finalLayout, VkPipelineStageFlags discardStages = 0);
+    void setImportedImage(VulkanGraphResource resource, VulkanImage * image);
+
+    VulkanGraphPass addPass(const std::string& name, bool graphics, const VulkanGraphRecordCallback& record, bool sideEffects = false);
+    void writeColor(VulkanGraphPass pass, VulkanGraphResource resource, const VkClearValue * clearValue = nullptr);
+    void writeDepth(VulkanGraphPass pass, VulkanGraphResource resource, const VkClearValue * clearValue = nullptr);
+    void resolve(VulkanGraphPass pass, VulkanGraphResource source, VulkanGraphResource target);
+    void readAttachment(VulkanGraphPass pass, VulkanGraphResource resource);
+    void readTexture(VulkanGraphPass pass, VulkanGraphResource resource, VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    void writeStorage(VulkanGraphPass pass, VulkanGraphResource resource, VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    void readTransfer(VulkanGraphPass pass, VulkanGraphResource resource);
+    void writeTransfer(VulkanGraphPass pass, VulkanGraphResource resource);
+
+    void compile();
+    void execute(VkCommandBuffer commandBuffer);
+    VulkanImage * getImage(VulkanGraphResource resource);
+    VkRenderPass getRenderPass(VulkanGraphPass pass);
+    uint32_t getSubpass(VulkanGraphPass pass);
+    void reset();
+
+    VulkanDevice *                          deviceContext;
+    bool                                    compiled;
+    bool                                    verbose;        // Log culled passes and aliasing on compile
+
+private:
+    void addUse(VulkanGraphPass pass, VulkanGraphResource resource, VulkanGraphAccess access, VkPipelineStageFlags shaderStages, const VkClearValue * clearValue, VulkanGraphResource resolveSource);
+    void allocateResources();
+    void buildGroups();
+    bool canMerge(const VulkanGraphGroup& group, const VulkanGraphPassInfo& pass);
+    void createRenderPass(VulkanGraphGroup& group, uint32_t groupIndex);
+    void cullPasses();
+    void destroyCompiled();
+    VkFramebuffer getFramebuffer(VulkanGraphGroup& group);
+
+    std::vector<VulkanGraphPassInfo>        passes;
+    std::vector<VulkanGraphResourceInfo>    resources;
+    std::vector<VulkanGraphGroup>           groups;
+    std::vector<VulkanGraphMemorySlot>      memorySlots;
+};
+
+#endif
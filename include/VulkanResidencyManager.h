@@ -0,0 +1,67 @@
+#ifndef __VULKAN_RESIDENCY_MANAGER_H__
+#define __VULKAN_RESIDENCY_MANAGER_H__
+
+#include <functional>
+#include <list>
+#include <mutex>
+#include "VulkanDriverInstance.h"
+
+struct VulkanDevice;
+struct VulkanMemoryAllocation;
+
+// Called when a resource is evicted. The owner frees the resource's memory and
+// registers it again once it has been streamed back in.
+typedef std::function<void()> VulkanEvictionCallback;
+
+struct VulkanHeapBudget{
+    VkDeviceSize                budget;             // Bytes the process may use before the heap pages or fails
+    VkDeviceSize                usage;              // Bytes the process is estimated to be using
+};
+
+struct VulkanResidentResource{
+    uint64_t                    id;
+    uint32_t                    heapIndex;
+    VkDeviceSize                size;
+    uint64_t                    lastUsedFrame;      // Last frame that touched the resource
+    VulkanEvictionCallback      evict;
+};
+
+// Per-heap budget tracking and eviction of streamable resources. Budgets come from
+// VK_EXT_memory_budget when the device has it, and are otherwise estimated as three
+// quarters of each heap measured against our own allocations. Streamable resources
+// (textures, mesh LODs) register with an eviction callback and are touched every frame
+// they are used; when a heap runs out of budget the least recently used ones that no
+// frame in flight can still reference are evicted to make room.
+class VulkanResidencyManager{
+public:
+    VulkanResidencyManager(VulkanDevice * __deviceContext);
+    void beginFrame(uint64_t frameNumber, uint32_t framesInFlight);
+    bool evict(uint32_t heapIndex, VkDeviceSize size);
+    VulkanHeapBudget getHeapBudget(uint32_t heapIndex);
+    bool hasBudget(uint32_t heapIndex, VkDeviceSize size);
+    void printBudgets();
+    uint64_t registerResource(const VulkanMemoryAllocation& allocation, const VulkanEvictionCallback& evictionCallback);
+    void touch(uint64_t resourceId);
+    void unregisterResource(uint64_t resourceId);
+    void updateBudgets();
+
+    VulkanDevice *              deviceContext;
+    VkDeviceSize                budgetLimit;        // Caps every heap's budget when set, to exercise eviction on machines with memory to spare
+
+private:
+    VulkanHeapBudget getHeapBudgetLocked(uint32_t heapIndex);
+
+    typedef std::list<VulkanResidentResource> ResidentList;
+
+    VkDeviceSize                heapBudgets[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize                heapUsages[VK_MAX_MEMORY_HEAPS];        // Driver-reported usage at the last update
+    VkDeviceSize                heapBlockBytes[VK_MAX_MEMORY_HEAPS];    // Our block bytes at the last update
+    ResidentList                residentResources[VK_MAX_MEMORY_HEAPS]; // Least recently used first
+    std::map<uint64_t, ResidentList::iterator>  resourceLookup;
+    uint64_t                    nextResourceId;
+    uint64_t                    currentFrame;
+    uint32_t                    framesInFlight;
+    std::mutex                  residencyMutex;
+};
+
+#endif
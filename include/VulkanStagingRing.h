@@ -0,0 +1,101 @@
+#ifndef __VULKAN_STAGING_RING_H__
+#define __VULKAN_STAGING_RING_H__
+
+#include <functional>
+#include "VulkanDriverInstance.h"
+#include "VulkanMemoryAllocator.h"
+
+struct VulkanDevice;
+class VulkanCommandPool;
+
+// Identifies an upload batch; 0 is never issued and always reads as complete
+typedef uint64_t VulkanUploadToken;
+
+// Work that has to follow an upload on a graphics queue, like blitting mip levels
+typedef std::function<void(VkCommandBuffer commandBuffer)> VulkanUploadCallback;
+
+struct VulkanStagingRegion{
+    VkBuffer                    buffer;         // Buffer to copy from
+    VkDeviceSize                offset;         // Offset of the staged data within buffer
+    void *                      mappedData;     // Host pointer to the staged data
+};
+
+// Persistently mapped upload ring. Uploads are recorded into a shared batch command
+// buffer and go out in a single submit; ring space is reclaimed once the batch fence
+// signals. Each upload returns the token of its batch, which can be polled or waited on.
+// Batches run on a dedicated transfer queue family when the device has one; uploaded
+// resources are then released to the graphics family, and acquireUploads records the
+// matching acquire barriers on a graphics command buffer, followed by any graphics work
+// queued with recordAfterUpload. Re-uploads into images the graphics family already
+// owns are handed over with acquireImage: the graphics queue releases them in a small
+// submit that the batch waits on, so the parts of a level a copy doesn't cover keep
+// their contents. Not thread-safe, record uploads from the thread that owns the device.
+class VulkanStagingRing{
+public:
+    VulkanStagingRing(VulkanDevice * __deviceContext, VkDeviceSize __capacity = 32 * 1024 * 1024, uint32_t __batchCount = 4);
+    ~VulkanStagingRing();
+    VkCommandBuffer getCommandBuffer();
+    VulkanStagingRegion stage(const void * data, VkDeviceSize dataSize, VkDeviceSize alignment = 4);
+    VulkanUploadToken copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& bufferCopy);
+    VulkanUploadToken copyToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void * data, VkDeviceSize dataSize);
+    VulkanUploadToken copyToImage(VkImage dstImage, VkImageLayout dstLayout, const void * data, VkDeviceSize dataSize, VkBufferImageCopy imageCopy, VkDeviceSize alignment = 4);
+    VulkanUploadToken copyToImage(VkImage dstImage, VkImageLayout dstLayout, const void * data, VkDeviceSize dataSize, std::vector<VkBufferImageCopy> imageCopies, VkDeviceSize alignment = 4);
+    void acquireImage(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout);
+    bool canRecordGraphics();
+    void recordAfterUpload(const VulkanUploadCallback& callback);
+    void releaseImage(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout);
+    VulkanUploadToken submit();
+    bool isComplete(VulkanUploadToken token);
+    void wait(VulkanUploadToken token);
+    void acquireUploads(VkCommandBuffer commandBuffer);
+    void finish();
+
+    VulkanDevice *              deviceContext;
+    VkBuffer                    ringBuffer;
+    VkDeviceSize                capacity;
+    VkQueue                     queue;
+    uint32_t                    queueFamilyIndex;
+    uint32_t                    graphicsQueueFamilyIndex;
+    VkQueue                     graphicsQueue;      // Releases images to the batches, only with ownershipTransfer
+    bool                        ownershipTransfer;  // Uploads run on a different family than rendering
+
+private:
+    struct Batch{
+        VkCommandBuffer                                             commandBuffer;
+        VkFence                                                     fence;
+        VkDeviceSize                                                ringStart;
+        VkDeviceSize                                                ringEnd;
+        bool                                                        submitted;
+        VulkanUploadToken                                           token;
+        std::vector<VkBufferMemoryBarrier>                          bufferReleases;
+        std::vector<VkImageMemoryBarrier>                           imageReleases;
+        std::vector<VkImageMemoryBarrier>                           imageHandoffs;          // Released by the graphics family to this batch
+        VkCommandBuffer                                             handoffCommandBuffer;   // Graphics queue side of imageHandoffs
+        VkSemaphore                                                 handoffSemaphore;       // Signaled by the handoff, waited on by the batch
+        std::vector<VulkanUploadCallback>                           graphicsCallbacks;
+        std::vector<std::pair<VkBuffer, VulkanMemoryAllocation>>    temporaryBuffers;
+    };
+
+    void beginBatch();
+    VkDeviceSize reserve(VkDeviceSize dataSize, VkDeviceSize alignment);
+    void retire(Batch& batch);
+    bool retireOldest();
+    void retireCompleted();
+    void releaseBuffer(VkBuffer buffer);
+
+    VulkanMemoryAllocation      ringAllocation;
+    VulkanCommandPool *         commandPool;
+    VulkanCommandPool *         handoffCommandPool;
+    std::vector<Batch>          batches;
+    uint32_t                    currentBatch;
+    bool                        recording;
+    VkDeviceSize                head;           // Next free byte, in bytes written since creation
+    VkDeviceSize                tail;           // Oldest byte still in use by the GPU
+    VulkanUploadToken           nextToken;
+    VulkanUploadToken           completedToken; // Every batch up to this one has retired
+    std::vector<VkBufferMemoryBarrier>  bufferAcquires;
+    std::vector<VkImageMemoryBarrier>   imageAcquires;
+    std::vector<VulkanUploadCallback>   graphicsCallbacks;  // Run by the next acquireUploads
+};
+
+#endif
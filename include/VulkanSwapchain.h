@@ -5,6 +5,7 @@
 #include "VulkanPipelineState.h"
 #include "VulkanRenderPass.h"
 #include "VulkanBuffer.h"
+#include "VulkanFramePacer.h"
 
 struct VulkanDevice;
 class VulkanDriverInstance;
@@ -15,13 +16,14 @@ private:
 public:
     VulkanSwapchain(VulkanDriverInstance * __instance, VulkanDevice * __deviceContext, VkPhysicalDevice __physicalDevice, VkSurfaceKHR __surface, VkSampleCountFlagBits __sampleCount = VK_SAMPLE_COUNT_1_BIT);
     ~VulkanSwapchain();
+    void acquireNextImage(const VulkanFrame& frame);
     void cleanupSwapchain();
+    void createAttachments();
     void createRenderpass();
-    void createSemaphores();
     VkFramebuffer getCurrentFramebuffer();
     VkImage       getCurrentImage();
     void initializeSwapchain(VkSurfaceKHR swapchainSurface, VkSwapchainKHR oldSwapchain);
-    void present(VkQueue presentationQueue);
+    void present(VkQueue presentationQueue, const VulkanFrame& frame);
     void querySwapchain();
     void recreateSwapchain();
     void setImageLayout(VkCommandBuffer cmdBuffer, VkImageLayout oldLayout, VkImageLayout newLayout);
@@ -42,19 +44,17 @@ public:
     std::vector<VkPresentModeKHR>       presentModes;
     uint32_t                            imageCount;
     VkSampleCountFlagBits               sampleCount;
-    std::vector<VulkanImage*>           swapchainDepthImages;
+    VulkanImage *                       swapchainDepthImage;        // Shared by every swapchain image, contents never stored; created by setupFramebuffers
     std::vector<VulkanImage*>           swapchainImages;
 
     // Multisampled resources
-    std::vector<VulkanImage*>           swapchainMultisampleImages;
+    VulkanImage *                       swapchainMultisampleImage;  // Shared, resolved into the swapchain image
 
     std::vector<VkFramebuffer>          swapchainFramebuffers;
     std::vector<uint32_t>               queueFamilyIndices;
     VkSurfaceCapabilitiesKHR            surfaceCaps;
     VulkanPipelineState *               pipelineState;
     uint32_t                            presentModeIndex;
-    VkSemaphore                         presentationSemaphore;
-    VkSemaphore                         renderingDoneSemaphore;
     VkRenderPass                        renderPass;
     uint32_t                            surfaceFormatIndex;
     VkFormat                            swapchainDepthFormat;
@@ -0,0 +1,134 @@
+#ifndef __VULKAN_TEXTURE_STREAMER_H__
+#define __VULKAN_TEXTURE_STREAMER_H__
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "VulkanDriverInstance.h"
+#include "VulkanFramePacer.h"
+#include "VulkanKtxTexture.h"
+#include "VulkanStagingRing.h"
+
+struct VulkanDevice;
+class VulkanImage;
+
+// Index of a requested texture, stays valid for the lifetime of the streamer
+typedef uint32_t VulkanTextureHandle;
+
+enum VulkanTextureState{
+    VULKAN_TEXTURE_STATE_QUEUED     = 0, // Waiting for a worker
+    VULKAN_TEXTURE_STATE_DECODING   = 1, // Being decoded by a worker
+    VULKAN_TEXTURE_STATE_DECODED    = 2, // Pixels ready, waiting for update to upload them
+    VULKAN_TEXTURE_STATE_UPLOADING  = 3, // Copy submitted, waiting on its batch
+    VULKAN_TEXTURE_STATE_RESIDENT   = 4, // Ready to sample
+    VULKAN_TEXTURE_STATE_FAILED     = 5, // Couldn't be read, the placeholder stays bound
+    VULKAN_TEXTURE_STATE_EVICTED    = 6  // Dropped for memory, queued again the next time it's bound
+};
+
+struct VulkanStreamedTexture{
+    std::string                 fileName;
+    VulkanTextureState          state;
+    uint32_t                    width;
+    uint32_t                    height;
+    unsigned char *             pixels;         // Decoded RGBA, freed once staged
+    VkDeviceSize                decodedSize;    // Bytes charged against the memory budget
+    VulkanImage *               image;
+    VulkanUploadToken           uploadToken;
+    uint64_t                    residencyId;    // Registered while resident and not being rebuilt, otherwise 0
+
+    // Cooked KTX2 textures keep only the levels on screen resident. The image holds
+    // residentMip and every coarser level, so its view never reaches an absent level.
+    bool                                mipStreamed;
+    VkFormat                            fileFormat;
+    VkFormat                            format;         // As uploaded, differs from fileFormat when transcoded
+    std::vector<VulkanKtx2Level>        levels;         // Level index from the file, finest first
+    uint32_t                            lowMip;         // Finest level loaded up front and never dropped
+    uint32_t                            residentMip;    // Finest level on the GPU
+    uint32_t                            loadingMip;     // Finest level of the image being loaded
+    uint32_t                            requestedMip;   // Finest level feedback asked for since the last update
+    uint64_t                            residentUsedFrame;  // Last frame that needed residentMip
+    VkDeviceSize                        residentBytes;  // Level data in the resident image
+    bool                                loading;        // A rebuild at loadingMip is on its way
+    VulkanImage *                       loadingImage;
+    std::vector<uint8_t>                mipData;        // Levels loadingMip and coarser, packed for one upload
+    std::vector<VkBufferImageCopy>      mipCopies;
+
+    // KTX2 files whose levels can't stream (arrays, cube maps, volumes, generated chains)
+    // are loaded whole by update instead, and ktxTexture owns the image
+    bool                                loadWhole;
+    VulkanKtxTexture *                  ktxTexture;
+};
+
+// Background texture loading. Worker threads decode image files; decoded pixels that
+// haven't been uploaded yet are bounded by a memory budget, so workers wait rather than
+// decode the whole scene into memory at once. update, called once per frame from the
+// render thread, uploads decoded textures with their mip chains through the staging
+// ring in one batch, capped per call so a frame never waits on a full ring. Until a
+// texture is resident, getImageView returns a placeholder.
+// KTX2 files stream their mip levels: they start with the levels up to lowMipExtent,
+// and requestFootprint feedback pulls in finer levels or, once unneeded for
+// mipRetainFrames, lets them go. Each change rebuilds the image from the file at the
+// new finest level and swaps it in when the upload lands, so getImageView can return
+// a different view from one frame to the next; the old image is destroyed once the
+// frames that sampled it have finished. KTX2 files that aren't a single 2D image with a
+// stored mip chain are loaded whole, with every level resident.
+// Resident textures are registered with the residency manager and touched by getImage.
+// When their heap runs out of budget, ones no frame in flight has bound are evicted
+// back to the placeholder, and loaded again from the file once they're bound again.
+// Request textures and call update from the render thread, update before
+// stagingRing->acquireUploads so textures that just became resident are acquired in
+// the same frame that first samples them.
+class VulkanTextureStreamer{
+public:
+    VulkanTextureStreamer(VulkanFramePacer * __framePacer, VkDeviceSize __memoryBudget = 256 * 1024 * 1024, VkDeviceSize __uploadBytesPerUpdate = 16 * 1024 * 1024, uint32_t __workerCount = 0);
+    ~VulkanTextureStreamer();
+    void finish();
+    static uint32_t getFootprintMip(VkExtent2D extent, float screenPixels);
+    VulkanImage * getImage(VulkanTextureHandle texture);
+    VkImageView getImageView(VulkanTextureHandle texture);
+    uint32_t getResidentMip(VulkanTextureHandle texture);
+    VulkanTextureState getState(VulkanTextureHandle texture);
+    bool isResident(VulkanTextureHandle texture);
+    void requestFootprint(VulkanTextureHandle texture, float screenPixels);
+    void requestMip(VulkanTextureHandle texture, uint32_t mipLevel);
+    VulkanTextureHandle requestTexture(const std::string& fileName);
+    void update();
+
+    VulkanDevice *              deviceContext;
+    VulkanFramePacer *          framePacer;
+    VkDeviceSize                memoryBudget;
+    VkDeviceSize                uploadBytesPerUpdate;
+    VkFormat                    format;
+    VulkanImage *               placeholderImage;
+    uint32_t                    lowMipExtent;       // Streamed textures start with the levels this size and smaller
+    uint32_t                    mipRetainFrames;    // Frames a finer level stays after feedback stops asking for it
+    VkDeviceSize                streamedBytes;      // Level data of streamed textures currently on the GPU
+
+private:
+    void decodeTexture(VulkanStreamedTexture& texture);
+    void evictTexture(VulkanStreamedTexture * texture);
+    void readMipLevels(VulkanStreamedTexture& texture);
+    void registerResidency(VulkanStreamedTexture * texture);
+    bool reserveBudget(VkDeviceSize dataSize);
+    void updateMipResidency();
+    void workerLoop();
+
+    std::deque<VulkanStreamedTexture>           textures;           // Deque, so workers' pointers survive new requests
+    std::map<std::string, VulkanTextureHandle>  textureLookup;
+    std::vector<std::thread>                    workers;
+    std::deque<VulkanStreamedTexture *>         decodeQueue;
+    std::deque<VulkanStreamedTexture *>         decodedQueue;
+    std::vector<VulkanStreamedTexture *>        uploadingTextures;  // Only touched by the render thread
+    std::vector<VulkanStreamedTexture *>        streamingTextures;  // Resident KTX2 textures, render thread only
+    std::deque<std::pair<VulkanImage *, uint64_t>>  retiredImages;  // Replaced images and the last frame that may sample them
+    VkDeviceSize                                decodedBytes;       // Decoded, not yet staged
+    uint32_t                                    outstandingCount;   // Requested, neither resident nor failed
+    std::mutex                                  queueMutex;
+    std::condition_variable                     queueCondition;     // Signaled when work is queued or on shutdown
+    std::condition_variable                     budgetCondition;    // Signaled when decoded bytes are released
+    std::condition_variable                     decodedCondition;   // Signaled when a texture is decoded or fails
+    bool                                        stopping;
+};
+
+#endif
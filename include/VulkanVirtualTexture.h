@@ -0,0 +1,117 @@
+#ifndef __VULKAN_VIRTUAL_TEXTURE_H__
+#define __VULKAN_VIRTUAL_TEXTURE_H__
+
+#include <functional>
+#include <list>
+#include "VulkanDriverInstance.h"
+#include "VulkanFramePacer.h"
+#include "VulkanMemoryAllocator.h"
+
+struct VulkanDevice;
+class VulkanImage;
+class VulkanVirtualTexture;
+
+// Fills one page of a virtual texture: texels (or blocks) of the region at offset and
+// extent in mipLevel, tightly packed, written to data
+typedef std::function<void(uint32_t mipLevel, VkOffset3D offset, VkExtent3D extent, void * data)> VulkanTileLoader;
+
+// One page of a virtual texture, in pages from the top left of its mip level
+struct VulkanVirtualPage{
+    uint32_t                    mipLevel;
+    uint32_t                    x;
+    uint32_t                    y;
+};
+
+// One sparse block of the physical pool
+struct VulkanTile{
+    VulkanVirtualTexture *      texture;            // nullptr while free
+    VulkanVirtualPage           page;
+    uint64_t                    lastUsedFrame;      // Last frame that requested the page
+    std::list<uint32_t>::iterator   lruPosition;
+};
+
+// Fixed pool of physical tiles shared by every virtual texture registered with it. The
+// pool is one allocation from the device allocator, made when the first texture
+// registers, so it matches that texture's memory type and sparse block size. update,
+// called once per frame before the render pass, binds tiles to the pages requested
+// this frame with vkQueueBindSparse and records their uploads into the frame. When the
+// pool is full, the least recently requested tiles no frame in flight can still sample
+// are unbound and reused. Coarser pages load first, so a page's fallback is resident
+// before its detail. The pool is registered with the residency manager and touched
+// every frame pages are requested; if its heap runs out of budget while no texture
+// asks for pages, every tile is unbound and the pool freed, to be allocated again by
+// the next update that has pages to load.
+// Render thread only; needs the sparseBinding and sparseResidencyImage2D features.
+class VulkanTileCache{
+public:
+    VulkanTileCache(VulkanFramePacer * __framePacer, uint32_t __tileCount, uint32_t __uploadTilesPerFrame = 16);
+    ~VulkanTileCache();
+    uint32_t getFreeTileCount();
+    void update();
+
+    VulkanDevice *              deviceContext;
+    VulkanFramePacer *          framePacer;
+    uint32_t                    tileCount;
+    VkDeviceSize                tileSize;           // Sparse block size, 0 until the first texture registers
+    uint32_t                    uploadTilesPerFrame;
+    uint32_t                    sparseQueueFamilyIndex;
+    VkQueue                     sparseQueue;
+
+private:
+    friend class VulkanVirtualTexture;
+    void bindSparse(const std::vector<VkSparseImageMemoryBindInfo>& imageBinds, const std::vector<VkSparseImageOpaqueMemoryBindInfo>& opaqueBinds, VkSemaphore signalSemaphore, VkFence fence);
+    bool allocatePool();
+    void evictPool();
+    void registerTexture(VulkanVirtualTexture * texture, const VkMemoryRequirements& memoryRequirements);
+    void touchTile(uint32_t tile, uint64_t frameNumber);
+    void unregisterTexture(VulkanVirtualTexture * texture);
+
+    std::vector<VulkanVirtualTexture *>     textures;
+    std::vector<VulkanTile>                 tiles;
+    std::vector<uint32_t>                   freeTiles;
+    std::list<uint32_t>                     lruTiles;           // Bound tiles, least recently used first
+    VulkanMemoryAllocation                  tileMemory;
+    VkMemoryRequirements                    poolRequirements;   // Pinned to the first allocation's memory type
+    uint64_t                                residencyId;        // 0 while the pool isn't allocated
+    std::vector<VkSemaphore>                bindSemaphores;     // One per frame slot, signaled by that frame's binds
+};
+
+// Sparse resident 2D texture whose pages are bound on demand from a VulkanTileCache.
+// Levels below the mip tail are split into pages of the format's sparse granularity;
+// the mip tail is bound to memory of its own and loaded when the texture is created,
+// so the coarsest levels are always resident. requestPage and requestRegion mark the
+// pages a frame needs, from CPU-side feedback such as the camera's position over a
+// terrain, and the cache loads missing ones through loader on its next update. The
+// CPU page table answers which level is resident where, for building a min-LOD clamp.
+class VulkanVirtualTexture{
+public:
+    VulkanVirtualTexture(VulkanTileCache * __tileCache, VkFormat __format, VkExtent2D __extent, const VulkanTileLoader& __loader, uint32_t __mipLevels = 0, VkImageUsageFlags __usage = VK_IMAGE_USAGE_SAMPLED_BIT);
+    ~VulkanVirtualTexture();
+    uint32_t getPageIndex(const VulkanVirtualPage& page);
+    uint32_t getResidentLod(const VulkanVirtualPage& page);
+    bool isPageResident(const VulkanVirtualPage& page);
+    void requestPage(const VulkanVirtualPage& page);
+    void requestRegion(uint32_t mipLevel, VkRect2D region);
+
+    VulkanTileCache *           tileCache;
+    VkFormat                    format;
+    VkExtent2D                  extent;
+    uint32_t                    mipLevels;
+    VulkanTileLoader            loader;
+    VulkanImage *               image;
+    VkExtent3D                  pageExtent;         // Sparse image granularity, in texels
+    uint32_t                    mipTailFirstLod;    // Levels from here on live in the always resident mip tail
+
+private:
+    friend class VulkanTileCache;
+    VkExtent3D getPageRegion(const VulkanVirtualPage& page, VkOffset3D& offset);
+
+    std::vector<uint32_t>               levelPageBase;      // First page index of each level below the tail, then the page count
+    std::vector<uint32_t>               levelPagesX;        // Pages across each level below the tail
+    std::vector<uint32_t>               pageTiles;          // Page table, tile bound to each page or noTile
+    std::vector<uint64_t>               pageRequestFrames;  // Last frame each page was requested, so requests dedupe
+    std::vector<VulkanVirtualPage>      requestedPages;     // Requested since the last update
+    VulkanMemoryAllocation              mipTailMemory;
+};
+
+#endif
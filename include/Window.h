@@ -32,6 +32,7 @@ public:
     #elif defined (__linux__)
         xcb_window_t  windowHandle;
         xcb_connection_t * windowInstance;
+        xcb_atom_t deleteWindowAtom;    // Sent in a client message when the window manager closes the window
     #endif
 };
 
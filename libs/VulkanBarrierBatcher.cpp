@@ -0,0 +1,215 @@
+#include <cassert>
+#include "VulkanBarrierBatcher.h"
+#include "VulkanBuffer.h"
+
+static const VkAccessFlags writeAccessMask = VK_ACCESS_SHADER_WRITE_BIT |
+                                             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                             VK_ACCESS_TRANSFER_WRITE_BIT |
+                                             VK_ACCESS_HOST_WRITE_BIT |
+                                             VK_ACCESS_MEMORY_WRITE_BIT;
+
+static const VkPipelineStageFlags shaderStageMask = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                                    VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT |
+                                                    VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT |
+                                                    VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT |
+                                                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                                                    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+VulkanBarrierBatcher::VulkanBarrierBatcher(VulkanDevice * __deviceContext, VkCommandBuffer __commandBuffer){
+    deviceContext   = __deviceContext;
+    commandBuffer   = __commandBuffer;
+    srcStages       = 0;
+    dstStages       = 0;
+    assert(deviceContext != nullptr && commandBuffer != VK_NULL_HANDLE);
+}
+
+VulkanBarrierBatcher::~VulkanBarrierBatcher(){
+    // Transitions still in the batch would never reach the command buffer
+    assert(imageBarriers.empty());
+}
+
+VkAccessFlags VulkanBarrierBatcher::getLayoutAccess(VkImageLayout layout){
+    // The accesses an image in this layout is normally used with
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED:
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+            return 0;
+        case VK_IMAGE_LAYOUT_PREINITIALIZED:
+            return VK_ACCESS_HOST_WRITE_BIT;
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+            return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+            return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+            return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            return VK_ACCESS_SHADER_READ_BIT;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+            return VK_ACCESS_TRANSFER_READ_BIT;
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            return VK_ACCESS_TRANSFER_WRITE_BIT;
+        default:
+            return VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    }
+}
+
+VkPipelineStageFlags VulkanBarrierBatcher::getLayoutStages(VkImageLayout layout){
+    // The stages an image in this layout is normally used in
+    switch (layout) {
+        case VK_IMAGE_LAYOUT_UNDEFINED:
+            return 0;
+        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+            return VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        case VK_IMAGE_LAYOUT_PREINITIALIZED:
+            return VK_PIPELINE_STAGE_HOST_BIT;
+        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+            return VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+            return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+            return VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | shaderStageMask;
+        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+            return shaderStageMask;
+        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+            return VK_PIPELINE_STAGE_TRANSFER_BIT;
+        default:
+            return VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    }
+}
+
+bool VulkanBarrierBatcher::isWriteAccess(VkAccessFlags access){
+    return (access & writeAccessMask) != 0;
+}
+
+void VulkanBarrierBatcher::flush(){
+    if (imageBarriers.empty()){
+        return;
+    }
+
+    deviceContext->vkCmdPipelineBarrier(commandBuffer,
+                                        srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                        dstStages != 0 ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                                        0,
+                                        0, nullptr,
+                                        0, nullptr,
+                                        imageBarriers.size(), &imageBarriers[0]);
+
+    imageBarriers.clear();
+    pendingSubresources.clear();
+    srcStages = 0;
+    dstStages = 0;
+}
+
+void VulkanBarrierBatcher::transition(VulkanImage& image, VkImageLayout newLayout, VkPipelineStageFlags __dstStages, VkAccessFlags dstAccess, bool discard){
+    transition(image, image.getSubresourceRange(), newLayout, __dstStages, dstAccess, discard);
+}
+
+void VulkanBarrierBatcher::transition(VulkanImage& image, const VkImageSubresourceRange& subresourceRange, VkImageLayout newLayout, VkPipelineStageFlags __dstStages, VkAccessFlags dstAccess, bool discard){
+    const VkImageCreateInfo& imageInfo = image.getImageCreateInfo();
+    uint32_t levelCount = subresourceRange.levelCount == VK_REMAINING_MIP_LEVELS ? imageInfo.mipLevels - subresourceRange.baseMipLevel : subresourceRange.levelCount;
+    uint32_t layerCount = subresourceRange.layerCount == VK_REMAINING_ARRAY_LAYERS ? imageInfo.arrayLayers - subresourceRange.baseArrayLayer : subresourceRange.layerCount;
+    assert(subresourceRange.baseMipLevel + levelCount <= imageInfo.mipLevels);
+    assert(subresourceRange.baseArrayLayer + layerCount <= imageInfo.arrayLayers);
+    assert(newLayout != VK_IMAGE_LAYOUT_UNDEFINED && newLayout != VK_IMAGE_LAYOUT_PREINITIALIZED);
+
+    // Layout changes, anything after a write, and writes after earlier accesses need a barrier; reads after reads don't
+    auto needsBarrier = [&](const VulkanSubresourceState& state){
+        if (state.layout == newLayout && (dstAccess == 0 || (!isWriteAccess(state.access) && (!isWriteAccess(dstAccess) || state.stages == 0)))){
+            return false;
+        }
+        return true;
+    };
+
+    // A subresource can only change layout once per barrier
+    for (uint32_t arrayLayer = subresourceRange.baseArrayLayer; arrayLayer < subresourceRange.baseArrayLayer + layerCount; arrayLayer++){
+        for (uint32_t mipLevel = subresourceRange.baseMipLevel; mipLevel < subresourceRange.baseMipLevel + levelCount; mipLevel++){
+            if (needsBarrier(image.getSubresourceState(mipLevel, arrayLayer)) &&
+                pendingSubresources.count(std::make_pair(image.imageHandle, arrayLayer * imageInfo.mipLevels + mipLevel)) != 0){
+                flush();
+            }
+        }
+    }
+
+    std::vector<size_t> previousLayerBarriers;
+    for (uint32_t arrayLayer = subresourceRange.baseArrayLayer; arrayLayer < subresourceRange.baseArrayLayer + layerCount; arrayLayer++){
+        std::vector<size_t> layerBarriers;
+        for (uint32_t mipLevel = subresourceRange.baseMipLevel; mipLevel < subresourceRange.baseMipLevel + levelCount; mipLevel++){
+            VulkanSubresourceState& state = image.getSubresourceState(mipLevel, arrayLayer);
+            if (!needsBarrier(state)){
+                // Later writes have to wait for this read as well
+                state.stages |= __dstStages;
+                state.access |= dstAccess;
+
+                // A barrier already in the batch has to cover the new read too
+                if (pendingSubresources.count(std::make_pair(image.imageHandle, arrayLayer * imageInfo.mipLevels + mipLevel)) != 0){
+                    for (auto& imageBarrier : imageBarriers){
+                        const VkImageSubresourceRange& range = imageBarrier.subresourceRange;
+                        if (imageBarrier.image == image.imageHandle &&
+                            mipLevel >= range.baseMipLevel && mipLevel < range.baseMipLevel + range.levelCount &&
+                            arrayLayer >= range.baseArrayLayer && arrayLayer < range.baseArrayLayer + range.layerCount){
+                            imageBarrier.dstAccessMask |= dstAccess;
+                        }
+                    }
+                    dstStages |= __dstStages;
+                }
+                continue;
+            }
+
+            VkImageLayout oldLayout     = discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+            VkAccessFlags srcAccess     = state.access & writeAccessMask;
+            srcStages |= state.stages;
+            dstStages |= __dstStages;
+            pendingSubresources.insert(std::make_pair(image.imageHandle, arrayLayer * imageInfo.mipLevels + mipLevel));
+
+            state.layout    = newLayout;
+            state.stages    = __dstStages;
+            state.access    = dstAccess;
+
+            // Extend the barrier for the previous mip level when it came from the same state
+            if (!layerBarriers.empty()){
+                VkImageMemoryBarrier& lastBarrier = imageBarriers[layerBarriers.back()];
+                if (lastBarrier.subresourceRange.baseMipLevel + lastBarrier.subresourceRange.levelCount == mipLevel &&
+                    lastBarrier.oldLayout == oldLayout && lastBarrier.srcAccessMask == srcAccess){
+                    lastBarrier.subresourceRange.levelCount++;
+                    continue;
+                }
+            }
+
+            VkImageMemoryBarrier imageBarrier;
+            imageBarrier.sType                  = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.pNext                  = nullptr;
+            imageBarrier.srcAccessMask          = srcAccess;
+            imageBarrier.dstAccessMask          = dstAccess;
+            imageBarrier.oldLayout              = oldLayout;
+            imageBarrier.newLayout              = newLayout;
+            imageBarrier.srcQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.image                  = image.imageHandle;
+            imageBarrier.subresourceRange       = {subresourceRange.aspectMask, mipLevel, 1, arrayLayer, 1};
+            layerBarriers.push_back(imageBarriers.size());
+            imageBarriers.push_back(imageBarrier);
+        }
+
+        // Layers that needed exactly the same barriers as the one before share them
+        bool sameAsPreviousLayer = !previousLayerBarriers.empty() && previousLayerBarriers.size() == layerBarriers.size();
+        for (size_t barrierIndex = 0; sameAsPreviousLayer && barrierIndex < layerBarriers.size(); barrierIndex++){
+            const VkImageMemoryBarrier& previousBarrier = imageBarriers[previousLayerBarriers[barrierIndex]];
+            const VkImageMemoryBarrier& layerBarrier    = imageBarriers[layerBarriers[barrierIndex]];
+            sameAsPreviousLayer = previousBarrier.subresourceRange.baseMipLevel == layerBarrier.subresourceRange.baseMipLevel &&
+                                  previousBarrier.subresourceRange.levelCount == layerBarrier.subresourceRange.levelCount &&
+                                  previousBarrier.subresourceRange.baseArrayLayer + previousBarrier.subresourceRange.layerCount == arrayLayer &&
+                                  previousBarrier.oldLayout == layerBarrier.oldLayout &&
+                                  previousBarrier.srcAccessMask == layerBarrier.srcAccessMask;
+        }
+        if (sameAsPreviousLayer){
+            for (auto barrierIndex : previousLayerBarriers){
+                imageBarriers[barrierIndex].subresourceRange.layerCount++;
+            }
+            imageBarriers.resize(imageBarriers.size() - layerBarriers.size());
+            layerBarriers = previousLayerBarriers;
+        }
+        previousLayerBarriers = layerBarriers;
+    }
+}
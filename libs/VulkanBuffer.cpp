@@ -8,9 +8,10 @@
 #endif
 #include <cassert>
 #include <regex>
+#include "VulkanBarrierBatcher.h"
 #include "VulkanBuffer.h"
-
-std::shared_ptr<VulkanCommandPool> VulkanBuffer::copyCommandPool;
+#include "VulkanFormatTraits.h"
+#include "VulkanPixelConverter.h"
 
 VulkanBuffer::VulkanBuffer(VulkanDevice * __deviceContext, VkBufferUsageFlags usage, const void * data, const uint32_t dataSize, const bool __hostVisible ){
 
@@ -18,6 +19,8 @@ VulkanBuffer::VulkanBuffer(VulkanDevice * __deviceContext, VkBufferUsageFlags us
     deviceContext = __deviceContext;
 
     hostVisible = __hostVisible;
+    dirtyBegin = (std::numeric_limits<VkDeviceSize>::max)();
+    dirtyEnd = 0;
 
     // Buffer Creation Info
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -34,27 +37,31 @@ VulkanBuffer::VulkanBuffer(VulkanDevice * __deviceContext, VkBufferUsageFlags us
     // Get Memory Requirements
     payloadSize = dataSize;
     deviceContext->vkGetBufferMemoryRequirements(deviceContext->device, bufferHandle, &memoryRequirements);
-    std::cout << "Memory requirements for " << (hostVisible ? "Host " : "Device ") << "buffer: " << std::dec << memoryRequirements.size << std::endl;
-    uint32_t memoryType = deviceContext->getUsableMemoryType(memoryRequirements.memoryTypeBits, hostVisible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    if ( memoryType == (std::numeric_limits<uint32_t>::max)()){
-        memoryType = deviceContext->getUsableMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-        assert (memoryType != (std::numeric_limits<uint32_t>::max)());
-    }
-    std::cout << "Memory type for  " << (hostVisible ? "Host " : "Device ") << "buffer: " << std::dec << memoryType << std::endl;
 
-    // Allocate Memory
-    bufferAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    bufferAllocateInfo.pNext = nullptr;
-    bufferAllocateInfo.allocationSize = memoryRequirements.size;
-    bufferAllocateInfo.memoryTypeIndex = memoryType;
-    assert( deviceContext->vkAllocateMemory(deviceContext->device, &bufferAllocateInfo, nullptr, &bufferMemory) == VK_SUCCESS);
-
-    // Bind Memory for buffer
-    assert( deviceContext->vkBindBufferMemory(deviceContext->device, bufferHandle, bufferMemory, 0) == VK_SUCCESS);
+    // Allocate and bind memory; device-local memory the host can map (UMA, resizable BAR) is written
+    // directly, without a staging copy or submit, as long as its heap has room
+    directWrite = false;
+    if(!hostVisible){
+        uint32_t directMemoryType = deviceContext->findMemoryType(memoryRequirements.memoryTypeBits,
+                                                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                                                  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                                                  VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                                                  memoryRequirements.size);
+        if(directMemoryType != (std::numeric_limits<uint32_t>::max)()){
+            bufferAllocation = deviceContext->memoryAllocator->allocate(memoryRequirements, directMemoryType, VULKAN_ALLOCATION_TYPE_LINEAR);
+            directWrite = (bufferAllocation.block != nullptr);
+        }
+        if(directWrite){
+            assert(deviceContext->vkBindBufferMemory(deviceContext->device, bufferHandle, bufferAllocation.memory, bufferAllocation.offset) == VK_SUCCESS);
+        }
+    }
+    if(!directWrite){
+        bufferAllocation = deviceContext->allocateAndBindBufferMemory(bufferHandle, hostVisible);
+    }
 
     // Copy data to buffer
     if(data != nullptr){
-        copyHostData(data, 0, memoryRequirements.size);
+        copyHostData(data, 0, dataSize);
     }
 }
 
@@ -63,10 +70,10 @@ VulkanBuffer::~VulkanBuffer(){
     deviceContext->vkDestroyBuffer(deviceContext->device, bufferHandle, nullptr);
 
     // Free Memory
-    deviceContext->vkFreeMemory(deviceContext->device, bufferMemory, nullptr);
+    deviceContext->freeMemory(bufferAllocation);
 }
 
-void VulkanBuffer::copyBuffer(const VulkanBuffer& srcBuffer, uint32_t offset, uint32_t dataSize){
+VulkanUploadToken VulkanBuffer::copyBuffer(const VulkanBuffer& srcBuffer, uint32_t offset, uint32_t dataSize){
 
     // Copy between buffers
     VkBufferCopy bufferToBufferCopy;
@@ -74,87 +81,43 @@ void VulkanBuffer::copyBuffer(const VulkanBuffer& srcBuffer, uint32_t offset, ui
     bufferToBufferCopy.dstOffset    = offset;
     bufferToBufferCopy.size         = dataSize;
 
-    // Find copy-capable queue (should be any queue)
-    uint32_t copyQueueFamily = deviceContext->getUsableDeviceQueueFamily(VK_QUEUE_TRANSFER_BIT);
-    assert(copyQueueFamily != (std::numeric_limits<uint32_t>::max)());
+    // Recorded into the device's upload batch, which runs on the transfer queue
+    return deviceContext->stagingRing->copyBuffer(srcBuffer.bufferHandle, bufferHandle, bufferToBufferCopy);
+}
 
-    if(VulkanBuffer::copyCommandPool == nullptr){
-        VulkanBuffer::copyCommandPool.reset(deviceContext->getCommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, copyQueueFamily));
+void VulkanBuffer::flush(){
+    // Everything written through write spans since the last flush
+    if(dirtyEnd > dirtyBegin){
+        deviceContext->flushMappedRange(bufferAllocation, dirtyBegin, dirtyEnd - dirtyBegin);
     }
-    assert(copyCommandPool != nullptr);
-    VkCommandBuffer * copyCommandBuffer = copyCommandPool->getCommandBuffers(VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-    assert(copyCommandBuffer != nullptr);
-
-    // Record into command buffer
-    VkCommandBufferBeginInfo cbBeginInfo;
-    cbBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cbBeginInfo.pNext = nullptr;
-    cbBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    cbBeginInfo.pInheritanceInfo = nullptr; // Not a secondary command buffer
-
-    deviceContext->vkBeginCommandBuffer(copyCommandBuffer[0], &cbBeginInfo);
-    deviceContext->vkCmdCopyBuffer(copyCommandBuffer[0], srcBuffer.bufferHandle, bufferHandle, 1, &bufferToBufferCopy);
-    deviceContext->vkEndCommandBuffer(copyCommandBuffer[0]);
-
-    // Dispatch
-    VkQueue copyQueue;
-    deviceContext->vkGetDeviceQueue(deviceContext->device, copyQueueFamily, 0, &copyQueue);
-    VkSubmitInfo copySubmitInfo;
-    copySubmitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    copySubmitInfo.pNext                = nullptr;
-    copySubmitInfo.waitSemaphoreCount   = 0; // No wait semaphores
-    copySubmitInfo.pWaitSemaphores      = nullptr; // No wait semaphores
-    copySubmitInfo.pWaitDstStageMask    =   nullptr; // No wait semaphores
-    copySubmitInfo.commandBufferCount   = 1;
-    copySubmitInfo.pCommandBuffers      = copyCommandBuffer;
-    copySubmitInfo.signalSemaphoreCount = 0; // No signal semaphores
-    copySubmitInfo.pSignalSemaphores    = nullptr; // No signal semaphores
-
-    // Fence
-    VkFence copyFence;
-    VkFenceCreateInfo copyFenceInfo;
-    copyFenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    copyFenceInfo.pNext = nullptr;
-    copyFenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    assert(deviceContext->vkCreateFence(deviceContext->device, &copyFenceInfo, nullptr, &copyFence) == VK_SUCCESS);
-    assert(deviceContext->vkResetFences(deviceContext->device, 1, &copyFence) == VK_SUCCESS);
-
-    assert(deviceContext->vkQueueSubmit(copyQueue, 1, &copySubmitInfo, copyFence) == VK_SUCCESS);
-    assert(deviceContext->vkWaitForFences(deviceContext->device, 1, &copyFence, VK_TRUE, 0x40000000) == VK_SUCCESS);
-    deviceContext->vkDestroyFence(deviceContext->device, copyFence, nullptr);
+    dirtyBegin  = (std::numeric_limits<VkDeviceSize>::max)();
+    dirtyEnd    = 0;
+}
 
-    delete copyCommandBuffer;
-    copyCommandPool.reset();
+void VulkanBuffer::markDirty(VkDeviceSize offset, VkDeviceSize dataSize){
+    dirtyBegin  = (std::min)(dirtyBegin, offset);
+    dirtyEnd    = (std::max)(dirtyEnd, offset + dataSize);
 }
 
-void VulkanBuffer::copyHostData(const void * data, uint32_t offset, uint32_t dataSize){
+VulkanUploadToken VulkanBuffer::copyHostData(const void * data, uint32_t offset, uint32_t dataSize){
     // Offset must be at least DWORD aligned
     if(offset % 4 != 0){
         std::runtime_error("Copy offset must be at least DWORD-aligned!");
     }
 
-    // Host-visible
-    if(hostVisible){
-        // Set buffer data
-        void * bufferData = nullptr;
-        assert( deviceContext->vkMapMemory(deviceContext->device, bufferMemory, offset, dataSize, 0, &bufferData) == VK_SUCCESS);
-        assert(bufferData != nullptr);
-        memcpy(bufferData, data, dataSize);
-
-        // Flush to make data GPU-visible
-        VkMappedMemoryRange hostMemoryRange;
-        hostMemoryRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        hostMemoryRange.pNext = nullptr;
-        hostMemoryRange.memory = bufferMemory;
-        hostMemoryRange.offset = 0;
-        hostMemoryRange.size = memoryRequirements.size;
-        deviceContext->vkFlushMappedMemoryRanges(deviceContext->device, 1, &hostMemoryRange);
-        deviceContext->vkUnmapMemory(deviceContext->device, bufferMemory);
-    }else{ // Create copy buffer
-        // Source Buffer must be host-mapped
-        VulkanBuffer * srcBuffer = new VulkanBuffer(deviceContext, bufferInfo.usage, data, dataSize, true);
-        copyBuffer(*srcBuffer, offset, dataSize);
-        delete srcBuffer;
+    // Host-visible, or device-local and mapped
+    if(hostVisible || directWrite){
+        // Set buffer data (allocation memory stays mapped)
+        assert(bufferAllocation.mappedData != nullptr);
+        memcpy(static_cast<char *>(bufferAllocation.mappedData) + offset, data, dataSize);
+
+        // Flush only what was written, and nothing on coherent memory
+        deviceContext->flushMappedRange(bufferAllocation, offset, dataSize);
+
+        // Nothing to wait for
+        return 0;
+    }else{ // Stage through the device's upload ring, submitted with the rest of the batch
+        return deviceContext->stagingRing->copyToBuffer(bufferHandle, offset, data, dataSize);
     }
 }
 
@@ -162,386 +125,86 @@ void VulkanBuffer::copyHostData(const void * data, uint32_t offset, uint32_t dat
 // VulkanImage
 ///////////////////////////////////////
 
-bool VulkanImage::isRGBAOrder(VkFormat format){
-    bool isRGBA = false;
-
-    switch (format){
-        case VK_FORMAT_R4G4_UNORM_PACK8:
-        case VK_FORMAT_R8_UNORM:
-        case VK_FORMAT_R8_SNORM:
-        case VK_FORMAT_R8_USCALED:
-        case VK_FORMAT_R8_SSCALED:
-        case VK_FORMAT_R8_UINT:
-        case VK_FORMAT_R8_SINT:
-        case VK_FORMAT_R8_SRGB:
-        case VK_FORMAT_R4G4B4A4_UNORM_PACK16:
-        case VK_FORMAT_R5G6B5_UNORM_PACK16:
-        case VK_FORMAT_R5G5B5A1_UNORM_PACK16:
-        case VK_FORMAT_R8G8_UNORM:
-        case VK_FORMAT_R8G8_SNORM:
-        case VK_FORMAT_R8G8_USCALED:
-        case VK_FORMAT_R8G8_SSCALED:
-        case VK_FORMAT_R8G8_UINT:
-        case VK_FORMAT_R8G8_SINT:
-        case VK_FORMAT_R8G8_SRGB:
-        case VK_FORMAT_R16_UNORM:
-        case VK_FORMAT_R16_SNORM:
-        case VK_FORMAT_R16_USCALED:
-        case VK_FORMAT_R16_SSCALED:
-        case VK_FORMAT_R16_UINT:
-        case VK_FORMAT_R16_SINT:
-        case VK_FORMAT_R16_SFLOAT:
-        case VK_FORMAT_D16_UNORM:
-        case VK_FORMAT_R8G8B8_UNORM:
-        case VK_FORMAT_R8G8B8_SNORM:
-        case VK_FORMAT_R8G8B8_USCALED:
-        case VK_FORMAT_R8G8B8_SSCALED:
-        case VK_FORMAT_R8G8B8_UINT:
-        case VK_FORMAT_R8G8B8_SINT:
-        case VK_FORMAT_R8G8B8_SRGB:
-        case VK_FORMAT_R8G8B8A8_UNORM:
-        case VK_FORMAT_R8G8B8A8_SNORM:
-        case VK_FORMAT_R8G8B8A8_USCALED:
-        case VK_FORMAT_R8G8B8A8_SSCALED:
-        case VK_FORMAT_R8G8B8A8_UINT:
-        case VK_FORMAT_R8G8B8A8_SINT:
-        case VK_FORMAT_R8G8B8A8_SRGB:
-        case VK_FORMAT_R16G16_UNORM:
-        case VK_FORMAT_R16G16_SNORM:
-        case VK_FORMAT_R16G16_USCALED:
-        case VK_FORMAT_R16G16_SSCALED:
-        case VK_FORMAT_R16G16_UINT:
-        case VK_FORMAT_R16G16_SINT:
-        case VK_FORMAT_R16G16_SFLOAT:
-        case VK_FORMAT_R32_UINT:
-        case VK_FORMAT_R32_SINT:
-        case VK_FORMAT_R32_SFLOAT:
-        case VK_FORMAT_R16G16B16_UNORM:
-        case VK_FORMAT_R16G16B16_SNORM:
-        case VK_FORMAT_R16G16B16_USCALED:
-        case VK_FORMAT_R16G16B16_SSCALED:
-        case VK_FORMAT_R16G16B16_UINT:
-        case VK_FORMAT_R16G16B16_SINT:
-        case VK_FORMAT_R16G16B16_SFLOAT:
-        case VK_FORMAT_R16G16B16A16_UNORM:
-        case VK_FORMAT_R16G16B16A16_SNORM:
-        case VK_FORMAT_R16G16B16A16_USCALED:
-        case VK_FORMAT_R16G16B16A16_SSCALED:
-        case VK_FORMAT_R16G16B16A16_UINT:
-        case VK_FORMAT_R16G16B16A16_SINT:
-        case VK_FORMAT_R16G16B16A16_SFLOAT:
-        case VK_FORMAT_R32G32_UINT:
-        case VK_FORMAT_R32G32_SINT:
-        case VK_FORMAT_R32G32_SFLOAT:
-        case VK_FORMAT_R64_UINT:
-        case VK_FORMAT_R64_SINT:
-        case VK_FORMAT_R64_SFLOAT:
-        case VK_FORMAT_R32G32B32_UINT:
-        case VK_FORMAT_R32G32B32_SINT:
-        case VK_FORMAT_R32G32B32_SFLOAT:
-        case VK_FORMAT_R32G32B32A32_UINT:
-        case VK_FORMAT_R32G32B32A32_SINT:
-        case VK_FORMAT_R32G32B32A32_SFLOAT:
-        case VK_FORMAT_R64G64_UINT:
-        case VK_FORMAT_R64G64_SINT:
-        case VK_FORMAT_R64G64_SFLOAT:
-        case VK_FORMAT_R64G64B64_UINT:
-        case VK_FORMAT_R64G64B64_SINT:
-        case VK_FORMAT_R64G64B64_SFLOAT:
-        case VK_FORMAT_R64G64B64A64_UINT:
-        case VK_FORMAT_R64G64B64A64_SINT:
-        case VK_FORMAT_R64G64B64A64_SFLOAT:
-            isRGBA = true;
-            break;
-        ////////////////////////////////////////
-        // TODO: Block formats are special
-        //
-        // VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131,
-        // VK_FORMAT_BC1_RGB_SRGB_BLOCK = 132,
-        // VK_FORMAT_BC1_RGBA_UNORM_BLOCK = 133,
-        // VK_FORMAT_BC1_RGBA_SRGB_BLOCK = 134,
-        // VK_FORMAT_BC2_UNORM_BLOCK = 135,
-        // VK_FORMAT_BC2_SRGB_BLOCK = 136,
-        // VK_FORMAT_BC3_UNORM_BLOCK = 137,
-        // VK_FORMAT_BC3_SRGB_BLOCK = 138,
-        // VK_FORMAT_BC4_UNORM_BLOCK = 139,
-        // VK_FORMAT_BC4_SNORM_BLOCK = 140,
-        // VK_FORMAT_BC5_UNORM_BLOCK = 141,
-        // VK_FORMAT_BC5_SNORM_BLOCK = 142,
-        // VK_FORMAT_BC6H_UFLOAT_BLOCK = 143,
-        // VK_FORMAT_BC6H_SFLOAT_BLOCK = 144,
-        // VK_FORMAT_BC7_UNORM_BLOCK = 145,
-        // VK_FORMAT_BC7_SRGB_BLOCK = 146,
-        // VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK = 147,
-        // VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK = 148,
-        // VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK = 149,
-        // VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK = 150,
-        // VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK = 151,
-        // VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK = 152,
-        // VK_FORMAT_EAC_R11_UNORM_BLOCK = 153,
-        // VK_FORMAT_EAC_R11_SNORM_BLOCK = 154,
-        // VK_FORMAT_EAC_R11G11_UNORM_BLOCK = 155,
-        // VK_FORMAT_EAC_R11G11_SNORM_BLOCK = 156,
-        // VK_FORMAT_ASTC_4x4_UNORM_BLOCK = 157,
-        // VK_FORMAT_ASTC_4x4_SRGB_BLOCK = 158,
-        // VK_FORMAT_ASTC_5x4_UNORM_BLOCK = 159,
-        // VK_FORMAT_ASTC_5x4_SRGB_BLOCK = 160,
-        // VK_FORMAT_ASTC_5x5_UNORM_BLOCK = 161,
-        // VK_FORMAT_ASTC_5x5_SRGB_BLOCK = 162,
-        // VK_FORMAT_ASTC_6x5_UNORM_BLOCK = 163,
-        // VK_FORMAT_ASTC_6x5_SRGB_BLOCK = 164,
-        // VK_FORMAT_ASTC_6x6_UNORM_BLOCK = 165,
-        // VK_FORMAT_ASTC_6x6_SRGB_BLOCK = 166,
-        // VK_FORMAT_ASTC_8x5_UNORM_BLOCK = 167,
-        // VK_FORMAT_ASTC_8x5_SRGB_BLOCK = 168,
-        // VK_FORMAT_ASTC_8x6_UNORM_BLOCK = 169,
-        // VK_FORMAT_ASTC_8x6_SRGB_BLOCK = 170,
-        // VK_FORMAT_ASTC_8x8_UNORM_BLOCK = 171,
-        // VK_FORMAT_ASTC_8x8_SRGB_BLOCK = 172,
-        // VK_FORMAT_ASTC_10x5_UNORM_BLOCK = 173,
-        // VK_FORMAT_ASTC_10x5_SRGB_BLOCK = 174,
-        // VK_FORMAT_ASTC_10x6_UNORM_BLOCK = 175,
-        // VK_FORMAT_ASTC_10x6_SRGB_BLOCK = 176,
-        // VK_FORMAT_ASTC_10x8_UNORM_BLOCK = 177,
-        // VK_FORMAT_ASTC_10x8_SRGB_BLOCK = 178,
-        // VK_FORMAT_ASTC_10x10_UNORM_BLOCK = 179,
-        // VK_FORMAT_ASTC_10x10_SRGB_BLOCK = 180,
-        // VK_FORMAT_ASTC_12x10_UNORM_BLOCK = 181,
-        // VK_FORMAT_ASTC_12x10_SRGB_BLOCK = 182,
-        // VK_FORMAT_ASTC_12x12_UNORM_BLOCK = 183,
-        // VK_FORMAT_ASTC_12x12_SRGB_BLOCK = 184,
-        default:
-            isRGBA = false;
-            break;
+static VkDeviceSize getCopyAlignment(VkFormat format){
+    // Buffer offset must be a multiple of both 4 and the texel block size
+    VkDeviceSize alignment = 4;
+    uint32_t texelSize = VulkanFormatTraits::getInfo(format).blockSize;
+    while(texelSize != 0 && alignment % texelSize != 0){
+        alignment += 4;
     }
 
-    return isRGBA;
+    return alignment;
 }
 
-uint32_t VulkanImage::bytesPerPixel(VkFormat format){
-    uint32_t BPP = 0;
-
-    switch (format){
-        case VK_FORMAT_UNDEFINED:
-            BPP = 0;
-            break;
-        case VK_FORMAT_R4G4_UNORM_PACK8:
-        case VK_FORMAT_R8_UNORM:
-        case VK_FORMAT_R8_SNORM:
-        case VK_FORMAT_R8_USCALED:
-        case VK_FORMAT_R8_SSCALED:
-        case VK_FORMAT_R8_UINT:
-        case VK_FORMAT_R8_SINT:
-        case VK_FORMAT_R8_SRGB:
-        case VK_FORMAT_S8_UINT:
-            BPP = 1;
-            break;
-        case VK_FORMAT_R4G4B4A4_UNORM_PACK16:
-        case VK_FORMAT_B4G4R4A4_UNORM_PACK16:
-        case VK_FORMAT_R5G6B5_UNORM_PACK16:
-        case VK_FORMAT_B5G6R5_UNORM_PACK16:
-        case VK_FORMAT_R5G5B5A1_UNORM_PACK16:
-        case VK_FORMAT_B5G5R5A1_UNORM_PACK16:
-        case VK_FORMAT_A1R5G5B5_UNORM_PACK16:
-        case VK_FORMAT_R8G8_UNORM:
-        case VK_FORMAT_R8G8_SNORM:
-        case VK_FORMAT_R8G8_USCALED:
-        case VK_FORMAT_R8G8_SSCALED:
-        case VK_FORMAT_R8G8_UINT:
-        case VK_FORMAT_R8G8_SINT:
-        case VK_FORMAT_R8G8_SRGB:
-        case VK_FORMAT_R16_UNORM:
-        case VK_FORMAT_R16_SNORM:
-        case VK_FORMAT_R16_USCALED:
-        case VK_FORMAT_R16_SSCALED:
-        case VK_FORMAT_R16_UINT:
-        case VK_FORMAT_R16_SINT:
-        case VK_FORMAT_R16_SFLOAT:
-        case VK_FORMAT_D16_UNORM:
-            BPP = 2;
-            break;
-        case VK_FORMAT_R8G8B8_UNORM:
-        case VK_FORMAT_R8G8B8_SNORM:
-        case VK_FORMAT_R8G8B8_USCALED:
-        case VK_FORMAT_R8G8B8_SSCALED:
-        case VK_FORMAT_R8G8B8_UINT:
-        case VK_FORMAT_R8G8B8_SINT:
-        case VK_FORMAT_R8G8B8_SRGB:
-        case VK_FORMAT_B8G8R8_UNORM:
-        case VK_FORMAT_B8G8R8_SNORM:
-        case VK_FORMAT_B8G8R8_USCALED:
-        case VK_FORMAT_B8G8R8_SSCALED:
-        case VK_FORMAT_B8G8R8_UINT:
-        case VK_FORMAT_B8G8R8_SINT:
-        case VK_FORMAT_B8G8R8_SRGB:
-        case VK_FORMAT_D16_UNORM_S8_UINT:
-            BPP = 3;
-            break;
-        case VK_FORMAT_R8G8B8A8_UNORM:
-        case VK_FORMAT_R8G8B8A8_SNORM:
-        case VK_FORMAT_R8G8B8A8_USCALED:
-        case VK_FORMAT_R8G8B8A8_SSCALED:
-        case VK_FORMAT_R8G8B8A8_UINT:
-        case VK_FORMAT_R8G8B8A8_SINT:
-        case VK_FORMAT_R8G8B8A8_SRGB:
-        case VK_FORMAT_B8G8R8A8_UNORM:
-        case VK_FORMAT_B8G8R8A8_SNORM:
-        case VK_FORMAT_B8G8R8A8_USCALED:
-        case VK_FORMAT_B8G8R8A8_SSCALED:
-        case VK_FORMAT_B8G8R8A8_UINT:
-        case VK_FORMAT_B8G8R8A8_SINT:
-        case VK_FORMAT_B8G8R8A8_SRGB:
-        case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
-        case VK_FORMAT_A8B8G8R8_SNORM_PACK32:
-        case VK_FORMAT_A8B8G8R8_USCALED_PACK32:
-        case VK_FORMAT_A8B8G8R8_SSCALED_PACK32:
-        case VK_FORMAT_A8B8G8R8_UINT_PACK32:
-        case VK_FORMAT_A8B8G8R8_SINT_PACK32:
-        case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
-        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
-        case VK_FORMAT_A2R10G10B10_SNORM_PACK32:
-        case VK_FORMAT_A2R10G10B10_USCALED_PACK32:
-        case VK_FORMAT_A2R10G10B10_SSCALED_PACK32:
-        case VK_FORMAT_A2R10G10B10_UINT_PACK32:
-        case VK_FORMAT_A2R10G10B10_SINT_PACK32:
-        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
-        case VK_FORMAT_A2B10G10R10_SNORM_PACK32:
-        case VK_FORMAT_A2B10G10R10_USCALED_PACK32:
-        case VK_FORMAT_A2B10G10R10_SSCALED_PACK32:
-        case VK_FORMAT_A2B10G10R10_UINT_PACK32:
-        case VK_FORMAT_A2B10G10R10_SINT_PACK32:
-        case VK_FORMAT_R16G16_UNORM:
-        case VK_FORMAT_R16G16_SNORM:
-        case VK_FORMAT_R16G16_USCALED:
-        case VK_FORMAT_R16G16_SSCALED:
-        case VK_FORMAT_R16G16_UINT:
-        case VK_FORMAT_R16G16_SINT:
-        case VK_FORMAT_R16G16_SFLOAT:
-        case VK_FORMAT_R32_UINT:
-        case VK_FORMAT_R32_SINT:
-        case VK_FORMAT_R32_SFLOAT:
-        case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
-        case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
-        case VK_FORMAT_X8_D24_UNORM_PACK32:
-        case VK_FORMAT_D32_SFLOAT:
-        case VK_FORMAT_D24_UNORM_S8_UINT:
-            BPP = 4;
-            break;
-        case VK_FORMAT_D32_SFLOAT_S8_UINT:
-            BPP = 5;
-            break;
-        case VK_FORMAT_R16G16B16_UNORM:
-        case VK_FORMAT_R16G16B16_SNORM:
-        case VK_FORMAT_R16G16B16_USCALED:
-        case VK_FORMAT_R16G16B16_SSCALED:
-        case VK_FORMAT_R16G16B16_UINT:
-        case VK_FORMAT_R16G16B16_SINT:
-        case VK_FORMAT_R16G16B16_SFLOAT:
-            BPP = 6;
-            break;
-        case VK_FORMAT_R16G16B16A16_UNORM:
-        case VK_FORMAT_R16G16B16A16_SNORM:
-        case VK_FORMAT_R16G16B16A16_USCALED:
-        case VK_FORMAT_R16G16B16A16_SSCALED:
-        case VK_FORMAT_R16G16B16A16_UINT:
-        case VK_FORMAT_R16G16B16A16_SINT:
-        case VK_FORMAT_R16G16B16A16_SFLOAT:
-        case VK_FORMAT_R32G32_UINT:
-        case VK_FORMAT_R32G32_SINT:
-        case VK_FORMAT_R32G32_SFLOAT:
-        case VK_FORMAT_R64_UINT:
-        case VK_FORMAT_R64_SINT:
-        case VK_FORMAT_R64_SFLOAT:
-            BPP = 8;
-            break;
-        case VK_FORMAT_R32G32B32_UINT:
-        case VK_FORMAT_R32G32B32_SINT:
-        case VK_FORMAT_R32G32B32_SFLOAT:
-            BPP = 12;
-            break;
-        case VK_FORMAT_R32G32B32A32_UINT:
-        case VK_FORMAT_R32G32B32A32_SINT:
-        case VK_FORMAT_R32G32B32A32_SFLOAT:
-        case VK_FORMAT_R64G64_UINT:
-        case VK_FORMAT_R64G64_SINT:
-        case VK_FORMAT_R64G64_SFLOAT:
-            BPP = 16;
-            break;
-        case VK_FORMAT_R64G64B64_UINT:
-        case VK_FORMAT_R64G64B64_SINT:
-        case VK_FORMAT_R64G64B64_SFLOAT:
-            BPP = 24;
-            break;
-        case VK_FORMAT_R64G64B64A64_UINT:
-        case VK_FORMAT_R64G64B64A64_SINT:
-        case VK_FORMAT_R64G64B64A64_SFLOAT:
-            BPP = 32;
-            break;
-        ////////////////////////////////////////
-        // TODO: Block formats are special
-        //
-        // VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131,
-        // VK_FORMAT_BC1_RGB_SRGB_BLOCK = 132,
-        // VK_FORMAT_BC1_RGBA_UNORM_BLOCK = 133,
-        // VK_FORMAT_BC1_RGBA_SRGB_BLOCK = 134,
-        // VK_FORMAT_BC2_UNORM_BLOCK = 135,
-        // VK_FORMAT_BC2_SRGB_BLOCK = 136,
-        // VK_FORMAT_BC3_UNORM_BLOCK = 137,
-        // VK_FORMAT_BC3_SRGB_BLOCK = 138,
-        // VK_FORMAT_BC4_UNORM_BLOCK = 139,
-        // VK_FORMAT_BC4_SNORM_BLOCK = 140,
-        // VK_FORMAT_BC5_UNORM_BLOCK = 141,
-        // VK_FORMAT_BC5_SNORM_BLOCK = 142,
-        // VK_FORMAT_BC6H_UFLOAT_BLOCK = 143,
-        // VK_FORMAT_BC6H_SFLOAT_BLOCK = 144,
-        // VK_FORMAT_BC7_UNORM_BLOCK = 145,
-        // VK_FORMAT_BC7_SRGB_BLOCK = 146,
-        // VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK = 147,
-        // VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK = 148,
-        // VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK = 149,
-        // VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK = 150,
-        // VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK = 151,
-        // VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK = 152,
-        // VK_FORMAT_EAC_R11_UNORM_BLOCK = 153,
-        // VK_FORMAT_EAC_R11_SNORM_BLOCK = 154,
-        // VK_FORMAT_EAC_R11G11_UNORM_BLOCK = 155,
-        // VK_FORMAT_EAC_R11G11_SNORM_BLOCK = 156,
-        // VK_FORMAT_ASTC_4x4_UNORM_BLOCK = 157,
-        // VK_FORMAT_ASTC_4x4_SRGB_BLOCK = 158,
-        // VK_FORMAT_ASTC_5x4_UNORM_BLOCK = 159,
-        // VK_FORMAT_ASTC_5x4_SRGB_BLOCK = 160,
-        // VK_FORMAT_ASTC_5x5_UNORM_BLOCK = 161,
-        // VK_FORMAT_ASTC_5x5_SRGB_BLOCK = 162,
-        // VK_FORMAT_ASTC_6x5_UNORM_BLOCK = 163,
-        // VK_FORMAT_ASTC_6x5_SRGB_BLOCK = 164,
-        // VK_FORMAT_ASTC_6x6_UNORM_BLOCK = 165,
-        // VK_FORMAT_ASTC_6x6_SRGB_BLOCK = 166,
-        // VK_FORMAT_ASTC_8x5_UNORM_BLOCK = 167,
-        // VK_FORMAT_ASTC_8x5_SRGB_BLOCK = 168,
-        // VK_FORMAT_ASTC_8x6_UNORM_BLOCK = 169,
-        // VK_FORMAT_ASTC_8x6_SRGB_BLOCK = 170,
-        // VK_FORMAT_ASTC_8x8_UNORM_BLOCK = 171,
-        // VK_FORMAT_ASTC_8x8_SRGB_BLOCK = 172,
-        // VK_FORMAT_ASTC_10x5_UNORM_BLOCK = 173,
-        // VK_FORMAT_ASTC_10x5_SRGB_BLOCK = 174,
-        // VK_FORMAT_ASTC_10x6_UNORM_BLOCK = 175,
-        // VK_FORMAT_ASTC_10x6_SRGB_BLOCK = 176,
-        // VK_FORMAT_ASTC_10x8_UNORM_BLOCK = 177,
-        // VK_FORMAT_ASTC_10x8_SRGB_BLOCK = 178,
-        // VK_FORMAT_ASTC_10x10_UNORM_BLOCK = 179,
-        // VK_FORMAT_ASTC_10x10_SRGB_BLOCK = 180,
-        // VK_FORMAT_ASTC_12x10_UNORM_BLOCK = 181,
-        // VK_FORMAT_ASTC_12x10_SRGB_BLOCK = 182,
-        // VK_FORMAT_ASTC_12x12_UNORM_BLOCK = 183,
-        // VK_FORMAT_ASTC_12x12_SRGB_BLOCK = 184,
-        default:
-            BPP = 0;
-            break;
+static bool hasUnormByteChannels(VkFormat format){
+    // Formats whose texels can be averaged one byte at a time
+    const VulkanFormatInfo& formatInfo = VulkanFormatTraits::getInfo(format);
+    return formatInfo.channelBits == 8 && formatInfo.aspect == VK_IMAGE_ASPECT_COLOR_BIT &&
+           (formatInfo.componentType == VULKAN_COMPONENT_TYPE_UNORM || formatInfo.componentType == VULKAN_COMPONENT_TYPE_SRGB);
+}
+
+static void downsampleBox(const uint8_t * src, uint32_t srcWidth, uint32_t srcHeight, uint8_t * dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t texelSize){
+    // 2x2 box filter, clamping at the edge of odd-sized levels. sRGB data is averaged as stored.
+    for (uint32_t y = 0; y < dstHeight; y++){
+        const uint8_t * row0 = src + (VkDeviceSize)(std::min)(y * 2, srcHeight - 1) * srcWidth * texelSize;
+        const uint8_t * row1 = src + (VkDeviceSize)(std::min)(y * 2 + 1, srcHeight - 1) * srcWidth * texelSize;
+        for (uint32_t x = 0; x < dstWidth; x++){
+            uint32_t x0 = (std::min)(x * 2, srcWidth - 1) * texelSize;
+            uint32_t x1 = (std::min)(x * 2 + 1, srcWidth - 1) * texelSize;
+            for (uint32_t channel = 0; channel < texelSize; channel++){
+                uint32_t sum = row0[x0 + channel] + row0[x1 + channel] + row1[x0 + channel] + row1[x1 + channel];
+                dst[((VkDeviceSize)y * dstWidth + x) * texelSize + channel] = (uint8_t)((sum + 2) / 4);
+            }
+        }
     }
+}
+
+static void downsampleBox(const float * src, uint32_t srcWidth, uint32_t srcHeight, float * dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t channelCount){
+    // Same filter for texels decoded to linear float
+    for (uint32_t y = 0; y < dstHeight; y++){
+        const float * row0 = src + (VkDeviceSize)(std::min)(y * 2, srcHeight - 1) * srcWidth * channelCount;
+        const float * row1 = src + (VkDeviceSize)(std::min)(y * 2 + 1, srcHeight - 1) * srcWidth * channelCount;
+        for (uint32_t x = 0; x < dstWidth; x++){
+            uint32_t x0 = (std::min)(x * 2, srcWidth - 1) * channelCount;
+            uint32_t x1 = (std::min)(x * 2 + 1, srcWidth - 1) * channelCount;
+            for (uint32_t channel = 0; channel < channelCount; channel++){
+                float sum = row0[x0 + channel] + row0[x1 + channel] + row1[x0 + channel] + row1[x1 + channel];
+                dst[((VkDeviceSize)y * dstWidth + x) * channelCount + channel] = sum * 0.25f;
+            }
+        }
+    }
+}
+
+bool VulkanImage::isRGBAOrder(VkFormat format){
+    // Block formats have no per-texel byte order
+    return VulkanFormatTraits::getInfo(format).channelOrder == VULKAN_CHANNEL_ORDER_RGBA;
+}
+
+uint32_t VulkanImage::bytesPerPixel(VkFormat format){
+    // Block formats are sized per block, see bytesPerBlock
+    assert(!VulkanFormatTraits::isBlockCompressed(format) && VulkanFormatTraits::getInfo(format).blockSize != 0);
 
-    assert(BPP != 0);
+    return VulkanFormatTraits::getInfo(format).blockSize;
+}
 
-    return BPP;
+VkExtent3D VulkanImage::blockExtent(VkFormat format){
+    return {VulkanFormatTraits::getInfo(format).blockWidth, VulkanFormatTraits::getInfo(format).blockHeight, 1};
+}
+
+uint32_t VulkanImage::bytesPerBlock(VkFormat format){
+    assert(VulkanFormatTraits::getInfo(format).blockSize != 0);
+
+    return VulkanFormatTraits::getInfo(format).blockSize;
+}
+
+VkDeviceSize VulkanImage::imageDataSize(VkFormat format, VkExtent3D extent){
+    assert(VulkanFormatTraits::getInfo(format).blockSize != 0);
+
+    return VulkanFormatTraits::imageDataSize(format, extent);
+}
+
+VkImageAspectFlags VulkanImage::formatAspect(VkFormat format){
+    return VulkanFormatTraits::getInfo(format).aspect;
 }
 
 VulkanImage::VulkanImage(VulkanDevice * __deviceContext,
@@ -561,10 +224,10 @@ VulkanImage::VulkanImage(VulkanDevice * __deviceContext,
                         VkImageLayout __layout){
     // Set context
     deviceContext   = __deviceContext;
-    layout          = __layout;
     imageHandle     = __imageHandle;
     externalImage   = true;
     imageViewHandle = VK_NULL_HANDLE;
+    imageAllocation = {};
 
     // Fill in relevant fields
     imageCreateInfo.sType                   = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -582,6 +245,7 @@ VulkanImage::VulkanImage(VulkanDevice * __deviceContext,
     imageCreateInfo.queueFamilyIndexCount   = __queueFamilyIndexCount;
     imageCreateInfo.pQueueFamilyIndices     = __pQueueFamilyIndices;
     imageCreateInfo.initialLayout           = __layout;
+    resetSubresourceStates(__layout);
 }
 
 VulkanImage::VulkanImage(VulkanDevice * __deviceContext,
@@ -600,7 +264,6 @@ VulkanImage::VulkanImage(VulkanDevice * __deviceContext,
                 VkImageLayout __layout){
     // Set context
     deviceContext   = __deviceContext;
-    layout          = __layout;
     externalImage   = false;
     imageViewHandle = VK_NULL_HANDLE;
 
@@ -620,9 +283,10 @@ VulkanImage::VulkanImage(VulkanDevice * __deviceContext,
     imageCreateInfo.queueFamilyIndexCount   = __queueFamilyIndexCount;
     imageCreateInfo.pQueueFamilyIndices     = __pQueueFamilyIndices;
     imageCreateInfo.initialLayout           = __layout;
+    resetSubresourceStates(__layout);
 
     assert(deviceContext->vkCreateImage(deviceContext->device, &imageCreateInfo, nullptr, &imageHandle) == VK_SUCCESS);
-    imageMemory = deviceContext->allocateAndBindMemory(imageHandle, false);
+    imageAllocation = deviceContext->allocateAndBindImageMemory(imageHandle, __tiling, false, (__usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0);
 }
 
 VulkanImage::~VulkanImage(){
@@ -634,9 +298,10 @@ VulkanImage::~VulkanImage(){
         deviceContext->vkDestroyImageView(deviceContext->device, imageViewHandle, nullptr);
     }
 
-    // Clean up image view
+    // Clean up image and its memory
     if(imageHandle != VK_NULL_HANDLE && !externalImage){
         deviceContext->vkDestroyImage(deviceContext->device, imageHandle, nullptr);
+        deviceContext->freeMemory(imageAllocation);
     }
 }
 
@@ -656,72 +321,209 @@ VkImageView VulkanImage::createImageView(VkImageViewType __imageViewType, VkImag
     return imageViewHandle;
 }
 
-void VulkanImage::loadImageData(const void * data, const uint32_t dataSize, VkExtent3D copyExtent, VkImageSubresourceLayers copySubresource, VkOffset3D copyOffset){
-    VulkanBuffer imageBuffer(deviceContext, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, data, dataSize, false);
+VkImageLayout VulkanImage::getLayout(uint32_t mipLevel, uint32_t arrayLayer){
+    return getSubresourceState(mipLevel, arrayLayer).layout;
+}
+
+VkImageSubresourceRange VulkanImage::getSubresourceRange(){
+    return {formatAspect(imageCreateInfo.format), 0, imageCreateInfo.mipLevels, 0, imageCreateInfo.arrayLayers};
+}
+
+VulkanSubresourceState& VulkanImage::getSubresourceState(uint32_t mipLevel, uint32_t arrayLayer){
+    assert(mipLevel < imageCreateInfo.mipLevels && arrayLayer < imageCreateInfo.arrayLayers);
+    return subresourceStates[arrayLayer * imageCreateInfo.mipLevels + mipLevel];
+}
 
+VulkanUploadToken VulkanImage::loadImageData(const void * data, const uint32_t dataSize, VkExtent3D copyExtent, VkImageSubresourceLayers copySubresource, VkOffset3D copyOffset){
     VkBufferImageCopy imageCopy;
-    imageCopy.bufferOffset                      = 0;
+    imageCopy.bufferOffset                      = 0; // Relative to data, moved by the staging ring
     imageCopy.bufferRowLength                   = 0;
     imageCopy.bufferImageHeight                 = 0;
     imageCopy.imageSubresource                  = copySubresource;
     imageCopy.imageOffset                       = copyOffset;
     imageCopy.imageExtent                       = copyExtent;
 
-    // Find copy-capable queue (should be any queue)
-    uint32_t copyQueueFamily = deviceContext->getUsableDeviceQueueFamily(VK_QUEUE_TRANSFER_BIT);
-    assert(copyQueueFamily != (std::numeric_limits<uint32_t>::max)());
+    return uploadRegions(data, dataSize, std::vector<VkBufferImageCopy>(1, imageCopy), VK_IMAGE_LAYOUT_UNDEFINED);
+}
 
-    VulkanCommandPool * copyCommandPool = deviceContext->getCommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, copyQueueFamily);
-    assert(copyCommandPool != nullptr);
-    VkCommandBuffer * copyCommandBuffer = copyCommandPool->getCommandBuffers(VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
-    assert(copyCommandBuffer != nullptr);
+VulkanUploadToken VulkanImage::loadImageDataWithMips(const void * data, const uint32_t dataSize, uint32_t baseArrayLayer, uint32_t layerCount){
+    VkImageAspectFlags aspect = formatAspect(imageCreateInfo.format);
+    VkImageSubresourceLayers topSubresource = {aspect, 0, baseArrayLayer, layerCount};
+    if (imageCreateInfo.mipLevels == 1){
+        return loadImageData(data, dataSize, imageCreateInfo.extent, topSubresource);
+    }
 
-    // Record into command buffer
-    VkCommandBufferBeginInfo cbBeginInfo;
-    cbBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cbBeginInfo.pNext = nullptr;
-    cbBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    cbBeginInfo.pInheritanceInfo = nullptr; // Not a secondary command buffer
+    VulkanStagingRing * stagingRing = deviceContext->stagingRing;
+    if (canBlitMipmaps() && stagingRing->canRecordGraphics()){
+        // Upload the top level only and leave it waiting as a blit source
+        VkBufferImageCopy imageCopy;
+        imageCopy.bufferOffset                  = 0;
+        imageCopy.bufferRowLength               = 0;
+        imageCopy.bufferImageHeight             = 0;
+        imageCopy.imageSubresource              = topSubresource;
+        imageCopy.imageOffset                   = {0, 0, 0};
+        imageCopy.imageExtent                   = imageCreateInfo.extent;
+        VulkanUploadToken uploadToken = uploadRegions(data, dataSize, std::vector<VkBufferImageCopy>(1, imageCopy), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+        // The blits follow either the copy itself or the acquire barrier on the graphics queue
+        VkImageSubresourceRange topRange = {aspect, 0, 1, baseArrayLayer, layerCount};
+        if (stagingRing->ownershipTransfer){
+            setSubresourceState(topRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0);
+        }else{
+            setSubresourceState(topRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        }
+
+        // The image has to outlive the acquireUploads that records the blits
+        VulkanImage * image = this;
+        stagingRing->recordAfterUpload([image, baseArrayLayer, layerCount](VkCommandBuffer commandBuffer){
+            image->generateMipmaps(commandBuffer, baseArrayLayer, layerCount);
+        });
 
-    VkImageLayout oldLayout = layout;
-    deviceContext->vkBeginCommandBuffer(copyCommandBuffer[0], &cbBeginInfo);
-    setImageLayout(copyCommandBuffer[0], layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    deviceContext->vkCmdCopyBufferToImage(copyCommandBuffer[0], imageBuffer.bufferHandle, imageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageCopy);
-    // Can't transition to undefined or pre-initialized layouts
-    if(oldLayout != VK_IMAGE_LAYOUT_PREINITIALIZED && oldLayout != VK_IMAGE_LAYOUT_UNDEFINED){
-        setImageLayout(copyCommandBuffer[0], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, oldLayout);
+        return uploadToken;
     }
-    deviceContext->vkEndCommandBuffer(copyCommandBuffer[0]);
 
-    // Dispatch
-    VkQueue copyQueue;
-    deviceContext->vkGetDeviceQueue(deviceContext->device, copyQueueFamily, 0, &copyQueue);
-    VkSubmitInfo copySubmitInfo;
-    copySubmitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    copySubmitInfo.pNext                = nullptr;
-    copySubmitInfo.waitSemaphoreCount   = 0; // No wait semaphores
-    copySubmitInfo.pWaitSemaphores      = nullptr; // No wait semaphores
-    copySubmitInfo.pWaitDstStageMask    = nullptr; // No wait semaphores
-    copySubmitInfo.commandBufferCount   = 1;
-    copySubmitInfo.pCommandBuffers      = copyCommandBuffer;
-    copySubmitInfo.signalSemaphoreCount = 0; // No signal semaphores
-    copySubmitInfo.pSignalSemaphores    = nullptr; // No signal semaphores
+    // No linear blits for this format, or no graphics queue to run them on, so filter on the host.
+    // Formats without byte channels are filtered in linear float and converted back per level.
+    bool filterAsFloat      = !hasUnormByteChannels(imageCreateInfo.format);
+    assert((!filterAsFloat || (VulkanPixelConverter::canConvert(imageCreateInfo.format, VK_FORMAT_R32G32B32A32_SFLOAT) &&
+                               VulkanPixelConverter::canConvert(VK_FORMAT_R32G32B32A32_SFLOAT, imageCreateInfo.format))) &&
+           imageCreateInfo.extent.depth == 1);
+    uint32_t texelSize      = bytesPerPixel(imageCreateInfo.format);
+    uint32_t floatTexelSize = 4 * sizeof(float);
+    VkDeviceSize alignment  = getCopyAlignment(imageCreateInfo.format);
+    VkDeviceSize topSize    = (VkDeviceSize)imageCreateInfo.extent.width * imageCreateInfo.extent.height * texelSize * layerCount;
+    assert(dataSize >= topSize);
+
+    // Levels follow each other in one staging block, each holding every layer
+    std::vector<uint8_t> mipData(static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + topSize);
+    std::vector<VkBufferImageCopy> mipCopies;
+    std::vector<float> levelTexels;
+    std::vector<float> nextTexels;
+    if (filterAsFloat){
+        // Layers are tightly packed, so they convert as one tall image
+        levelTexels.resize((size_t)imageCreateInfo.extent.width * imageCreateInfo.extent.height * 4 * layerCount);
+        VulkanPixelConverter::convert(imageCreateInfo.format, data, imageCreateInfo.extent.width * texelSize,
+                                      VK_FORMAT_R32G32B32A32_SFLOAT, &levelTexels[0], imageCreateInfo.extent.width * floatTexelSize,
+                                      imageCreateInfo.extent.width, imageCreateInfo.extent.height * layerCount);
+    }
+    VkDeviceSize levelOffset = 0;
+    uint32_t mipWidth        = imageCreateInfo.extent.width;
+    uint32_t mipHeight       = imageCreateInfo.extent.height;
+    for (uint32_t mipLevel = 0; mipLevel < imageCreateInfo.mipLevels; mipLevel++){
+        if (mipLevel > 0){
+            uint32_t nextWidth          = (std::max)(mipWidth / 2, 1u);
+            uint32_t nextHeight         = (std::max)(mipHeight / 2, 1u);
+            VkDeviceSize nextOffset     = ((mipData.size() + alignment - 1) / alignment) * alignment;
+            VkDeviceSize srcLayerSize   = (VkDeviceSize)mipWidth * mipHeight * texelSize;
+            VkDeviceSize dstLayerSize   = (VkDeviceSize)nextWidth * nextHeight * texelSize;
+            mipData.resize(nextOffset + dstLayerSize * layerCount);
+            if (filterAsFloat){
+                VkDeviceSize srcLayerTexels = (VkDeviceSize)mipWidth * mipHeight * 4;
+                VkDeviceSize dstLayerTexels = (VkDeviceSize)nextWidth * nextHeight * 4;
+                nextTexels.resize(dstLayerTexels * layerCount);
+                for (uint32_t arrayLayer = 0; arrayLayer < layerCount; arrayLayer++){
+                    downsampleBox(&levelTexels[arrayLayer * srcLayerTexels], mipWidth, mipHeight,
+                                  &nextTexels[arrayLayer * dstLayerTexels], nextWidth, nextHeight, 4);
+                }
+                VulkanPixelConverter::convert(VK_FORMAT_R32G32B32A32_SFLOAT, &nextTexels[0], nextWidth * floatTexelSize,
+                                              imageCreateInfo.format, &mipData[nextOffset], nextWidth * texelSize, nextWidth, nextHeight * layerCount);
+                levelTexels.swap(nextTexels);
+            }else{
+                for (uint32_t arrayLayer = 0; arrayLayer < layerCount; arrayLayer++){
+                    downsampleBox(&mipData[levelOffset + arrayLayer * srcLayerSize], mipWidth, mipHeight,
+                                  &mipData[nextOffset + arrayLayer * dstLayerSize], nextWidth, nextHeight, texelSize);
+                }
+            }
+            levelOffset = nextOffset;
+            mipWidth    = nextWidth;
+            mipHeight   = nextHeight;
+        }
 
-    // Fence
-    VkFence copyFence;
-    VkFenceCreateInfo copyFenceInfo;
-    copyFenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    copyFenceInfo.pNext = nullptr;
-    copyFenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    assert(deviceContext->vkCreateFence(deviceContext->device, &copyFenceInfo, nullptr, &copyFence) == VK_SUCCESS);
-    assert(deviceContext->vkResetFences(deviceContext->device, 1, &copyFence) == VK_SUCCESS);
+        VkBufferImageCopy mipCopy;
+        mipCopy.bufferOffset                    = levelOffset;
+        mipCopy.bufferRowLength                 = 0;
+        mipCopy.bufferImageHeight               = 0;
+        mipCopy.imageSubresource                = {aspect, mipLevel, baseArrayLayer, layerCount};
+        mipCopy.imageOffset                     = {0, 0, 0};
+        mipCopy.imageExtent                     = {mipWidth, mipHeight, 1};
+        mipCopies.push_back(mipCopy);
+    }
 
-    assert(deviceContext->vkQueueSubmit(copyQueue, 1, &copySubmitInfo, copyFence) == VK_SUCCESS);
-    assert(deviceContext->vkWaitForFences(deviceContext->device, 1, &copyFence, VK_TRUE, 0x40000000) == VK_SUCCESS);
-    deviceContext->vkDestroyFence(deviceContext->device, copyFence, nullptr);
+    return uploadRegions(&mipData[0], mipData.size(), mipCopies, VK_IMAGE_LAYOUT_UNDEFINED);
+}
 
-    copyCommandPool->freeCommandBuffers(1, &copyCommandBuffer);
-    delete copyCommandPool;
+VulkanUploadToken VulkanImage::loadImageMipChain(const void * data, const uint32_t dataSize, const std::vector<VkBufferImageCopy>& mipCopies){
+    return uploadRegions(data, dataSize, mipCopies, VK_IMAGE_LAYOUT_UNDEFINED);
+}
+
+uint32_t VulkanImage::mipLevelCount(VkExtent3D extent){
+    // Halve the largest dimension down to 1
+    uint32_t maxDimension = (std::max)((std::max)(extent.width, extent.height), extent.depth);
+    uint32_t levelCount = 1;
+    while (maxDimension > 1){
+        maxDimension /= 2;
+        levelCount++;
+    }
+
+    return levelCount;
+}
+
+VulkanUploadToken VulkanImage::uploadRegions(const void * data, const uint32_t dataSize, const std::vector<VkBufferImageCopy>& imageCopies, VkImageLayout releaseLayout){
+    assert(!imageCopies.empty());
+
+    // Only the copied subresources move, the rest of the image keeps its layout
+    std::vector<VkImageSubresourceRange> copyRanges;
+    std::vector<VkImageLayout> oldLayouts;
+    for (const auto& imageCopy : imageCopies){
+        const VkImageSubresourceLayers& copySubresource = imageCopy.imageSubresource;
+        VkImageSubresourceRange copyRange = {copySubresource.aspectMask, copySubresource.mipLevel, 1, copySubresource.baseArrayLayer, copySubresource.layerCount};
+
+        bool duplicate = false;
+        for (const auto& existingRange : copyRanges){
+            duplicate |= existingRange.baseMipLevel == copyRange.baseMipLevel && existingRange.baseArrayLayer == copyRange.baseArrayLayer && existingRange.layerCount == copyRange.layerCount;
+        }
+        if (!duplicate){
+            copyRanges.push_back(copyRange);
+            oldLayouts.push_back(getLayout(copyRange.baseMipLevel, copyRange.baseArrayLayer));
+        }
+    }
+
+    // Record into the device's upload batch; it goes out with the next staging ring submit
+    VulkanStagingRing * stagingRing = deviceContext->stagingRing;
+    if (stagingRing->ownershipTransfer){
+        // The transfer family can't wait on graphics stages, so subresources that were never written start from the top
+        // of the pipe, and ones the graphics family owns are handed over by its queue with their contents intact. Frames
+        // not yet submitted must leave them alone until the upload has been acquired back.
+        for (uint32_t rangeIndex = 0; rangeIndex < copyRanges.size(); rangeIndex++){
+            VkImageLayout oldLayout = oldLayouts[rangeIndex];
+            if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED || oldLayout == VK_IMAGE_LAYOUT_PREINITIALIZED){
+                setSubresourceState(copyRanges[rangeIndex], oldLayout, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+            }else{
+                stagingRing->acquireImage(imageHandle, copyRanges[rangeIndex], oldLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+                setSubresourceState(copyRanges[rangeIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+            }
+        }
+    }
+    VulkanBarrierBatcher barrierBatcher(deviceContext, stagingRing->getCommandBuffer());
+    for (const auto& copyRange : copyRanges){
+        barrierBatcher.transition(*this, copyRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+    barrierBatcher.flush();
+    VulkanUploadToken uploadToken = stagingRing->copyToImage(imageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, data, dataSize, imageCopies, getCopyAlignment(imageCreateInfo.format));
+
+    for (uint32_t rangeIndex = 0; rangeIndex < copyRanges.size(); rangeIndex++){
+        // Hand the subresources back in the layout they had, or ready to sample if they had none
+        VkImageLayout newLayout = releaseLayout != VK_IMAGE_LAYOUT_UNDEFINED ? releaseLayout : oldLayouts[rangeIndex];
+        if(newLayout == VK_IMAGE_LAYOUT_PREINITIALIZED || newLayout == VK_IMAGE_LAYOUT_UNDEFINED){
+            newLayout = (imageCreateInfo.usage & VK_IMAGE_USAGE_SAMPLED_BIT) ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        }
+        stagingRing->releaseImage(imageHandle, copyRanges[rangeIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, newLayout);
+
+        // The release and the upload token order the copy against later use
+        setSubresourceState(copyRanges[rangeIndex], newLayout, 0, 0);
+    }
+
+    return uploadToken;
 }
 
 void VulkanImage::blitImage(VkCommandBuffer commandBuffer, VulkanImage& destImage, VkImageBlit *blitPtr, VkFilter filter){
@@ -755,19 +557,24 @@ void VulkanImage::blitImage(VkCommandBuffer commandBuffer, VulkanImage& destImag
         blitPtr = &defaultBlit;
     }
 
-    VkImageLayout srcOldLayout  = layout;
-    VkImageLayout destOldLayout = destImage.layout;
-    setImageLayout(commandBuffer, srcOldLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-    destImage.setImageLayout(commandBuffer, destOldLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    // Both images stay in transfer layouts; whoever uses them next transitions from there
+    const VkImageSubresourceLayers& srcSubresource  = blitPtr->srcSubresource;
+    const VkImageSubresourceLayers& dstSubresource  = blitPtr->dstSubresource;
+    VulkanBarrierBatcher barrierBatcher(deviceContext, commandBuffer);
+    barrierBatcher.transition(*this, {srcSubresource.aspectMask, srcSubresource.mipLevel, 1, srcSubresource.baseArrayLayer, srcSubresource.layerCount},
+                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    barrierBatcher.transition(destImage, {dstSubresource.aspectMask, dstSubresource.mipLevel, 1, dstSubresource.baseArrayLayer, dstSubresource.layerCount},
+                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    barrierBatcher.flush();
     deviceContext->vkCmdBlitImage(commandBuffer, imageHandle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destImage.imageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, blitPtr, filter);
-    // Can't transition to undefined or pre-initialized layouts
-    if(srcOldLayout != VK_IMAGE_LAYOUT_PREINITIALIZED && srcOldLayout != VK_IMAGE_LAYOUT_UNDEFINED){
-        setImageLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcOldLayout);
-    }
-     // Can't transition to undefined or pre-initialized layouts
-    if(destOldLayout != VK_IMAGE_LAYOUT_PREINITIALIZED && destOldLayout != VK_IMAGE_LAYOUT_UNDEFINED){
-        destImage.setImageLayout(commandBuffer,VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, destOldLayout);
-    }
+}
+
+bool VulkanImage::canBlitMipmaps(){
+    // Levels are filtered from the level above, which needs linear blits within the image
+    VkImageUsageFlags blitUsage         = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    VkFormatFeatureFlags blitFeatures   = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (imageCreateInfo.usage & blitUsage) == blitUsage &&
+           deviceContext->getSupportedFormat({imageCreateInfo.format}, imageCreateInfo.tiling, blitFeatures) == imageCreateInfo.format;
 }
 
 void VulkanImage::copyImageToBuffer(VkCommandBuffer commandBuffer, VulkanBuffer& destBuffer, VkBufferImageCopy *imageCopyPtr){
@@ -788,14 +595,50 @@ void VulkanImage::copyImageToBuffer(VkCommandBuffer commandBuffer, VulkanBuffer&
         imageCopyPtr = &defaultImageCopy;
     }
 
-    // Standard image copy
-    VkImageLayout oldLayout = layout;
-    setImageLayout(commandBuffer, oldLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    // Standard image copy, leaving the copied subresources in the transfer layout
+    const VkImageSubresourceLayers& copySubresource = imageCopyPtr->imageSubresource;
+    VulkanBarrierBatcher barrierBatcher(deviceContext, commandBuffer);
+    barrierBatcher.transition(*this, {copySubresource.aspectMask, copySubresource.mipLevel, 1, copySubresource.baseArrayLayer, copySubresource.layerCount},
+                              VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    barrierBatcher.flush();
     deviceContext->vkCmdCopyImageToBuffer(commandBuffer, imageHandle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destBuffer.bufferHandle, 1, imageCopyPtr);
-    // Can't transition to undefined or pre-initialized layouts
-    if(oldLayout != VK_IMAGE_LAYOUT_PREINITIALIZED && oldLayout != VK_IMAGE_LAYOUT_UNDEFINED){
-        setImageLayout(commandBuffer, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, oldLayout);
+}
+
+void VulkanImage::generateMipmaps(VkCommandBuffer commandBuffer, uint32_t baseArrayLayer, uint32_t layerCount){
+    assert(canBlitMipmaps());
+    if (layerCount == VK_REMAINING_ARRAY_LAYERS){
+        layerCount = imageCreateInfo.arrayLayers - baseArrayLayer;
+    }
+    VkImageAspectFlags aspect = formatAspect(imageCreateInfo.format);
+
+    // Each level is blitted from the one above, so every level needs its own barrier
+    VulkanBarrierBatcher barrierBatcher(deviceContext, commandBuffer);
+    VkExtent3D mipExtent = imageCreateInfo.extent;
+    for (uint32_t mipLevel = 1; mipLevel < imageCreateInfo.mipLevels; mipLevel++){
+        VkExtent3D nextExtent = {(std::max)(mipExtent.width / 2, 1u), (std::max)(mipExtent.height / 2, 1u), (std::max)(mipExtent.depth / 2, 1u)};
+
+        barrierBatcher.transition(*this, {aspect, mipLevel - 1, 1, baseArrayLayer, layerCount}, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        barrierBatcher.transition(*this, {aspect, mipLevel, 1, baseArrayLayer, layerCount}, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, true);
+        barrierBatcher.flush();
+
+        VkImageBlit mipBlit;
+        mipBlit.srcSubresource  = {aspect, mipLevel - 1, baseArrayLayer, layerCount};
+        mipBlit.srcOffsets[0]   = {0, 0, 0};
+        mipBlit.srcOffsets[1]   = {(int32_t)mipExtent.width, (int32_t)mipExtent.height, (int32_t)mipExtent.depth};
+        mipBlit.dstSubresource  = {aspect, mipLevel, baseArrayLayer, layerCount};
+        mipBlit.dstOffsets[0]   = {0, 0, 0};
+        mipBlit.dstOffsets[1]   = {(int32_t)nextExtent.width, (int32_t)nextExtent.height, (int32_t)nextExtent.depth};
+        deviceContext->vkCmdBlitImage(commandBuffer, imageHandle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, imageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &mipBlit, VK_FILTER_LINEAR);
+
+        mipExtent = nextExtent;
     }
+
+    // The whole chain is ready to sample after one more barrier
+    if (imageCreateInfo.usage & VK_IMAGE_USAGE_SAMPLED_BIT){
+        barrierBatcher.transition(*this, {aspect, 0, imageCreateInfo.mipLevels, baseArrayLayer, layerCount}, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                  VulkanBarrierBatcher::getLayoutStages(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), VulkanBarrierBatcher::getLayoutAccess(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+    }
+    barrierBatcher.flush();
 }
 
 void VulkanImage::saveImage(const std::string& imageFileName){
@@ -803,7 +646,7 @@ void VulkanImage::saveImage(const std::string& imageFileName){
     uint32_t bytesPerPixel      = VulkanImage::bytesPerPixel(imageCreateInfo.format);
     uint32_t destBytesPerPixel  = 4;
     uint32_t imageRowLength     = imageCreateInfo.extent.width;
-    uint32_t dataSize           = imageRowLength * imageCreateInfo.extent.height * destBytesPerPixel;
+    uint32_t dataSize           = imageRowLength * imageCreateInfo.extent.height * (std::max)(bytesPerPixel, destBytesPerPixel);
     VulkanBuffer imageBuffer(deviceContext, VK_BUFFER_USAGE_TRANSFER_DST_BIT, nullptr, dataSize, true);
 
     VkBufferImageCopy imageCopy;
@@ -814,23 +657,6 @@ void VulkanImage::saveImage(const std::string& imageFileName){
     imageCopy.imageOffset                       = {0, 0, 0};
     imageCopy.imageExtent                       = imageCreateInfo.extent;
 
-    // Choose the appropriate save function
-    std::regex extensionRegex(".+\\.(.+)");
-    std::smatch matches;
-    std::string extension;
-
-    if(std::regex_match(imageFileName, matches, extensionRegex)){
-        try{
-            extension = (matches[1].str)();
-        }catch(std::out_of_range oor){
-            std::cout << "Invalid extension " << extension << std::endl;
-            extension = "raw";
-        }catch(std::invalid_argument ia){
-            std::cout << "Invalid extension " << extension << std::endl;
-            extension = "raw";
-        }
-    }
-
     // Find copy-capable queue (should be any queue)
     uint32_t copyQueueFamily = deviceContext->getUsableDeviceQueueFamily(VK_QUEUE_TRANSFER_BIT);
     assert(copyQueueFamily != (std::numeric_limits<uint32_t>::max)());
@@ -847,13 +673,17 @@ void VulkanImage::saveImage(const std::string& imageFileName){
     cbBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     cbBeginInfo.pInheritanceInfo = nullptr; // Not a secondary command buffer
 
-    // Blit image to an R(G)(B)(A) 8bpp target if the source image is not R(G)(B)(A) or 8bpp
-    bool isRGBA = VulkanImage::isRGBAOrder(imageCreateInfo.format);
+    // Blit image to an R(G)(B)(A) 8bpp target if the source image is not R(G)(B)(A) or 8bpp,
+    // or convert it on the host when the device can't blit it
+    const VulkanFormatInfo& formatInfo = VulkanFormatTraits::getInfo(imageCreateInfo.format);
+    bool isRGBA = formatInfo.channelOrder == VULKAN_CHANNEL_ORDER_RGBA && formatInfo.channelCount == 4 && formatInfo.channelBits == 8;
     bool isBlittable = (deviceContext->getSupportedFormat({imageCreateInfo.format}, imageCreateInfo.tiling, VK_FORMAT_FEATURE_BLIT_SRC_BIT ) == imageCreateInfo.format) && 
                        (imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT == VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
-    if(!isBlittable){
-        std::cout << "The source image does not support blits, falling back to standard RAW copy-to-buffer" << std::endl;
-        extension = "raw";
+    VkFormat encodeFormat = VulkanPixelConverter::getEncodeFormat(imageCreateInfo.format);
+    bool isConvertible = !isRGBA && !isBlittable && VulkanPixelConverter::canConvert(imageCreateInfo.format, encodeFormat);
+    bool isRaw = !isRGBA && !isBlittable && !isConvertible;
+    if(isRaw){
+        std::cout << "The source image does not support blits or host conversion, falling back to standard RAW copy-to-buffer" << std::endl;
     }
 
     // Choose first from unsigned formats, then switch to signed formats if unsigned formats don't support blitting
@@ -871,7 +701,7 @@ void VulkanImage::saveImage(const std::string& imageFileName){
     destImage.createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
 
     // Perform blit to an R8G8B8A8 Image for saving to an image file
-    if((!isRGBA || bytesPerPixel != 4) && isBlittable){
+    if(!isRGBA && isBlittable){
         // Blit then copy
         deviceContext->vkBeginCommandBuffer(copyCommandBuffer[0], &cbBeginInfo);
         blitImage(copyCommandBuffer[0], destImage);
@@ -912,149 +742,100 @@ void VulkanImage::saveImage(const std::string& imageFileName){
     deviceContext->vkDestroyFence(deviceContext->device, copyFence, nullptr);
 
     // Invalidate memory to make it visible to host
-    VkMappedMemoryRange imageBufferMemoryRange;
-    imageBufferMemoryRange.sType    = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    imageBufferMemoryRange.pNext    = nullptr;
-    imageBufferMemoryRange.memory   = imageBuffer.bufferMemory;
-    imageBufferMemoryRange.offset   = 0;
-    imageBufferMemoryRange.size     = VK_WHOLE_SIZE;
-    assert(deviceContext->vkInvalidateMappedMemoryRanges(deviceContext->device, 1, &imageBufferMemoryRange) == VK_SUCCESS);
-
-    // Save image
-    void * bufferData = nullptr;
-    assert( deviceContext->vkMapMemory(deviceContext->device, imageBuffer.bufferMemory, 0, dataSize, 0, &bufferData) == VK_SUCCESS);
+    deviceContext->invalidateMappedRange(imageBuffer.bufferAllocation, 0, imageBuffer.payloadSize);
+
+    // Save image straight from the mapped buffer, through the converter if it wasn't blitted
+    void * bufferData = imageBuffer.bufferAllocation.mappedData;
     assert(bufferData != nullptr);
+    uint32_t rowPitch = imageRowLength * destBytesPerPixel;
+    if(isConvertible){
+        std::vector<uint8_t> convertedData((size_t)rowPitch * imageCreateInfo.extent.height);
+        VulkanPixelConverter::convert(imageCreateInfo.format, bufferData, imageRowLength * bytesPerPixel, encodeFormat, &convertedData[0], rowPitch,
+                                      imageCreateInfo.extent.width, imageCreateInfo.extent.height);
+        writeImageFile(imageFileName, &convertedData[0], imageCreateInfo.extent.width, imageCreateInfo.extent.height, rowPitch);
+    }else{
+        writeImageFile(imageFileName, bufferData, imageCreateInfo.extent.width, imageCreateInfo.extent.height, isRaw ? imageRowLength * bytesPerPixel : rowPitch, isRaw);
+    }
 
-    std::vector<char> copyArray(dataSize, ' ');
-    memcpy(&copyArray[0], bufferData, dataSize);
-    deviceContext->vkUnmapMemory(deviceContext->device, imageBuffer.bufferMemory);
-
-    int w = (int)imageCreateInfo.extent.width;
-    int h = (int)imageCreateInfo.extent.height;
-
-    if(isBlittable){
-        if(extension.compare("png") == 0){
-            stbi_write_png(imageFileName.c_str(), w, h, 4, &copyArray[0], imageRowLength * destBytesPerPixel);
-        }else if(extension.compare("bmp") == 0){
-            stbi_write_bmp(imageFileName.c_str(), w, h, 4, &copyArray[0]);
-        }else if(extension.compare("tga") == 0){
-            stbi_write_tga(imageFileName.c_str(), w, h, 4, &copyArray[0]);
-        }else if(extension.compare("jpg") == 0){
-            int jpegQuality = 75;
-            stbi_write_jpg(imageFileName.c_str(), w, h, 4, &copyArray[0], jpegQuality);
-        }else if(extension.compare("hdr") == 0){
-            stbi_write_hdr(imageFileName.c_str(), w, h, 4, (const float *)&copyArray[0]);
-        }else{
-            // Raw dump
-            std::ofstream rawImageStream(imageFileName.c_str(), std::ofstream::binary);
-            rawImageStream.write(&copyArray[0], dataSize);
-            rawImageStream.close();
+    copyCommandPool->freeCommandBuffers(1, &copyCommandBuffer);
+    delete copyCommandBuffer;
+    delete copyCommandPool;
+}
+
+void VulkanImage::writeImageFile(const std::string& imageFileName, const void * data, uint32_t width, uint32_t height, uint32_t rowPitch, bool raw){
+    // Choose the appropriate save function
+    std::regex extensionRegex(".+\\.(.+)");
+    std::smatch matches;
+    std::string extension = "raw";
+
+    if(std::regex_match(imageFileName, matches, extensionRegex)){
+        try{
+            extension = (matches[1].str)();
+        }catch(std::out_of_range oor){
+            std::cout << "Invalid extension " << extension << std::endl;
+            extension = "raw";
+        }catch(std::invalid_argument ia){
+            std::cout << "Invalid extension " << extension << std::endl;
+            extension = "raw";
         }
+    }
+
+    int w = (int)width;
+    int h = (int)height;
+
+    // Encoders expect tightly packed RGBA8 rows
+    if(!raw && extension.compare("png") == 0){
+        stbi_write_png(imageFileName.c_str(), w, h, 4, data, rowPitch);
+    }else if(!raw && extension.compare("bmp") == 0){
+        stbi_write_bmp(imageFileName.c_str(), w, h, 4, data);
+    }else if(!raw && extension.compare("tga") == 0){
+        stbi_write_tga(imageFileName.c_str(), w, h, 4, data);
+    }else if(!raw && extension.compare("jpg") == 0){
+        int jpegQuality = 75;
+        stbi_write_jpg(imageFileName.c_str(), w, h, 4, data, jpegQuality);
+    }else if(!raw && extension.compare("hdr") == 0){
+        stbi_write_hdr(imageFileName.c_str(), w, h, 4, (const float *)data);
     }else{
         // Raw dump
         std::ofstream rawImageStream(imageFileName.c_str(), std::ofstream::binary);
-        rawImageStream.write(&copyArray[0], dataSize);
+        rawImageStream.write((const char *)data, (std::streamsize)rowPitch * height);
         rawImageStream.close();
     }
+}
 
-    copyArray.clear();
-
-    copyCommandPool->freeCommandBuffers(1, &copyCommandBuffer);
-    delete copyCommandBuffer;
-    delete copyCommandPool;
+void VulkanImage::resetSubresourceStates(VkImageLayout initialLayout){
+    VulkanSubresourceState initialState;
+    initialState.layout = initialLayout;
+    initialState.stages = VulkanBarrierBatcher::getLayoutStages(initialLayout);
+    initialState.access = VulkanBarrierBatcher::getLayoutAccess(initialLayout);
+    subresourceStates.assign(imageCreateInfo.mipLevels * imageCreateInfo.arrayLayers, initialState);
 }
 
 void VulkanImage::setImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout){
-    assert(imageViewHandle != VK_NULL_HANDLE);
-
-    VkImageMemoryBarrier imageBarrier;
-    imageBarrier.sType                  = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageBarrier.pNext                  = nullptr;
-    imageBarrier.srcAccessMask          = 0;
-    imageBarrier.dstAccessMask          = 0;
-    imageBarrier.oldLayout              = oldLayout;
-    imageBarrier.newLayout              = newLayout;
-    imageBarrier.srcQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
-    imageBarrier.dstQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
-    imageBarrier.image                  = imageHandle;
-    imageBarrier.subresourceRange       = imageViewCreateInfo.subresourceRange;
-
-    VkPipelineStageFlags srcStageMask = (VkPipelineStageFlags)0;
-    VkPipelineStageFlags dstStageMask = (VkPipelineStageFlags)0;
-
-    switch (oldLayout) {
-        case VK_IMAGE_LAYOUT_PREINITIALIZED:
-            imageBarrier.srcAccessMask =
-            VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
-            srcStageMask = VK_PIPELINE_STAGE_HOST_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-            imageBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-            srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            imageBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-            imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-            imageBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            srcStageMask = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
-                           VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT |
-                           VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT |
-                           VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT |
-                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
-                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-            break;
-        default:
-            break;
-    }
-
-    switch (newLayout) {
-        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
-            imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
-            imageBarrier.srcAccessMask |= VK_ACCESS_TRANSFER_READ_BIT;
-            imageBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
-            dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
-            imageBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-            imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            srcStageMask |= VK_PIPELINE_STAGE_TRANSFER_BIT;
-            break;
-        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
-            imageBarrier.dstAccessMask |=
-                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            dstStageMask |= (VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
-            break;
-        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
-            imageBarrier.srcAccessMask =
-                VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
-            srcStageMask = VK_PIPELINE_STAGE_HOST_BIT;
-            imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            dstStageMask = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
-                           VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT |
-                           VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT |
-                           VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT |
-                           VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
-                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-            break;
-        default:
-            break;
+    // The caller knows better where a render pass or present left the image
+    for (auto& state : subresourceStates){
+        if (state.layout != oldLayout && oldLayout != VK_IMAGE_LAYOUT_UNDEFINED){
+            state.layout = oldLayout;
+            state.stages = VulkanBarrierBatcher::getLayoutStages(oldLayout);
+            state.access = VulkanBarrierBatcher::getLayoutAccess(oldLayout);
+        }
     }
 
-    srcStageMask = (srcStageMask == 0) ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : srcStageMask;
-    dstStageMask = (dstStageMask == 0) ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : dstStageMask;
+    VulkanBarrierBatcher barrierBatcher(deviceContext, commandBuffer);
+    barrierBatcher.transition(*this, newLayout, VulkanBarrierBatcher::getLayoutStages(newLayout), VulkanBarrierBatcher::getLayoutAccess(newLayout), oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+    barrierBatcher.flush();
+}
 
-    deviceContext->vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
-    // std::cout << "Transitioning Image Layout for Image Handle {0x" << std::hex << imageHandle << "} from " << oldLayout << " to " << newLayout << std::endl;
-    layout = newLayout;
+void VulkanImage::setSubresourceState(const VkImageSubresourceRange& subresourceRange, VkImageLayout layout, VkPipelineStageFlags stages, VkAccessFlags access){
+    // For changes made outside a barrier batcher, like render pass final layouts and queue transfers
+    uint32_t levelCount = subresourceRange.levelCount == VK_REMAINING_MIP_LEVELS ? imageCreateInfo.mipLevels - subresourceRange.baseMipLevel : subresourceRange.levelCount;
+    uint32_t layerCount = subresourceRange.layerCount == VK_REMAINING_ARRAY_LAYERS ? imageCreateInfo.arrayLayers - subresourceRange.baseArrayLayer : subresourceRange.layerCount;
+    for (uint32_t arrayLayer = subresourceRange.baseArrayLayer; arrayLayer < subresourceRange.baseArrayLayer + layerCount; arrayLayer++){
+        for (uint32_t mipLevel = subresourceRange.baseMipLevel; mipLevel < subresourceRange.baseMipLevel + levelCount; mipLevel++){
+            VulkanSubresourceState& state = getSubresourceState(mipLevel, arrayLayer);
+            state.layout = layout;
+            state.stages = stages;
+            state.access = access;
+        }
+    }
 }
\ No newline at end of file
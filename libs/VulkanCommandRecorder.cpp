@@ -0,0 +1,145 @@
+#include <cassert>
+#include "VulkanCommandRecorder.h"
+
+VulkanCommandRecorder::VulkanCommandRecorder(VulkanFramePacer * __framePacer, uint32_t __workerCount, uint32_t __minDrawsPerTask){
+    framePacer      = __framePacer;
+    assert(framePacer != nullptr);
+    deviceContext   = framePacer->deviceContext;
+    workerCount     = (__workerCount != 0) ? __workerCount : std::thread::hardware_concurrency();
+    workerCount     = (std::max)(workerCount, 1u);
+    minDrawsPerTask = (std::max)(__minDrawsPerTask, 1u);
+    pendingTasks    = 0;
+    stopping        = false;
+
+    // One transient pool per worker per frame in flight, command buffers are allocated on first use
+    workerCommands.resize(framePacer->framesInFlight * workerCount);
+    for (auto& commands : workerCommands){
+        commands.commandPool    = deviceContext->getCommandPool(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, framePacer->queueFamilyIndex);
+        commands.usedCount      = 0;
+        commands.frameNumber    = (std::numeric_limits<uint64_t>::max)();
+    }
+
+    for (uint32_t workerIndex = 0; workerIndex < workerCount; workerIndex++){
+        workers.push_back(std::thread(&VulkanCommandRecorder::workerLoop, this, workerIndex));
+    }
+}
+
+VulkanCommandRecorder::~VulkanCommandRecorder(){
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    for (auto& worker : workers){
+        worker.join();
+    }
+
+    // Command buffers may still be executing
+    framePacer->waitIdle();
+    for (auto& commands : workerCommands){
+        delete commands.commandPool;
+    }
+}
+
+void VulkanCommandRecorder::recordParallel(VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, uint32_t drawCount, const VulkanRecordJob& job){
+    if (drawCount == 0){
+        return;
+    }
+
+    VulkanFrame& frame = framePacer->getCurrentFrame();
+
+    // Secondary buffers continue the render pass the primary buffer already began
+    VkCommandBufferInheritanceInfo inheritanceInfo;
+    inheritanceInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.pNext                   = nullptr;
+    inheritanceInfo.renderPass              = renderPass;
+    inheritanceInfo.subpass                 = subpass;
+    inheritanceInfo.framebuffer             = framebuffer;
+    inheritanceInfo.occlusionQueryEnable    = VK_FALSE;
+    inheritanceInfo.queryFlags              = 0;
+    inheritanceInfo.pipelineStatistics      = 0;
+
+    // Small draw lists aren't worth waking every worker for
+    uint32_t taskCount      = (std::min)((drawCount + minDrawsPerTask - 1) / minDrawsPerTask, workerCount);
+    uint32_t drawsPerTask   = (drawCount + taskCount - 1) / taskCount;
+    taskCount               = (drawCount + drawsPerTask - 1) / drawsPerTask;
+    std::vector<VkCommandBuffer> secondaryCommandBuffers(taskCount, VK_NULL_HANDLE);
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (uint32_t taskIndex = 0; taskIndex < taskCount; taskIndex++){
+            VulkanRecordTask task;
+            task.job                = &job;
+            task.inheritanceInfo    = &inheritanceInfo;
+            task.frameIndex         = frame.frameIndex;
+            task.frameNumber        = frame.frameNumber;
+            task.firstDraw          = taskIndex * drawsPerTask;
+            task.drawCount          = (std::min)(drawsPerTask, drawCount - task.firstDraw);
+            task.result             = &secondaryCommandBuffers[taskIndex];
+            taskQueue.push_back(task);
+        }
+        pendingTasks += taskCount;
+    }
+    queueCondition.notify_all();
+
+    // Wait for the workers, then execute in draw order
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        doneCondition.wait(lock, [this]{ return pendingTasks == 0; });
+    }
+    deviceContext->vkCmdExecuteCommands(frame.commandBuffer, taskCount, &secondaryCommandBuffers[0]);
+}
+
+VkCommandBuffer VulkanCommandRecorder::getCommandBuffer(uint32_t workerIndex, uint32_t frameIndex, uint64_t frameNumber){
+    VulkanWorkerCommands& commands = workerCommands[frameIndex * workerCount + workerIndex];
+
+    // The frame pacer already waited for the frame that last used this slot
+    if (commands.frameNumber != frameNumber){
+        commands.commandPool->resetCommandPool(0);
+        commands.usedCount      = 0;
+        commands.frameNumber    = frameNumber;
+    }
+
+    if (commands.usedCount == commands.commandBuffers.size()){
+        VkCommandBuffer * commandBuffers = commands.commandPool->getCommandBuffers(VK_COMMAND_BUFFER_LEVEL_SECONDARY, 1);
+        commands.commandBuffers.push_back(commandBuffers[0]);
+        delete [] commandBuffers;
+    }
+    return commands.commandBuffers[commands.usedCount++];
+}
+
+void VulkanCommandRecorder::workerLoop(uint32_t workerIndex){
+    while (true){
+        VulkanRecordTask task;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]{ return stopping || !taskQueue.empty(); });
+            if (taskQueue.empty()){
+                return;
+            }
+            task = taskQueue.front();
+            taskQueue.pop_front();
+        }
+
+        VkCommandBuffer commandBuffer = getCommandBuffer(workerIndex, task.frameIndex, task.frameNumber);
+
+        VkCommandBufferBeginInfo cbBeginInfo;
+        cbBeginInfo.sType               = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cbBeginInfo.pNext               = nullptr;
+        cbBeginInfo.flags               = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        cbBeginInfo.pInheritanceInfo    = task.inheritanceInfo;
+        assert(deviceContext->vkBeginCommandBuffer(commandBuffer, &cbBeginInfo) == VK_SUCCESS);
+        (*task.job)(commandBuffer, task.firstDraw, task.drawCount);
+        assert(deviceContext->vkEndCommandBuffer(commandBuffer) == VK_SUCCESS);
+        *task.result = commandBuffer;
+
+        bool finished = false;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            finished = (--pendingTasks == 0);
+        }
+        if (finished){
+            doneCondition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,283 @@
+#include <algorithm>
+#include <cassert>
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanFramePacer.h"
+
+VulkanDescriptorAllocator::VulkanDescriptorAllocator(VulkanDevice * __deviceContext, uint32_t __initialSetsPerPool, uint32_t __maxSetsPerPool){
+    deviceContext       = __deviceContext;
+    initialSetsPerPool  = (std::max)(__initialSetsPerPool, 1u);
+    maxSetsPerPool      = (std::max)(__maxSetsPerPool, initialSetsPerPool);
+    currentFrame        = 0;
+    framesInFlight      = 1;
+    assert(deviceContext != nullptr);
+}
+
+VulkanDescriptorAllocator::~VulkanDescriptorAllocator(){
+    for (auto& frame : frames){
+        for (auto& chainPair : frame.chains){
+            for (auto pool : chainPair.second.pools){
+                deviceContext->vkDestroyDescriptorPool(deviceContext->device, pool, nullptr);
+            }
+        }
+    }
+
+    for (auto& infoPair : layoutInfos){
+        for (auto pool : infoPair.second.chain.pools){
+            deviceContext->vkDestroyDescriptorPool(deviceContext->device, pool, nullptr);
+        }
+        deviceContext->vkDestroyDescriptorSetLayout(deviceContext->device, infoPair.first, nullptr);
+    }
+}
+
+void VulkanDescriptorAllocator::allocateSets(VkDescriptorSetLayout layout, uint32_t setCount, VkDescriptorSet * sets){
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    VulkanDescriptorSetLayoutInfo& layoutInfo = layoutInfos.at(layout);
+    allocateFromChain(layoutInfo.chain, layoutInfo, layout, setCount, sets);
+}
+
+void VulkanDescriptorAllocator::allocateSets(const std::vector<VkDescriptorSetLayout>& layouts, VkDescriptorSet * sets){
+    // Sets of one layout share a pool chain, so each layout is allocated as one batch
+    std::map<VkDescriptorSetLayout, std::vector<uint32_t>> layoutSetIndices;
+    for (uint32_t setIndex = 0; setIndex < layouts.size(); setIndex++){
+        layoutSetIndices[layouts[setIndex]].push_back(setIndex);
+    }
+
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    std::vector<VkDescriptorSet> batchSets;
+    for (auto& layoutPair : layoutSetIndices){
+        VulkanDescriptorSetLayoutInfo& layoutInfo = layoutInfos.at(layoutPair.first);
+        batchSets.resize(layoutPair.second.size());
+        allocateFromChain(layoutInfo.chain, layoutInfo, layoutPair.first, batchSets.size(), &batchSets[0]);
+        for (uint32_t batchIndex = 0; batchIndex < batchSets.size(); batchIndex++){
+            sets[layoutPair.second[batchIndex]] = batchSets[batchIndex];
+        }
+    }
+}
+
+void VulkanDescriptorAllocator::allocateTransientSets(const VulkanFrame& frame, VkDescriptorSetLayout layout, uint32_t setCount, VkDescriptorSet * sets){
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    if (frame.frameIndex >= frames.size()){
+        VulkanDescriptorFrame newFrame;
+        newFrame.frameNumber = (std::numeric_limits<uint64_t>::max)();
+        frames.resize(frame.frameIndex + 1, newFrame);
+    }
+
+    // The frame pacer already waited for the frame that last used this slot
+    VulkanDescriptorFrame& descriptorFrame = frames[frame.frameIndex];
+    if (descriptorFrame.frameNumber != frame.frameNumber){
+        for (auto& chainPair : descriptorFrame.chains){
+            resetChain(chainPair.second);
+        }
+        descriptorFrame.frameNumber = frame.frameNumber;
+    }
+
+    VulkanDescriptorPoolChain& chain = descriptorFrame.chains[layout];
+    allocateFromChain(chain, layoutInfos.at(layout), layout, setCount, sets);
+}
+
+void VulkanDescriptorAllocator::beginFrame(uint64_t frameNumber, uint32_t __framesInFlight){
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    currentFrame    = frameNumber;
+    framesInFlight  = __framesInFlight;
+
+    // The frame pacer waited for every frame that could have bound these, so they can be handed out again
+    while (!releasedSets.empty() && releasedSets.front().frameNumber + framesInFlight <= currentFrame){
+        VulkanReleasedDescriptorSet& releasedSet = releasedSets.front();
+        layoutInfos.at(releasedSet.layout).chain.freeSets.push_back(releasedSet.set);
+        releasedSets.pop_front();
+    }
+}
+
+VkDescriptorSetLayout VulkanDescriptorAllocator::getSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings){
+    // Layouts with the same bindings are interchangeable, so the signature ignores binding order
+    std::vector<VkDescriptorSetLayoutBinding> sortedBindings(bindings);
+    std::sort(sortedBindings.begin(), sortedBindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b){
+        return a.binding < b.binding;
+    });
+
+    std::vector<uint64_t> signature;
+    for (auto& binding : sortedBindings){
+        signature.push_back(binding.binding);
+        signature.push_back(binding.descriptorType);
+        signature.push_back(binding.descriptorCount);
+        signature.push_back(binding.stageFlags);
+        signature.push_back(binding.pImmutableSamplers != nullptr ? 1 : 0);
+        if (binding.pImmutableSamplers != nullptr){
+            for (uint32_t samplerIndex = 0; samplerIndex < binding.descriptorCount; samplerIndex++){
+                signature.push_back((uint64_t)binding.pImmutableSamplers[samplerIndex]);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    auto existingLayout = layoutCache.find(signature);
+    if (existingLayout != layoutCache.end()){
+        return existingLayout->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo setLayoutInfo;
+    setLayoutInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutInfo.pNext         = nullptr;
+    setLayoutInfo.flags         = 0;
+    setLayoutInfo.bindingCount  = sortedBindings.size();
+    setLayoutInfo.pBindings     = sortedBindings.empty() ? nullptr : &sortedBindings[0];
+
+    VkDescriptorSetLayout layout;
+    assert(deviceContext->vkCreateDescriptorSetLayout(deviceContext->device, &setLayoutInfo, nullptr, &layout) == VK_SUCCESS);
+    layoutCache.emplace(signature, layout);
+
+    // Total descriptors of each type in one set
+    std::map<VkDescriptorType, uint32_t> typeCounts;
+    for (auto& binding : sortedBindings){
+        if (binding.descriptorCount > 0){
+            typeCounts[binding.descriptorType] += binding.descriptorCount;
+        }
+    }
+
+    VulkanDescriptorSetLayoutInfo& layoutInfo = layoutInfos[layout];
+    for (auto& typeCount : typeCounts){
+        VkDescriptorPoolSize poolSize;
+        poolSize.type               = typeCount.first;
+        poolSize.descriptorCount    = typeCount.second;
+        layoutInfo.poolSizes.push_back(poolSize);
+    }
+    layoutInfo.chain.currentPool        = 0;
+    layoutInfo.chain.currentPoolUsed    = 0;
+
+    return layout;
+}
+
+void VulkanDescriptorAllocator::releaseSets(VkDescriptorSetLayout layout, uint32_t setCount, const VkDescriptorSet * sets){
+    // Frames still in flight may have bound the sets, so they only reach the free list once those finish
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+    for (uint32_t setIndex = 0; setIndex < setCount; setIndex++){
+        VulkanReleasedDescriptorSet releasedSet;
+        releasedSet.layout      = layout;
+        releasedSet.set         = sets[setIndex];
+        releasedSet.frameNumber = currentFrame;
+        releasedSets.push_back(releasedSet);
+    }
+}
+
+void VulkanDescriptorAllocator::allocateFromChain(VulkanDescriptorPoolChain& chain, const VulkanDescriptorSetLayoutInfo& layoutInfo, VkDescriptorSetLayout layout, uint32_t setCount, VkDescriptorSet * sets){
+    assert(!layoutInfo.poolSizes.empty());
+    uint32_t allocatedCount = 0;
+
+    // Released sets come back first, they only need new writes
+    while (allocatedCount < setCount && !chain.freeSets.empty()){
+        sets[allocatedCount++] = chain.freeSets.back();
+        chain.freeSets.pop_back();
+    }
+
+    while (allocatedCount < setCount){
+        if (chain.currentPool == chain.pools.size()){
+            // Every pool is full, add one twice the size of the last
+            uint32_t capacity = chain.poolCapacities.empty() ? initialSetsPerPool : (std::min)(chain.poolCapacities.back() * 2, maxSetsPerPool);
+
+            std::vector<VkDescriptorPoolSize> poolSizes(layoutInfo.poolSizes);
+            for (auto& poolSize : poolSizes){
+                poolSize.descriptorCount *= capacity;
+            }
+
+            VkDescriptorPoolCreateInfo poolInfo;
+            poolInfo.sType          = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            poolInfo.pNext          = nullptr;
+            poolInfo.flags          = 0;
+            poolInfo.maxSets        = capacity;
+            poolInfo.poolSizeCount  = poolSizes.size();
+            poolInfo.pPoolSizes     = &poolSizes[0];
+
+            VkDescriptorPool pool;
+            assert(deviceContext->vkCreateDescriptorPool(deviceContext->device, &poolInfo, nullptr, &pool) == VK_SUCCESS);
+            chain.pools.push_back(pool);
+            chain.poolCapacities.push_back(capacity);
+            chain.currentPoolUsed = 0;
+        }
+
+        uint32_t availableCount = chain.poolCapacities[chain.currentPool] - chain.currentPoolUsed;
+        if (availableCount == 0){
+            chain.currentPool++;
+            chain.currentPoolUsed = 0;
+            continue;
+        }
+
+        // Allocate as many as fit in one call
+        uint32_t batchCount = (std::min)(availableCount, setCount - allocatedCount);
+        std::vector<VkDescriptorSetLayout> setLayouts(batchCount, layout);
+
+        VkDescriptorSetAllocateInfo descriptorSetInfo;
+        descriptorSetInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetInfo.pNext                 = nullptr;
+        descriptorSetInfo.descriptorPool        = chain.pools[chain.currentPool];
+        descriptorSetInfo.descriptorSetCount    = batchCount;
+        descriptorSetInfo.pSetLayouts           = &setLayouts[0];
+        assert(deviceContext->vkAllocateDescriptorSets(deviceContext->device, &descriptorSetInfo, &sets[allocatedCount]) == VK_SUCCESS);
+
+        chain.currentPoolUsed   += batchCount;
+        allocatedCount          += batchCount;
+    }
+}
+
+void VulkanDescriptorAllocator::resetChain(VulkanDescriptorPoolChain& chain){
+    for (auto pool : chain.pools){
+        assert(deviceContext->vkResetDescriptorPool(deviceContext->device, pool, 0) == VK_SUCCESS);
+    }
+    chain.currentPool       = 0;
+    chain.currentPoolUsed   = 0;
+}
+
+VulkanDescriptorWriter::VulkanDescriptorWriter(VulkanDevice * __deviceContext){
+    deviceContext = __deviceContext;
+    assert(deviceContext != nullptr);
+}
+
+void VulkanDescriptorWriter::update(){
+    if (!writes.empty()){
+        deviceContext->vkUpdateDescriptorSets(deviceContext->device, writes.size(), &writes[0], 0, nullptr);
+    }
+    writes.clear();
+    bufferInfos.clear();
+    imageInfos.clear();
+}
+
+void VulkanDescriptorWriter::writeBuffer(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range, uint32_t arrayElement){
+    VkDescriptorBufferInfo bufferInfo;
+    bufferInfo.buffer   = buffer;
+    bufferInfo.offset   = offset;
+    bufferInfo.range    = range;
+    bufferInfos.push_back(bufferInfo);
+
+    VkWriteDescriptorSet descriptorWrite;
+    descriptorWrite.sType               = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.pNext               = nullptr;
+    descriptorWrite.dstSet              = set;
+    descriptorWrite.dstBinding          = binding;
+    descriptorWrite.dstArrayElement     = arrayElement;
+    descriptorWrite.descriptorCount     = 1;
+    descriptorWrite.descriptorType      = type;
+    descriptorWrite.pImageInfo          = nullptr;
+    descriptorWrite.pBufferInfo         = &bufferInfos.back();
+    descriptorWrite.pTexelBufferView    = nullptr;
+    writes.push_back(descriptorWrite);
+}
+
+void VulkanDescriptorWriter::writeImage(VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkSampler sampler, VkImageView imageView, VkImageLayout imageLayout, uint32_t arrayElement){
+    VkDescriptorImageInfo imageInfo;
+    imageInfo.sampler       = sampler;
+    imageInfo.imageView     = imageView;
+    imageInfo.imageLayout   = imageLayout;
+    imageInfos.push_back(imageInfo);
+
+    VkWriteDescriptorSet descriptorWrite;
+    descriptorWrite.sType               = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.pNext               = nullptr;
+    descriptorWrite.dstSet              = set;
+    descriptorWrite.dstBinding          = binding;
+    descriptorWrite.dstArrayElement     = arrayElement;
+    descriptorWrite.descriptorCount     = 1;
+    descriptorWrite.descriptorType      = type;
+    descriptorWrite.pImageInfo          = &imageInfos.back();
+    descriptorWrite.pBufferInfo         = nullptr;
+    descriptorWrite.pTexelBufferView    = nullptr;
+    writes.push_back(descriptorWrite);
+}
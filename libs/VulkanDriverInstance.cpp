@@ -1,5 +1,9 @@
 #include <cassert>
 #include "VulkanDriverInstance.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanPipelineCache.h"
+#include "VulkanResidencyManager.h"
+#include "VulkanStagingRing.h"
 
 #if defined (_WIN32) || defined (_WIN64)
     #define VK_EXPORTED_FUNCTION(function) function = (PFN_##function)GetProcAddress(loader, #function ); assert( function != nullptr);
@@ -311,25 +315,26 @@ VulkanDevice::VulkanDevice(VulkanDriverInstance * __instance, uint32_t __deviceN
     }
 
     // Device Queue Create Info
+    // Create queues in every family, so that transfer-only families are usable for uploads
     std::vector<VkDeviceQueueCreateInfo> queueInfo(deviceQueueFamilyPropertyCount);
+    std::vector<std::vector<float>> queuePriorities(deviceQueueFamilyPropertyCount);
     for (uint32_t queueFamily = 0; queueFamily < deviceQueueFamilyPropertyCount; queueFamily++){
         auto queueFamilyProperties = deviceQueueProperties[queueFamily];
         
         queueInfo[queueFamily].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueInfo[queueFamily].pNext = nullptr;
         queueInfo[queueFamily].flags = 0;
-        queueInfo[queueFamily].queueFamilyIndex = 0;
+        queueInfo[queueFamily].queueFamilyIndex = queueFamily;
         queueInfo[queueFamily].queueCount = queueFamilyProperties.queueCount;
-        float * queuePriorities = new float[queueInfo[queueFamily].queueCount];
-        for (uint32_t i = 0; i < queueInfo[queueFamily].queueCount; i++){
-            queuePriorities[i] = 1.0; // Leave at same priority for now
-        }
-        queueInfo[queueFamily].pQueuePriorities = queuePriorities;
-        queueFamily++;
+        queuePriorities[queueFamily].assign(queueInfo[queueFamily].queueCount, 1.0f); // Leave at same priority for now
+        queueInfo[queueFamily].pQueuePriorities = &queuePriorities[queueFamily][0];
     }
 
     // Extensions
-    std::vector<const char*> requestedExtensions = {"VK_KHR_swapchain"};
+    std::vector<const char*> requestedExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    if (instance->properties2Support){
+        requestedExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
     std::vector<const char*> enabledExtensions;
     uint32_t extensionCount = 0;
     assert(instance->vkEnumerateDeviceExtensionProperties(instance->physicalDevices[deviceNumber], nullptr, &extensionCount, nullptr) == VK_SUCCESS);
@@ -347,21 +352,41 @@ VulkanDevice::VulkanDevice(VulkanDriverInstance * __instance, uint32_t __deviceN
         }
     }
 
+    // Presentation is optional, headless devices render to offscreen targets only
+    swapchainSupport = instance->surfaceSupport && std::find_if(enabledExtensions.begin(), enabledExtensions.end(), [](const char* extension){
+        return strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+    }) != enabledExtensions.end();
+    if (!swapchainSupport){
+        enabledExtensions.erase(std::remove_if(enabledExtensions.begin(), enabledExtensions.end(), [](const char* extension){
+            return strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0;
+        }), enabledExtensions.end());
+    }
+
+    // Without the budget extension, heap usage is estimated from our own allocations
+    memoryBudgetSupport = std::find_if(enabledExtensions.begin(), enabledExtensions.end(), [](const char* extension){
+        return strcmp(extension, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+    }) != enabledExtensions.end();
+
     // Create Info
     VkDeviceCreateInfo creationInfo;
     creationInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     creationInfo.pNext = nullptr;
     creationInfo.flags = 0; // Reserved
-    creationInfo.queueCreateInfoCount = 1;
+    creationInfo.queueCreateInfoCount = queueInfo.size();
     creationInfo.pQueueCreateInfos = &queueInfo[0];
     creationInfo.enabledLayerCount = 0;
     creationInfo.ppEnabledLayerNames = nullptr;
-    creationInfo.enabledExtensionCount = 1;
-    creationInfo.ppEnabledExtensionNames = &enabledExtensions[0];
+    creationInfo.enabledExtensionCount = enabledExtensions.size();
+    creationInfo.ppEnabledExtensionNames = enabledExtensions.empty() ? nullptr : &enabledExtensions[0];
     creationInfo.pEnabledFeatures =  ((requiredFeatures != nullptr || requestedFeatures != nullptr) ? &appliedFeatures : nullptr);
 
     // Create Device
     assert (instance->vkCreateDevice(instance->physicalDevices[deviceNumber], &creationInfo, nullptr, &device) == VK_SUCCESS);
+    if (creationInfo.pEnabledFeatures != nullptr){
+        enabledFeatures = appliedFeatures;
+    }else{
+        memset(&enabledFeatures, 0, sizeof(enabledFeatures));
+    }
 
     /***********************************************************
      * Enumerate Device Function Pointers
@@ -419,6 +444,7 @@ VulkanDevice::VulkanDevice(VulkanDriverInstance * __instance, uint32_t __deviceN
     VK_DEVICE_FUNCTION(vkCmdWaitEvents);
     VK_DEVICE_FUNCTION(vkCmdWriteTimestamp);
     VK_DEVICE_FUNCTION(vkEndCommandBuffer);
+    VK_DEVICE_FUNCTION(vkQueueBindSparse);
     VK_DEVICE_FUNCTION(vkQueueSubmit);
 
     // Creation
@@ -502,11 +528,33 @@ VulkanDevice::VulkanDevice(VulkanDriverInstance * __instance, uint32_t __deviceN
     VK_DEVICE_FUNCTION(vkWaitForFences);
 
     // Extensions
-    VK_DEVICE_FUNCTION(vkCreateSwapchainKHR);
-    VK_DEVICE_FUNCTION(vkDestroySwapchainKHR);
-    VK_DEVICE_FUNCTION(vkGetSwapchainImagesKHR);
-    VK_DEVICE_FUNCTION(vkAcquireNextImageKHR);
-    VK_DEVICE_FUNCTION(vkQueuePresentKHR);
+    vkCreateSwapchainKHR    = nullptr;
+    vkDestroySwapchainKHR   = nullptr;
+    vkGetSwapchainImagesKHR = nullptr;
+    vkAcquireNextImageKHR   = nullptr;
+    vkQueuePresentKHR       = nullptr;
+    if (swapchainSupport){
+        VK_DEVICE_FUNCTION(vkCreateSwapchainKHR);
+        VK_DEVICE_FUNCTION(vkDestroySwapchainKHR);
+        VK_DEVICE_FUNCTION(vkGetSwapchainImagesKHR);
+        VK_DEVICE_FUNCTION(vkAcquireNextImageKHR);
+        VK_DEVICE_FUNCTION(vkQueuePresentKHR);
+    }
+
+    // Device memory is sub-allocated from large blocks
+    memoryAllocator = new VulkanMemoryAllocator(this);
+
+    // Heap budgets decide where allocations go and when streamable resources are evicted
+    residencyManager = new VulkanResidencyManager(this);
+
+    // Uploads to device-local memory go through a shared staging ring
+    stagingRing = new VulkanStagingRing(this);
+
+    // Pipelines compile against a cache that persists between runs
+    pipelineCache = new VulkanPipelineCache(this);
+
+    // Descriptor sets come from pool chains shared by every pipeline with the same layout
+    descriptorAllocator = new VulkanDescriptorAllocator(this);
 }
 
 VulkanDevice::~VulkanDevice(){
@@ -514,22 +562,27 @@ VulkanDevice::~VulkanDevice(){
     for(auto descriptorPool : descriptorPools){
         vkDestroyDescriptorPool(device, descriptorPool, nullptr);
     }
+    delete descriptorAllocator;
+    delete pipelineCache;
+    delete stagingRing;
+    delete residencyManager;
+    delete memoryAllocator;
     instance->vkDestroyDevice(device, nullptr);
 }
 
-VkDescriptorPool * VulkanDevice::getDescriptorPool(const std::vector<VkDescriptorPoolSize>& descriptorSizes){
-    VkDescriptorPool * pool = new VkDescriptorPool();
+VkDescriptorPool VulkanDevice::getDescriptorPool(const std::vector<VkDescriptorPoolSize>& descriptorSizes, uint32_t maxSets, VkDescriptorPoolCreateFlags flags){
+    VkDescriptorPool pool;
 
     VkDescriptorPoolCreateInfo poolInfo;
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
     poolInfo.pNext = nullptr;
-    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-    poolInfo.maxSets = descriptorSizes.size();
+    poolInfo.flags = flags;
+    poolInfo.maxSets = maxSets;
     poolInfo.poolSizeCount = descriptorSizes.size();
     poolInfo.pPoolSizes = &descriptorSizes[0];
 
-    assert(vkCreateDescriptorPool(device, &poolInfo, nullptr, pool) == VK_SUCCESS);
-    descriptorPools.push_back(*pool);
+    assert(vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) == VK_SUCCESS);
+    descriptorPools.push_back(pool);
     return pool;
 }
 
@@ -543,28 +596,53 @@ VkPhysicalDevice VulkanDevice::getPhysicalDevice(){
     return instance->physicalDevices.at(deviceNumber);
 }
 
-uint32_t VulkanDevice::getUsableMemoryType(uint32_t memoryTypeBits, const VkMemoryPropertyFlags requiredProperties){
+static uint32_t countBits(uint32_t value){
+    uint32_t count = 0;
+    for (; value != 0; value &= value - 1){
+        count++;
+    }
+    return count;
+}
+
+uint32_t VulkanDevice::findMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags requiredProperties, VkMemoryPropertyFlags preferredProperties, VkMemoryPropertyFlags avoidedProperties, VkDeviceSize allocationSize){
     uint32_t type = (std::numeric_limits<uint32_t>::max)();
-    uint32_t memoryTypeIndex = 0;
-    while (type == (std::numeric_limits<uint32_t>::max)() && memoryTypeIndex < deviceMemoryProperties.memoryTypeCount){
-        if ((memoryTypeBits & 1 << memoryTypeIndex) != 0){
-            if ((requiredProperties & deviceMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags) == requiredProperties){
-                type = memoryTypeIndex;
-            }
+    int32_t bestScore = (std::numeric_limits<int32_t>::min)();
+    for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < deviceMemoryProperties.memoryTypeCount; memoryTypeIndex++){
+        VkMemoryPropertyFlags propertyFlags = deviceMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+        if ((memoryTypeBits & 1 << memoryTypeIndex) == 0 || (propertyFlags & requiredProperties) != requiredProperties){
+            continue;
+        }
+
+        // Skip heaps the allocation would push over budget
+        if (allocationSize > 0 && residencyManager != nullptr && !residencyManager->hasBudget(deviceMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex, allocationSize)){
+            continue;
+        }
+
+        // Preferred flags win, avoided flags lose more, and flags nobody asked for cost a little
+        int32_t score = 4 * (int32_t)countBits(propertyFlags & preferredProperties)
+                      - 8 * (int32_t)countBits(propertyFlags & avoidedProperties)
+                      - (int32_t)countBits(propertyFlags & ~(requiredProperties | preferredProperties | avoidedProperties));
+        if (score > bestScore){
+            bestScore   = score;
+            type        = memoryTypeIndex;
         }
-        memoryTypeIndex++;
     }
 
     return type;
 }
 
-uint32_t VulkanDevice::getUsableDeviceQueueFamily(const VkQueueFlags requiredProperties){
+uint32_t VulkanDevice::getUsableMemoryType(uint32_t memoryTypeBits, const VkMemoryPropertyFlags requiredProperties){
+    return findMemoryType(memoryTypeBits, requiredProperties);
+}
+
+uint32_t VulkanDevice::getUsableDeviceQueueFamily(const VkQueueFlags requiredProperties, const VkQueueFlags excludedProperties){
     uint32_t queueFamily = (std::numeric_limits<uint32_t>::max)();
     uint32_t queueFamilyIndex = 0;
     while(queueFamilyIndex < deviceQueueFamilyPropertyCount && queueFamily == (std::numeric_limits<uint32_t>::max)()){
         auto queueFamilyProperty = deviceQueueProperties[queueFamilyIndex];
 
-        if((requiredProperties & queueFamilyProperty.queueFlags) == requiredProperties){
+        if((requiredProperties & queueFamilyProperty.queueFlags) == requiredProperties &&
+           (excludedProperties & queueFamilyProperty.queueFlags) == 0){
             queueFamily = queueFamilyIndex;
         }
         queueFamilyIndex++;
@@ -573,56 +651,145 @@ uint32_t VulkanDevice::getUsableDeviceQueueFamily(const VkQueueFlags requiredPro
     return queueFamily;
 }
 
-// VkImage and VkBuffer collide on VC++
-//void VulkanDevice::allocateAndBindMemory(VkBuffer buffer, bool hostVisible){
-//    VkDeviceMemory          bufferMemory;
-//    VkMemoryAllocateInfo    allocateInfo;
-//    VkMemoryRequirements    memoryRequirements;
-//
-//    // Get Memory Requirements
-//    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
-//
-//    int32_t memoryType = getUsableMemoryType(memoryRequirements.memoryTypeBits, 
-//                                                            hostVisible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-//    assert (memoryType != -1);
-//    std::cout << "Memory type for buffer: " << std::dec << memoryType << std::endl;
-//
-//    // Allocate Memory
-//    allocateInfo.sType              = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-//    allocateInfo.pNext              = nullptr;
-//    allocateInfo.allocationSize     = memoryRequirements.size;
-//    allocateInfo.memoryTypeIndex    = memoryType;
-//    assert( vkAllocateMemory(device, &allocateInfo, nullptr, &bufferMemory) == VK_SUCCESS);
-//
-//    // Bind Memory for buffer
-//    assert( vkBindBufferMemory(device, buffer, bufferMemory, 0) == VK_SUCCESS);
-//}
-
-VkDeviceMemory VulkanDevice::allocateAndBindMemory(VkImage image, bool hostVisible){
-    VkDeviceMemory          imageMemory;
-    VkMemoryAllocateInfo    allocateInfo;
+VulkanMemoryAllocation VulkanDevice::allocateMemory(const VkMemoryRequirements& memoryRequirements, VkMemoryPropertyFlags requiredProperties, VkMemoryPropertyFlags preferredProperties, VkMemoryPropertyFlags avoidedProperties, VulkanAllocationType allocationType, bool ignoreBudget){
+    VulkanMemoryAllocation allocation;
+    allocation.memory   = VK_NULL_HANDLE;
+    allocation.block    = nullptr;
+
+    uint32_t memoryTypeBits = memoryRequirements.memoryTypeBits;
+    bool evicted = false;
+    while (memoryTypeBits != 0){
+        uint32_t memoryType = findMemoryType(memoryTypeBits, requiredProperties, preferredProperties, avoidedProperties, ignoreBudget ? 0 : memoryRequirements.size);
+        if (memoryType == (std::numeric_limits<uint32_t>::max)()){
+            // Every matching heap is over budget, so evict from the best one once and look again
+            uint32_t overBudgetType = findMemoryType(memoryTypeBits, requiredProperties, preferredProperties, avoidedProperties);
+            if (ignoreBudget || evicted || overBudgetType == (std::numeric_limits<uint32_t>::max)()){
+                break;
+            }
+            residencyManager->evict(deviceMemoryProperties.memoryTypes[overBudgetType].heapIndex, memoryRequirements.size);
+            evicted = true;
+            continue;
+        }
+
+        allocation = memoryAllocator->allocate(memoryRequirements, memoryType, allocationType);
+        if (allocation.block != nullptr){
+            break;
+        }
+
+        // The driver is out of this memory type even though the budget allowed it
+        std::cout << "Allocation from memory type " << std::dec << memoryType << " failed, trying another." << std::endl;
+        memoryTypeBits &= ~(1u << memoryType);
+    }
+
+    return allocation;
+}
+
+// Device-local memory that is over budget falls back to host-visible memory, which is slower
+// for the GPU to read but keeps large scenes running; budgets are only ignored as a last resort
+static VulkanMemoryAllocation allocateWithFallback(VulkanDevice& deviceContext, const VkMemoryRequirements& memoryRequirements, bool hostVisible, VulkanAllocationType allocationType){
+    VulkanMemoryAllocation allocation;
+    if (hostVisible){
+        allocation = deviceContext.allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, allocationType);
+    }else{
+        // Device-local resources keep out of the small host-visible (BAR) heap
+        allocation = deviceContext.allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, allocationType);
+        if (allocation.block == nullptr){
+            std::cout << "Device-local memory over budget, falling back to host-visible memory." << std::endl;
+            allocation = deviceContext.allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, allocationType);
+        }
+    }
+
+    if (allocation.block == nullptr){
+        std::cout << "Every heap is over budget, allocating anyway." << std::endl;
+        allocation = deviceContext.allocateMemory(memoryRequirements, hostVisible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : 0, hostVisible ? 0 : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, allocationType, true);
+    }
+    assert(allocation.block != nullptr);
+
+    return allocation;
+}
+
+// VkImage and VkBuffer collide on VC++, so buffers and images get separately named functions
+VulkanMemoryAllocation VulkanDevice::allocateAndBindBufferMemory(VkBuffer buffer, bool hostVisible){
+    VkMemoryRequirements    memoryRequirements;
+
+    // Get Memory Requirements
+    vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
+
+    std::cout << "Memory requirements for " << (hostVisible ? "Host " : "Device ") << "buffer: " << std::dec << memoryRequirements.size << std::endl;
+
+    // Sub-allocate Memory
+    VulkanMemoryAllocation bufferAllocation = allocateWithFallback(*this, memoryRequirements, hostVisible, VULKAN_ALLOCATION_TYPE_LINEAR);
+    std::cout << "Memory type for " << (hostVisible ? "Host " : "Device ") << "buffer: " << std::dec << bufferAllocation.memoryTypeIndex << std::endl;
+
+    // Bind Memory for buffer
+    assert( vkBindBufferMemory(device, buffer, bufferAllocation.memory, bufferAllocation.offset) == VK_SUCCESS);
+
+    return bufferAllocation;
+}
+
+VulkanMemoryAllocation VulkanDevice::allocateAndBindImageMemory(VkImage image, VkImageTiling tiling, bool hostVisible, bool lazilyAllocated){
     VkMemoryRequirements    memoryRequirements;
 
     // Get Memory Requirements
     vkGetImageMemoryRequirements(device, image, &memoryRequirements);
 
     std::cout << "Memory requirements for image: " << std::dec << memoryRequirements.size << std::endl;
-    uint32_t memoryType = getUsableMemoryType(memoryRequirements.memoryTypeBits, 
-                                                            hostVisible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    assert (memoryType != (std::numeric_limits<uint32_t>::max)());
-    std::cout << "Memory type for image: " << std::dec << memoryType << std::endl;
-
-    // Allocate Memory
-    allocateInfo.sType              = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.pNext              = nullptr;
-    allocateInfo.allocationSize     = memoryRequirements.size;
-    allocateInfo.memoryTypeIndex    = memoryType;
-    assert( vkAllocateMemory(device, &allocateInfo, nullptr, &imageMemory) == VK_SUCCESS);
+
+    // Sub-allocate Memory
+    VulkanAllocationType allocationType = (tiling == VK_IMAGE_TILING_LINEAR) ? VULKAN_ALLOCATION_TYPE_LINEAR : VULKAN_ALLOCATION_TYPE_OPTIMAL;
+    VulkanMemoryAllocation imageAllocation;
+    imageAllocation.block = nullptr;
+    if (lazilyAllocated && !hostVisible){
+        // Transient attachments only get physical pages for what the GPU actually touches, often none on tilers
+        imageAllocation = allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, allocationType);
+    }
+    if (imageAllocation.block == nullptr){
+        imageAllocation = allocateWithFallback(*this, memoryRequirements, hostVisible, allocationType);
+    }
+    std::cout << "Memory type for image: " << std::dec << imageAllocation.memoryTypeIndex << std::endl;
 
     // Bind Memory for image
-    assert( vkBindImageMemory(device, image, imageMemory, 0) == VK_SUCCESS);
+    assert( vkBindImageMemory(device, image, imageAllocation.memory, imageAllocation.offset) == VK_SUCCESS);
+
+    return imageAllocation;
+}
 
-    return imageMemory;
+void VulkanDevice::freeMemory(VulkanMemoryAllocation& allocation){
+    memoryAllocator->free(allocation);
+}
+
+static bool getNonCoherentRange(const VulkanDevice& deviceContext, const VulkanMemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange& range){
+    // Coherent memory needs no flush or invalidate
+    VkMemoryPropertyFlags propertyFlags = deviceContext.deviceMemoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags;
+    if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0 || size == 0){
+        return false;
+    }
+
+    // Widen to whole atoms of the memory object, the allocation itself may not start on one
+    VkDeviceSize atomSize   = (std::max)(deviceContext.deviceProperties.limits.nonCoherentAtomSize, (VkDeviceSize)1);
+    VkDeviceSize rangeStart = ((allocation.offset + offset) / atomSize) * atomSize;
+    VkDeviceSize rangeEnd   = ((allocation.offset + offset + size + atomSize - 1) / atomSize) * atomSize;
+
+    range.sType     = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.pNext     = nullptr;
+    range.memory    = allocation.memory;
+    range.offset    = rangeStart;
+    range.size      = (rangeEnd >= allocation.block->size) ? VK_WHOLE_SIZE : (rangeEnd - rangeStart);
+    return true;
+}
+
+void VulkanDevice::flushMappedRange(const VulkanMemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size){
+    VkMappedMemoryRange range;
+    if (getNonCoherentRange(*this, allocation, offset, size, range)){
+        assert(vkFlushMappedMemoryRanges(device, 1, &range) == VK_SUCCESS);
+    }
+}
+
+void VulkanDevice::invalidateMappedRange(const VulkanMemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size){
+    VkMappedMemoryRange range;
+    if (getNonCoherentRange(*this, allocation, offset, size, range)){
+        assert(vkInvalidateMappedMemoryRanges(device, 1, &range) == VK_SUCCESS);
+    }
 }
 
 VkFormat VulkanDevice::getSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features){
@@ -696,8 +863,9 @@ VkSampleCountFlagBits VulkanDevice::requestSupportedSampleFlags(uint32_t sampleC
     return sampleCountFlag;
 }
 
-VulkanDriverInstance::VulkanDriverInstance(std::string applicationName){
+VulkanDriverInstance::VulkanDriverInstance(std::string applicationName, bool headless){
     numPhysicalDevices                              = 0;
+    surfaceSupport                                  = false;
 
 #if defined (_WIN32) || defined (_WIN64)
     loader = LoadLibrary("vulkan-1.dll");
@@ -745,17 +913,14 @@ VulkanDriverInstance::VulkanDriverInstance(std::string applicationName){
     app.engineVersion = 0;
     app.apiVersion = VK_API_VERSION_1_0; // Use version supported by NVIDIA
 
-    // Extensions
-    std::vector<const char*> requestedExtensions    = { VK_KHR_SURFACE_EXTENSION_NAME };
-    std::vector<const char*> requiredExtensions     = { VK_KHR_SURFACE_EXTENSION_NAME };
-
-#if defined (_WIN32) || defined (_WIN64)
-    requestedExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
-    requiredExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
-#elif defined (__linux__)
-    requestedExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
-    requiredExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
-#endif
+    // Extensions, surface extensions are only required when rendering to a window
+    std::vector<const char*> surfaceExtensions      = { VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_PLATFORM_SURFACE_EXTENSION_NAME };
+    std::vector<const char*> requestedExtensions    = surfaceExtensions;
+    std::vector<const char*> requiredExtensions;
+    requestedExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME); // Needed to query memory budgets
+    if (!headless){
+        requiredExtensions = surfaceExtensions;
+    }
 
     std::vector<const char*> enabledExtensions;
     uint32_t requiredExtensionsFound = 0;
@@ -785,6 +950,18 @@ VulkanDriverInstance::VulkanDriverInstance(std::string applicationName){
     uint32_t enabledExtensionCount = enabledExtensions.size();
     // Ensure that all required extensions were found
     assert( requiredExtensionsFound == requiredExtensions.size() );
+    uint32_t surfaceExtensionsEnabled = std::count_if(enabledExtensions.begin(), enabledExtensions.end(), [&surfaceExtensions](const char* extension){
+        return std::find_if(surfaceExtensions.begin(), surfaceExtensions.end(), [extension](const char* surfaceExtension){
+            return strcmp(extension, surfaceExtension) == 0;
+        }) != surfaceExtensions.end();
+    });
+    surfaceSupport = (surfaceExtensionsEnabled == surfaceExtensions.size());
+    properties2Support = std::find_if(enabledExtensions.begin(), enabledExtensions.end(), [](const char* extension){
+        return strcmp(extension, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0;
+    }) != enabledExtensions.end();
+    if (!surfaceSupport){
+        std::cout << "Surface extensions unavailable, running headless." << std::endl;
+    }
 
     // Instance creation info
     VkInstanceCreateInfo instanceCreateInfo;
@@ -793,9 +970,9 @@ VulkanDriverInstance::VulkanDriverInstance(std::string applicationName){
     instanceCreateInfo.flags                    = 0;
     instanceCreateInfo.pApplicationInfo         = &app;
     instanceCreateInfo.enabledLayerCount        = enabledLayerCount;
-    instanceCreateInfo.ppEnabledLayerNames      = &enabledLayers[0];
+    instanceCreateInfo.ppEnabledLayerNames      = enabledLayerCount > 0 ? &enabledLayers[0] : nullptr;
     instanceCreateInfo.enabledExtensionCount    = enabledExtensionCount;
-    instanceCreateInfo.ppEnabledExtensionNames  = &enabledExtensions[0];
+    instanceCreateInfo.ppEnabledExtensionNames  = enabledExtensionCount > 0 ? &enabledExtensions[0] : nullptr;
 
     // Assert if instance creation failed
     assert (vkCreateInstance(&instanceCreateInfo, nullptr, &instance) == VK_SUCCESS);
@@ -817,13 +994,26 @@ VulkanDriverInstance::VulkanDriverInstance(std::string applicationName){
     VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceSparseImageFormatProperties);
 
     // Window System Integration
-    VK_INSTANCE_FUNCTION(vkCreateSurfaceKHR);
-    VK_INSTANCE_FUNCTION(vkDestroySurfaceKHR);
-    VK_INSTANCE_FUNCTION(vkGetPhysicalDevicePresentationSupportKHR);
-    VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
-    VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceFormatsKHR);
-    VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfacePresentModesKHR);
-    VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceSupportKHR);
+    vkCreateSurfaceKHR                          = nullptr;
+    vkDestroySurfaceKHR                         = nullptr;
+    vkGetPhysicalDevicePresentationSupportKHR   = nullptr;
+    vkGetPhysicalDeviceSurfaceCapabilitiesKHR   = nullptr;
+    vkGetPhysicalDeviceSurfaceFormatsKHR        = nullptr;
+    vkGetPhysicalDeviceSurfacePresentModesKHR   = nullptr;
+    vkGetPhysicalDeviceSurfaceSupportKHR        = nullptr;
+    vkGetPhysicalDeviceMemoryProperties2KHR     = nullptr;
+    if (properties2Support){
+        VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceMemoryProperties2KHR);
+    }
+    if (surfaceSupport){
+        VK_INSTANCE_FUNCTION(vkCreateSurfaceKHR);
+        VK_INSTANCE_FUNCTION(vkDestroySurfaceKHR);
+        VK_INSTANCE_FUNCTION(vkGetPhysicalDevicePresentationSupportKHR);
+        VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
+        VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceFormatsKHR);
+        VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfacePresentModesKHR);
+        VK_INSTANCE_FUNCTION(vkGetPhysicalDeviceSurfaceSupportKHR);
+    }
 
     enumeratePhysicalDevices();
 }
@@ -0,0 +1,22 @@
+#include "VulkanFormatTraits.h"
+
+// Storage for lookups that aren't constant expressions
+constexpr VulkanFormatInfo VulkanFormatTraits::formatInfos[];
+
+// Rows have to stay in VkFormat order for getInfo to index them
+static constexpr bool isTableOrdered(uint32_t index){
+    return index == VulkanFormatTraits::formatCount ||
+           ((uint32_t)VulkanFormatTraits::formatInfos[index].format == index && isTableOrdered(index + 1));
+}
+
+// Every SRGB pair points back at the format it came from
+static constexpr bool areSrgbPairsMatched(uint32_t index){
+    return index == VulkanFormatTraits::formatCount ||
+           ((VulkanFormatTraits::formatInfos[index].srgbPair == VK_FORMAT_UNDEFINED ||
+             VulkanFormatTraits::getInfo(VulkanFormatTraits::formatInfos[index].srgbPair).srgbPair == (VkFormat)index) && areSrgbPairsMatched(index + 1));
+}
+
+static_assert(isTableOrdered(0), "Format table is out of VkFormat order");
+static_assert(areSrgbPairsMatched(0), "Format table has an unmatched SRGB pair");
+static_assert(VulkanFormatTraits::getInfo(VK_FORMAT_R8G8B8A8_UNORM).blockSize == 4, "Unexpected R8G8B8A8 size");
+static_assert(VulkanFormatTraits::imageDataSize(VK_FORMAT_BC1_RGBA_UNORM_BLOCK, {5, 5, 1}) == 32, "Partial blocks should round up");
@@ -0,0 +1,201 @@
+#include <cassert>
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanFramePacer.h"
+#include "VulkanResidencyManager.h"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment){
+    return alignment > 1 ? ((value + alignment - 1) / alignment) * alignment : value;
+}
+
+VulkanFramePacer::VulkanFramePacer(VulkanDevice * __deviceContext, uint32_t __queueFamilyIndex, uint32_t __framesInFlight, VkDeviceSize __transientBufferSize){
+    deviceContext       = __deviceContext;
+    queueFamilyIndex    = __queueFamilyIndex;
+    framesInFlight      = __framesInFlight;
+    transientBufferSize = __transientBufferSize;
+    currentFrame        = __framesInFlight - 1;
+    frameNumber         = 0;
+    recording           = false;
+    assert(deviceContext != nullptr);
+    assert(framesInFlight > 0);
+
+    // Start signaled, so that the first trip through each slot doesn't wait
+    VkFenceCreateInfo fenceInfo;
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.pNext = nullptr;
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    VkSemaphoreCreateInfo semaphoreInfo;
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = nullptr;
+    semaphoreInfo.flags = 0;
+
+    // Transient Buffer; regions start on boundaries valid for any dynamic offset and for flushes
+    const VkPhysicalDeviceLimits& limits = deviceContext->deviceProperties.limits;
+    VkDeviceSize regionAlignment = (std::max)((std::max)(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment), limits.nonCoherentAtomSize);
+    transientRegionSize = alignUp(transientBufferSize, regionAlignment);
+
+    VkBufferCreateInfo bufferInfo;
+    bufferInfo.sType                    = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext                    = nullptr;
+    bufferInfo.flags                    = 0;
+    bufferInfo.size                     = transientRegionSize * framesInFlight;
+    bufferInfo.usage                    = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode              = VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount    = 0; // Not sharing
+    bufferInfo.pQueueFamilyIndices      = nullptr;
+
+    assert(deviceContext->vkCreateBuffer(deviceContext->device, &bufferInfo, nullptr, &transientBuffer) == VK_SUCCESS);
+    transientAllocation = deviceContext->allocateAndBindBufferMemory(transientBuffer, true);
+    assert(transientAllocation.mappedData != nullptr);
+
+    frames.resize(framesInFlight);
+    for (uint32_t frameIndex = 0; frameIndex < framesInFlight; frameIndex++){
+        VulkanFrame& frame  = frames[frameIndex];
+        frame.frameIndex    = frameIndex;
+        frame.frameNumber   = 0;
+
+        // One pool per frame, reset as a whole instead of per command buffer
+        frame.commandPool = deviceContext->getCommandPool(VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, queueFamilyIndex);
+        VkCommandBuffer * commandBuffers = frame.commandPool->getCommandBuffers(VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+        frame.commandBuffer = commandBuffers[0];
+        delete [] commandBuffers;
+
+        assert(deviceContext->vkCreateSemaphore(deviceContext->device, &semaphoreInfo, nullptr, &frame.imageAcquiredSemaphore) == VK_SUCCESS);
+        assert(deviceContext->vkCreateSemaphore(deviceContext->device, &semaphoreInfo, nullptr, &frame.renderingDoneSemaphore) == VK_SUCCESS);
+        assert(deviceContext->vkCreateFence(deviceContext->device, &fenceInfo, nullptr, &frame.fence) == VK_SUCCESS);
+
+        frame.transientBase     = frameIndex * transientRegionSize;
+        frame.transientOffset   = 0;
+    }
+}
+
+VulkanFramePacer::~VulkanFramePacer(){
+    waitIdle();
+
+    deviceContext->vkDestroyBuffer(deviceContext->device, transientBuffer, nullptr);
+    deviceContext->freeMemory(transientAllocation);
+
+    for (auto& frame : frames){
+        deviceContext->vkDestroyFence(deviceContext->device, frame.fence, nullptr);
+        deviceContext->vkDestroySemaphore(deviceContext->device, frame.renderingDoneSemaphore, nullptr);
+        deviceContext->vkDestroySemaphore(deviceContext->device, frame.imageAcquiredSemaphore, nullptr);
+        delete frame.commandPool;
+    }
+}
+
+VulkanFrame& VulkanFramePacer::beginFrame(){
+    assert(!recording);
+    currentFrame = (currentFrame + 1) % framesInFlight;
+    VulkanFrame& frame = frames[currentFrame];
+
+    // Only wait for the frame that last used this slot
+    assert(deviceContext->vkWaitForFences(deviceContext->device, 1, &frame.fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)()) == VK_SUCCESS);
+    assert(deviceContext->vkResetFences(deviceContext->device, 1, &frame.fence) == VK_SUCCESS);
+
+    // Everything the slot recorded or allocated last time is free again
+    frame.commandPool->resetCommandPool(0);
+    frame.transientOffset   = 0;
+    frame.frameNumber       = frameNumber++;
+
+    // Resources last used by the frame we just waited for can now be evicted, and its released descriptor sets reused
+    deviceContext->residencyManager->beginFrame(frame.frameNumber, framesInFlight);
+    deviceContext->descriptorAllocator->beginFrame(frame.frameNumber, framesInFlight);
+
+    VkCommandBufferBeginInfo cbBeginInfo;
+    cbBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cbBeginInfo.pNext = nullptr;
+    cbBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cbBeginInfo.pInheritanceInfo = nullptr; // Not a secondary command buffer
+    assert(deviceContext->vkBeginCommandBuffer(frame.commandBuffer, &cbBeginInfo) == VK_SUCCESS);
+
+    recording = true;
+    return frame;
+}
+
+VulkanFrame& VulkanFramePacer::getCurrentFrame(){
+    return frames[currentFrame];
+}
+
+VulkanTransientAllocation VulkanFramePacer::allocateTransient(VkDeviceSize dataSize, VkDeviceSize alignment){
+    assert(recording);
+    VulkanFrame& frame = frames[currentFrame];
+
+    VkDeviceSize offset = alignUp(frame.transientOffset, alignment);
+    if (offset + dataSize > transientBufferSize){
+        throw std::runtime_error("Per-frame transient buffer is full!");
+    }
+    frame.transientOffset = offset + dataSize;
+
+    VulkanTransientAllocation allocation;
+    allocation.buffer       = transientBuffer;
+    allocation.offset       = frame.transientBase + offset;
+    allocation.mappedData   = static_cast<char *>(transientAllocation.mappedData) + allocation.offset;
+
+    return allocation;
+}
+
+VulkanTransientAllocation VulkanFramePacer::allocateUniform(VkDeviceSize dataSize){
+    // Offset can be passed straight to vkCmdBindDescriptorSets as a dynamic offset
+    return allocateTransient(dataSize, deviceContext->deviceProperties.limits.minUniformBufferOffsetAlignment);
+}
+
+void VulkanFramePacer::addWaitSemaphore(VkSemaphore semaphore, VkPipelineStageFlags waitStageMask){
+    // Work queued on other queues this frame depends on, waited on by the frame submit
+    assert(recording);
+    waitSemaphores.push_back(semaphore);
+    waitStageMasks.push_back(waitStageMask);
+}
+
+void VulkanFramePacer::endFrame(VkQueue queue, VkPipelineStageFlags waitStageMask, bool presenting){
+    assert(recording);
+    VulkanFrame& frame = frames[currentFrame];
+
+    assert(deviceContext->vkEndCommandBuffer(frame.commandBuffer) == VK_SUCCESS);
+
+    // Flush transient data written this frame, only this frame's region
+    deviceContext->flushMappedRange(transientAllocation, frame.transientBase, frame.transientOffset);
+
+    // Dispatch, offscreen frames have no swapchain image to wait on or present
+    if (presenting){
+        waitSemaphores.push_back(frame.imageAcquiredSemaphore);
+        waitStageMasks.push_back(waitStageMask);
+    }
+    VkSubmitInfo frameSubmitInfo;
+    frameSubmitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    frameSubmitInfo.pNext                = nullptr;
+    frameSubmitInfo.waitSemaphoreCount   = waitSemaphores.size();
+    frameSubmitInfo.pWaitSemaphores      = waitSemaphores.empty() ? nullptr : &waitSemaphores[0];
+    frameSubmitInfo.pWaitDstStageMask    = waitStageMasks.empty() ? nullptr : &waitStageMasks[0];
+    frameSubmitInfo.commandBufferCount   = 1;
+    frameSubmitInfo.pCommandBuffers      = &frame.commandBuffer;
+    frameSubmitInfo.signalSemaphoreCount = presenting ? 1 : 0;
+    frameSubmitInfo.pSignalSemaphores    = presenting ? &frame.renderingDoneSemaphore : nullptr;
+    assert(deviceContext->vkQueueSubmit(queue, 1, &frameSubmitInfo, frame.fence) == VK_SUCCESS);
+    waitSemaphores.clear();
+    waitStageMasks.clear();
+
+    recording = false;
+}
+
+bool VulkanFramePacer::isFrameComplete(uint64_t number){
+    // A later frame reusing the slot already waited for this one
+    if (number + framesInFlight < frameNumber){
+        return true;
+    }
+
+    VulkanFrame& frame = frames[number % framesInFlight];
+    if (frame.frameNumber != number || (recording && number + 1 == frameNumber)){
+        return false;
+    }
+    return deviceContext->vkGetFenceStatus(deviceContext->device, frame.fence) == VK_SUCCESS;
+}
+
+void VulkanFramePacer::waitIdle(){
+    for (auto& frame : frames){
+        assert(deviceContext->vkWaitForFences(deviceContext->device, 1, &frame.fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)()) == VK_SUCCESS);
+    }
+}
@@ -0,0 +1,332 @@
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include "VulkanBuffer.h"
+#include "VulkanKtxTexture.h"
+
+static const uint8_t ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+static void expand565(uint16_t color, uint8_t * texel){
+    uint32_t red    = (color >> 11) & 0x1F;
+    uint32_t green  = (color >> 5) & 0x3F;
+    uint32_t blue   = color & 0x1F;
+    texel[0] = (uint8_t)((red << 3) | (red >> 2));
+    texel[1] = (uint8_t)((green << 2) | (green >> 4));
+    texel[2] = (uint8_t)((blue << 3) | (blue >> 2));
+    texel[3] = 255;
+}
+
+static void decodeColorBlock(const uint8_t * block, bool punchThrough, uint8_t texels[16][4]){
+    uint16_t color0     = (uint16_t)(block[0] | (block[1] << 8));
+    uint16_t color1     = (uint16_t)(block[2] | (block[3] << 8));
+    uint32_t indices    = (uint32_t)block[4] | ((uint32_t)block[5] << 8) | ((uint32_t)block[6] << 16) | ((uint32_t)block[7] << 24);
+
+    uint8_t palette[4][4];
+    expand565(color0, palette[0]);
+    expand565(color1, palette[1]);
+    for (uint32_t channel = 0; channel < 3; channel++){
+        // BC1 switches to three colours and transparent black when the endpoints are in ascending order
+        if (color0 > color1 || !punchThrough){
+            palette[2][channel] = (uint8_t)((2 * palette[0][channel] + palette[1][channel] + 1) / 3);
+            palette[3][channel] = (uint8_t)((palette[0][channel] + 2 * palette[1][channel] + 1) / 3);
+        }else{
+            palette[2][channel] = (uint8_t)((palette[0][channel] + palette[1][channel]) / 2);
+            palette[3][channel] = 0;
+        }
+    }
+    palette[2][3] = 255;
+    palette[3][3] = (color0 > color1 || !punchThrough) ? 255 : 0;
+
+    for (uint32_t texel = 0; texel < 16; texel++){
+        memcpy(texels[texel], palette[(indices >> (texel * 2)) & 0x3], 4);
+    }
+}
+
+static void decodeChannelBlock(const uint8_t * block, bool isSigned, uint8_t values[16]){
+    // BC3 alpha, BC4 and BC5 channels: two endpoints and eight 3-bit indices
+    int32_t value0 = isSigned ? (int32_t)(int8_t)block[0] : (int32_t)block[0];
+    int32_t value1 = isSigned ? (int32_t)(int8_t)block[1] : (int32_t)block[1];
+
+    int32_t palette[8];
+    palette[0] = value0;
+    palette[1] = value1;
+    if (value0 > value1){
+        for (int32_t step = 1; step < 7; step++){
+            palette[step + 1] = ((7 - step) * value0 + step * value1) / 7;
+        }
+    }else{
+        for (int32_t step = 1; step < 5; step++){
+            palette[step + 1] = ((5 - step) * value0 + step * value1) / 5;
+        }
+        palette[6] = isSigned ? -127 : 0;
+        palette[7] = isSigned ? 127 : 255;
+    }
+
+    uint64_t indices = 0;
+    for (uint32_t byte = 0; byte < 6; byte++){
+        indices |= (uint64_t)block[2 + byte] << (byte * 8);
+    }
+    for (uint32_t texel = 0; texel < 16; texel++){
+        values[texel] = (uint8_t)palette[(indices >> (texel * 3)) & 0x7];
+    }
+}
+
+VulkanKtxTexture::VulkanKtxTexture(VulkanDevice * __deviceContext, const std::string& __fileName, VkImageUsageFlags __usage){
+    deviceContext   = __deviceContext;
+    fileName        = __fileName;
+    image           = nullptr;
+    uploadToken     = 0;
+    assert(deviceContext != nullptr);
+
+    std::vector<char> fileData = load();
+    if (fileData.size() < sizeof(VulkanKtx2Header)){
+        throw std::runtime_error("Unable to read KTX2 texture " + fileName + "!");
+    }
+    memcpy(&header, fileData.data(), sizeof(VulkanKtx2Header));
+    if (memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0){
+        throw std::runtime_error(fileName + " is not a KTX2 file!");
+    }
+    if (header.supercompressionScheme != 0 || header.vkFormat == VK_FORMAT_UNDEFINED){
+        throw std::runtime_error(fileName + " is supercompressed, which is not supported!");
+    }
+    fileFormat = (VkFormat)header.vkFormat;
+
+    // Level index follows the header, largest level first
+    uint32_t levelCount = (std::max)(header.levelCount, 1u);
+    if (fileData.size() < sizeof(VulkanKtx2Header) + levelCount * sizeof(VulkanKtx2Level)){
+        throw std::runtime_error(fileName + " has a truncated level index!");
+    }
+    std::vector<VulkanKtx2Level> levels(levelCount);
+    memcpy(&levels[0], &fileData[sizeof(VulkanKtx2Header)], levelCount * sizeof(VulkanKtx2Level));
+
+    // Upload as stored when the device can sample it, otherwise decode on the host
+    format = fileFormat;
+    if (!isFormatEnabled(deviceContext, fileFormat)){
+        if (!canTranscode(fileFormat)){
+            throw std::runtime_error("Format " + std::to_string(fileFormat) + " of " + fileName + " is not supported on this device!");
+        }
+        format = getTranscodeFormat(fileFormat);
+    }
+
+    // Layers and faces become array layers, face-major within each layer as in the file
+    uint32_t faceCount      = (std::max)(header.faceCount, 1u);
+    uint32_t arrayLayers    = (std::max)(header.layerCount, 1u) * faceCount;
+    VkExtent3D extent       = {header.pixelWidth, (std::max)(header.pixelHeight, 1u), (std::max)(header.pixelDepth, 1u)};
+    VkImageType imageType   = header.pixelDepth > 0 ? VK_IMAGE_TYPE_3D : (header.pixelHeight > 0 ? VK_IMAGE_TYPE_2D : VK_IMAGE_TYPE_1D);
+    if (faceCount == 6){
+        viewType = header.layerCount > 0 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+    }else if (imageType == VK_IMAGE_TYPE_3D){
+        viewType = VK_IMAGE_VIEW_TYPE_3D;
+    }else if (imageType == VK_IMAGE_TYPE_1D){
+        viewType = header.layerCount > 0 ? VK_IMAGE_VIEW_TYPE_1D_ARRAY : VK_IMAGE_VIEW_TYPE_1D;
+    }else{
+        viewType = header.layerCount > 0 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+    }
+
+    // A level count of 0 asks for the chain to be generated, which block formats can't be
+    bool generateMips       = header.levelCount == 0 && VulkanImage::blockExtent(format).width == 1;
+    uint32_t mipLevels      = generateMips ? VulkanImage::mipLevelCount(extent) : levelCount;
+    VkImageUsageFlags usage = __usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | (generateMips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+
+    // One region per level covers all of its layers and faces
+    VkDeviceSize dataStart = fileData.size();
+    for (const auto& level : levels){
+        dataStart = (std::min)(dataStart, (VkDeviceSize)level.byteOffset);
+    }
+    std::vector<uint8_t> transcodedData;
+    std::vector<VkBufferImageCopy> levelCopies;
+    for (uint32_t levelIndex = 0; levelIndex < levelCount; levelIndex++){
+        const VulkanKtx2Level& level = levels[levelIndex];
+        VkExtent3D levelExtent  = {(std::max)(extent.width >> levelIndex, 1u), (std::max)(extent.height >> levelIndex, 1u), (std::max)(extent.depth >> levelIndex, 1u)};
+        uint32_t sliceCount     = arrayLayers * levelExtent.depth;
+        VkDeviceSize sliceSize  = VulkanImage::imageDataSize(fileFormat, {levelExtent.width, levelExtent.height, 1});
+        if (level.byteLength < sliceSize * sliceCount || level.byteOffset + level.byteLength > fileData.size()){
+            throw std::runtime_error(fileName + " has a truncated mip level!");
+        }
+
+        VkBufferImageCopy levelCopy;
+        levelCopy.bufferOffset          = level.byteOffset - dataStart;
+        levelCopy.bufferRowLength       = 0;
+        levelCopy.bufferImageHeight     = 0;
+        levelCopy.imageSubresource      = {VulkanImage::formatAspect(format), levelIndex, 0, arrayLayers};
+        levelCopy.imageOffset           = {0, 0, 0};
+        levelCopy.imageExtent           = levelExtent;
+
+        if (format != fileFormat){
+            // Decoded levels are packed one after the other, each slice as RGBA8
+            VkDeviceSize texelSliceSize = (VkDeviceSize)levelExtent.width * levelExtent.height * 4;
+            levelCopy.bufferOffset      = transcodedData.size();
+            transcodedData.resize(transcodedData.size() + texelSliceSize * sliceCount);
+            for (uint32_t slice = 0; slice < sliceCount; slice++){
+                transcode(fileFormat, reinterpret_cast<const uint8_t *>(&fileData[level.byteOffset + slice * sliceSize]), levelExtent.width, levelExtent.height,
+                          &transcodedData[levelCopy.bufferOffset + slice * texelSliceSize]);
+            }
+        }
+        levelCopies.push_back(levelCopy);
+    }
+
+    // The image is only created once every level checked out, so a bad file leaves nothing behind
+    image = new VulkanImage(deviceContext, usage, imageType, format, extent, faceCount == 6 ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0,
+                            VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, mipLevels, arrayLayers);
+    image->createImageView(viewType, VulkanImage::formatAspect(format));
+
+    // Everything goes out in one staged copy
+    const void * uploadData = format != fileFormat ? static_cast<const void *>(&transcodedData[0]) : static_cast<const void *>(&fileData[dataStart]);
+    VkDeviceSize uploadSize = format != fileFormat ? transcodedData.size() : fileData.size() - dataStart;
+    if (generateMips){
+        uploadToken = image->loadImageDataWithMips(static_cast<const char *>(uploadData) + levelCopies[0].bufferOffset, (uint32_t)(uploadSize - levelCopies[0].bufferOffset), 0, arrayLayers);
+    }else{
+        uploadToken = image->loadImageMipChain(uploadData, (uint32_t)uploadSize, levelCopies);
+    }
+
+    std::cout << "Loaded texture " << fileName << ": " << std::dec << extent.width << "x" << extent.height << ", " << mipLevels << " levels, format " << format;
+    std::cout << (format != fileFormat ? " (transcoded)" : "") << std::endl;
+}
+
+VulkanKtxTexture::~VulkanKtxTexture(){
+    delete image;
+}
+
+bool VulkanKtxTexture::canTranscode(VkFormat format){
+    return getTranscodeFormat(format) != VK_FORMAT_UNDEFINED;
+}
+
+VkFormat VulkanKtxTexture::getTranscodeFormat(VkFormat format){
+    switch (format){
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+            return VK_FORMAT_R8G8B8A8_SRGB;
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+            return VK_FORMAT_R8G8B8A8_SNORM;
+        default:
+            return VK_FORMAT_UNDEFINED;
+    }
+}
+
+bool VulkanKtxTexture::isFormatEnabled(VulkanDevice * deviceContext, VkFormat format){
+    // Block families also need their device feature, which format properties don't reflect
+    const VkPhysicalDeviceFeatures& enabledFeatures = deviceContext->enabledFeatures;
+    if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK && !enabledFeatures.textureCompressionBC){
+        return false;
+    }
+    if (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK && !enabledFeatures.textureCompressionETC2){
+        return false;
+    }
+    if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK && !enabledFeatures.textureCompressionASTC_LDR){
+        return false;
+    }
+
+    return deviceContext->getSupportedFormat({format}, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == format;
+}
+
+bool VulkanKtxTexture::readHeader(const std::string& fileName, VulkanKtx2Header& header, std::vector<VulkanKtx2Level>& levels){
+    // Header and level index only, for loaders that read levels one at a time
+    std::ifstream textureFile(fileName, std::ios::binary);
+    if (!textureFile.read(reinterpret_cast<char *>(&header), sizeof(VulkanKtx2Header)) || memcmp(header.identifier, ktx2Identifier, sizeof(ktx2Identifier)) != 0){
+        return false;
+    }
+
+    levels.resize((std::max)(header.levelCount, 1u));
+    return (bool)textureFile.read(reinterpret_cast<char *>(&levels[0]), levels.size() * sizeof(VulkanKtx2Level));
+}
+
+void VulkanKtxTexture::transcode(VkFormat format, const uint8_t * blocks, uint32_t width, uint32_t height, uint8_t * texels){
+    assert(canTranscode(format));
+    uint32_t blockSize  = VulkanImage::bytesPerBlock(format);
+    uint32_t blocksWide = (width + 3) / 4;
+    uint32_t blocksHigh = (height + 3) / 4;
+    bool isSigned       = format == VK_FORMAT_BC4_SNORM_BLOCK || format == VK_FORMAT_BC5_SNORM_BLOCK;
+
+    for (uint32_t blockY = 0; blockY < blocksHigh; blockY++){
+        for (uint32_t blockX = 0; blockX < blocksWide; blockX++){
+            const uint8_t * block = blocks + ((VkDeviceSize)blockY * blocksWide + blockX) * blockSize;
+
+            uint8_t blockTexels[16][4];
+            uint8_t channel[16];
+            switch (format){
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                    decodeColorBlock(block, true, blockTexels);
+                    for (uint32_t texel = 0; texel < 16; texel++){
+                        blockTexels[texel][3] = 255;
+                    }
+                    break;
+                case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                    decodeColorBlock(block, true, blockTexels);
+                    break;
+                case VK_FORMAT_BC2_UNORM_BLOCK:
+                case VK_FORMAT_BC2_SRGB_BLOCK:
+                    // Explicit 4-bit alpha, then a colour block that never uses punch-through
+                    decodeColorBlock(block + 8, false, blockTexels);
+                    for (uint32_t texel = 0; texel < 16; texel++){
+                        blockTexels[texel][3] = (uint8_t)(((block[texel / 2] >> ((texel % 2) * 4)) & 0xF) * 17);
+                    }
+                    break;
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                case VK_FORMAT_BC3_SRGB_BLOCK:
+                    decodeColorBlock(block + 8, false, blockTexels);
+                    decodeChannelBlock(block, false, channel);
+                    for (uint32_t texel = 0; texel < 16; texel++){
+                        blockTexels[texel][3] = channel[texel];
+                    }
+                    break;
+                default:
+                    // BC4 and BC5: one or two independent channels, the rest as if sampling an R or RG format
+                    decodeChannelBlock(block, isSigned, channel);
+                    for (uint32_t texel = 0; texel < 16; texel++){
+                        blockTexels[texel][0] = channel[texel];
+                        blockTexels[texel][1] = 0;
+                        blockTexels[texel][2] = 0;
+                        blockTexels[texel][3] = isSigned ? 127 : 255;
+                    }
+                    if (blockSize == 16){
+                        decodeChannelBlock(block + 8, isSigned, channel);
+                        for (uint32_t texel = 0; texel < 16; texel++){
+                            blockTexels[texel][1] = channel[texel];
+                        }
+                    }
+                    break;
+            }
+
+            // Partial blocks at the right and bottom edges
+            for (uint32_t texel = 0; texel < 16; texel++){
+                uint32_t x = blockX * 4 + texel % 4;
+                uint32_t y = blockY * 4 + texel / 4;
+                if (x < width && y < height){
+                    memcpy(texels + ((VkDeviceSize)y * width + x) * 4, blockTexels[texel], 4);
+                }
+            }
+        }
+    }
+}
+
+std::vector<char> VulkanKtxTexture::load(){
+    std::vector<char> fileData;
+    std::ifstream textureFile(fileName, std::ios::binary | std::ios::ate);
+    if(!textureFile.is_open()){
+        return fileData;
+    }
+
+    std::streamsize fileSize = textureFile.tellg();
+    if(fileSize <= 0){
+        return fileData;
+    }
+
+    fileData.resize((size_t)fileSize);
+    textureFile.seekg(0, std::ios::beg);
+    if(!textureFile.read(fileData.data(), fileSize)){
+        fileData.clear();
+    }
+    return fileData;
+}
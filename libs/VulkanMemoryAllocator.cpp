@@ -0,0 +1,329 @@
+#include <cassert>
+#include "VulkanMemoryAllocator.h"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment){
+    return alignment > 1 ? ((value + alignment - 1) / alignment) * alignment : value;
+}
+
+///////////////////////////////////////
+// VulkanMemoryBlock
+///////////////////////////////////////
+
+VulkanMemoryBlock::VulkanMemoryBlock(VulkanDevice * __deviceContext, uint32_t __memoryTypeIndex, VkDeviceSize __size, VulkanAllocationType __allocationType, bool __dedicated){
+    deviceContext   = __deviceContext;
+    memoryTypeIndex = __memoryTypeIndex;
+    size            = __size;
+    allocationType  = __allocationType;
+    dedicated       = __dedicated;
+    mappedData      = nullptr;
+    usedBytes       = 0;
+    allocationCount = 0;
+
+    // Allocate Memory
+    VkMemoryAllocateInfo allocateInfo;
+    allocateInfo.sType              = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.pNext              = nullptr;
+    allocateInfo.allocationSize     = size;
+    allocateInfo.memoryTypeIndex    = memoryTypeIndex;
+    if (deviceContext->vkAllocateMemory(deviceContext->device, &allocateInfo, nullptr, &memory) != VK_SUCCESS){
+        // The heap is exhausted, the allocator discards the block and reports the failure
+        memory = VK_NULL_HANDLE;
+        return;
+    }
+
+    // Host-visible blocks stay mapped for their whole lifetime, since a memory object can only be mapped once
+    if ((deviceContext->deviceMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0){
+        assert( deviceContext->vkMapMemory(deviceContext->device, memory, 0, VK_WHOLE_SIZE, 0, &mappedData) == VK_SUCCESS);
+    }
+
+    // Whole block starts out free
+    insertFreeRange(0, size);
+}
+
+VulkanMemoryBlock::~VulkanMemoryBlock(){
+    if (allocationCount != 0){
+        std::cout << "Freeing memory block with " << std::dec << allocationCount << " live allocations!" << std::endl;
+    }
+
+    if (mappedData != nullptr){
+        deviceContext->vkUnmapMemory(deviceContext->device, memory);
+    }
+    if (memory != VK_NULL_HANDLE){
+        deviceContext->vkFreeMemory(deviceContext->device, memory, nullptr);
+    }
+}
+
+void VulkanMemoryBlock::insertFreeRange(VkDeviceSize rangeOffset, VkDeviceSize rangeSize){
+    freeRangesByOffset[rangeOffset] = rangeSize;
+    freeRangesBySize.insert(std::make_pair(rangeSize, rangeOffset));
+}
+
+void VulkanMemoryBlock::removeFreeRange(VkDeviceSize rangeOffset, VkDeviceSize rangeSize){
+    freeRangesByOffset.erase(rangeOffset);
+
+    auto range = freeRangesBySize.equal_range(rangeSize);
+    for (auto it = range.first; it != range.second; it++){
+        if (it->second == rangeOffset){
+            freeRangesBySize.erase(it);
+            break;
+        }
+    }
+}
+
+bool VulkanMemoryBlock::allocate(VkDeviceSize allocationSize, VkDeviceSize alignment, VkDeviceSize& allocationOffset){
+    // Best fit: walk free ranges from the smallest that could possibly hold the request
+    for (auto it = freeRangesBySize.lower_bound(allocationSize); it != freeRangesBySize.end(); it++){
+        VkDeviceSize rangeSize      = it->first;
+        VkDeviceSize rangeOffset    = it->second;
+        VkDeviceSize alignedOffset  = alignUp(rangeOffset, alignment);
+        VkDeviceSize padding        = alignedOffset - rangeOffset;
+
+        if (padding + allocationSize > rangeSize){
+            continue;
+        }
+
+        // Split range into leading padding, allocation and trailing remainder
+        removeFreeRange(rangeOffset, rangeSize);
+        if (padding > 0){
+            insertFreeRange(rangeOffset, padding);
+        }
+        VkDeviceSize remainder = rangeSize - padding - allocationSize;
+        if (remainder > 0){
+            insertFreeRange(alignedOffset + allocationSize, remainder);
+        }
+
+        allocationOffset = alignedOffset;
+        usedBytes += allocationSize;
+        allocationCount++;
+        return true;
+    }
+
+    return false;
+}
+
+void VulkanMemoryBlock::free(VkDeviceSize allocationOffset, VkDeviceSize allocationSize){
+    assert(allocationCount > 0);
+    VkDeviceSize rangeOffset    = allocationOffset;
+    VkDeviceSize rangeSize      = allocationSize;
+
+    // Coalesce with following range
+    auto next = freeRangesByOffset.find(rangeOffset + rangeSize);
+    if (next != freeRangesByOffset.end()){
+        VkDeviceSize nextSize = next->second;
+        removeFreeRange(rangeOffset + rangeSize, nextSize);
+        rangeSize += nextSize;
+    }
+
+    // Coalesce with preceding range
+    auto prev = freeRangesByOffset.lower_bound(rangeOffset);
+    if (prev != freeRangesByOffset.begin()){
+        prev--;
+        if (prev->first + prev->second == rangeOffset){
+            VkDeviceSize prevOffset = prev->first;
+            VkDeviceSize prevSize   = prev->second;
+            removeFreeRange(prevOffset, prevSize);
+            rangeOffset = prevOffset;
+            rangeSize  += prevSize;
+        }
+    }
+
+    insertFreeRange(rangeOffset, rangeSize);
+    usedBytes -= allocationSize;
+    allocationCount--;
+}
+
+VkDeviceSize VulkanMemoryBlock::largestFreeRange() const{
+    return freeRangesBySize.empty() ? 0 : freeRangesBySize.rbegin()->first;
+}
+
+///////////////////////////////////////
+// VulkanMemoryAllocator
+///////////////////////////////////////
+
+VulkanMemoryAllocator::VulkanMemoryAllocator(VulkanDevice * __deviceContext, VkDeviceSize __preferredBlockSize){
+    deviceContext       = __deviceContext;
+    preferredBlockSize  = __preferredBlockSize;
+    assert(deviceContext != nullptr);
+}
+
+VulkanMemoryAllocator::~VulkanMemoryAllocator(){
+    for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < VK_MAX_MEMORY_TYPES; memoryTypeIndex++){
+        for (uint32_t allocationType = 0; allocationType < VULKAN_ALLOCATION_TYPE_COUNT; allocationType++){
+            for (auto block : blocks[memoryTypeIndex][allocationType]){
+                delete block;
+            }
+            blocks[memoryTypeIndex][allocationType].clear();
+        }
+    }
+}
+
+VkDeviceSize VulkanMemoryAllocator::getBlockSize(uint32_t memoryTypeIndex){
+    // Small heaps get proportionally smaller blocks
+    uint32_t heapIndex  = deviceContext->deviceMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    VkDeviceSize heapSize = deviceContext->deviceMemoryProperties.memoryHeaps[heapIndex].size;
+
+    return (std::min)(preferredBlockSize, heapSize / 8);
+}
+
+VulkanMemoryAllocation VulkanMemoryAllocator::allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, VulkanAllocationType allocationType){
+    assert(memoryTypeIndex < deviceContext->deviceMemoryProperties.memoryTypeCount);
+    assert((requirements.memoryTypeBits & (1 << memoryTypeIndex)) != 0);
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    VkDeviceSize allocationSize = requirements.size;
+    VkDeviceSize alignment      = requirements.alignment;
+
+    // Keep non-coherent allocations on atom boundaries so that flushes never touch a neighbour
+    VkMemoryPropertyFlags propertyFlags = deviceContext->deviceMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+    if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 && (propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0){
+        VkDeviceSize atomSize   = deviceContext->deviceProperties.limits.nonCoherentAtomSize;
+        alignment               = (std::max)(alignment, atomSize);
+        allocationSize          = alignUp(allocationSize, atomSize);
+    }
+
+    // Without separate block sets, linear and optimal resources would need bufferImageGranularity padding
+    std::vector<VulkanMemoryBlock *>& blockList = blocks[memoryTypeIndex][allocationType];
+
+    VulkanMemoryBlock * block   = nullptr;
+    VkDeviceSize offset         = 0;
+    VkDeviceSize blockSize      = getBlockSize(memoryTypeIndex);
+
+    VulkanMemoryAllocation allocation;
+    allocation.memory           = VK_NULL_HANDLE;
+    allocation.offset           = 0;
+    allocation.size             = 0;
+    allocation.memoryTypeIndex  = memoryTypeIndex;
+    allocation.mappedData       = nullptr;
+    allocation.block            = nullptr;
+
+    if (allocationSize > blockSize / 2){
+        // Large resources get a dedicated block
+        block = new VulkanMemoryBlock(deviceContext, memoryTypeIndex, allocationSize, allocationType, true);
+    }else{
+        for (auto candidate : blockList){
+            if (!candidate->dedicated && candidate->allocate(allocationSize, alignment, offset)){
+                block = candidate;
+                break;
+            }
+        }
+
+        // Out of space in every block, so grab a new one
+        if (block == nullptr){
+            block = new VulkanMemoryBlock(deviceContext, memoryTypeIndex, blockSize, allocationType, false);
+        }
+    }
+
+    // New blocks can fail when the heap is exhausted; callers fall back to another memory type
+    if (block->allocationCount == 0){
+        if (block->memory == VK_NULL_HANDLE){
+            delete block;
+            return allocation;
+        }
+        bool allocated = block->allocate(allocationSize, alignment, offset);
+        assert(allocated);
+        blockList.push_back(block);
+    }
+
+    allocation.memory           = block->memory;
+    allocation.offset           = offset;
+    allocation.size             = allocationSize;
+    allocation.memoryTypeIndex  = memoryTypeIndex;
+    allocation.mappedData       = block->mappedData != nullptr ? static_cast<char *>(block->mappedData) + offset : nullptr;
+    allocation.block            = block;
+
+    return allocation;
+}
+
+void VulkanMemoryAllocator::free(VulkanMemoryAllocation& allocation){
+    if (allocation.block == nullptr){
+        return;
+    }
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    VulkanMemoryBlock * block = allocation.block;
+    block->free(allocation.offset, allocation.size);
+
+    // Release empty blocks, but keep one shared block around per memory type to avoid churn
+    if (block->allocationCount == 0){
+        std::vector<VulkanMemoryBlock *>& blockList = blocks[block->memoryTypeIndex][block->allocationType];
+        uint32_t sharedBlockCount = 0;
+        for (auto candidate : blockList){
+            sharedBlockCount += candidate->dedicated ? 0 : 1;
+        }
+
+        if (block->dedicated || sharedBlockCount > 1){
+            blockList.erase(std::find(blockList.begin(), blockList.end(), block));
+            delete block;
+        }
+    }
+
+    allocation.memory       = VK_NULL_HANDLE;
+    allocation.mappedData   = nullptr;
+    allocation.block        = nullptr;
+}
+
+VulkanMemoryHeapStats VulkanMemoryAllocator::getHeapStats(uint32_t heapIndex){
+    assert(heapIndex < deviceContext->deviceMemoryProperties.memoryHeapCount);
+    std::lock_guard<std::mutex> lock(allocatorMutex);
+
+    VulkanMemoryHeapStats stats;
+    stats.blockCount        = 0;
+    stats.allocationCount   = 0;
+    stats.blockBytes        = 0;
+    stats.usedBytes         = 0;
+    stats.largestFreeRange  = 0;
+
+    for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < deviceContext->deviceMemoryProperties.memoryTypeCount; memoryTypeIndex++){
+        if (deviceContext->deviceMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex != heapIndex){
+            continue;
+        }
+
+        for (uint32_t allocationType = 0; allocationType < VULKAN_ALLOCATION_TYPE_COUNT; allocationType++){
+            for (auto block : blocks[memoryTypeIndex][allocationType]){
+                stats.blockCount++;
+                stats.allocationCount  += block->allocationCount;
+                stats.blockBytes       += block->size;
+                stats.usedBytes        += block->usedBytes;
+                stats.largestFreeRange  = (std::max)(stats.largestFreeRange, block->largestFreeRange());
+            }
+        }
+    }
+
+    return stats;
+}
+
+void VulkanMemoryAllocator::printStats(){
+    std::cout << "Memory Allocator Statistics: " << std::endl;
+    for (uint32_t heapIndex = 0; heapIndex < deviceContext->deviceMemoryProperties.memoryHeapCount; heapIndex++){
+        VulkanMemoryHeapStats stats = getHeapStats(heapIndex);
+        std::cout << "   Memory Heap " << std::dec << heapIndex << ": " << std::endl;
+        std::cout << "      Blocks: " << stats.blockCount << " (" << stats.blockBytes << " bytes)" << std::endl;
+        std::cout << "      Allocations: " << stats.allocationCount << " (" << stats.usedBytes << " bytes)" << std::endl;
+        std::cout << "      Largest Free Range: " << stats.largestFreeRange << std::endl;
+
+        // Lazily allocated blocks only consume what the driver actually committed
+        VkDeviceSize lazyBytes      = 0;
+        VkDeviceSize committedBytes = 0;
+        {
+            std::lock_guard<std::mutex> lock(allocatorMutex);
+            for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < deviceContext->deviceMemoryProperties.memoryTypeCount; memoryTypeIndex++){
+                const VkMemoryType& memoryType = deviceContext->deviceMemoryProperties.memoryTypes[memoryTypeIndex];
+                if (memoryType.heapIndex != heapIndex || (memoryType.propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) == 0){
+                    continue;
+                }
+
+                for (uint32_t allocationType = 0; allocationType < VULKAN_ALLOCATION_TYPE_COUNT; allocationType++){
+                    for (auto block : blocks[memoryTypeIndex][allocationType]){
+                        VkDeviceSize blockCommitment = 0;
+                        deviceContext->vkGetDeviceMemoryCommitment(deviceContext->device, block->memory, &blockCommitment);
+                        lazyBytes       += block->size;
+                        committedBytes  += blockCommitment;
+                    }
+                }
+            }
+        }
+        if (lazyBytes > 0){
+            std::cout << "      Lazily Allocated: " << committedBytes << " of " << lazyBytes << " bytes committed" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,297 @@
+#include "VulkanOffscreenTarget.h"
+
+VulkanOffscreenTarget::VulkanOffscreenTarget(VulkanDevice * __deviceContext, VkExtent2D __extent, uint32_t __imageCount, VkFormat __format, VkSampleCountFlagBits __sampleCount){
+    deviceContext       = __deviceContext;
+    extent              = __extent;
+    imageCount          = __imageCount;
+    sampleCount         = __sampleCount;
+    assert(deviceContext != nullptr);
+    assert(imageCount > 0);
+    assert(extent.width > 0 && extent.height > 0);
+
+    pipelineState       = nullptr;
+    renderPass          = nullptr;
+    depthImage          = nullptr;
+    multisampleImage    = nullptr;
+    dirtyFramebuffers   = true;
+    imageIndex          = 0;
+
+    // Any graphics queue can render offscreen, no presentation support needed
+    queueFamilyIndex = deviceContext->getUsableDeviceQueueFamily(VK_QUEUE_GRAPHICS_BIT);
+    assert(queueFamilyIndex != (std::numeric_limits<uint32_t>::max)());
+
+    // Fall back to formats every implementation can render to
+    std::vector<VkFormat> colorCandidates = {__format, VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM};
+    colorFormat = deviceContext->getSupportedFormat(colorCandidates, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT);
+    assert(colorFormat != VK_FORMAT_UNDEFINED);
+    if (colorFormat != __format){
+        std::cout << "Offscreen format " << __format << " unsupported, using " << colorFormat << std::endl;
+    }
+
+    std::vector<VkFormat> depthCandidates = {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT};
+    depthFormat = deviceContext->getSupportedFormat(depthCandidates, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    assert(depthFormat != VK_FORMAT_UNDEFINED);
+
+    // Initialize
+    initializeTarget();
+}
+
+VulkanOffscreenTarget::~VulkanOffscreenTarget(){
+    cleanupTarget();
+    if (renderPass != nullptr){
+        delete renderPass;
+    }
+}
+
+void VulkanOffscreenTarget::acquireNextImage(const VulkanFrame& frame){
+    // Images are handed out in order; the frame fence already guarantees the GPU is done with the oldest one
+    imageIndex = (uint32_t)(frame.frameNumber % imageCount);
+
+    // The caller renders into it with our render pass, which leaves it as a colour attachment
+    colorImages[imageIndex]->setSubresourceState(colorImages[imageIndex]->getSubresourceRange(), VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                                                 VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+}
+
+void VulkanOffscreenTarget::cleanupTarget(){
+    // Destroy framebuffers
+    for (auto framebuffer : framebuffers){
+        if (framebuffer != VK_NULL_HANDLE){
+            deviceContext->vkDestroyFramebuffer(deviceContext->device, framebuffer, nullptr);
+        }
+    }
+    framebuffers.clear();
+
+    // Destroy images
+    for (auto colorImage : colorImages){
+        if (colorImage != nullptr){
+            delete colorImage;
+        }
+    }
+    colorImages.clear();
+
+    if (depthImage != nullptr){
+        delete depthImage;
+        depthImage = nullptr;
+    }
+
+    if (multisampleImage != nullptr){
+        delete multisampleImage;
+        multisampleImage = nullptr;
+    }
+}
+
+void VulkanOffscreenTarget::createRenderpass(){
+    assert(pipelineState != nullptr);
+
+    // Same attachment layout as VulkanSwapchain::createRenderpass, so pipelines work with either
+    VkAttachmentDescription defaultAttachment;
+    defaultAttachment.flags = VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT;
+    defaultAttachment.format = colorFormat;
+    defaultAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    defaultAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    defaultAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    defaultAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    defaultAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    defaultAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    defaultAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    // Depth attachment
+    VkAttachmentDescription depthAttachment;
+    depthAttachment.flags = VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT;
+    depthAttachment.format = depthFormat;
+    depthAttachment.samples = sampleCount;
+    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    std::vector<VkAttachmentDescription> attachments = {defaultAttachment, depthAttachment};
+
+    if(sampleCount != VK_SAMPLE_COUNT_1_BIT){
+        // Multisample color attachment
+        VkAttachmentDescription multisampleAttachment;
+        multisampleAttachment.flags = VK_ATTACHMENT_DESCRIPTION_MAY_ALIAS_BIT;
+        multisampleAttachment.format = colorFormat;
+        multisampleAttachment.samples = sampleCount;
+        multisampleAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        multisampleAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        multisampleAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        multisampleAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        multisampleAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        multisampleAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        attachments.push_back(multisampleAttachment);
+    }
+
+    std::vector<VkAttachmentReference> attachmentReferences = {{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
+                                                               {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL}};
+    if(sampleCount != VK_SAMPLE_COUNT_1_BIT){
+        attachmentReferences.push_back({2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL});
+    }
+
+    VkSubpassDescription subpassDescription;
+    subpassDescription.flags                    = 0;
+    subpassDescription.pipelineBindPoint        = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpassDescription.inputAttachmentCount     = 0;
+    subpassDescription.pInputAttachments        = nullptr;
+    subpassDescription.colorAttachmentCount     = 1;
+    subpassDescription.pColorAttachments        = &attachmentReferences[0];
+    subpassDescription.pResolveAttachments      = nullptr;
+    subpassDescription.pDepthStencilAttachment  = &attachmentReferences[1];
+    if(sampleCount != VK_SAMPLE_COUNT_1_BIT){
+        // Render into the multisampled attachment and resolve into the colour attachment
+        subpassDescription.pColorAttachments        = &attachmentReferences[2];
+        subpassDescription.pResolveAttachments      = &attachmentReferences[0];
+    }
+    subpassDescription.preserveAttachmentCount  = 0;
+    subpassDescription.pPreserveAttachments     = nullptr;
+
+    std::vector<VkSubpassDescription> subpasses     = {subpassDescription};
+
+    // Depth and multisample attachments are shared by every frame, so a frame's attachment writes wait for the last frame's
+    VkSubpassDependency attachmentDependency;
+    attachmentDependency.srcSubpass         = VK_SUBPASS_EXTERNAL;
+    attachmentDependency.dstSubpass         = 0;
+    attachmentDependency.srcStageMask       = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    attachmentDependency.dstStageMask       = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    attachmentDependency.srcAccessMask      = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    attachmentDependency.dstAccessMask      = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    attachmentDependency.dependencyFlags    = 0;
+    std::vector<VkSubpassDependency> dependencies   = {attachmentDependency};
+
+    if (renderPass != nullptr){
+        delete renderPass;
+    }
+    renderPass = new VulkanRenderPass(deviceContext, attachments, subpasses, dependencies);
+
+    // Blend states
+    attachmentBlendState.blendEnable            = VK_FALSE;
+    attachmentBlendState.srcColorBlendFactor    = VK_BLEND_FACTOR_ONE;
+    attachmentBlendState.dstColorBlendFactor    = VK_BLEND_FACTOR_ZERO;
+    attachmentBlendState.colorBlendOp           = VK_BLEND_OP_ADD;
+    attachmentBlendState.srcAlphaBlendFactor    = VK_BLEND_FACTOR_ONE;
+    attachmentBlendState.dstAlphaBlendFactor    = VK_BLEND_FACTOR_ZERO;
+    attachmentBlendState.alphaBlendOp           = VK_BLEND_OP_ADD;
+    attachmentBlendState.colorWriteMask         = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    blendState.sType                = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blendState.pNext                = nullptr;
+    blendState.flags                = 0; //MBZ
+    blendState.logicOpEnable        = VK_FALSE;
+    blendState.logicOp              = VK_LOGIC_OP_NO_OP;
+    blendState.attachmentCount      = subpasses[0].colorAttachmentCount;
+    blendState.pAttachments         = &attachmentBlendState;
+    blendState.blendConstants[0]    = 1.0;
+    blendState.blendConstants[1]    = 1.0;
+    blendState.blendConstants[2]    = 1.0;
+    blendState.blendConstants[3]    = 1.0;
+    pipelineState->pipelineInfo.pColorBlendState = &blendState;
+
+    pipelineState->pipelineInfo.renderPass = renderPass->renderPass;
+
+    pipelineState->setMultisampleState(sampleCount);
+}
+
+VkFramebuffer VulkanOffscreenTarget::getCurrentFramebuffer(){
+    if ( framebuffers.size() == 0){
+        return VK_NULL_HANDLE;
+    }else{
+        return framebuffers[imageIndex];
+    }
+}
+
+VkImage VulkanOffscreenTarget::getCurrentImage(){
+    if ( colorImages.size() == 0){
+        return VK_NULL_HANDLE;
+    }else{
+        return colorImages[imageIndex]->imageHandle;
+    }
+}
+
+void VulkanOffscreenTarget::initializeTarget(){
+    colorImages     = std::vector<VulkanImage*>(imageCount);
+
+    for(uint32_t index = 0; index < imageCount; index++){
+        // Colour images stand in for swapchain images and can be copied out
+        colorImages[index] = new VulkanImage(deviceContext,
+                                             VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                             VK_IMAGE_TYPE_2D,
+                                             colorFormat,
+                                             {extent.width, extent.height, 1});
+        colorImages[index]->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, 0);
+        std::cout << "Offscreen Image #" << index << ": " << colorImages[index]->imageHandle << std::endl;
+    }
+
+    // Transient attachments are never stored, so one of each serves every colour image
+    depthImage = new VulkanImage(deviceContext,
+                                 VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                                 VK_IMAGE_TYPE_2D,
+                                 depthFormat,
+                                 {extent.width, extent.height, 1},
+                                 0,
+                                 sampleCount);
+    depthImage->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0);
+
+    if(sampleCount != VK_SAMPLE_COUNT_1_BIT){
+        multisampleImage = new VulkanImage(deviceContext,
+                                           VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                                           VK_IMAGE_TYPE_2D,
+                                           colorFormat,
+                                           {extent.width, extent.height, 1},
+                                           0,
+                                           sampleCount);
+        multisampleImage->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, 0);
+    }
+
+    std::cout << "Offscreen Target Creation Complete!" << std::endl;
+}
+
+void VulkanOffscreenTarget::saveImage(const std::string& imageFileName){
+    // Caller must make sure the frame that rendered the current image has finished
+    colorImages[imageIndex]->saveImage(imageFileName);
+}
+
+void VulkanOffscreenTarget::setImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout){
+    if ( colorImages.size() != 0){
+        colorImages[imageIndex]->setImageLayout(commandBuffer, oldLayout, newLayout);
+    }
+}
+
+void VulkanOffscreenTarget::setPipelineState(VulkanPipelineState *vps){
+    pipelineState = vps;
+}
+
+void VulkanOffscreenTarget::setupFramebuffers(VkCommandBuffer cmdBuffer){
+    assert(renderPass != nullptr);
+    framebuffers = std::vector<VkFramebuffer>(imageCount);
+
+    for(uint32_t index = 0; index < imageCount; index++){
+        // Set layout before the image is first rendered to
+        colorImages[index]->setImageLayout(cmdBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+        // Framebuffer creation
+        std::vector<VkImageView> attachments;
+        attachments.push_back(colorImages[index]->imageViewHandle);
+        attachments.push_back(depthImage->imageViewHandle);
+        if(sampleCount != VK_SAMPLE_COUNT_1_BIT){
+            attachments.push_back(multisampleImage->imageViewHandle);
+        }
+
+        VkFramebufferCreateInfo framebufferCreateInfo;
+        framebufferCreateInfo.sType             = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferCreateInfo.pNext             = nullptr;
+        framebufferCreateInfo.flags             = 0;
+        framebufferCreateInfo.renderPass        = renderPass->renderPass;
+        framebufferCreateInfo.attachmentCount   = attachments.size();
+        framebufferCreateInfo.pAttachments      = &attachments[0];
+        framebufferCreateInfo.width             = extent.width;
+        framebufferCreateInfo.height            = extent.height;
+        framebufferCreateInfo.layers            = 1;
+
+        assert(deviceContext->vkCreateFramebuffer(deviceContext->device, &framebufferCreateInfo, nullptr, &(framebuffers[index])) == VK_SUCCESS);
+    }
+
+    dirtyFramebuffers = false;
+}
@@ -0,0 +1,121 @@
+#include <cstdio>
+#include "VulkanPipelineCache.h"
+
+VulkanPipelineCache::VulkanPipelineCache(VulkanDevice * __deviceContext, std::string __fileName){
+    deviceContext   = __deviceContext;
+    fileName        = __fileName;
+    cache           = VK_NULL_HANDLE;
+    assert(deviceContext != nullptr);
+
+    // Seed the cache from disk when the previous run left compatible data behind
+    std::vector<char> cacheData = load();
+    if(!cacheData.empty() && !isCompatible(cacheData)){
+        std::cout << "Pipeline cache " << fileName << " does not match this device, starting empty." << std::endl;
+        cacheData.clear();
+    }
+
+    VkPipelineCacheCreateInfo cacheInfo;
+    cacheInfo.sType             = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.pNext             = nullptr;
+    cacheInfo.flags             = 0;
+    cacheInfo.initialDataSize   = cacheData.size();
+    cacheInfo.pInitialData      = cacheData.empty() ? nullptr : cacheData.data();
+
+    VkResult result = deviceContext->vkCreatePipelineCache(deviceContext->device, &cacheInfo, nullptr, &cache);
+    if(result != VK_SUCCESS && !cacheData.empty()){
+        // The driver may still reject data that passed header validation
+        std::cout << "Pipeline cache " << fileName << " rejected by the driver, starting empty." << std::endl;
+        cacheInfo.initialDataSize   = 0;
+        cacheInfo.pInitialData      = nullptr;
+        result = deviceContext->vkCreatePipelineCache(deviceContext->device, &cacheInfo, nullptr, &cache);
+    }
+    assert(result == VK_SUCCESS);
+
+    if(!cacheData.empty()){
+        std::cout << "Loaded " << std::dec << cacheData.size() << " bytes of pipeline cache from " << fileName << std::endl;
+    }
+}
+
+VulkanPipelineCache::~VulkanPipelineCache(){
+    save();
+    deviceContext->vkDestroyPipelineCache(deviceContext->device, cache, nullptr);
+}
+
+bool VulkanPipelineCache::isCompatible(const std::vector<char>& cacheData){
+    if(cacheData.size() < sizeof(VulkanPipelineCacheHeader)){
+        return false;
+    }
+
+    VulkanPipelineCacheHeader header;
+    memcpy(&header, cacheData.data(), sizeof(VulkanPipelineCacheHeader));
+
+    // Reject data written by another device, vendor or driver build
+    const VkPhysicalDeviceProperties& properties = deviceContext->deviceProperties;
+    return header.headerSize >= sizeof(VulkanPipelineCacheHeader) &&
+           header.headerSize <= cacheData.size() &&
+           header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID &&
+           header.deviceID == properties.deviceID &&
+           memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void VulkanPipelineCache::merge(const std::vector<VkPipelineCache>& sourceCaches){
+    if(!sourceCaches.empty()){
+        assert(deviceContext->vkMergePipelineCaches(deviceContext->device, cache, (uint32_t)sourceCaches.size(), sourceCaches.data()) == VK_SUCCESS);
+    }
+}
+
+bool VulkanPipelineCache::save(){
+    size_t dataSize = 0;
+    assert(deviceContext->vkGetPipelineCacheData(deviceContext->device, cache, &dataSize, nullptr) == VK_SUCCESS);
+    if(dataSize == 0){
+        return false;
+    }
+
+    std::vector<char> cacheData(dataSize);
+    assert(deviceContext->vkGetPipelineCacheData(deviceContext->device, cache, &dataSize, cacheData.data()) == VK_SUCCESS);
+
+    // Write to a temporary file first so a crash mid-write never leaves a truncated cache
+    std::string tempFileName = fileName + ".tmp";
+    std::ofstream cacheFile(tempFileName, std::ios::binary | std::ios::trunc);
+    if(!cacheFile.is_open()){
+        std::cout << "Unable to write pipeline cache " << tempFileName << std::endl;
+        return false;
+    }
+    cacheFile.write(cacheData.data(), dataSize);
+    cacheFile.close();
+    if(cacheFile.fail()){
+        std::cout << "Unable to write pipeline cache " << tempFileName << std::endl;
+        std::remove(tempFileName.c_str());
+        return false;
+    }
+
+    std::remove(fileName.c_str());
+    if(std::rename(tempFileName.c_str(), fileName.c_str()) != 0){
+        std::cout << "Unable to replace pipeline cache " << fileName << std::endl;
+        return false;
+    }
+
+    std::cout << "Saved " << std::dec << dataSize << " bytes of pipeline cache to " << fileName << std::endl;
+    return true;
+}
+
+std::vector<char> VulkanPipelineCache::load(){
+    std::vector<char> cacheData;
+    std::ifstream cacheFile(fileName, std::ios::binary | std::ios::ate);
+    if(!cacheFile.is_open()){
+        return cacheData;
+    }
+
+    std::streamsize fileSize = cacheFile.tellg();
+    if(fileSize <= 0){
+        return cacheData;
+    }
+
+    cacheData.resize((size_t)fileSize);
+    cacheFile.seekg(0, std::ios::beg);
+    if(!cacheFile.read(cacheData.data(), fileSize)){
+        cacheData.clear();
+    }
+    return cacheData;
+}
@@ -1,4 +1,6 @@
 #include "VulkanPipelineState.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanPipelineCache.h"
 
 VulkanPipelineState::VulkanPipelineState(VulkanDevice                          * __deviceContext) {
     deviceContext   = __deviceContext;
@@ -20,6 +22,9 @@ VulkanPipelineState::VulkanPipelineState(VulkanDevice                          *
     pipelineInfo.pVertexInputState      = nullptr;
     pipelineInfo.pViewportState         = nullptr;
 
+    viewport = {};
+    scissor  = {};
+
     unusedStageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     pipelineInfo.basePipelineIndex  = -1;
@@ -46,13 +51,13 @@ VulkanPipelineState::~VulkanPipelineState() {
     }
 
     if (pipelineInfo.pViewportState != nullptr) {
-        if (pipelineInfo.pViewportState->pViewports != nullptr) {
-            delete pipelineInfo.pViewportState->pViewports;
-        }
-
         delete pipelineInfo.pViewportState;
     }
 
+    if (pipelineInfo.pDynamicState != nullptr) {
+        delete pipelineInfo.pDynamicState;
+    }
+
     if (pipelineInfo.pDepthStencilState != nullptr){
         delete pipelineInfo.pDepthStencilState;
     }
@@ -63,14 +68,12 @@ VulkanPipelineState::~VulkanPipelineState() {
     }
     descriptorSetLayoutBindings.clear();
 
-    for(auto layoutPair : descriptorSetLayouts){
-        deviceContext->vkDestroyDescriptorSetLayout(deviceContext->device, layoutPair.second, nullptr);
-    }
+    // Layouts are shared through the allocator's cache, only the sets go back
     descriptorSetLayouts.clear();
 
     for(auto mapPair : descriptorSets){
-        // mapPair is a pair of <VkDescriptorPool, std::vector<VkDescriptorSet>>
-        assert(deviceContext->vkFreeDescriptorSets(deviceContext->device, mapPair.first, mapPair.second.size(), &mapPair.second.at(0)) == VK_SUCCESS);
+        // mapPair is a pair of <VkDescriptorSetLayout, std::vector<VkDescriptorSet>>
+        deviceContext->descriptorAllocator->releaseSets(mapPair.first, mapPair.second.size(), &mapPair.second.at(0));
         mapPair.second.clear();
     }
     descriptorSets.clear();
@@ -154,7 +157,8 @@ void VulkanPipelineState::addShaderStage(std::string shaderFileName, VkShaderSta
     }
 }
 
-std::vector<VkDescriptorSet>& VulkanPipelineState::generateDescriptorSets(VkDescriptorPool descriptorPool){
+std::vector<VkDescriptorSet> VulkanPipelineState::generateDescriptorSets(){
+    std::vector<VkDescriptorSetLayout> setLayouts;
 
     // Check Descriptor Set Layouts
     for(auto pair : descriptorSetLayoutBindings){
@@ -162,55 +166,29 @@ std::vector<VkDescriptorSet>& VulkanPipelineState::generateDescriptorSets(VkDesc
         std::map<uint32_t, VkDescriptorSetLayoutBinding> duplicateMap;
         for(VkDescriptorSetLayoutBinding layoutBinding : mapEntry){
             // Check if duplicate
-            std::cout << "Descriptor Set Binding: ( Set " << pair.first << ", Binding " << layoutBinding.binding << " )" << std::endl;
-            std::cout << "   Descriptor Type:"                  << descriptorTypeToString(layoutBinding.descriptorType)     << std::endl;
-            std::cout << "   Descriptor Count:"                 << layoutBinding.descriptorCount    << std::endl;
-            std::cout << "   Descriptor Stage Flags:"           << layoutBinding.stageFlags         << std::endl;
-            // std::cout << "   Descriptor Immutable Samplers:"    << (layoutBinding.pImmutableSamplers == nullptr ? "None" : ()layoutBinding.pImmutableSamplers) << std::endl; TODO
-            std::map<uint32_t, VkDescriptorSetLayoutBinding>::iterator existingKeyIterator;
-            existingKeyIterator = duplicateMap.find(layoutBinding.binding);
-            if(existingKeyIterator != duplicateMap.end()){
-                duplicateMap.emplace(layoutBinding.binding, layoutBinding);
-            }else{
-                std::runtime_error("Duplicate layout binding found!");
+            if(!duplicateMap.emplace(layoutBinding.binding, layoutBinding).second){
+                throw std::runtime_error("Duplicate layout binding found!");
             }
         }
 
         if(mapEntry.size() > 0){
-            VkDescriptorSetLayoutCreateInfo setLayoutInfo;
-            setLayoutInfo.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            setLayoutInfo.pNext         = nullptr;
-            setLayoutInfo.flags         = 0;
-            setLayoutInfo.bindingCount  = mapEntry.size();
-            setLayoutInfo.pBindings     = &mapEntry[0];
-
-            VkDescriptorSetLayout setLayout;
-            assert(deviceContext->vkCreateDescriptorSetLayout(deviceContext->device, &setLayoutInfo, nullptr, &setLayout) == VK_SUCCESS);
-            descriptorSetLayouts.emplace(pair.first, setLayout);
-
-            // Allocate Descriptor Set
-            VkDescriptorSetAllocateInfo descriptorSetInfo;
-            descriptorSetInfo.sType                 = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            descriptorSetInfo.pNext                 = nullptr;
-            descriptorSetInfo.descriptorPool        = descriptorPool;
-            descriptorSetInfo.descriptorSetCount    = 1;
-            descriptorSetInfo.pSetLayouts           = &setLayout;
-
-            VkDescriptorSet descriptorSet;
-            VkResult result = deviceContext->vkAllocateDescriptorSets(deviceContext->device, &descriptorSetInfo, &descriptorSet);
-            assert(result == VK_SUCCESS);
-            // Add map entry if it doesn't exist
-            try{
-                std::vector<VkDescriptorSet>& entry = descriptorSets.at(descriptorPool);
-            }catch(std::out_of_range oor){
-                descriptorSets.emplace(descriptorPool, std::vector<VkDescriptorSet>());
+            // Layouts are created once and shared with every pipeline using the same bindings
+            if(descriptorSetLayouts.find(pair.first) == descriptorSetLayouts.end()){
+                descriptorSetLayouts.emplace(pair.first, deviceContext->descriptorAllocator->getSetLayout(mapEntry));
             }
-            std::cout << "Adding Descriptor Set" << std::endl;
-            descriptorSets.at(descriptorPool).push_back(descriptorSet);
+            setLayouts.push_back(descriptorSetLayouts.at(pair.first));
         }
     }
 
-    return descriptorSets.at(descriptorPool);
+    std::vector<VkDescriptorSet> generatedSets(setLayouts.size());
+    if(!setLayouts.empty()){
+        deviceContext->descriptorAllocator->allocateSets(setLayouts, &generatedSets[0]);
+    }
+    for(uint32_t setIndex = 0; setIndex < setLayouts.size(); setIndex++){
+        descriptorSets[setLayouts[setIndex]].push_back(generatedSets[setIndex]);
+    }
+
+    return generatedSets;
 }
 
 void VulkanPipelineState::setMultisampleState(VkSampleCountFlagBits sampleCount, double minSampleShading, const VkSampleMask* sampleMask, VkBool32 alphaToCoverageEnable, VkBool32 alphaToOneEnable){
@@ -298,44 +276,120 @@ void VulkanPipelineState::setViewportState(VkExtent2D &viewportExtent,
     assert(viewportExtent.height > 0 && viewportExtent.height != (std::numeric_limits<uint32_t>::max)());
 
     // Viewport
-    VkViewport * viewport = new VkViewport();
-    viewport->x         = viewportOffset.first;
-    viewport->y         = viewportOffset.second;
-    viewport->width     = (float)viewportExtent.width;
-    viewport->height    = (float)viewportExtent.height;
-    viewport->minDepth  = depthRange.first;
-    viewport->maxDepth  = depthRange.second;
-
-    // Scissor Rectangle
-    int32_t swapchainWidth      = (int32_t)viewportExtent.width;
-    int32_t swapchainHeight     = (int32_t)viewportExtent.width;
-    scissorRect.offset.x        = (std::max)(scissorRect.offset.x, (std::min)(scissorRect.offset.x, swapchainWidth));
-    scissorRect.offset.y        = (std::max)(scissorRect.offset.y, (std::min)(scissorRect.offset.y, swapchainHeight));
+    viewport.x          = viewportOffset.first;
+    viewport.y          = viewportOffset.second;
+    viewport.width      = (float)viewportExtent.width;
+    viewport.height     = (float)viewportExtent.height;
+    viewport.minDepth   = depthRange.first;
+    viewport.maxDepth   = depthRange.second;
+
+    // Scissor Rectangle, clamped to the viewport extent
+    int32_t viewportWidth       = (int32_t)viewportExtent.width;
+    int32_t viewportHeight      = (int32_t)viewportExtent.height;
+    scissorRect.offset.x        = (std::max)(0, (std::min)(scissorRect.offset.x, viewportWidth));
+    scissorRect.offset.y        = (std::max)(0, (std::min)(scissorRect.offset.y, viewportHeight));
     uint32_t extentBoundsX      = viewportExtent.width - scissorRect.offset.x;
     uint32_t extentBoundsY      = viewportExtent.height - scissorRect.offset.y;
-    scissorRect.extent.width    = (std::max)(extentBoundsX, (std::min)(scissorRect.extent.width, viewportExtent.width));
-    scissorRect.extent.height   = (std::max)(extentBoundsY, (std::min)(scissorRect.extent.height, viewportExtent.height));
-    
-    // Viewport State Info
-    VkPipelineViewportStateCreateInfo * viewportInfo = new VkPipelineViewportStateCreateInfo();
-    viewportInfo->sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportInfo->pNext         = nullptr;
-    viewportInfo->viewportCount = viewport == nullptr ? 0 : 1;
-    viewportInfo->pViewports    = viewport;
-    viewportInfo->scissorCount  = 1;
-    viewportInfo->pScissors     = &scissorRect;
-
-    if (pipelineInfo.pViewportState != nullptr) {
-        if (pipelineInfo.pViewportState->pViewports != nullptr) {
-            delete pipelineInfo.pViewportState->pViewports;
-        }
+    scissorRect.extent.width    = (std::min)(scissorRect.extent.width, extentBoundsX);
+    scissorRect.extent.height   = (std::min)(scissorRect.extent.height, extentBoundsY);
+    scissor                     = scissorRect;
+
+    // Viewport State Info, the viewport and scissor are read from this object at pipeline creation
+    if (pipelineInfo.pViewportState == nullptr) {
+        VkPipelineViewportStateCreateInfo * viewportInfo = new VkPipelineViewportStateCreateInfo();
+        viewportInfo->sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportInfo->pNext         = nullptr;
+        viewportInfo->viewportCount = 1;
+        viewportInfo->pViewports    = &viewport;
+        viewportInfo->scissorCount  = 1;
+        viewportInfo->pScissors     = &scissor;
+        pipelineInfo.pViewportState = viewportInfo;
+    }
 
-        delete pipelineInfo.pViewportState;
+    // Dynamic viewport and scissor are set at record time, so the pipeline stays valid
+    if (isDynamicState(VK_DYNAMIC_STATE_VIEWPORT) && isDynamicState(VK_DYNAMIC_STATE_SCISSOR)) {
+        return;
     }
 
-    pipelineInfo.pViewportState = viewportInfo;
+    // Recreate pipeline
+    updatePipeline();
+}
+
+void VulkanPipelineState::setDynamicState(const std::vector<VkDynamicState>& states) {
+    dynamicStates = states;
+
+    // Dynamic State Info
+    VkPipelineDynamicStateCreateInfo * dynamicStateInfo = new VkPipelineDynamicStateCreateInfo();
+    dynamicStateInfo->sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicStateInfo->pNext             = nullptr;
+    dynamicStateInfo->flags             = 0;
+    dynamicStateInfo->dynamicStateCount = dynamicStates.size();
+    dynamicStateInfo->pDynamicStates    = dynamicStates.size() > 0 ? &dynamicStates[0] : nullptr;
+
+    if (pipelineInfo.pDynamicState != nullptr) {
+        delete pipelineInfo.pDynamicState;
+    }
+    pipelineInfo.pDynamicState = dynamicStateInfo;
 
     // Recreate pipeline
+    updatePipeline();
+}
+
+bool VulkanPipelineState::isDynamicState(VkDynamicState state) {
+    return std::find(dynamicStates.begin(), dynamicStates.end(), state) != dynamicStates.end();
+}
+
+void VulkanPipelineState::recordDynamicState(VkCommandBuffer cmdBuffer) {
+    // Dynamic values come from the same state the pipeline would otherwise have baked in
+    for (auto state : dynamicStates) {
+        switch (state) {
+            case VK_DYNAMIC_STATE_VIEWPORT:
+                deviceContext->vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+                break;
+            case VK_DYNAMIC_STATE_SCISSOR:
+                deviceContext->vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+                break;
+            case VK_DYNAMIC_STATE_LINE_WIDTH:
+                assert(pipelineInfo.pRasterizationState != nullptr);
+                deviceContext->vkCmdSetLineWidth(cmdBuffer, pipelineInfo.pRasterizationState->lineWidth);
+                break;
+            case VK_DYNAMIC_STATE_DEPTH_BIAS:
+                assert(pipelineInfo.pRasterizationState != nullptr);
+                deviceContext->vkCmdSetDepthBias(cmdBuffer,
+                                                 pipelineInfo.pRasterizationState->depthBiasConstantFactor,
+                                                 pipelineInfo.pRasterizationState->depthBiasClamp,
+                                                 pipelineInfo.pRasterizationState->depthBiasSlopeFactor);
+                break;
+            case VK_DYNAMIC_STATE_BLEND_CONSTANTS:
+                assert(pipelineInfo.pColorBlendState != nullptr);
+                deviceContext->vkCmdSetBlendConstants(cmdBuffer, pipelineInfo.pColorBlendState->blendConstants);
+                break;
+            case VK_DYNAMIC_STATE_DEPTH_BOUNDS:
+                assert(pipelineInfo.pDepthStencilState != nullptr);
+                deviceContext->vkCmdSetDepthBounds(cmdBuffer, pipelineInfo.pDepthStencilState->minDepthBounds, pipelineInfo.pDepthStencilState->maxDepthBounds);
+                break;
+            case VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK:
+                assert(pipelineInfo.pDepthStencilState != nullptr);
+                deviceContext->vkCmdSetStencilCompareMask(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT, pipelineInfo.pDepthStencilState->front.compareMask);
+                deviceContext->vkCmdSetStencilCompareMask(cmdBuffer, VK_STENCIL_FACE_BACK_BIT, pipelineInfo.pDepthStencilState->back.compareMask);
+                break;
+            case VK_DYNAMIC_STATE_STENCIL_WRITE_MASK:
+                assert(pipelineInfo.pDepthStencilState != nullptr);
+                deviceContext->vkCmdSetStencilWriteMask(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT, pipelineInfo.pDepthStencilState->front.writeMask);
+                deviceContext->vkCmdSetStencilWriteMask(cmdBuffer, VK_STENCIL_FACE_BACK_BIT, pipelineInfo.pDepthStencilState->back.writeMask);
+                break;
+            case VK_DYNAMIC_STATE_STENCIL_REFERENCE:
+                assert(pipelineInfo.pDepthStencilState != nullptr);
+                deviceContext->vkCmdSetStencilReference(cmdBuffer, VK_STENCIL_FACE_FRONT_BIT, pipelineInfo.pDepthStencilState->front.reference);
+                deviceContext->vkCmdSetStencilReference(cmdBuffer, VK_STENCIL_FACE_BACK_BIT, pipelineInfo.pDepthStencilState->back.reference);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void VulkanPipelineState::updatePipeline() {
     if(isComplete){
         std::cout << "Recreating pipeline!" << std::endl;
         assert(deviceContext->vkDeviceWaitIdle(deviceContext->device) == VK_SUCCESS);
@@ -347,7 +401,6 @@ void VulkanPipelineState::setViewportState(VkExtent2D &viewportExtent,
 
 void VulkanPipelineState::complete() {
     if (!isComplete){
-        // TODO: Option to use pipeline caching
         // TODO: Check for minimum viable pipeline
         pipelineInfo.pStages = shaderStages.data();
         assert(pipelineInfo.pStages != nullptr); // Vertex shader required
@@ -375,7 +428,7 @@ void VulkanPipelineState::complete() {
         }
         pipelineInfo.pDepthStencilState = depthStencilStateInfo;
 
-        VkResult result = deviceContext->vkCreateGraphicsPipelines(deviceContext->device, VK_NULL_HANDLE, 1, &pipelineInfo, VK_NULL_HANDLE, &pipeline);
+        VkResult result = deviceContext->vkCreateGraphicsPipelines(deviceContext->device, deviceContext->pipelineCache->cache, 1, &pipelineInfo, VK_NULL_HANDLE, &pipeline);
         switch(result){
             case VK_ERROR_OUT_OF_HOST_MEMORY:
                 std::cout << "VulkanPipelineState - Out of host memory!" << std::endl;
@@ -0,0 +1,618 @@
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "VulkanFormatTraits.h"
+#include "VulkanPixelConverter.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    #define VULKAN_PIXEL_CONVERTER_X86
+    #include <immintrin.h>
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+// GCC and Clang only emit SSE4.1 and AVX2 instructions in functions that ask for them,
+// so the rest of the library keeps building for the baseline CPU
+#if defined(__GNUC__)
+    #define VULKAN_TARGET_SSE41 __attribute__((target("sse4.1")))
+    #define VULKAN_TARGET_AVX2  __attribute__((target("avx2,f16c")))
+#else
+    #define VULKAN_TARGET_SSE41
+    #define VULKAN_TARGET_AVX2
+#endif
+
+enum VulkanPixelClass{
+    VULKAN_PIXEL_CLASS_NONE     = 0, // Not convertible
+    VULKAN_PIXEL_CLASS_BYTE4    = 1, // Four 8-bit UNORM or SRGB channels
+    VULKAN_PIXEL_CLASS_PACKED10 = 2, // 10:10:10:2 UNORM
+    VULKAN_PIXEL_CLASS_HALF4    = 3,
+    VULKAN_PIXEL_CLASS_FLOAT4   = 4
+};
+
+// SRGB curves, built once on first use
+struct VulkanTransferTables{
+    float                       srgbToLinear[256];
+    int32_t                     linearToSrgb[4096];     // Indexed by linear value * 4095, 32-bit for AVX2 gathers
+
+    VulkanTransferTables(){
+        for (uint32_t value = 0; value < 256; value++){
+            float encoded = value / 255.0f;
+            srgbToLinear[value] = encoded <= 0.04045f ? encoded / 12.92f : std::pow((encoded + 0.055f) / 1.055f, 2.4f);
+        }
+        for (uint32_t index = 0; index < 4096; index++){
+            float linear = index / 4095.0f;
+            float encoded = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+            linearToSrgb[index] = (int32_t)(encoded * 255.0f + 0.5f);
+        }
+    }
+};
+
+static const VulkanTransferTables& getTransferTables(){
+    static const VulkanTransferTables transferTables;
+    return transferTables;
+}
+
+static VulkanPixelClass getPixelClass(VkFormat format){
+    const VulkanFormatInfo& formatInfo = VulkanFormatTraits::getInfo(format);
+    if (formatInfo.aspect != VK_IMAGE_ASPECT_COLOR_BIT || formatInfo.channelCount != 4 || formatInfo.blockWidth != 1){
+        return VULKAN_PIXEL_CLASS_NONE;
+    }
+
+    bool unorm = formatInfo.componentType == VULKAN_COMPONENT_TYPE_UNORM;
+    bool sfloat = formatInfo.componentType == VULKAN_COMPONENT_TYPE_SFLOAT;
+    if (formatInfo.channelBits == 8 && (unorm || formatInfo.componentType == VULKAN_COMPONENT_TYPE_SRGB)){
+        return VULKAN_PIXEL_CLASS_BYTE4;
+    }else if (formatInfo.channelBits == 0 && formatInfo.blockSize == 4 && unorm){
+        return VULKAN_PIXEL_CLASS_PACKED10;
+    }else if (formatInfo.channelBits == 16 && sfloat){
+        return VULKAN_PIXEL_CLASS_HALF4;
+    }else if (formatInfo.channelBits == 32 && sfloat){
+        return VULKAN_PIXEL_CLASS_FLOAT4;
+    }
+    return VULKAN_PIXEL_CLASS_NONE;
+}
+
+static void getChannelBytes(VkFormat format, uint32_t channelBytes[4]){
+    // Byte of R, G, B and A in each texel; packed ABGR is RGBA in memory on little-endian hosts
+    bool bgra = VulkanFormatTraits::getInfo(format).channelOrder == VULKAN_CHANNEL_ORDER_BGRA;
+    channelBytes[0] = bgra ? 2 : 0;
+    channelBytes[1] = 1;
+    channelBytes[2] = bgra ? 0 : 2;
+    channelBytes[3] = 3;
+}
+
+static void getChannelShifts(VkFormat format, uint32_t channelShifts[4]){
+    // Lowest bit of R, G, B and A in a 10:10:10:2 texel
+    bool argb = VulkanFormatTraits::getInfo(format).channelOrder == VULKAN_CHANNEL_ORDER_ARGB;
+    channelShifts[0] = argb ? 20 : 0;
+    channelShifts[1] = 10;
+    channelShifts[2] = argb ? 0 : 20;
+    channelShifts[3] = 30;
+}
+
+static float halfToFloat(uint16_t half){
+    uint32_t sign       = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent   = (half >> 10) & 0x1f;
+    uint32_t mantissa   = half & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f){
+        // Infinity or NaN
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    }else if (exponent != 0){
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }else if (mantissa == 0){
+        bits = sign;
+    }else{
+        // Denormal halves are normal floats
+        exponent = 113;
+        while ((mantissa & 0x400) == 0){
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint16_t floatToHalf(float value){
+    // Rounds to nearest even, like F16C
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign       = (bits >> 16) & 0x8000;
+    uint32_t absBits    = bits & 0x7fffffff;
+    if (absBits >= 0x7f800000){
+        // Infinity stays infinity, NaN stays a quiet NaN
+        return sign | 0x7c00 | (absBits > 0x7f800000 ? 0x200 : 0);
+    }else if (absBits >= 0x477ff000){
+        // Rounds past 65504
+        return sign | 0x7c00;
+    }else if (absBits < 0x38800000){
+        // Denormal half, or zero below half the smallest one
+        if (absBits < 0x33000000){
+            return sign;
+        }
+        uint32_t mantissa       = (absBits & 0x7fffff) | 0x800000;
+        uint32_t shift          = 126 - (absBits >> 23);
+        uint32_t halfMantissa   = mantissa >> shift;
+        uint32_t remainder      = mantissa & ((1u << shift) - 1);
+        uint32_t halfway        = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (halfMantissa & 1))){
+            halfMantissa++;
+        }
+        return sign | (uint16_t)halfMantissa;
+    }
+
+    // Rebias the exponent; a carry out of the mantissa rounds up into it
+    uint32_t halfBits   = (absBits >> 13) - (112 << 10);
+    uint32_t remainder  = absBits & 0x1fff;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (halfBits & 1))){
+        halfBits++;
+    }
+    return sign | (uint16_t)halfBits;
+}
+
+static float saturate(float value){
+    // NaN goes to 0
+    return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+}
+
+#ifdef VULKAN_PIXEL_CONVERTER_X86
+static void cpuid(int info[4], int leaf, int subleaf){
+#if defined(_MSC_VER)
+    __cpuidex(info, leaf, subleaf);
+#else
+    unsigned int registers[4] = {};
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+    for (uint32_t index = 0; index < 4; index++){
+        info[index] = (int)registers[index];
+    }
+#endif
+}
+
+static uint64_t xgetbv(){
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+
+// Each SIMD kernel handles whole vectors and returns how far it got; the scalar loop in
+// its caller does the rest of the row
+
+VULKAN_TARGET_SSE41 static uint32_t shuffleBytesSse41(const uint8_t * src, uint8_t * dst, uint32_t pixelCount, const uint32_t pattern[4]){
+    int8_t maskBytes[16];
+    for (uint32_t index = 0; index < 16; index++){
+        maskBytes[index] = (int8_t)((index & 12) + pattern[index & 3]);
+    }
+    const __m128i mask = _mm_loadu_si128((const __m128i *)maskBytes);
+
+    uint32_t pixel = 0;
+    for (; pixel + 4 <= pixelCount; pixel += 4){
+        __m128i texels = _mm_loadu_si128((const __m128i *)(src + pixel * 4));
+        _mm_storeu_si128((__m128i *)(dst + pixel * 4), _mm_shuffle_epi8(texels, mask));
+    }
+    return pixel;
+}
+
+VULKAN_TARGET_AVX2 static uint32_t shuffleBytesAvx2(const uint8_t * src, uint8_t * dst, uint32_t pixelCount, const uint32_t pattern[4]){
+    // vpshufb works within each 128-bit lane, which the pattern repeats in anyway
+    int8_t maskBytes[32];
+    for (uint32_t index = 0; index < 32; index++){
+        maskBytes[index] = (int8_t)((index & 12) + pattern[index & 3]);
+    }
+    const __m256i mask = _mm256_loadu_si256((const __m256i *)maskBytes);
+
+    uint32_t pixel = 0;
+    for (; pixel + 8 <= pixelCount; pixel += 8){
+        __m256i texels = _mm256_loadu_si256((const __m256i *)(src + pixel * 4));
+        _mm256_storeu_si256((__m256i *)(dst + pixel * 4), _mm256_shuffle_epi8(texels, mask));
+    }
+    return pixel;
+}
+
+VULKAN_TARGET_SSE41 static uint32_t unpackPacked10Sse41(const uint32_t * src, uint8_t * dst, uint32_t pixelCount, const uint32_t channelShifts[4], const uint32_t channelBytes[4]){
+    const __m128i channelMask   = _mm_set1_epi32(0x3ff);
+    const __m128i alphaScale    = _mm_set1_epi32(85);
+    const __m128 scale          = _mm_set1_ps(255.0f / 1023.0f);
+    const __m128 half           = _mm_set1_ps(0.5f);
+
+    uint32_t pixel = 0;
+    for (; pixel + 4 <= pixelCount; pixel += 4){
+        __m128i texels = _mm_loadu_si128((const __m128i *)(src + pixel));
+
+        // 2-bit alpha is exact as a multiple of 85, and small enough for a 16-bit multiply
+        __m128i bytes = _mm_mullo_epi16(_mm_srli_epi32(texels, 30), alphaScale);
+        bytes = _mm_sll_epi32(bytes, _mm_cvtsi32_si128(channelBytes[3] * 8));
+        for (uint32_t channel = 0; channel < 3; channel++){
+            __m128i value = _mm_and_si128(_mm_srl_epi32(texels, _mm_cvtsi32_si128(channelShifts[channel])), channelMask);
+            value = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(value), scale), half));
+            bytes = _mm_or_si128(bytes, _mm_sll_epi32(value, _mm_cvtsi32_si128(channelBytes[channel] * 8)));
+        }
+        _mm_storeu_si128((__m128i *)(dst + pixel * 4), bytes);
+    }
+    return pixel;
+}
+
+VULKAN_TARGET_AVX2 static uint32_t unpackPacked10Avx2(const uint32_t * src, uint8_t * dst, uint32_t pixelCount, const uint32_t channelShifts[4], const uint32_t channelBytes[4]){
+    const __m256i channelMask   = _mm256_set1_epi32(0x3ff);
+    const __m256i alphaScale    = _mm256_set1_epi32(85);
+    const __m256 scale          = _mm256_set1_ps(255.0f / 1023.0f);
+    const __m256 half           = _mm256_set1_ps(0.5f);
+
+    uint32_t pixel = 0;
+    for (; pixel + 8 <= pixelCount; pixel += 8){
+        __m256i texels = _mm256_loadu_si256((const __m256i *)(src + pixel));
+
+        __m256i bytes = _mm256_mullo_epi16(_mm256_srli_epi32(texels, 30), alphaScale);
+        bytes = _mm256_sll_epi32(bytes, _mm_cvtsi32_si128(channelBytes[3] * 8));
+        for (uint32_t channel = 0; channel < 3; channel++){
+            __m256i value = _mm256_and_si256(_mm256_srl_epi32(texels, _mm_cvtsi32_si128(channelShifts[channel])), channelMask);
+            value = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(value), scale), half));
+            bytes = _mm256_or_si256(bytes, _mm256_sll_epi32(value, _mm_cvtsi32_si128(channelBytes[channel] * 8)));
+        }
+        _mm256_storeu_si256((__m256i *)(dst + pixel * 4), bytes);
+    }
+    return pixel;
+}
+
+VULKAN_TARGET_SSE41 static uint32_t halfToFloatSse41(const uint16_t * src, float * dst, uint32_t valueCount){
+    // Shift into a float and rescale the exponent with one multiply, which also turns
+    // denormal halves into normal floats; infinity and NaN get their exponent forced
+    const __m128i noSign            = _mm_set1_epi32(0x7fff);
+    const __m128 magic              = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+    const __m128i largestFinite     = _mm_set1_epi32(0x7bff);
+    const __m128i infNanExponent    = _mm_set1_epi32(255 << 23);
+
+    uint32_t value = 0;
+    for (; value + 4 <= valueCount; value += 4){
+        __m128i halves          = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)(src + value)));
+        __m128i exponentMantissa = _mm_and_si128(halves, noSign);
+        __m128i sign            = _mm_slli_epi32(_mm_xor_si128(halves, exponentMantissa), 16);
+        __m128 scaled           = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 13)), magic);
+        __m128i infNan          = _mm_and_si128(_mm_cmpgt_epi32(exponentMantissa, largestFinite), infNanExponent);
+        _mm_storeu_ps(dst + value, _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infNan))));
+    }
+    return value;
+}
+
+VULKAN_TARGET_AVX2 static uint32_t halfToFloatAvx2(const uint16_t * src, float * dst, uint32_t valueCount){
+    uint32_t value = 0;
+    for (; value + 8 <= valueCount; value += 8){
+        _mm256_storeu_ps(dst + value, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + value))));
+    }
+    return value;
+}
+
+VULKAN_TARGET_AVX2 static uint32_t floatToHalfAvx2(const float * src, uint16_t * dst, uint32_t valueCount){
+    uint32_t value = 0;
+    for (; value + 8 <= valueCount; value += 8){
+        _mm_storeu_si128((__m128i *)(dst + value), _mm256_cvtps_ph(_mm256_loadu_ps(src + value), _MM_FROUND_TO_NEAREST_INT));
+    }
+    return value;
+}
+
+VULKAN_TARGET_SSE41 static uint32_t floatToBytesSse41(const float * src, uint8_t * dst, uint32_t pixelCount){
+    const __m128 zero   = _mm_setzero_ps();
+    const __m128 one    = _mm_set1_ps(1.0f);
+    const __m128 scale  = _mm_set1_ps(255.0f);
+    const __m128 half   = _mm_set1_ps(0.5f);
+
+    uint32_t pixel = 0;
+    for (; pixel + 4 <= pixelCount; pixel += 4){
+        __m128i texels[4];
+        for (uint32_t texel = 0; texel < 4; texel++){
+            // max returns its second operand for NaN, so NaN goes to 0
+            __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + (pixel + texel) * 4), zero), one);
+            texels[texel] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half));
+        }
+        __m128i words0 = _mm_packus_epi32(texels[0], texels[1]);
+        __m128i words1 = _mm_packus_epi32(texels[2], texels[3]);
+        _mm_storeu_si128((__m128i *)(dst + pixel * 4), _mm_packus_epi16(words0, words1));
+    }
+    return pixel;
+}
+
+VULKAN_TARGET_AVX2 static uint32_t floatToBytesAvx2(const float * src, uint8_t * dst, uint32_t pixelCount, bool srgb){
+    const __m256 zero           = _mm256_setzero_ps();
+    const __m256 one            = _mm256_set1_ps(1.0f);
+    const __m256 unormScale     = _mm256_set1_ps(255.0f);
+    const __m256 srgbScale      = _mm256_set1_ps(4095.0f);
+    const __m256 half           = _mm256_set1_ps(0.5f);
+    const __m256i alphaLanes    = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+    const __m256i texelOrder    = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const int * srgbTable       = getTransferTables().linearToSrgb;
+
+    uint32_t pixel = 0;
+    for (; pixel + 8 <= pixelCount; pixel += 8){
+        __m256i texelPairs[4];
+        for (uint32_t texelPair = 0; texelPair < 4; texelPair++){
+            __m256 value = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + (pixel + texelPair * 2) * 4), zero), one);
+            __m256i bytes = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, unormScale), half));
+            if (srgb){
+                // Colour goes through the curve, alpha stays linear
+                __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, srgbScale), half));
+                bytes = _mm256_blendv_epi8(_mm256_i32gather_epi32(srgbTable, index, 4), bytes, alphaLanes);
+            }
+            texelPairs[texelPair] = bytes;
+        }
+
+        // Packs work per 128-bit lane, so texels come out as 0 2 4 6 1 3 5 7
+        __m256i words0 = _mm256_packus_epi32(texelPairs[0], texelPairs[1]);
+        __m256i words1 = _mm256_packus_epi32(texelPairs[2], texelPairs[3]);
+        __m256i bytes = _mm256_packus_epi16(words0, words1);
+        _mm256_storeu_si256((__m256i *)(dst + pixel * 4), _mm256_permutevar8x32_epi32(bytes, texelOrder));
+    }
+    return pixel;
+}
+#endif
+
+static void shuffleBytes(const uint8_t * src, uint8_t * dst, uint32_t pixelCount, const uint32_t pattern[4]){
+    // Byte i of each destination texel is byte pattern[i] of the source texel, in place is fine
+    uint32_t pixel = 0;
+#ifdef VULKAN_PIXEL_CONVERTER_X86
+    VulkanSimdLevel simdLevel = VulkanPixelConverter::getSimdLevel();
+    if (simdLevel == VULKAN_SIMD_LEVEL_AVX2){
+        pixel = shuffleBytesAvx2(src, dst, pixelCount, pattern);
+    }else if (simdLevel == VULKAN_SIMD_LEVEL_SSE41){
+        pixel = shuffleBytesSse41(src, dst, pixelCount, pattern);
+    }
+#endif
+    for (; pixel < pixelCount; pixel++){
+        uint8_t texel[4];
+        memcpy(texel, src + pixel * 4, 4);
+        for (uint32_t byte = 0; byte < 4; byte++){
+            dst[pixel * 4 + byte] = texel[pattern[byte]];
+        }
+    }
+}
+
+static void unpackPacked10(const uint32_t * src, uint8_t * dst, uint32_t pixelCount, const uint32_t channelShifts[4], const uint32_t channelBytes[4]){
+    uint32_t pixel = 0;
+#ifdef VULKAN_PIXEL_CONVERTER_X86
+    VulkanSimdLevel simdLevel = VulkanPixelConverter::getSimdLevel();
+    if (simdLevel == VULKAN_SIMD_LEVEL_AVX2){
+        pixel = unpackPacked10Avx2(src, dst, pixelCount, channelShifts, channelBytes);
+    }else if (simdLevel == VULKAN_SIMD_LEVEL_SSE41){
+        pixel = unpackPacked10Sse41(src, dst, pixelCount, channelShifts, channelBytes);
+    }
+#endif
+    for (; pixel < pixelCount; pixel++){
+        for (uint32_t channel = 0; channel < 3; channel++){
+            // round(value * 255 / 1023)
+            uint32_t value = (src[pixel] >> channelShifts[channel]) & 0x3ff;
+            dst[pixel * 4 + channelBytes[channel]] = (uint8_t)((value * 510 + 1023) / 2046);
+        }
+        dst[pixel * 4 + channelBytes[3]] = (uint8_t)((src[pixel] >> 30) * 85);
+    }
+}
+
+static void halfToFloatRow(const uint16_t * src, float * dst, uint32_t valueCount){
+    uint32_t value = 0;
+#ifdef VULKAN_PIXEL_CONVERTER_X86
+    VulkanSimdLevel simdLevel = VulkanPixelConverter::getSimdLevel();
+    if (simdLevel == VULKAN_SIMD_LEVEL_AVX2){
+        value = halfToFloatAvx2(src, dst, valueCount);
+    }else if (simdLevel == VULKAN_SIMD_LEVEL_SSE41){
+        value = halfToFloatSse41(src, dst, valueCount);
+    }
+#endif
+    for (; value < valueCount; value++){
+        dst[value] = halfToFloat(src[value]);
+    }
+}
+
+static void floatToHalfRow(const float * src, uint16_t * dst, uint32_t valueCount){
+    // Needs F16C to vectorise, so SSE4.1 CPUs take the scalar path
+    uint32_t value = 0;
+#ifdef VULKAN_PIXEL_CONVERTER_X86
+    if (VulkanPixelConverter::getSimdLevel() == VULKAN_SIMD_LEVEL_AVX2){
+        value = floatToHalfAvx2(src, dst, valueCount);
+    }
+#endif
+    for (; value < valueCount; value++){
+        dst[value] = floatToHalf(src[value]);
+    }
+}
+
+static void floatToBytesRow(const float * src, uint8_t * dst, uint32_t pixelCount, bool srgb){
+    // Writes RGBA; the SRGB curve is a table lookup, which only AVX2 can gather
+    uint32_t pixel = 0;
+#ifdef VULKAN_PIXEL_CONVERTER_X86
+    VulkanSimdLevel simdLevel = VulkanPixelConverter::getSimdLevel();
+    if (simdLevel == VULKAN_SIMD_LEVEL_AVX2){
+        pixel = floatToBytesAvx2(src, dst, pixelCount, srgb);
+    }else if (simdLevel == VULKAN_SIMD_LEVEL_SSE41 && !srgb){
+        pixel = floatToBytesSse41(src, dst, pixelCount);
+    }
+#endif
+    const VulkanTransferTables& transferTables = getTransferTables();
+    for (; pixel < pixelCount; pixel++){
+        for (uint32_t channel = 0; channel < 4; channel++){
+            float value = saturate(src[pixel * 4 + channel]);
+            if (srgb && channel < 3){
+                dst[pixel * 4 + channel] = (uint8_t)transferTables.linearToSrgb[(uint32_t)(value * 4095.0f + 0.5f)];
+            }else{
+                dst[pixel * 4 + channel] = (uint8_t)(value * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+static void decodeRow(VkFormat format, VulkanPixelClass pixelClass, const uint8_t * src, float * dst, uint32_t width){
+    // To linear float RGBA
+    switch (pixelClass){
+        case VULKAN_PIXEL_CLASS_BYTE4:{
+            const VulkanTransferTables& transferTables = getTransferTables();
+            bool srgb = VulkanFormatTraits::isSrgb(format);
+            uint32_t channelBytes[4];
+            getChannelBytes(format, channelBytes);
+            for (uint32_t pixel = 0; pixel < width; pixel++){
+                for (uint32_t channel = 0; channel < 4; channel++){
+                    uint8_t value = src[pixel * 4 + channelBytes[channel]];
+                    dst[pixel * 4 + channel] = srgb && channel < 3 ? transferTables.srgbToLinear[value] : value / 255.0f;
+                }
+            }
+            break;
+        }
+        case VULKAN_PIXEL_CLASS_PACKED10:{
+            uint32_t channelShifts[4];
+            getChannelShifts(format, channelShifts);
+            const uint32_t * texels = reinterpret_cast<const uint32_t *>(src);
+            for (uint32_t pixel = 0; pixel < width; pixel++){
+                for (uint32_t channel = 0; channel < 3; channel++){
+                    dst[pixel * 4 + channel] = ((texels[pixel] >> channelShifts[channel]) & 0x3ff) / 1023.0f;
+                }
+                dst[pixel * 4 + 3] = (texels[pixel] >> 30) / 3.0f;
+            }
+            break;
+        }
+        case VULKAN_PIXEL_CLASS_HALF4:
+            halfToFloatRow(reinterpret_cast<const uint16_t *>(src), dst, width * 4);
+            break;
+        case VULKAN_PIXEL_CLASS_FLOAT4:
+            memcpy(dst, src, (size_t)width * 16);
+            break;
+        default:
+            assert(false);
+            break;
+    }
+}
+
+static void encodeRow(VkFormat format, VulkanPixelClass pixelClass, const float * src, uint8_t * dst, uint32_t width){
+    // From linear float RGBA
+    switch (pixelClass){
+        case VULKAN_PIXEL_CLASS_BYTE4:{
+            floatToBytesRow(src, dst, width, VulkanFormatTraits::isSrgb(format));
+            if (VulkanFormatTraits::getInfo(format).channelOrder == VULKAN_CHANNEL_ORDER_BGRA){
+                const uint32_t swapRedBlue[4] = {2, 1, 0, 3};
+                shuffleBytes(dst, dst, width, swapRedBlue);
+            }
+            break;
+        }
+        case VULKAN_PIXEL_CLASS_PACKED10:{
+            uint32_t channelShifts[4];
+            getChannelShifts(format, channelShifts);
+            uint32_t * texels = reinterpret_cast<uint32_t *>(dst);
+            for (uint32_t pixel = 0; pixel < width; pixel++){
+                uint32_t texel = (uint32_t)(saturate(src[pixel * 4 + 3]) * 3.0f + 0.5f) << channelShifts[3];
+                for (uint32_t channel = 0; channel < 3; channel++){
+                    texel |= (uint32_t)(saturate(src[pixel * 4 + channel]) * 1023.0f + 0.5f) << channelShifts[channel];
+                }
+                texels[pixel] = texel;
+            }
+            break;
+        }
+        case VULKAN_PIXEL_CLASS_HALF4:
+            floatToHalfRow(src, reinterpret_cast<uint16_t *>(dst), width * 4);
+            break;
+        case VULKAN_PIXEL_CLASS_FLOAT4:
+            memcpy(dst, src, (size_t)width * 16);
+            break;
+        default:
+            assert(false);
+            break;
+    }
+}
+
+bool VulkanPixelConverter::canConvert(VkFormat srcFormat, VkFormat dstFormat){
+    return getPixelClass(srcFormat) != VULKAN_PIXEL_CLASS_NONE && getPixelClass(dstFormat) != VULKAN_PIXEL_CLASS_NONE;
+}
+
+void VulkanPixelConverter::convert(VkFormat srcFormat, const void * src, uint32_t srcRowPitch, VkFormat dstFormat, void * dst, uint32_t dstRowPitch, uint32_t width, uint32_t height){
+    assert(canConvert(srcFormat, dstFormat));
+    VulkanPixelClass srcClass   = getPixelClass(srcFormat);
+    VulkanPixelClass dstClass   = getPixelClass(dstFormat);
+    bool srcSrgb                = VulkanFormatTraits::isSrgb(srcFormat);
+    bool dstSrgb                = VulkanFormatTraits::isSrgb(dstFormat);
+    const uint8_t * srcRow      = static_cast<const uint8_t *>(src);
+    uint8_t * dstRow            = static_cast<uint8_t *>(dst);
+
+    if (srcFormat == dstFormat){
+        for (uint32_t row = 0; row < height; row++, srcRow += srcRowPitch, dstRow += dstRowPitch){
+            memcpy(dstRow, srcRow, (size_t)width * VulkanFormatTraits::getInfo(srcFormat).blockSize);
+        }
+    }else if (srcClass == VULKAN_PIXEL_CLASS_BYTE4 && dstClass == VULKAN_PIXEL_CLASS_BYTE4 && srcSrgb == dstSrgb){
+        // Same values, at most a swizzle
+        uint32_t srcBytes[4], dstBytes[4], pattern[4];
+        getChannelBytes(srcFormat, srcBytes);
+        getChannelBytes(dstFormat, dstBytes);
+        for (uint32_t channel = 0; channel < 4; channel++){
+            pattern[dstBytes[channel]] = srcBytes[channel];
+        }
+        for (uint32_t row = 0; row < height; row++, srcRow += srcRowPitch, dstRow += dstRowPitch){
+            shuffleBytes(srcRow, dstRow, width, pattern);
+        }
+    }else if (srcClass == VULKAN_PIXEL_CLASS_PACKED10 && dstClass == VULKAN_PIXEL_CLASS_BYTE4 && !dstSrgb){
+        uint32_t channelShifts[4], channelBytes[4];
+        getChannelShifts(srcFormat, channelShifts);
+        getChannelBytes(dstFormat, channelBytes);
+        for (uint32_t row = 0; row < height; row++, srcRow += srcRowPitch, dstRow += dstRowPitch){
+            unpackPacked10(reinterpret_cast<const uint32_t *>(srcRow), dstRow, width, channelShifts, channelBytes);
+        }
+    }else{
+        // Through linear float, skipping the row buffer when either end already is one
+        std::vector<float> linearRow(dstClass == VULKAN_PIXEL_CLASS_FLOAT4 || srcClass == VULKAN_PIXEL_CLASS_FLOAT4 ? 0 : (size_t)width * 4);
+        for (uint32_t row = 0; row < height; row++, srcRow += srcRowPitch, dstRow += dstRowPitch){
+            if (srcClass == VULKAN_PIXEL_CLASS_FLOAT4){
+                encodeRow(dstFormat, dstClass, reinterpret_cast<const float *>(srcRow), dstRow, width);
+            }else if (dstClass == VULKAN_PIXEL_CLASS_FLOAT4){
+                decodeRow(srcFormat, srcClass, srcRow, reinterpret_cast<float *>(dstRow), width);
+            }else{
+                decodeRow(srcFormat, srcClass, srcRow, &linearRow[0], width);
+                encodeRow(dstFormat, dstClass, &linearRow[0], dstRow, width);
+            }
+        }
+    }
+}
+
+VkFormat VulkanPixelConverter::getEncodeFormat(VkFormat format){
+    // Image encoders take 8-bit RGBA. Float sources are linear, so they're encoded to SRGB
+    // like a swapchain would; 8 and 10-bit sources keep their values as they are.
+    VulkanPixelClass pixelClass = getPixelClass(format);
+    bool srgb = VulkanFormatTraits::isSrgb(format) || pixelClass == VULKAN_PIXEL_CLASS_HALF4 || pixelClass == VULKAN_PIXEL_CLASS_FLOAT4;
+    return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+static VulkanSimdLevel detectSimdLevel(){
+#ifdef VULKAN_PIXEL_CONVERTER_X86
+    int info[4];
+    cpuid(info, 0, 0);
+    int maxLeaf = info[0];
+
+    cpuid(info, 1, 0);
+    bool sse41      = (info[2] & (1 << 19)) != 0;
+    bool osxsave    = (info[2] & (1 << 27)) != 0;
+    bool avx        = (info[2] & (1 << 28)) != 0;
+    bool f16c       = (info[2] & (1 << 29)) != 0;
+
+    // AVX also needs the OS to save the upper halves of the YMM registers
+    bool ymmSaved   = osxsave && avx && (xgetbv() & 6) == 6;
+    bool avx2       = false;
+    if (maxLeaf >= 7){
+        cpuid(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+
+    if (avx2 && f16c && ymmSaved){
+        return VULKAN_SIMD_LEVEL_AVX2;
+    }else if (sse41){
+        return VULKAN_SIMD_LEVEL_SSE41;
+    }
+#endif
+    return VULKAN_SIMD_LEVEL_SCALAR;
+}
+
+VulkanSimdLevel VulkanPixelConverter::getSimdLevel(){
+    static const VulkanSimdLevel simdLevel = detectSimdLevel();
+    return simdLevel;
+}
@@ -0,0 +1,236 @@
+#include <cassert>
+#include "VulkanBarrierBatcher.h"
+#include "VulkanPixelConverter.h"
+#include "VulkanReadbackQueue.h"
+
+VulkanReadbackQueue::VulkanReadbackQueue(VulkanFramePacer * __framePacer, uint32_t __slotCount, uint32_t __workerCount){
+    framePacer      = __framePacer;
+    assert(framePacer != nullptr);
+    assert(__slotCount > 0);
+    assert(__workerCount > 0);
+    deviceContext   = framePacer->deviceContext;
+    droppedCaptures = 0;
+    stopping        = false;
+
+    // Buffers are created on first use, once the image size is known
+    slots.resize(__slotCount);
+    for (auto& slot : slots){
+        slot.buffer     = VK_NULL_HANDLE;
+        slot.allocation = {};
+        slot.capacity   = 0;
+        slot.dataSize   = 0;
+        slot.state      = VULKAN_READBACK_STATE_FREE;
+    }
+
+    for (uint32_t workerIndex = 0; workerIndex < __workerCount; workerIndex++){
+        workers.push_back(std::thread(&VulkanReadbackQueue::workerLoop, this));
+    }
+}
+
+VulkanReadbackQueue::~VulkanReadbackQueue(){
+    flush();
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    for (auto& worker : workers){
+        worker.join();
+    }
+
+    for (auto& slot : slots){
+        if (slot.buffer != VK_NULL_HANDLE){
+            deviceContext->vkDestroyBuffer(deviceContext->device, slot.buffer, nullptr);
+            deviceContext->freeMemory(slot.allocation);
+        }
+    }
+}
+
+bool VulkanReadbackQueue::captureImage(VulkanImage& image, const std::string& imageFileName){
+    const VkImageCreateInfo& imageInfo = image.getImageCreateInfo();
+
+    // Find a slot the workers are done with
+    VulkanReadbackSlot * slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto& candidate : slots){
+            if (candidate.state == VULKAN_READBACK_STATE_FREE){
+                slot = &candidate;
+                break;
+            }
+        }
+    }
+    if (slot == nullptr){
+        droppedCaptures++;
+        return false;
+    }
+
+    // The worker converts to the encoder's 8-bit RGBA; anything it can't convert is dumped raw
+    slot->format    = imageInfo.format;
+    slot->raw       = !VulkanPixelConverter::canConvert(slot->format, VulkanPixelConverter::getEncodeFormat(slot->format));
+
+    uint32_t bytesPerPixel  = VulkanImage::bytesPerPixel(imageInfo.format);
+    slot->width             = imageInfo.extent.width;
+    slot->height            = imageInfo.extent.height;
+    slot->fileName          = imageFileName;
+    slot->frameNumber       = framePacer->getCurrentFrame().frameNumber;
+    slot->dataSize          = (VkDeviceSize)slot->width * slot->height * bytesPerPixel;
+    reserveSlot(*slot, slot->dataSize);
+
+    // Record the copy into the frame, it completes with the frame's own fence
+    VkCommandBuffer commandBuffer = framePacer->getCurrentFrame().commandBuffer;
+
+    VkBufferImageCopy imageCopy;
+    imageCopy.bufferOffset                      = 0;
+    imageCopy.bufferRowLength                   = slot->width;
+    imageCopy.bufferImageHeight                 = slot->height;
+    imageCopy.imageSubresource                  = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    imageCopy.imageOffset                       = {0, 0, 0};
+    imageCopy.imageExtent                       = imageInfo.extent;
+
+    // The image stays in the transfer layout until its next user transitions it
+    VulkanBarrierBatcher barrierBatcher(deviceContext, commandBuffer);
+    barrierBatcher.transition(image, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    barrierBatcher.flush();
+    deviceContext->vkCmdCopyImageToBuffer(commandBuffer, image.imageHandle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->buffer, 1, &imageCopy);
+
+    // Make the copy visible to host reads once the fence signals
+    VkBufferMemoryBarrier bufferBarrier;
+    bufferBarrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.pNext                 = nullptr;
+    bufferBarrier.srcAccessMask         = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask         = VK_ACCESS_HOST_READ_BIT;
+    bufferBarrier.srcQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.dstQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+    bufferBarrier.buffer                = slot->buffer;
+    bufferBarrier.offset                = 0;
+    bufferBarrier.size                  = VK_WHOLE_SIZE;
+    deviceContext->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+    std::lock_guard<std::mutex> lock(queueMutex);
+    slot->state = VULKAN_READBACK_STATE_PENDING;
+    return true;
+}
+
+void VulkanReadbackQueue::flush(){
+    // Every recorded frame has to be submitted first, so call this between frames
+    framePacer->waitIdle();
+    update();
+
+    std::unique_lock<std::mutex> lock(queueMutex);
+    idleCondition.wait(lock, [this]{
+        for (auto& slot : slots){
+            if (slot.state == VULKAN_READBACK_STATE_ENCODING){
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void VulkanReadbackQueue::update(){
+    std::vector<VulkanReadbackSlot *> readySlots;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto& slot : slots){
+            if (slot.state == VULKAN_READBACK_STATE_PENDING && framePacer->isFrameComplete(slot.frameNumber)){
+                readySlots.push_back(&slot);
+            }
+        }
+    }
+    if (readySlots.empty()){
+        return;
+    }
+
+    for (auto slot : readySlots){
+        // Invalidate memory to make it visible to host
+        deviceContext->invalidateMappedRange(slot->allocation, 0, slot->dataSize);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto slot : readySlots){
+            slot->state = VULKAN_READBACK_STATE_ENCODING;
+            encodeQueue.push_back(slot);
+        }
+    }
+    queueCondition.notify_all();
+}
+
+void VulkanReadbackQueue::encodeSlot(VulkanReadbackSlot& slot){
+    const char * pixels = static_cast<const char *>(slot.allocation.mappedData);
+
+    if (slot.raw){
+        std::ofstream rawImageStream(slot.fileName.c_str(), std::ofstream::binary);
+        rawImageStream.write(pixels, (std::streamsize)slot.dataSize);
+        rawImageStream.close();
+        return;
+    }
+
+    VkFormat encodeFormat   = VulkanPixelConverter::getEncodeFormat(slot.format);
+    uint32_t rowPitch       = slot.width * VulkanImage::bytesPerPixel(encodeFormat);
+    if (slot.format != encodeFormat){
+        // Reading from cached memory keeps the conversion at memory speed
+        std::vector<char> converted((size_t)rowPitch * slot.height);
+        VulkanPixelConverter::convert(slot.format, pixels, slot.width * VulkanImage::bytesPerPixel(slot.format), encodeFormat, &converted[0], rowPitch, slot.width, slot.height);
+        VulkanImage::writeImageFile(slot.fileName, &converted[0], slot.width, slot.height, rowPitch);
+    }else{
+        VulkanImage::writeImageFile(slot.fileName, pixels, slot.width, slot.height, rowPitch);
+    }
+}
+
+void VulkanReadbackQueue::reserveSlot(VulkanReadbackSlot& slot, VkDeviceSize dataSize){
+    if (slot.capacity >= dataSize){
+        return;
+    }
+
+    // Only free slots are resized, so nothing is using the old buffer
+    if (slot.buffer != VK_NULL_HANDLE){
+        deviceContext->vkDestroyBuffer(deviceContext->device, slot.buffer, nullptr);
+        deviceContext->freeMemory(slot.allocation);
+    }
+
+    VkBufferCreateInfo bufferInfo;
+    bufferInfo.sType                    = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext                    = nullptr;
+    bufferInfo.flags                    = 0;
+    bufferInfo.size                     = dataSize;
+    bufferInfo.usage                    = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode              = VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount    = 0;
+    bufferInfo.pQueueFamilyIndices      = nullptr;
+    assert(deviceContext->vkCreateBuffer(deviceContext->device, &bufferInfo, nullptr, &slot.buffer) == VK_SUCCESS);
+
+    VkMemoryRequirements memoryRequirements;
+    deviceContext->vkGetBufferMemoryRequirements(deviceContext->device, slot.buffer, &memoryRequirements);
+
+    // Host reads of uncached memory are very slow, so prefer cached memory for readback
+    slot.allocation = deviceContext->allocateMemory(memoryRequirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VULKAN_ALLOCATION_TYPE_LINEAR);
+    assert(slot.allocation.block != nullptr && slot.allocation.mappedData != nullptr);
+    assert(deviceContext->vkBindBufferMemory(deviceContext->device, slot.buffer, slot.allocation.memory, slot.allocation.offset) == VK_SUCCESS);
+    slot.capacity = dataSize;
+}
+
+void VulkanReadbackQueue::workerLoop(){
+    while (true){
+        VulkanReadbackSlot * slot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]{ return stopping || !encodeQueue.empty(); });
+            if (encodeQueue.empty()){
+                return;
+            }
+            slot = encodeQueue.front();
+            encodeQueue.pop_front();
+        }
+
+        encodeSlot(*slot);
+
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            slot->state = VULKAN_READBACK_STATE_FREE;
+        }
+        idleCondition.notify_all();
+    }
+}
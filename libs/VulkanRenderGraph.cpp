@@ -0,0 +1,835 @@
+#include <algorithm>
+#include <cassert>
+#include "VulkanBarrierBatcher.h"
+#include "VulkanRenderGraph.h"
+
+struct VulkanGraphAccessInfo{
+    VkImageLayout               layout;
+    VkPipelineStageFlags        stages;             // Shader accesses add the use's own stages
+    VkAccessFlags               access;
+    VkImageUsageFlags           usage;
+    bool                        write;
+    bool                        attachment;         // Bound to the framebuffer, can stay inside a render pass
+};
+
+static const VulkanGraphAccessInfo graphAccessInfos[VULKAN_GRAPH_ACCESS_COUNT] = {
+    {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+     VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,            true,   true},
+    {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+     VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,   true,   true},
+    {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,          VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+     VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,                                                      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,            true,   true},
+    {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+     VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,                                                       VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,            false,  true},
+    {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,          0,
+     VK_ACCESS_SHADER_READ_BIT,                                                                 VK_IMAGE_USAGE_SAMPLED_BIT,                     false,  false},
+    {VK_IMAGE_LAYOUT_GENERAL,                           0,
+     VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,                                    VK_IMAGE_USAGE_STORAGE_BIT,                     true,   false},
+    {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,              VK_PIPELINE_STAGE_TRANSFER_BIT,
+     VK_ACCESS_TRANSFER_READ_BIT,                                                               VK_IMAGE_USAGE_TRANSFER_SRC_BIT,                false,  false},
+    {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,              VK_PIPELINE_STAGE_TRANSFER_BIT,
+     VK_ACCESS_TRANSFER_WRITE_BIT,                                                              VK_IMAGE_USAGE_TRANSFER_DST_BIT,                true,   false}
+};
+
+static bool isDepthFormat(VkFormat format){
+    switch(format){
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool hasStencil(VkFormat format){
+    return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+static VkImageLayout getUseLayout(const VulkanGraphResourceUse& use, VkFormat format){
+    // Depth read by shaders stays in a depth layout
+    if (isDepthFormat(format) && (use.access == VULKAN_GRAPH_ACCESS_INPUT_ATTACHMENT || use.access == VULKAN_GRAPH_ACCESS_SAMPLED)){
+        return VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    }
+    return graphAccessInfos[use.access].layout;
+}
+
+static VkPipelineStageFlags getUseStages(const VulkanGraphResourceUse& use){
+    return graphAccessInfos[use.access].stages | use.shaderStages;
+}
+
+// Whether the use replaces every texel, so nothing written before it is needed
+static bool overwritesContents(const VulkanGraphResourceUse& use){
+    return use.clear || use.access == VULKAN_GRAPH_ACCESS_RESOLVE_ATTACHMENT;
+}
+
+VulkanRenderGraph::VulkanRenderGraph(VulkanDevice * __deviceContext){
+    deviceContext   = __deviceContext;
+    compiled        = false;
+    verbose         = false;
+    assert(deviceContext != nullptr);
+}
+
+VulkanRenderGraph::~VulkanRenderGraph(){
+    destroyCompiled();
+}
+
+VulkanGraphResource VulkanRenderGraph::createImage(const std::string& name, VkFormat format, VkExtent2D extent, VkSampleCountFlagBits samples){
+    assert(!compiled);
+
+    VulkanGraphResourceInfo resource = {};
+    resource.name           = name;
+    resource.format         = format;
+    resource.extent         = extent;
+    resource.samples        = samples;
+    resource.imported       = false;
+    resource.finalLayout    = VK_IMAGE_LAYOUT_UNDEFINED;
+    resource.discardStages  = 0;
+    resource.image          = nullptr;
+    resource.imageHandle    = VK_NULL_HANDLE;
+    resources.push_back(resource);
+
+    return resources.size() - 1;
+}
+
+VulkanGraphResource VulkanRenderGraph::importImage(const std::string& name, VulkanImage * image, VkImageLayout finalLayout, VkPipelineStageFlags discardStages){
+    assert(!compiled && image != nullptr && image->imageViewHandle != VK_NULL_HANDLE);
+    const VkImageCreateInfo& imageInfo = image->getImageCreateInfo();
+
+    VulkanGraphResourceInfo resource = {};
+    resource.name           = name;
+    resource.format         = imageInfo.format;
+    resource.extent         = {imageInfo.extent.width, imageInfo.extent.height};
+    resource.samples        = imageInfo.samples;
+    resource.usage          = imageInfo.usage;
+    resource.imported       = true;
+    resource.finalLayout    = finalLayout;
+    resource.discardStages  = discardStages;
+    resource.image          = image;
+    resource.imageHandle    = VK_NULL_HANDLE;
+    resources.push_back(resource);
+
+    return resources.size() - 1;
+}
+
+void VulkanRenderGraph::setImportedImage(VulkanGraphResource resource, VulkanImage * image){
+    // Swapchain images change every frame, the compiled graph stays valid as long as the format does
+    assert(resource < resources.size() && resources[resource].imported && image != nullptr);
+    assert(image->getImageCreateInfo().format == resources[resource].format);
+    resources[resource].image = image;
+}
+
+VulkanGraphPass VulkanRenderGraph::addPass(const std::string& name, bool graphics, const VulkanGraphRecordCallback& record, bool sideEffects){
+    assert(!compiled);
+
+    VulkanGraphPassInfo pass;
+    pass.name           = name;
+    pass.graphics       = graphics;
+    pass.sideEffects    = sideEffects;
+    pass.record         = record;
+    pass.culled         = false;
+    pass.group          = 0;
+    pass.subpass        = 0;
+    passes.push_back(pass);
+
+    return passes.size() - 1;
+}
+
+void VulkanRenderGraph::writeColor(VulkanGraphPass pass, VulkanGraphResource resource, const VkClearValue * clearValue){
+    addUse(pass, resource, VULKAN_GRAPH_ACCESS_COLOR_ATTACHMENT, 0, clearValue, resource);
+}
+
+void VulkanRenderGraph::writeDepth(VulkanGraphPass pass, VulkanGraphResource resource, const VkClearValue * clearValue){
+    addUse(pass, resource, VULKAN_GRAPH_ACCESS_DEPTH_ATTACHMENT, 0, clearValue, resource);
+}
+
+void VulkanRenderGraph::resolve(VulkanGraphPass pass, VulkanGraphResource source, VulkanGraphResource target){
+    addUse(pass, target, VULKAN_GRAPH_ACCESS_RESOLVE_ATTACHMENT, 0, nullptr, source);
+}
+
+void VulkanRenderGraph::readAttachment(VulkanGraphPass pass, VulkanGraphResource resource){
+    addUse(pass, resource, VULKAN_GRAPH_ACCESS_INPUT_ATTACHMENT, 0, nullptr, resource);
+}
+
+void VulkanRenderGraph::readTexture(VulkanGraphPass pass, VulkanGraphResource resource, VkPipelineStageFlags shaderStages){
+    addUse(pass, resource, VULKAN_GRAPH_ACCESS_SAMPLED, shaderStages, nullptr, resource);
+}
+
+void VulkanRenderGraph::writeStorage(VulkanGraphPass pass, VulkanGraphResource resource, VkPipelineStageFlags shaderStages){
+    addUse(pass, resource, VULKAN_GRAPH_ACCESS_STORAGE_WRITE, shaderStages, nullptr, resource);
+}
+
+void VulkanRenderGraph::readTransfer(VulkanGraphPass pass, VulkanGraphResource resource){
+    addUse(pass, resource, VULKAN_GRAPH_ACCESS_TRANSFER_SRC, 0, nullptr, resource);
+}
+
+void VulkanRenderGraph::writeTransfer(VulkanGraphPass pass, VulkanGraphResource resource){
+    addUse(pass, resource, VULKAN_GRAPH_ACCESS_TRANSFER_DST, 0, nullptr, resource);
+}
+
+void VulkanRenderGraph::addUse(VulkanGraphPass pass, VulkanGraphResource resource, VulkanGraphAccess access, VkPipelineStageFlags shaderStages, const VkClearValue * clearValue, VulkanGraphResource resolveSource){
+    assert(!compiled && pass < passes.size() && resource < resources.size());
+
+    // Attachments only exist inside render passes
+    assert(passes[pass].graphics || !graphAccessInfos[access].attachment);
+    assert(clearValue == nullptr || access == VULKAN_GRAPH_ACCESS_COLOR_ATTACHMENT || access == VULKAN_GRAPH_ACCESS_DEPTH_ATTACHMENT);
+
+    VulkanGraphResourceUse use = {};
+    use.resource        = resource;
+    use.access          = access;
+    use.shaderStages    = shaderStages;
+    use.clear           = clearValue != nullptr;
+    use.resolveSource   = resolveSource;
+    if (clearValue != nullptr){
+        use.clearValue  = *clearValue;
+    }
+    passes[pass].uses.push_back(use);
+
+    resources[resource].usage |= graphAccessInfos[access].usage;
+}
+
+void VulkanRenderGraph::compile(){
+    assert(!compiled);
+
+    cullPasses();
+    buildGroups();
+    allocateResources();
+    for (uint32_t groupIndex = 0; groupIndex < groups.size(); groupIndex++){
+        createRenderPass(groups[groupIndex], groupIndex);
+    }
+    compiled = true;
+
+    if (!verbose){
+        return;
+    }
+
+    uint32_t livePasses     = 0;
+    uint32_t renderPasses   = 0;
+    for (auto& pass : passes){
+        livePasses += pass.culled ? 0 : 1;
+    }
+    for (auto& group : groups){
+        renderPasses += group.graphics ? 1 : 0;
+    }
+    std::cout << "Render graph: " << std::dec << livePasses << " of " << passes.size() << " passes in " << renderPasses << " render passes" << std::endl;
+}
+
+void VulkanRenderGraph::cullPasses(){
+    // Walk back from the passes with visible results: anything they read must be produced
+    std::vector<bool> needed(resources.size(), false);
+    for (uint32_t passIndex = passes.size(); passIndex-- > 0;){
+        VulkanGraphPassInfo& pass = passes[passIndex];
+
+        bool live = pass.sideEffects;
+        for (auto& use : pass.uses){
+            if (graphAccessInfos[use.access].write && (resources[use.resource].imported || needed[use.resource])){
+                live = true;
+            }
+        }
+
+        pass.culled = !live;
+        if (!live){
+            if (verbose){
+                std::cout << "Render graph: culling pass " << pass.name << std::endl;
+            }
+            continue;
+        }
+
+        // Full overwrites satisfy later readers, anything else needs the earlier contents
+        for (auto& use : pass.uses){
+            if (overwritesContents(use)){
+                needed[use.resource] = false;
+            }
+        }
+        for (auto& use : pass.uses){
+            if (!overwritesContents(use)){
+                needed[use.resource] = true;
+            }
+        }
+    }
+}
+
+bool VulkanRenderGraph::canMerge(const VulkanGraphGroup& group, const VulkanGraphPassInfo& pass){
+    for (auto& use : pass.uses){
+        const VulkanGraphResourceInfo& resource = resources[use.resource];
+        bool attachment = graphAccessInfos[use.access].attachment;
+        if (attachment && (resource.extent.width != group.extent.width || resource.extent.height != group.extent.height)){
+            return false;
+        }
+
+        // Data may only move between subpasses through attachments; sampling a resource the
+        // render pass touches as an attachment (or the reverse) needs the render pass to end
+        for (auto passIndex : group.passes){
+            for (auto& groupUse : passes[passIndex].uses){
+                if (groupUse.resource == use.resource && graphAccessInfos[groupUse.access].attachment != attachment){
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void VulkanRenderGraph::buildGroups(){
+    groups.clear();
+    for (uint32_t passIndex = 0; passIndex < passes.size(); passIndex++){
+        VulkanGraphPassInfo& pass = passes[passIndex];
+        if (pass.culled){
+            continue;
+        }
+
+        if (groups.empty() || !pass.graphics || !groups.back().graphics || !canMerge(groups.back(), pass)){
+            VulkanGraphGroup group;
+            group.graphics      = pass.graphics;
+            group.extent        = {0, 0};
+            group.renderPass    = VK_NULL_HANDLE;
+
+            // Render area comes from the attachments
+            for (auto& use : pass.uses){
+                if (graphAccessInfos[use.access].attachment){
+                    group.extent = resources[use.resource].extent;
+                    break;
+                }
+            }
+            assert(!group.graphics || group.extent.width > 0);
+            groups.push_back(group);
+        }
+
+        VulkanGraphGroup& group = groups.back();
+        pass.group      = groups.size() - 1;
+        pass.subpass    = group.passes.size();
+        group.passes.push_back(passIndex);
+    }
+
+    // Lifetimes in groups, for load and store ops and for aliasing
+    for (auto& resource : resources){
+        resource.firstGroup = ~0u;
+        resource.lastGroup  = 0;
+    }
+    for (auto& pass : passes){
+        if (pass.culled){
+            continue;
+        }
+        for (auto& use : pass.uses){
+            VulkanGraphResourceInfo& resource = resources[use.resource];
+            resource.firstGroup = (std::min)(resource.firstGroup, pass.group);
+            resource.lastGroup  = (std::max)(resource.lastGroup, pass.group);
+        }
+    }
+
+    // Fold every use in a group into one transition per resource
+    for (uint32_t groupIndex = 0; groupIndex < groups.size(); groupIndex++){
+        VulkanGraphGroup& group = groups[groupIndex];
+        std::map<VulkanGraphResource, uint32_t> useIndices;
+        for (auto passIndex : group.passes){
+            for (auto& use : passes[passIndex].uses){
+                const VulkanGraphResourceInfo& resource = resources[use.resource];
+                VkImageLayout useLayout = getUseLayout(use, resource.format);
+
+                auto existingUse = useIndices.find(use.resource);
+                if (existingUse == useIndices.end()){
+                    VulkanGraphGroupResource groupUse;
+                    groupUse.resource       = use.resource;
+                    groupUse.initialLayout  = useLayout;
+                    groupUse.finalLayout    = useLayout;
+                    groupUse.stages         = 0;
+                    groupUse.access         = 0;
+                    groupUse.write          = false;
+                    groupUse.discard        = overwritesContents(use) || ((!resource.imported || resource.discardStages != 0) && resource.firstGroup == groupIndex);
+                    useIndices[use.resource] = group.resourceUses.size();
+                    group.resourceUses.push_back(groupUse);
+                    existingUse = useIndices.find(use.resource);
+                }
+
+                VulkanGraphGroupResource& groupUse = group.resourceUses[existingUse->second];
+                groupUse.finalLayout    = useLayout;
+                groupUse.stages        |= getUseStages(use);
+                groupUse.access        |= graphAccessInfos[use.access].access;
+                groupUse.write         |= graphAccessInfos[use.access].write;
+            }
+        }
+    }
+}
+
+void VulkanRenderGraph::allocateResources(){
+    std::vector<VulkanGraphResource> aliasedResources;
+    VkDeviceSize unaliasedBytes = 0;
+
+    for (uint32_t resourceIndex = 0; resourceIndex < resources.size(); resourceIndex++){
+        VulkanGraphResourceInfo& resource = resources[resourceIndex];
+        if (resource.imported || resource.firstGroup == ~0u){
+            continue;
+        }
+
+        // Attachments that never leave their render pass don't need backing memory on tilers
+        resource.transientAttachment = resource.firstGroup == resource.lastGroup && groups[resource.firstGroup].graphics;
+        for (auto passIndex : groups[resource.firstGroup].passes){
+            for (auto& use : passes[passIndex].uses){
+                if (use.resource == resourceIndex && !graphAccessInfos[use.access].attachment){
+                    resource.transientAttachment = false;
+                }
+            }
+        }
+
+        VkImageAspectFlags viewAspect = isDepthFormat(resource.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+        VkExtent3D extent = {resource.extent.width, resource.extent.height, 1};
+        if (resource.transientAttachment){
+            resource.image = new VulkanImage(deviceContext, resource.usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, VK_IMAGE_TYPE_2D, resource.format, extent, 0, resource.samples);
+            resource.image->createImageView(VK_IMAGE_VIEW_TYPE_2D, viewAspect);
+            continue;
+        }
+
+        VkImageCreateInfo imageInfo;
+        imageInfo.sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.pNext                 = nullptr;
+        imageInfo.flags                 = 0;
+        imageInfo.imageType             = VK_IMAGE_TYPE_2D;
+        imageInfo.format                = resource.format;
+        imageInfo.extent                = extent;
+        imageInfo.mipLevels             = 1;
+        imageInfo.arrayLayers           = 1;
+        imageInfo.samples               = resource.samples;
+        imageInfo.tiling                = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.usage                 = resource.usage;
+        imageInfo.sharingMode           = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.queueFamilyIndexCount = 0;
+        imageInfo.pQueueFamilyIndices   = nullptr;
+        imageInfo.initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED;
+        assert(deviceContext->vkCreateImage(deviceContext->device, &imageInfo, nullptr, &resource.imageHandle) == VK_SUCCESS);
+        aliasedResources.push_back(resourceIndex);
+    }
+
+    // Largest first, each image goes into the first slot none of whose images are alive at the same time
+    std::vector<VkMemoryRequirements> memoryRequirements(resources.size());
+    for (auto resourceIndex : aliasedResources){
+        deviceContext->vkGetImageMemoryRequirements(deviceContext->device, resources[resourceIndex].imageHandle, &memoryRequirements[resourceIndex]);
+        unaliasedBytes += memoryRequirements[resourceIndex].size;
+    }
+    std::sort(aliasedResources.begin(), aliasedResources.end(), [&](VulkanGraphResource a, VulkanGraphResource b){
+        return memoryRequirements[a].size > memoryRequirements[b].size;
+    });
+
+    for (auto resourceIndex : aliasedResources){
+        VulkanGraphResourceInfo& resource = resources[resourceIndex];
+        const VkMemoryRequirements& requirements = memoryRequirements[resourceIndex];
+
+        uint32_t slotIndex = 0;
+        for (; slotIndex < memorySlots.size(); slotIndex++){
+            VulkanGraphMemorySlot& slot = memorySlots[slotIndex];
+            bool fits = (slot.memoryRequirements.memoryTypeBits & requirements.memoryTypeBits) != 0;
+            for (auto slotResource : slot.resources){
+                if (resources[slotResource].firstGroup <= resource.lastGroup && resource.firstGroup <= resources[slotResource].lastGroup){
+                    fits = false;
+                }
+            }
+            if (fits){
+                break;
+            }
+        }
+
+        if (slotIndex == memorySlots.size()){
+            VulkanGraphMemorySlot slot;
+            slot.memoryRequirements = requirements;
+            slot.allocation         = {};
+            slot.lastStages         = 0;
+            slot.lastAccess         = 0;
+            memorySlots.push_back(slot);
+        }
+
+        VulkanGraphMemorySlot& slot = memorySlots[slotIndex];
+        slot.memoryRequirements.size            = (std::max)(slot.memoryRequirements.size, requirements.size);
+        slot.memoryRequirements.alignment       = (std::max)(slot.memoryRequirements.alignment, requirements.alignment);
+        slot.memoryRequirements.memoryTypeBits &= requirements.memoryTypeBits;
+        slot.resources.push_back(resourceIndex);
+        resource.memorySlot = slotIndex;
+    }
+
+    VkDeviceSize aliasedBytes = 0;
+    for (auto& slot : memorySlots){
+        slot.allocation = deviceContext->allocateMemory(slot.memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VULKAN_ALLOCATION_TYPE_OPTIMAL);
+        if (slot.allocation.block == nullptr){
+            slot.allocation = deviceContext->allocateMemory(slot.memoryRequirements, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, VULKAN_ALLOCATION_TYPE_OPTIMAL, true);
+        }
+        assert(slot.allocation.block != nullptr);
+        aliasedBytes += slot.memoryRequirements.size;
+
+        for (auto resourceIndex : slot.resources){
+            VulkanGraphResourceInfo& resource = resources[resourceIndex];
+            assert(deviceContext->vkBindImageMemory(deviceContext->device, resource.imageHandle, slot.allocation.memory, slot.allocation.offset) == VK_SUCCESS);
+
+            VkImageAspectFlags viewAspect = isDepthFormat(resource.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+            resource.image = new VulkanImage(deviceContext, resource.imageHandle, resource.usage, VK_IMAGE_TYPE_2D, resource.format, {resource.extent.width, resource.extent.height, 1}, 0, resource.samples);
+            resource.image->createImageView(VK_IMAGE_VIEW_TYPE_2D, viewAspect);
+        }
+    }
+
+    if (verbose && !aliasedResources.empty()){
+        std::cout << "Render graph: " << std::dec << aliasedResources.size() << " images aliased into " << memorySlots.size() << " allocations, "
+                  << aliasedBytes << " bytes instead of " << unaliasedBytes << std::endl;
+    }
+}
+
+void VulkanRenderGraph::createRenderPass(VulkanGraphGroup& group, uint32_t groupIndex){
+    if (!group.graphics){
+        return;
+    }
+
+    // Every resource used as an attachment anywhere in the group, in order of first use
+    std::map<VulkanGraphResource, uint32_t> attachmentIndices;
+    for (auto passIndex : group.passes){
+        for (auto& use : passes[passIndex].uses){
+            if (graphAccessInfos[use.access].attachment && attachmentIndices.find(use.resource) == attachmentIndices.end()){
+                attachmentIndices[use.resource] = group.attachments.size();
+                group.attachments.push_back(use.resource);
+            }
+        }
+    }
+
+    std::vector<VkAttachmentDescription> attachmentDescriptions;
+    for (auto resourceIndex : group.attachments){
+        const VulkanGraphResourceInfo& resource = resources[resourceIndex];
+        const VulkanGraphResourceUse * firstUse = nullptr;
+        for (auto passIndex : group.passes){
+            for (auto& use : passes[passIndex].uses){
+                if (use.resource == resourceIndex && firstUse == nullptr){
+                    firstUse = &use;
+                }
+            }
+        }
+        const VulkanGraphGroupResource * groupUse = nullptr;
+        for (auto& resourceUse : group.resourceUses){
+            if (resourceUse.resource == resourceIndex){
+                groupUse = &resourceUse;
+            }
+        }
+        assert(firstUse != nullptr && groupUse != nullptr);
+
+        // Keep contents only if something wrote them before, and only store what is read later
+        VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        if (firstUse->clear){
+            loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        }
+        else if (!groupUse->discard){
+            loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+        }
+        VkAttachmentStoreOp storeOp = (resource.imported || resource.lastGroup > groupIndex) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+        VkAttachmentDescription attachmentDescription;
+        attachmentDescription.flags             = 0;
+        attachmentDescription.format            = resource.format;
+        attachmentDescription.samples           = resource.samples;
+        attachmentDescription.loadOp            = loadOp;
+        attachmentDescription.storeOp           = storeOp;
+        attachmentDescription.stencilLoadOp     = hasStencil(resource.format) ? loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachmentDescription.stencilStoreOp    = hasStencil(resource.format) ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachmentDescription.initialLayout     = groupUse->initialLayout;
+        attachmentDescription.finalLayout       = groupUse->finalLayout;
+        attachmentDescriptions.push_back(attachmentDescription);
+
+        VkClearValue clearValue = {};
+        if (firstUse->clear){
+            clearValue = firstUse->clearValue;
+        }
+        group.clearValues.push_back(clearValue);
+    }
+
+    // References have to outlive vkCreateRenderPass
+    uint32_t subpassCount = group.passes.size();
+    std::vector< std::vector<VkAttachmentReference> > colorReferences(subpassCount);
+    std::vector< std::vector<VkAttachmentReference> > resolveReferences(subpassCount);
+    std::vector< std::vector<VkAttachmentReference> > inputReferences(subpassCount);
+    std::vector< std::vector<uint32_t> > preserveReferences(subpassCount);
+    std::vector<VkAttachmentReference> depthReferences(subpassCount, {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED});
+    std::vector<VkSubpassDescription> subpassDescriptions(subpassCount);
+
+    for (uint32_t subpass = 0; subpass < subpassCount; subpass++){
+        const VulkanGraphPassInfo& pass = passes[group.passes[subpass]];
+        bool hasResolve = false;
+        for (auto& use : pass.uses){
+            VkAttachmentReference reference = {attachmentIndices[use.resource], getUseLayout(use, resources[use.resource].format)};
+            switch(use.access){
+                case VULKAN_GRAPH_ACCESS_COLOR_ATTACHMENT:
+                    colorReferences[subpass].push_back(reference);
+                    break;
+                case VULKAN_GRAPH_ACCESS_DEPTH_ATTACHMENT:
+                    depthReferences[subpass] = reference;
+                    break;
+                case VULKAN_GRAPH_ACCESS_INPUT_ATTACHMENT:
+                    inputReferences[subpass].push_back(reference);
+                    break;
+                default:
+                    break;
+            }
+            hasResolve |= use.access == VULKAN_GRAPH_ACCESS_RESOLVE_ATTACHMENT;
+        }
+
+        // Resolve attachments line up with the colour attachments they resolve
+        if (hasResolve){
+            resolveReferences[subpass].resize(colorReferences[subpass].size(), {VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED});
+            for (auto& use : pass.uses){
+                if (use.access != VULKAN_GRAPH_ACCESS_RESOLVE_ATTACHMENT){
+                    continue;
+                }
+                uint32_t sourceIndex = attachmentIndices.at(use.resolveSource);
+                for (uint32_t colorIndex = 0; colorIndex < colorReferences[subpass].size(); colorIndex++){
+                    if (colorReferences[subpass][colorIndex].attachment == sourceIndex){
+                        resolveReferences[subpass][colorIndex] = {attachmentIndices[use.resource], VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+                    }
+                }
+            }
+        }
+
+        // Attachments used before and after this subpass but not by it must be preserved
+        for (uint32_t attachmentIndex = 0; attachmentIndex < group.attachments.size(); attachmentIndex++){
+            bool usedBefore = false;
+            bool usedHere   = false;
+            bool usedAfter  = false;
+            for (uint32_t otherSubpass = 0; otherSubpass < subpassCount; otherSubpass++){
+                for (auto& use : passes[group.passes[otherSubpass]].uses){
+                    if (use.resource != group.attachments[attachmentIndex]){
+                        continue;
+                    }
+                    usedBefore  |= otherSubpass < subpass;
+                    usedHere    |= otherSubpass == subpass;
+                    usedAfter   |= otherSubpass > subpass;
+                }
+            }
+            if (usedBefore && usedAfter && !usedHere){
+                preserveReferences[subpass].push_back(attachmentIndex);
+            }
+        }
+
+        VkSubpassDescription& subpassDescription = subpassDescriptions[subpass];
+        subpassDescription.flags                    = 0;
+        subpassDescription.pipelineBindPoint        = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpassDescription.inputAttachmentCount     = inputReferences[subpass].size();
+        subpassDescription.pInputAttachments        = inputReferences[subpass].empty() ? nullptr : &inputReferences[subpass][0];
+        subpassDescription.colorAttachmentCount     = colorReferences[subpass].size();
+        subpassDescription.pColorAttachments        = colorReferences[subpass].empty() ? nullptr : &colorReferences[subpass][0];
+        subpassDescription.pResolveAttachments      = resolveReferences[subpass].empty() ? nullptr : &resolveReferences[subpass][0];
+        subpassDescription.pDepthStencilAttachment  = depthReferences[subpass].attachment == VK_ATTACHMENT_UNUSED ? nullptr : &depthReferences[subpass];
+        subpassDescription.preserveAttachmentCount  = preserveReferences[subpass].size();
+        subpassDescription.pPreserveAttachments     = preserveReferences[subpass].empty() ? nullptr : &preserveReferences[subpass][0];
+    }
+
+    // One dependency from the last subpass that touched an attachment to the next one that does, if either writes.
+    // Before the render pass and after it the graph's own barriers take over.
+    std::map< std::pair<uint32_t, uint32_t>, VkSubpassDependency > dependencies;
+    for (uint32_t subpass = 1; subpass < subpassCount; subpass++){
+        for (auto& use : passes[group.passes[subpass]].uses){
+            for (uint32_t srcSubpass = subpass; srcSubpass-- > 0;){
+                const VulkanGraphResourceUse * srcUse = nullptr;
+                for (auto& otherUse : passes[group.passes[srcSubpass]].uses){
+                    if (otherUse.resource == use.resource){
+                        srcUse = &otherUse;
+                    }
+                }
+                if (srcUse == nullptr){
+                    continue;
+                }
+
+                bool srcWrite = graphAccessInfos[srcUse->access].write;
+                if (srcWrite || graphAccessInfos[use.access].write){
+                    auto dependencyKey = std::make_pair(srcSubpass, subpass);
+                    if (dependencies.find(dependencyKey) == dependencies.end()){
+                        VkSubpassDependency dependency;
+                        dependency.srcSubpass       = srcSubpass;
+                        dependency.dstSubpass       = subpass;
+                        dependency.srcStageMask     = 0;
+                        dependency.dstStageMask     = 0;
+                        dependency.srcAccessMask    = 0;
+                        dependency.dstAccessMask    = 0;
+                        dependency.dependencyFlags  = VK_DEPENDENCY_BY_REGION_BIT;
+                        dependencies[dependencyKey] = dependency;
+                    }
+
+                    VkSubpassDependency& dependency = dependencies[dependencyKey];
+                    if (!graphAccessInfos[srcUse->access].attachment || !graphAccessInfos[use.access].attachment){
+                        dependency.dependencyFlags = 0;
+                    }
+                    dependency.srcStageMask    |= getUseStages(*srcUse);
+                    dependency.dstStageMask    |= getUseStages(use);
+                    dependency.srcAccessMask   |= srcWrite ? graphAccessInfos[srcUse->access].access : 0;
+                    dependency.dstAccessMask   |= graphAccessInfos[use.access].access;
+                }
+                break;
+            }
+        }
+    }
+    std::vector<VkSubpassDependency> subpassDependencies;
+    for (auto& dependency : dependencies){
+        subpassDependencies.push_back(dependency.second);
+    }
+
+    VkRenderPassCreateInfo renderPassInfo;
+    renderPassInfo.sType            = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.pNext            = nullptr;
+    renderPassInfo.flags            = 0;
+    renderPassInfo.attachmentCount  = attachmentDescriptions.size();
+    renderPassInfo.pAttachments     = attachmentDescriptions.empty() ? nullptr : &attachmentDescriptions[0];
+    renderPassInfo.subpassCount     = subpassDescriptions.size();
+    renderPassInfo.pSubpasses       = &subpassDescriptions[0];
+    renderPassInfo.dependencyCount  = subpassDependencies.size();
+    renderPassInfo.pDependencies    = subpassDependencies.empty() ? nullptr : &subpassDependencies[0];
+
+    assert(deviceContext->vkCreateRenderPass(deviceContext->device, &renderPassInfo, nullptr, &group.renderPass) == VK_SUCCESS);
+}
+
+void VulkanRenderGraph::execute(VkCommandBuffer commandBuffer){
+    assert(compiled);
+
+    for (uint32_t groupIndex = 0; groupIndex < groups.size(); groupIndex++){
+        VulkanGraphGroup& group = groups[groupIndex];
+
+        // Every transition and hazard of the group in one barrier
+        VulkanBarrierBatcher barrierBatcher(deviceContext, commandBuffer);
+        for (auto& groupUse : group.resourceUses){
+            VulkanGraphResourceInfo& resource = resources[groupUse.resource];
+            VkImageSubresourceRange subresourceRange = resource.image->getSubresourceRange();
+
+            // The first use of an aliased image waits for whatever last used its memory
+            if (!resource.imported && !resource.transientAttachment && groupIndex == resource.firstGroup){
+                VulkanGraphMemorySlot& slot = memorySlots[resource.memorySlot];
+                resource.image->setSubresourceState(subresourceRange, VK_IMAGE_LAYOUT_UNDEFINED, slot.lastStages, slot.lastAccess);
+            }
+
+            // Discarded imports only wait for the stages they were imported with, e.g. the swapchain acquire
+            if (resource.imported && resource.discardStages != 0 && groupIndex == resource.firstGroup){
+                resource.image->setSubresourceState(subresourceRange, VK_IMAGE_LAYOUT_UNDEFINED, resource.discardStages, 0);
+            }
+            barrierBatcher.transition(*resource.image, subresourceRange, groupUse.initialLayout, groupUse.stages, groupUse.access, groupUse.discard);
+        }
+        barrierBatcher.flush();
+
+        if (group.graphics){
+            VkRenderPassBeginInfo renderPassBeginInfo;
+            renderPassBeginInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassBeginInfo.pNext           = nullptr;
+            renderPassBeginInfo.renderPass      = group.renderPass;
+            renderPassBeginInfo.framebuffer     = getFramebuffer(group);
+            renderPassBeginInfo.renderArea      = {{0, 0}, group.extent};
+            renderPassBeginInfo.clearValueCount = group.clearValues.size();
+            renderPassBeginInfo.pClearValues    = group.clearValues.empty() ? nullptr : &group.clearValues[0];
+
+            deviceContext->vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+            for (uint32_t subpass = 0; subpass < group.passes.size(); subpass++){
+                if (subpass > 0){
+                    deviceContext->vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+                }
+                passes[group.passes[subpass]].record(commandBuffer);
+            }
+            deviceContext->vkCmdEndRenderPass(commandBuffer);
+        }
+        else{
+            passes[group.passes[0]].record(commandBuffer);
+        }
+
+        for (auto& groupUse : group.resourceUses){
+            VulkanGraphResourceInfo& resource = resources[groupUse.resource];
+
+            // Subpasses may have moved the image to another layout
+            if (groupUse.finalLayout != groupUse.initialLayout){
+                resource.image->setSubresourceState(resource.image->getSubresourceRange(), groupUse.finalLayout, groupUse.stages, groupUse.access);
+            }
+            if (!resource.imported && !resource.transientAttachment){
+                memorySlots[resource.memorySlot].lastStages = groupUse.stages;
+                memorySlots[resource.memorySlot].lastAccess = groupUse.access;
+            }
+        }
+    }
+
+    // Leave imported images how the caller asked, e.g. ready to present
+    VulkanBarrierBatcher barrierBatcher(deviceContext, commandBuffer);
+    for (auto& resource : resources){
+        if (resource.imported && resource.firstGroup != ~0u && resource.finalLayout != VK_IMAGE_LAYOUT_UNDEFINED){
+            barrierBatcher.transition(*resource.image, resource.finalLayout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+        }
+    }
+    barrierBatcher.flush();
+}
+
+VkFramebuffer VulkanRenderGraph::getFramebuffer(VulkanGraphGroup& group){
+    std::vector<VkImageView> attachmentViews;
+    for (auto resourceIndex : group.attachments){
+        attachmentViews.push_back(resources[resourceIndex].image->imageViewHandle);
+    }
+
+    // Imported images change between executes, so framebuffers are cached by their views
+    auto existingFramebuffer = group.framebuffers.find(attachmentViews);
+    if (existingFramebuffer != group.framebuffers.end()){
+        return existingFramebuffer->second;
+    }
+
+    VkFramebufferCreateInfo framebufferInfo;
+    framebufferInfo.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferInfo.pNext           = nullptr;
+    framebufferInfo.flags           = 0;
+    framebufferInfo.renderPass      = group.renderPass;
+    framebufferInfo.attachmentCount = attachmentViews.size();
+    framebufferInfo.pAttachments    = &attachmentViews[0];
+    framebufferInfo.width           = group.extent.width;
+    framebufferInfo.height          = group.extent.height;
+    framebufferInfo.layers          = 1;
+
+    VkFramebuffer framebuffer;
+    assert(deviceContext->vkCreateFramebuffer(deviceContext->device, &framebufferInfo, nullptr, &framebuffer) == VK_SUCCESS);
+    group.framebuffers[attachmentViews] = framebuffer;
+
+    return framebuffer;
+}
+
+VulkanImage * VulkanRenderGraph::getImage(VulkanGraphResource resource){
+    assert(resource < resources.size());
+    return resources[resource].image;
+}
+
+VkRenderPass VulkanRenderGraph::getRenderPass(VulkanGraphPass pass){
+    assert(compiled && pass < passes.size() && !passes[pass].culled);
+    return groups[passes[pass].group].renderPass;
+}
+
+uint32_t VulkanRenderGraph::getSubpass(VulkanGraphPass pass){
+    assert(compiled && pass < passes.size() && !passes[pass].culled);
+    return passes[pass].subpass;
+}
+
+void VulkanRenderGraph::reset(){
+    destroyCompiled();
+    passes.clear();
+    resources.clear();
+}
+
+void VulkanRenderGraph::destroyCompiled(){
+    // The caller makes sure the device is done with the last execute
+    for (auto& group : groups){
+        for (auto& framebuffer : group.framebuffers){
+            deviceContext->vkDestroyFramebuffer(deviceContext->device, framebuffer.second, nullptr);
+        }
+        if (group.renderPass != VK_NULL_HANDLE){
+            deviceContext->vkDestroyRenderPass(deviceContext->device, group.renderPass, nullptr);
+        }
+    }
+    groups.clear();
+
+    for (auto& resource : resources){
+        if (resource.imported){
+            continue;
+        }
+        delete resource.image;
+        resource.image = nullptr;
+        if (resource.imageHandle != VK_NULL_HANDLE){
+            deviceContext->vkDestroyImage(deviceContext->device, resource.imageHandle, nullptr);
+            resource.imageHandle = VK_NULL_HANDLE;
+        }
+    }
+
+    for (auto& slot : memorySlots){
+        deviceContext->freeMemory(slot.allocation);
+    }
+    memorySlots.clear();
+    compiled = false;
+}
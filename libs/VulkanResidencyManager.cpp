@@ -0,0 +1,179 @@
+#include <cassert>
+#include "VulkanResidencyManager.h"
+
+VulkanResidencyManager::VulkanResidencyManager(VulkanDevice * __deviceContext){
+    deviceContext   = __deviceContext;
+    assert(deviceContext != nullptr && deviceContext->memoryAllocator != nullptr);
+    nextResourceId  = 1;
+    currentFrame    = 0;
+    framesInFlight  = 1;
+    budgetLimit     = 0;
+
+    for (uint32_t heapIndex = 0; heapIndex < VK_MAX_MEMORY_HEAPS; heapIndex++){
+        heapBudgets[heapIndex]      = 0;
+        heapUsages[heapIndex]       = 0;
+        heapBlockBytes[heapIndex]   = 0;
+    }
+    updateBudgets();
+}
+
+void VulkanResidencyManager::beginFrame(uint64_t frameNumber, uint32_t __framesInFlight){
+    {
+        std::lock_guard<std::mutex> lock(residencyMutex);
+        currentFrame    = frameNumber;
+        framesInFlight  = __framesInFlight;
+    }
+
+    // Budgets move as other processes allocate, so refresh them once a frame
+    updateBudgets();
+}
+
+bool VulkanResidencyManager::evict(uint32_t heapIndex, VkDeviceSize size){
+    assert(heapIndex < deviceContext->deviceMemoryProperties.memoryHeapCount);
+    std::vector<VulkanEvictionCallback> evictionCallbacks;
+    {
+        std::lock_guard<std::mutex> lock(residencyMutex);
+        VulkanHeapBudget heapBudget = getHeapBudgetLocked(heapIndex);
+        VkDeviceSize evictedBytes   = 0;
+
+        ResidentList& resources = residentResources[heapIndex];
+        while (!resources.empty() && heapBudget.usage + size > heapBudget.budget + evictedBytes){
+            // Resources a frame in flight may still read stay put; the list is in order of use, so stop here
+            VulkanResidentResource& resource = resources.front();
+            if (resource.lastUsedFrame + framesInFlight > currentFrame){
+                break;
+            }
+
+            evictedBytes += resource.size;
+            evictionCallbacks.push_back(resource.evict);
+            resourceLookup.erase(resource.id);
+            resources.pop_front();
+        }
+    }
+
+    // Callbacks free memory, so they run without the lock held
+    if (!evictionCallbacks.empty()){
+        std::cout << "Evicting " << std::dec << evictionCallbacks.size() << " resources from memory heap " << heapIndex << std::endl;
+    }
+    for (auto& evictionCallback : evictionCallbacks){
+        evictionCallback();
+    }
+
+    return hasBudget(heapIndex, size);
+}
+
+VulkanHeapBudget VulkanResidencyManager::getHeapBudget(uint32_t heapIndex){
+    assert(heapIndex < deviceContext->deviceMemoryProperties.memoryHeapCount);
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    return getHeapBudgetLocked(heapIndex);
+}
+
+VulkanHeapBudget VulkanResidencyManager::getHeapBudgetLocked(uint32_t heapIndex){
+    // Usage from the last update, adjusted by what we allocated or freed since
+    VulkanMemoryHeapStats heapStats = deviceContext->memoryAllocator->getHeapStats(heapIndex);
+    VkDeviceSize usage = heapUsages[heapIndex] + heapStats.blockBytes;
+
+    VulkanHeapBudget heapBudget;
+    heapBudget.budget   = heapBudgets[heapIndex];
+    heapBudget.usage    = usage > heapBlockBytes[heapIndex] ? usage - heapBlockBytes[heapIndex] : 0;
+
+    return heapBudget;
+}
+
+bool VulkanResidencyManager::hasBudget(uint32_t heapIndex, VkDeviceSize size){
+    // Allocations that fit in an existing block don't take any more memory from the heap
+    VulkanMemoryHeapStats heapStats = deviceContext->memoryAllocator->getHeapStats(heapIndex);
+    if (heapStats.largestFreeRange >= size){
+        return true;
+    }
+
+    VulkanHeapBudget heapBudget = getHeapBudget(heapIndex);
+    return heapBudget.usage + size <= heapBudget.budget;
+}
+
+void VulkanResidencyManager::printBudgets(){
+    std::cout << "Memory Budgets" << (deviceContext->memoryBudgetSupport ? ": " : " (estimated): ") << std::endl;
+    for (uint32_t heapIndex = 0; heapIndex < deviceContext->deviceMemoryProperties.memoryHeapCount; heapIndex++){
+        VulkanHeapBudget heapBudget = getHeapBudget(heapIndex);
+        std::cout << "   Memory Heap " << std::dec << heapIndex << ": " << heapBudget.usage << " / " << heapBudget.budget << " bytes" << std::endl;
+    }
+}
+
+uint64_t VulkanResidencyManager::registerResource(const VulkanMemoryAllocation& allocation, const VulkanEvictionCallback& evictionCallback){
+    assert(allocation.block != nullptr);
+    std::lock_guard<std::mutex> lock(residencyMutex);
+
+    VulkanResidentResource resource;
+    resource.id             = nextResourceId++;
+    resource.heapIndex      = deviceContext->deviceMemoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex;
+    resource.size           = allocation.size;
+    resource.lastUsedFrame  = currentFrame;
+    resource.evict          = evictionCallback;
+
+    ResidentList& resources = residentResources[resource.heapIndex];
+    resources.push_back(resource);
+    resourceLookup[resource.id] = std::prev(resources.end());
+
+    return resource.id;
+}
+
+void VulkanResidencyManager::touch(uint64_t resourceId){
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    auto resource = resourceLookup.find(resourceId);
+    if (resource == resourceLookup.end()){
+        return;
+    }
+
+    // Most recently used resources live at the back
+    ResidentList& resources = residentResources[resource->second->heapIndex];
+    resources.splice(resources.end(), resources, resource->second);
+    resource->second->lastUsedFrame = currentFrame;
+}
+
+void VulkanResidencyManager::unregisterResource(uint64_t resourceId){
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    auto resource = resourceLookup.find(resourceId);
+    if (resource == resourceLookup.end()){
+        return;
+    }
+
+    residentResources[resource->second->heapIndex].erase(resource->second);
+    resourceLookup.erase(resource);
+}
+
+void VulkanResidencyManager::updateBudgets(){
+    std::lock_guard<std::mutex> lock(residencyMutex);
+    const VkPhysicalDeviceMemoryProperties& memoryProperties = deviceContext->deviceMemoryProperties;
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties;
+    if (deviceContext->memoryBudgetSupport){
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        budgetProperties.pNext = nullptr;
+
+        VkPhysicalDeviceMemoryProperties2KHR memoryProperties2;
+        memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+        memoryProperties2.pNext = &budgetProperties;
+        deviceContext->instance->vkGetPhysicalDeviceMemoryProperties2KHR(deviceContext->getPhysicalDevice(), &memoryProperties2);
+    }
+
+    for (uint32_t heapIndex = 0; heapIndex < memoryProperties.memoryHeapCount; heapIndex++){
+        VkDeviceSize heapSize   = memoryProperties.memoryHeaps[heapIndex].size;
+        VkDeviceSize blockBytes = deviceContext->memoryAllocator->getHeapStats(heapIndex).blockBytes;
+        heapBlockBytes[heapIndex] = blockBytes;
+
+        // Fall back to three quarters of the heap, leaving room for other processes and the driver
+        heapBudgets[heapIndex]  = (heapSize / 4) * 3;
+        heapUsages[heapIndex]   = blockBytes;
+        if (deviceContext->memoryBudgetSupport){
+            heapUsages[heapIndex] = budgetProperties.heapUsage[heapIndex];
+
+            // Some drivers report no budget at all for heaps they don't track
+            if (budgetProperties.heapBudget[heapIndex] > 0){
+                heapBudgets[heapIndex] = (std::min)(budgetProperties.heapBudget[heapIndex], heapSize);
+            }
+        }
+        if (budgetLimit > 0){
+            heapBudgets[heapIndex] = (std::min)(heapBudgets[heapIndex], budgetLimit);
+        }
+    }
+}
@@ -0,0 +1,562 @@
+#include <cassert>
+#include "VulkanStagingRing.h"
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment){
+    return alignment > 1 ? ((value + alignment - 1) / alignment) * alignment : value;
+}
+
+VulkanStagingRing::VulkanStagingRing(VulkanDevice * __deviceContext, VkDeviceSize __capacity, uint32_t __batchCount){
+    deviceContext   = __deviceContext;
+    capacity        = __capacity;
+    currentBatch    = 0;
+    recording       = false;
+    head            = 0;
+    tail            = 0;
+    nextToken       = 1;
+    completedToken  = 0;
+    assert(deviceContext != nullptr);
+    assert(__batchCount > 0);
+
+    // Prefer a transfer-only family, then an async compute family, so that uploads overlap rendering
+    graphicsQueueFamilyIndex = deviceContext->getUsableDeviceQueueFamily(VK_QUEUE_GRAPHICS_BIT);
+    queueFamilyIndex = deviceContext->getUsableDeviceQueueFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+    if (queueFamilyIndex == (std::numeric_limits<uint32_t>::max)()){
+        queueFamilyIndex = deviceContext->getUsableDeviceQueueFamily(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT);
+    }
+    if (queueFamilyIndex == (std::numeric_limits<uint32_t>::max)()){
+        // Graphics queues support transfers whether or not they report it
+        queueFamilyIndex = graphicsQueueFamilyIndex != (std::numeric_limits<uint32_t>::max)() ? graphicsQueueFamilyIndex : deviceContext->getUsableDeviceQueueFamily(VK_QUEUE_TRANSFER_BIT);
+    }
+    assert(queueFamilyIndex != (std::numeric_limits<uint32_t>::max)());
+    deviceContext->vkGetDeviceQueue(deviceContext->device, queueFamilyIndex, 0, &queue);
+
+    ownershipTransfer = graphicsQueueFamilyIndex != (std::numeric_limits<uint32_t>::max)() && queueFamilyIndex != graphicsQueueFamilyIndex;
+    std::cout << "Uploads use queue family " << queueFamilyIndex << (ownershipTransfer ? " (dedicated)" : "") << std::endl;
+    graphicsQueue = VK_NULL_HANDLE;
+    if (ownershipTransfer){
+        deviceContext->vkGetDeviceQueue(deviceContext->device, graphicsQueueFamilyIndex, 0, &graphicsQueue);
+    }
+
+    // Ring Buffer
+    VkBufferCreateInfo bufferInfo;
+    bufferInfo.sType                    = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.pNext                    = nullptr;
+    bufferInfo.flags                    = 0;
+    bufferInfo.size                     = capacity;
+    bufferInfo.usage                    = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode              = VK_SHARING_MODE_EXCLUSIVE;
+    bufferInfo.queueFamilyIndexCount    = 0; // Not sharing
+    bufferInfo.pQueueFamilyIndices      = nullptr;
+    assert(deviceContext->vkCreateBuffer(deviceContext->device, &bufferInfo, nullptr, &ringBuffer) == VK_SUCCESS);
+    ringAllocation = deviceContext->allocateAndBindBufferMemory(ringBuffer, true);
+    assert(ringAllocation.mappedData != nullptr);
+
+    // One command buffer and fence per batch in flight
+    commandPool = deviceContext->getCommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, queueFamilyIndex);
+    VkCommandBuffer * commandBuffers = commandPool->getCommandBuffers(VK_COMMAND_BUFFER_LEVEL_PRIMARY, __batchCount);
+
+    // Graphics side of image handoffs, one command buffer and semaphore per batch
+    handoffCommandPool = nullptr;
+    VkCommandBuffer * handoffCommandBuffers = nullptr;
+    if (ownershipTransfer){
+        handoffCommandPool      = deviceContext->getCommandPool(VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, graphicsQueueFamilyIndex);
+        handoffCommandBuffers   = handoffCommandPool->getCommandBuffers(VK_COMMAND_BUFFER_LEVEL_PRIMARY, __batchCount);
+    }
+
+    VkFenceCreateInfo fenceInfo;
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fenceInfo.pNext = nullptr;
+    fenceInfo.flags = 0; // Unsignaled state
+
+    VkSemaphoreCreateInfo semaphoreInfo;
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = nullptr;
+    semaphoreInfo.flags = 0;
+
+    batches.resize(__batchCount);
+    for (uint32_t batchIndex = 0; batchIndex < __batchCount; batchIndex++){
+        Batch& batch        = batches[batchIndex];
+        batch.commandBuffer = commandBuffers[batchIndex];
+        batch.ringStart     = 0;
+        batch.ringEnd       = 0;
+        batch.submitted     = false;
+        batch.token         = 0;
+        assert(deviceContext->vkCreateFence(deviceContext->device, &fenceInfo, nullptr, &batch.fence) == VK_SUCCESS);
+
+        batch.handoffCommandBuffer  = VK_NULL_HANDLE;
+        batch.handoffSemaphore      = VK_NULL_HANDLE;
+        if (ownershipTransfer){
+            batch.handoffCommandBuffer = handoffCommandBuffers[batchIndex];
+            assert(deviceContext->vkCreateSemaphore(deviceContext->device, &semaphoreInfo, nullptr, &batch.handoffSemaphore) == VK_SUCCESS);
+        }
+    }
+    delete [] commandBuffers;
+    delete [] handoffCommandBuffers;
+}
+
+VulkanStagingRing::~VulkanStagingRing(){
+    finish();
+
+    for (auto& batch : batches){
+        deviceContext->vkDestroyFence(deviceContext->device, batch.fence, nullptr);
+        if (batch.handoffSemaphore != VK_NULL_HANDLE){
+            deviceContext->vkDestroySemaphore(deviceContext->device, batch.handoffSemaphore, nullptr);
+        }
+    }
+    delete commandPool;
+    delete handoffCommandPool;
+
+    deviceContext->vkDestroyBuffer(deviceContext->device, ringBuffer, nullptr);
+    deviceContext->freeMemory(ringAllocation);
+}
+
+void VulkanStagingRing::beginBatch(){
+    Batch& batch = batches[currentBatch];
+
+    // Slot still in flight from a previous trip around the ring
+    if (batch.submitted){
+        retire(batch);
+    }
+
+    VkCommandBufferBeginInfo cbBeginInfo;
+    cbBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    cbBeginInfo.pNext = nullptr;
+    cbBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    cbBeginInfo.pInheritanceInfo = nullptr; // Not a secondary command buffer
+    assert(deviceContext->vkBeginCommandBuffer(batch.commandBuffer, &cbBeginInfo) == VK_SUCCESS);
+
+    batch.ringStart = head;
+    batch.token     = nextToken++;
+    recording       = true;
+}
+
+void VulkanStagingRing::retire(Batch& batch){
+    assert(batch.submitted);
+    assert(deviceContext->vkWaitForFences(deviceContext->device, 1, &batch.fence, VK_TRUE, (std::numeric_limits<uint64_t>::max)()) == VK_SUCCESS);
+    assert(deviceContext->vkResetFences(deviceContext->device, 1, &batch.fence) == VK_SUCCESS);
+
+    // Everything staged up to the end of this batch can be overwritten
+    tail = (std::max)(tail, batch.ringEnd);
+
+    for (auto& temporaryBuffer : batch.temporaryBuffers){
+        deviceContext->vkDestroyBuffer(deviceContext->device, temporaryBuffer.first, nullptr);
+        deviceContext->freeMemory(temporaryBuffer.second);
+    }
+    batch.temporaryBuffers.clear();
+
+    // Released resources are now ready to be acquired by the graphics family
+    for (auto bufferBarrier : batch.bufferReleases){
+        bufferBarrier.srcAccessMask = 0;
+        bufferBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        bufferAcquires.push_back(bufferBarrier);
+    }
+    for (auto imageBarrier : batch.imageReleases){
+        imageBarrier.srcAccessMask = 0;
+        imageBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        imageAcquires.push_back(imageBarrier);
+    }
+    batch.bufferReleases.clear();
+    batch.imageReleases.clear();
+    graphicsCallbacks.insert(graphicsCallbacks.end(), batch.graphicsCallbacks.begin(), batch.graphicsCallbacks.end());
+    batch.graphicsCallbacks.clear();
+
+    completedToken  = (std::max)(completedToken, batch.token);
+    batch.submitted = false;
+}
+
+bool VulkanStagingRing::retireOldest(){
+    // Batches are submitted in slot order, so the oldest one follows the current slot
+    for (uint32_t i = 0; i < batches.size(); i++){
+        uint32_t batchIndex = (currentBatch + i) % batches.size();
+        if (recording && batchIndex == currentBatch){
+            continue;
+        }
+        if (batches[batchIndex].submitted){
+            retire(batches[batchIndex]);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void VulkanStagingRing::retireCompleted(){
+    // Retire in submission order, stopping at the first batch still executing
+    for (uint32_t i = 0; i < batches.size(); i++){
+        uint32_t batchIndex = (currentBatch + i) % batches.size();
+        if (recording && batchIndex == currentBatch){
+            continue;
+        }
+        if (batches[batchIndex].submitted){
+            if (deviceContext->vkGetFenceStatus(deviceContext->device, batches[batchIndex].fence) != VK_SUCCESS){
+                return;
+            }
+            retire(batches[batchIndex]);
+        }
+    }
+}
+
+VkDeviceSize VulkanStagingRing::reserve(VkDeviceSize dataSize, VkDeviceSize alignment){
+    while (true){
+        VkDeviceSize offset = alignUp(head, alignment);
+
+        // Don't straddle the end of the ring
+        if ((offset % capacity) + dataSize > capacity){
+            offset = alignUp(offset, capacity);
+        }
+
+        if (offset + dataSize - tail <= capacity){
+            return offset;
+        }
+
+        // Ring is full, so wait for the oldest batch; if the open batch holds the space, send it first
+        if (!retireOldest()){
+            if (recording){
+                submit();
+            }else{
+                // Nothing in flight, but the region would straddle the end, so restart at the beginning
+                assert(head == tail);
+                head = tail = alignUp(head, capacity);
+            }
+        }
+    }
+}
+
+VkCommandBuffer VulkanStagingRing::getCommandBuffer(){
+    if (!recording){
+        beginBatch();
+    }
+
+    return batches[currentBatch].commandBuffer;
+}
+
+VulkanStagingRegion VulkanStagingRing::stage(const void * data, VkDeviceSize dataSize, VkDeviceSize alignment){
+    VulkanStagingRegion region;
+
+    if (dataSize + alignment > capacity){
+        // Too big for the ring, so stage through a temporary buffer that lives as long as the batch
+        if (!recording){
+            beginBatch();
+        }
+
+        VkBufferCreateInfo bufferInfo;
+        bufferInfo.sType                    = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.pNext                    = nullptr;
+        bufferInfo.flags                    = 0;
+        bufferInfo.size                     = dataSize;
+        bufferInfo.usage                    = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode              = VK_SHARING_MODE_EXCLUSIVE;
+        bufferInfo.queueFamilyIndexCount    = 0; // Not sharing
+        bufferInfo.pQueueFamilyIndices      = nullptr;
+
+        VkBuffer temporaryBuffer;
+        assert(deviceContext->vkCreateBuffer(deviceContext->device, &bufferInfo, nullptr, &temporaryBuffer) == VK_SUCCESS);
+        VulkanMemoryAllocation temporaryAllocation = deviceContext->allocateAndBindBufferMemory(temporaryBuffer, true);
+        assert(temporaryAllocation.mappedData != nullptr);
+
+        memcpy(temporaryAllocation.mappedData, data, dataSize);
+        deviceContext->flushMappedRange(temporaryAllocation, 0, dataSize);
+        batches[currentBatch].temporaryBuffers.push_back(std::make_pair(temporaryBuffer, temporaryAllocation));
+
+        region.buffer       = temporaryBuffer;
+        region.offset       = 0;
+        region.mappedData   = temporaryAllocation.mappedData;
+        return region;
+    }
+
+    // Reserve before opening the batch, so that the region belongs to the batch that records its copy
+    VkDeviceSize offset = reserve(dataSize, alignment);
+    if (!recording){
+        beginBatch();
+    }
+    head = offset + dataSize;
+
+    region.buffer       = ringBuffer;
+    region.offset       = offset % capacity;
+    region.mappedData   = static_cast<char *>(ringAllocation.mappedData) + region.offset;
+    memcpy(region.mappedData, data, dataSize);
+
+    return region;
+}
+
+void VulkanStagingRing::releaseBuffer(VkBuffer buffer){
+    if (!ownershipTransfer){
+        return;
+    }
+
+    // Released once per batch, after all of its copies
+    Batch& batch = batches[currentBatch];
+    for (auto& bufferBarrier : batch.bufferReleases){
+        if (bufferBarrier.buffer == buffer){
+            return;
+        }
+    }
+
+    VkBufferMemoryBarrier bufferBarrier;
+    bufferBarrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    bufferBarrier.pNext                 = nullptr;
+    bufferBarrier.srcAccessMask         = VK_ACCESS_TRANSFER_WRITE_BIT;
+    bufferBarrier.dstAccessMask         = 0; // Ignored on release
+    bufferBarrier.srcQueueFamilyIndex   = queueFamilyIndex;
+    bufferBarrier.dstQueueFamilyIndex   = graphicsQueueFamilyIndex;
+    bufferBarrier.buffer                = buffer;
+    bufferBarrier.offset                = 0;
+    bufferBarrier.size                  = VK_WHOLE_SIZE;
+    batch.bufferReleases.push_back(bufferBarrier);
+}
+
+VulkanUploadToken VulkanStagingRing::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, const VkBufferCopy& bufferCopy){
+    deviceContext->vkCmdCopyBuffer(getCommandBuffer(), srcBuffer, dstBuffer, 1, &bufferCopy);
+    releaseBuffer(dstBuffer);
+
+    return batches[currentBatch].token;
+}
+
+VulkanUploadToken VulkanStagingRing::copyToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void * data, VkDeviceSize dataSize){
+    VulkanStagingRegion region = stage(data, dataSize);
+
+    VkBufferCopy bufferToBufferCopy;
+    bufferToBufferCopy.srcOffset    = region.offset;
+    bufferToBufferCopy.dstOffset    = dstOffset;
+    bufferToBufferCopy.size         = dataSize;
+
+    return copyBuffer(region.buffer, dstBuffer, bufferToBufferCopy);
+}
+
+VulkanUploadToken VulkanStagingRing::copyToImage(VkImage dstImage, VkImageLayout dstLayout, const void * data, VkDeviceSize dataSize, VkBufferImageCopy imageCopy, VkDeviceSize alignment){
+    imageCopy.bufferOffset = 0;
+    return copyToImage(dstImage, dstLayout, data, dataSize, std::vector<VkBufferImageCopy>(1, imageCopy), alignment);
+}
+
+VulkanUploadToken VulkanStagingRing::copyToImage(VkImage dstImage, VkImageLayout dstLayout, const void * data, VkDeviceSize dataSize, std::vector<VkBufferImageCopy> imageCopies, VkDeviceSize alignment){
+    assert(!imageCopies.empty());
+    VulkanStagingRegion region = stage(data, dataSize, alignment);
+
+    // Region offsets are relative to data; every region goes out in one copy
+    for (auto& imageCopy : imageCopies){
+        assert(imageCopy.bufferOffset < dataSize && imageCopy.bufferOffset % alignment == 0);
+        imageCopy.bufferOffset += region.offset;
+    }
+    deviceContext->vkCmdCopyBufferToImage(getCommandBuffer(), region.buffer, dstImage, dstLayout, imageCopies.size(), &imageCopies[0]);
+
+    return batches[currentBatch].token;
+}
+
+void VulkanStagingRing::acquireImage(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout){
+    // Without a dedicated family the batch's own barriers cover this
+    assert(ownershipTransfer);
+    VkCommandBuffer commandBuffer = getCommandBuffer();
+
+    // The graphics family has to own the image already, so an earlier upload of it must have been acquired
+    for (const auto& batch : batches){
+        for (const auto& imageRelease : batch.imageReleases){
+            assert(imageRelease.image != image);
+        }
+    }
+    for (const auto& imageAcquire : imageAcquires){
+        assert(imageAcquire.image != image);
+    }
+
+    VkImageMemoryBarrier imageBarrier;
+    imageBarrier.sType                  = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.pNext                  = nullptr;
+    imageBarrier.srcAccessMask          = VK_ACCESS_MEMORY_WRITE_BIT;
+    imageBarrier.dstAccessMask          = 0; // Ignored on release
+    imageBarrier.oldLayout              = oldLayout;
+    imageBarrier.newLayout              = newLayout;
+    imageBarrier.srcQueueFamilyIndex    = graphicsQueueFamilyIndex;
+    imageBarrier.dstQueueFamilyIndex    = queueFamilyIndex;
+    imageBarrier.image                  = image;
+    imageBarrier.subresourceRange       = subresourceRange;
+
+    // Released on the graphics queue when the batch is submitted
+    batches[currentBatch].imageHandoffs.push_back(imageBarrier);
+
+    // Acquired ahead of the copies that follow; the batch waits on the release at the transfer stage
+    imageBarrier.srcAccessMask          = 0; // Ignored on acquire
+    imageBarrier.dstAccessMask          = VK_ACCESS_TRANSFER_WRITE_BIT;
+    deviceContext->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+}
+
+bool VulkanStagingRing::canRecordGraphics(){
+    // Either the upload queue is the graphics queue, or graphics work waits for acquireUploads
+    return graphicsQueueFamilyIndex != (std::numeric_limits<uint32_t>::max)();
+}
+
+void VulkanStagingRing::recordAfterUpload(const VulkanUploadCallback& callback){
+    assert(canRecordGraphics());
+    VkCommandBuffer commandBuffer = getCommandBuffer();
+
+    if (!ownershipTransfer){
+        // Same queue, so it can follow the copies in the batch itself
+        callback(commandBuffer);
+        return;
+    }
+
+    // Recorded on the graphics queue once the batch has finished and been acquired
+    batches[currentBatch].graphicsCallbacks.push_back(callback);
+}
+
+void VulkanStagingRing::releaseImage(VkImage image, const VkImageSubresourceRange& subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout){
+    VkImageMemoryBarrier imageBarrier;
+    imageBarrier.sType                  = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    imageBarrier.pNext                  = nullptr;
+    imageBarrier.srcAccessMask          = VK_ACCESS_TRANSFER_WRITE_BIT;
+    imageBarrier.dstAccessMask          = VK_ACCESS_MEMORY_READ_BIT;
+    imageBarrier.oldLayout              = oldLayout;
+    imageBarrier.newLayout              = newLayout;
+    imageBarrier.srcQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.dstQueueFamilyIndex    = VK_QUEUE_FAMILY_IGNORED;
+    imageBarrier.image                  = image;
+    imageBarrier.subresourceRange       = subresourceRange;
+
+    if (!ownershipTransfer){
+        // Same family, so only the layout needs to change
+        if (oldLayout != newLayout){
+            deviceContext->vkCmdPipelineBarrier(getCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier);
+        }
+        return;
+    }
+
+    // Release with the rest of the batch; the layout change happens as part of the transfer
+    getCommandBuffer();
+    imageBarrier.dstAccessMask          = 0; // Ignored on release
+    imageBarrier.srcQueueFamilyIndex    = queueFamilyIndex;
+    imageBarrier.dstQueueFamilyIndex    = graphicsQueueFamilyIndex;
+    batches[currentBatch].imageReleases.push_back(imageBarrier);
+}
+
+VulkanUploadToken VulkanStagingRing::submit(){
+    if (!recording){
+        return nextToken - 1;
+    }
+    Batch& batch = batches[currentBatch];
+
+    if (ownershipTransfer){
+        // Hand the uploaded resources to the graphics family
+        if (!batch.bufferReleases.empty() || !batch.imageReleases.empty()){
+            deviceContext->vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                                                batch.bufferReleases.size(), batch.bufferReleases.empty() ? nullptr : &batch.bufferReleases[0],
+                                                batch.imageReleases.size(), batch.imageReleases.empty() ? nullptr : &batch.imageReleases[0]);
+        }
+    }else{
+        // Make transfer writes visible to whatever is submitted to the queue afterwards
+        VkMemoryBarrier uploadBarrier;
+        uploadBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        uploadBarrier.pNext         = nullptr;
+        uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        uploadBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        deviceContext->vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &uploadBarrier, 0, nullptr, 0, nullptr);
+    }
+    assert(deviceContext->vkEndCommandBuffer(batch.commandBuffer) == VK_SUCCESS);
+
+    // Images the graphics family owned are released on its queue first, after the work already submitted there
+    bool handoff = !batch.imageHandoffs.empty();
+    if (handoff){
+        VkCommandBufferBeginInfo handoffBeginInfo;
+        handoffBeginInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        handoffBeginInfo.pNext              = nullptr;
+        handoffBeginInfo.flags              = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        handoffBeginInfo.pInheritanceInfo   = nullptr; // Not a secondary command buffer
+        assert(deviceContext->vkBeginCommandBuffer(batch.handoffCommandBuffer, &handoffBeginInfo) == VK_SUCCESS);
+        deviceContext->vkCmdPipelineBarrier(batch.handoffCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr,
+                                            batch.imageHandoffs.size(), &batch.imageHandoffs[0]);
+        assert(deviceContext->vkEndCommandBuffer(batch.handoffCommandBuffer) == VK_SUCCESS);
+
+        VkSubmitInfo handoffSubmitInfo;
+        handoffSubmitInfo.sType                 = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        handoffSubmitInfo.pNext                 = nullptr;
+        handoffSubmitInfo.waitSemaphoreCount    = 0;
+        handoffSubmitInfo.pWaitSemaphores       = nullptr;
+        handoffSubmitInfo.pWaitDstStageMask     = nullptr;
+        handoffSubmitInfo.commandBufferCount    = 1;
+        handoffSubmitInfo.pCommandBuffers       = &batch.handoffCommandBuffer;
+        handoffSubmitInfo.signalSemaphoreCount  = 1;
+        handoffSubmitInfo.pSignalSemaphores     = &batch.handoffSemaphore;
+        assert(deviceContext->vkQueueSubmit(graphicsQueue, 1, &handoffSubmitInfo, VK_NULL_HANDLE) == VK_SUCCESS);
+        batch.imageHandoffs.clear();
+    }
+
+    // Flush host writes made during this batch, split where the ring wraps
+    VkDeviceSize batchSize = head - batch.ringStart;
+    if (batchSize >= capacity){
+        deviceContext->flushMappedRange(ringAllocation, 0, capacity);
+    }else if (batchSize > 0){
+        VkDeviceSize rangeStart = batch.ringStart % capacity;
+        VkDeviceSize rangeEnd   = rangeStart + batchSize;
+        if (rangeEnd <= capacity){
+            deviceContext->flushMappedRange(ringAllocation, rangeStart, batchSize);
+        }else{
+            deviceContext->flushMappedRange(ringAllocation, rangeStart, capacity - rangeStart);
+            deviceContext->flushMappedRange(ringAllocation, 0, rangeEnd - capacity);
+        }
+    }
+
+    // Dispatch
+    VkSubmitInfo copySubmitInfo;
+    copySubmitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    copySubmitInfo.pNext                = nullptr;
+    VkPipelineStageFlags handoffWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    copySubmitInfo.waitSemaphoreCount   = handoff ? 1 : 0;
+    copySubmitInfo.pWaitSemaphores      = handoff ? &batch.handoffSemaphore : nullptr;
+    copySubmitInfo.pWaitDstStageMask    = handoff ? &handoffWaitStage : nullptr;
+    copySubmitInfo.commandBufferCount   = 1;
+    copySubmitInfo.pCommandBuffers      = &batch.commandBuffer;
+    copySubmitInfo.signalSemaphoreCount = 0; // No signal semaphores
+    copySubmitInfo.pSignalSemaphores    = nullptr; // No signal semaphores
+    assert(deviceContext->vkQueueSubmit(queue, 1, &copySubmitInfo, batch.fence) == VK_SUCCESS);
+
+    batch.ringEnd   = head;
+    batch.submitted = true;
+    recording       = false;
+    currentBatch    = (currentBatch + 1) % batches.size();
+
+    return batch.token;
+}
+
+bool VulkanStagingRing::isComplete(VulkanUploadToken token){
+    if (token > completedToken){
+        retireCompleted();
+    }
+
+    return token <= completedToken;
+}
+
+void VulkanStagingRing::wait(VulkanUploadToken token){
+    // Still recording, so send it off first
+    if (recording && token >= batches[currentBatch].token){
+        submit();
+    }
+
+    while (completedToken < token && retireOldest()){
+    }
+}
+
+void VulkanStagingRing::acquireUploads(VkCommandBuffer commandBuffer){
+    if (!ownershipTransfer){
+        return;
+    }
+    retireCompleted();
+
+    // Matches the releases recorded on the transfer queue; their batches have already finished
+    if (!bufferAcquires.empty() || !imageAcquires.empty()){
+        deviceContext->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr,
+                                            bufferAcquires.size(), bufferAcquires.empty() ? nullptr : &bufferAcquires[0],
+                                            imageAcquires.size(), imageAcquires.empty() ? nullptr : &imageAcquires[0]);
+    }
+    bufferAcquires.clear();
+    imageAcquires.clear();
+
+    // Graphics work queued behind the uploads, now that it owns them
+    std::vector<VulkanUploadCallback> pendingCallbacks;
+    pendingCallbacks.swap(graphicsCallbacks);
+    for (auto& callback : pendingCallbacks){
+        callback(commandBuffer);
+    }
+}
+
+void VulkanStagingRing::finish(){
+    submit();
+    while (retireOldest()){
+    }
+}
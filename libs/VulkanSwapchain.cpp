@@ -10,8 +10,8 @@ VulkanSwapchain::VulkanSwapchain(VulkanDriverInstance * __instance, VulkanDevice
 
     assert(deviceContext != nullptr);
     pipelineState = nullptr;
-
-    createSemaphores();
+    swapchainDepthImage = nullptr;
+    swapchainMultisampleImage = nullptr;
     dirtyFramebuffers = true;
     surfaceFormatIndex = 0;
     presentModeIndex = 0;
@@ -46,19 +46,15 @@ void VulkanSwapchain::cleanupSwapchain(){
     // Destroy images
     swapchainImages.clear();
 
-    for (auto depthImage : swapchainDepthImages){
-        if (depthImage != nullptr){
-            delete depthImage;
-        }
+    if (swapchainDepthImage != nullptr){
+        delete swapchainDepthImage;
+        swapchainDepthImage = nullptr;
     }
-    swapchainDepthImages.clear();
 
-    for (auto multisampleImage : swapchainMultisampleImages){
-        if (multisampleImage != nullptr){
-            delete multisampleImage;
-        }
+    if (swapchainMultisampleImage != nullptr){
+        delete swapchainMultisampleImage;
+        swapchainMultisampleImage = nullptr;
     }
-    swapchainMultisampleImages.clear();
 
     // Destroy images
     for (auto image : swapchainImages){
@@ -75,9 +71,6 @@ void VulkanSwapchain::cleanupSwapchain(){
         }
     }
     swapchainFramebuffers.clear();
-
-    deviceContext->vkDestroySemaphore(deviceContext->device, presentationSemaphore, nullptr);
-    deviceContext->vkDestroySemaphore(deviceContext->device, renderingDoneSemaphore, nullptr);
 }
 
 void VulkanSwapchain::createRenderpass(){
@@ -101,7 +94,7 @@ void VulkanSwapchain::createRenderpass(){
     depthAttachment.format = swapchainDepthFormat;
     depthAttachment.samples = sampleCount;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // Never read after the pass, so tile-based GPUs can skip the write back
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -116,7 +109,7 @@ void VulkanSwapchain::createRenderpass(){
         multisampleAttachment.format = surfaceFormats[surfaceFormatIndex].format;
         multisampleAttachment.samples = sampleCount;
         multisampleAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        multisampleAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        multisampleAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // Only the resolved image is kept
         multisampleAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         multisampleAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         multisampleAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -151,7 +144,17 @@ void VulkanSwapchain::createRenderpass(){
     subpassDescription.pPreserveAttachments     = nullptr; // pPreserveAttachments
 
     std::vector<VkSubpassDescription> subpasses     = {subpassDescription};
-    std::vector<VkSubpassDependency> dependencies   = {};
+
+    // Depth and multisample attachments are shared by every frame, so a frame's attachment writes wait for the last frame's
+    VkSubpassDependency attachmentDependency;
+    attachmentDependency.srcSubpass         = VK_SUBPASS_EXTERNAL;
+    attachmentDependency.dstSubpass         = 0;
+    attachmentDependency.srcStageMask       = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    attachmentDependency.dstStageMask       = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+    attachmentDependency.srcAccessMask      = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    attachmentDependency.dstAccessMask      = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    attachmentDependency.dependencyFlags    = 0;
+    std::vector<VkSubpassDependency> dependencies   = {attachmentDependency};
 
     uint32_t attachmentCount        = attachments.size();
     uint32_t subpassCount           = subpasses.size();
@@ -204,26 +207,6 @@ void VulkanSwapchain::createRenderpass(){
     pipelineState->setMultisampleState(sampleCount);
 }
 
-void VulkanSwapchain::createSemaphores(){
-    // Create presentation semaphore
-    VkSemaphoreCreateInfo presentationSemaphoreCreateInfo = {
-        VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        nullptr,
-        0
-    };
-
-    assert(deviceContext->vkCreateSemaphore(deviceContext->device, &presentationSemaphoreCreateInfo, nullptr, &presentationSemaphore) == VK_SUCCESS);
-
-    // Create rendering done semaphore
-    VkSemaphoreCreateInfo renderingDoneSemaphoreCreateInfo = {
-        VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-        nullptr,
-        0
-    };
-
-    assert(deviceContext->vkCreateSemaphore(deviceContext->device, &renderingDoneSemaphoreCreateInfo, nullptr, &renderingDoneSemaphore) == VK_SUCCESS);
-}
-
 void VulkanSwapchain::initializeSwapchain(VkSurfaceKHR swapchainSurface, VkSwapchainKHR oldSwapchain){
     surface             = swapchainSurface;
     surfaceFormatIndex  = 0; // Default surface format
@@ -288,13 +271,8 @@ void VulkanSwapchain::initializeSwapchain(VkSurfaceKHR swapchainSurface, VkSwapc
     assert(deviceContext->vkGetSwapchainImagesKHR(deviceContext->device, swapchain, &imageCount, &swapchainPrimitiveImages[0]) == VK_SUCCESS);
 
     swapchainImages             = std::vector<VulkanImage*>(imageCount);
-    swapchainDepthImages        = std::vector<VulkanImage*>(imageCount);
     swapchainFramebuffers       = std::vector<VkFramebuffer>(imageCount);
 
-    if(sampleCount != VK_SAMPLE_COUNT_1_BIT){
-        swapchainMultisampleImages   = std::vector<VulkanImage*>(imageCount);
-    }
-
     for(uint32_t index = 0; index < imageCount; index++){
         // Create image wrapper for WSI image
         swapchainImages[index] = new VulkanImage(deviceContext,
@@ -314,53 +292,53 @@ void VulkanSwapchain::initializeSwapchain(VkSurfaceKHR swapchainSurface, VkSwapc
                                                 VK_IMAGE_LAYOUT_UNDEFINED);
         swapchainImages[index]->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, 0);
         std::cout << "Swapchain Image #" << index << ": " << swapchainImages[index] << std::endl;
-
-        // Depth buffer images must be created
-        swapchainDepthImages[index] = new VulkanImage(deviceContext,
-                                                       VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                                                       VK_IMAGE_TYPE_2D,
-                                                       swapchainDepthFormat,
-                                                       {extent.width, extent.height, 1},
-                                                       0,
-                                                       sampleCount,
-                                                       VK_IMAGE_TILING_OPTIMAL,
-                                                       1,
-                                                       1,
-                                                       imageSharingMode,
-                                                       queueFamilyIndices.size(),
-                                                       (imageSharingMode == VK_SHARING_MODE_CONCURRENT) ? &queueFamilyIndices.at(0) : nullptr,
-                                                       VK_IMAGE_LAYOUT_UNDEFINED);
-        swapchainDepthImages[index]->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0);
-        std::cout << "Swapchain Depth Image #" << index << ": " << swapchainDepthImages[index]->imageHandle << std::endl;
-
-        // Create multisampled color and depth buffers
-        if(sampleCount != VK_SAMPLE_COUNT_1_BIT){
-            // Create multisampled color buffer
-            swapchainMultisampleImages[index] = new VulkanImage(deviceContext,
-                                                               VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                                                               VK_IMAGE_TYPE_2D,
-                                                               swapchainFormat,
-                                                               {extent.width, extent.height, 1},
-                                                               0,
-                                                               sampleCount,
-                                                               VK_IMAGE_TILING_OPTIMAL,
-                                                               1,
-                                                               1,
-                                                               imageSharingMode,
-                                                               queueFamilyIndices.size(),
-                                                               (imageSharingMode == VK_SHARING_MODE_CONCURRENT) ? &queueFamilyIndices.at(0) : nullptr,
-                                                               VK_IMAGE_LAYOUT_UNDEFINED);
-            swapchainMultisampleImages[index]->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, 0);
-            std::cout << "Multisampled Swapchain Image #" << index << ": " << swapchainMultisampleImages[index]->imageHandle << std::endl;
-        }
     }
 
-    assert(deviceContext->vkAcquireNextImageKHR(deviceContext->device, swapchain, UINT64_MAX, presentationSemaphore, VK_NULL_HANDLE, &swapchainImageIndex) == VK_SUCCESS);
-    assert(swapchainImageIndex != 0xFFFFFFFF);
-
     std::cout << "Window Creation Complete!" << std::endl;
 }
 
+void VulkanSwapchain::createAttachments(){
+    // Depth and multisampled colour are cleared at the start of every pass and never stored, so one of
+    // each serves every swapchain image; as transient attachments they can live in lazily allocated memory.
+    // Only the swapchain's own framebuffers use them, a render graph drawing to the swapchain brings its own
+    VkSharingMode imageSharingMode = queueFamilyIndices.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    swapchainDepthImage = new VulkanImage(deviceContext,
+                                          VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                                          VK_IMAGE_TYPE_2D,
+                                          swapchainDepthFormat,
+                                          {extent.width, extent.height, 1},
+                                          0,
+                                          sampleCount,
+                                          VK_IMAGE_TILING_OPTIMAL,
+                                          1,
+                                          1,
+                                          imageSharingMode,
+                                          queueFamilyIndices.size(),
+                                          (imageSharingMode == VK_SHARING_MODE_CONCURRENT) ? &queueFamilyIndices.at(0) : nullptr,
+                                          VK_IMAGE_LAYOUT_UNDEFINED);
+    swapchainDepthImage->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 0);
+    std::cout << "Swapchain Depth Image: " << swapchainDepthImage->imageHandle << std::endl;
+
+    if(sampleCount != VK_SAMPLE_COUNT_1_BIT){
+        swapchainMultisampleImage = new VulkanImage(deviceContext,
+                                                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                                                    VK_IMAGE_TYPE_2D,
+                                                    swapchainFormat,
+                                                    {extent.width, extent.height, 1},
+                                                    0,
+                                                    sampleCount,
+                                                    VK_IMAGE_TILING_OPTIMAL,
+                                                    1,
+                                                    1,
+                                                    imageSharingMode,
+                                                    queueFamilyIndices.size(),
+                                                    (imageSharingMode == VK_SHARING_MODE_CONCURRENT) ? &queueFamilyIndices.at(0) : nullptr,
+                                                    VK_IMAGE_LAYOUT_UNDEFINED);
+        swapchainMultisampleImage->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT, 0, 0);
+        std::cout << "Multisampled Swapchain Image: " << swapchainMultisampleImage->imageHandle << std::endl;
+    }
+}
+
 VkFramebuffer VulkanSwapchain::getCurrentFramebuffer(){
     if ( swapchainFramebuffers.size() == 0){
         return VK_NULL_HANDLE;
@@ -377,59 +355,61 @@ VkImage VulkanSwapchain::getCurrentImage(){
     }
 }
 
-void VulkanSwapchain::present(VkQueue presentationQueue){
-    // Get the index of the image for rendering
-    uint32_t acquireTimeout         = 0x1000000; // ~16.7 ms
+void VulkanSwapchain::acquireNextImage(const VulkanFrame& frame){
+    // Get the index of the image for rendering; blocks until one is free, which paces the frame loop
+    while(true){
+        VkResult acquireResult = deviceContext->vkAcquireNextImageKHR(deviceContext->device, swapchain, UINT64_MAX, frame.imageAcquiredSemaphore, VK_NULL_HANDLE, &swapchainImageIndex);
+        if(acquireResult == VK_ERROR_OUT_OF_DATE_KHR){
+            // Semaphore is left unsignaled, so it can be used again with the new swapchain
+            std::cout << "vkAcquireNextImageKHR status:VK_ERROR_OUT_OF_DATE_KHR" << std::endl;
+            recreateSwapchain();
+            continue;
+        }else if(acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR){
+            std::string errorString = "";
+            switch(acquireResult){
+                case VK_ERROR_OUT_OF_HOST_MEMORY:
+                    errorString = "VK_ERROR_OUT_OF_HOST_MEMORY";
+                    break;
+                case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+                    errorString = "VK_ERROR_OUT_OF_DEVICE_MEMORY";
+                    break;
+                case VK_ERROR_DEVICE_LOST:
+                    errorString = "VK_ERROR_DEVICE_LOST";
+                    break;
+                case VK_ERROR_SURFACE_LOST_KHR:
+                    errorString = "VK_ERROR_SURFACE_LOST_KHR";
+                    break;   
+                default:
+                    errorString += acquireResult;
+                }
+            throw std::runtime_error("Failed to acquire swapchain image!" + errorString);
+        }
+        break;
+    }
+    assert(swapchainImageIndex != 0xFFFFFFFF);
+}
 
+void VulkanSwapchain::present(VkQueue presentationQueue, const VulkanFrame& frame){
     // std::cout << "Present - Swapchain Image Index: " << swapchainImageIndex << std::endl;
 
-    // Present
+    // Present once the frame's rendering is done
     VkPresentInfoKHR presentInfo;
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.pNext = nullptr;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &renderingDoneSemaphore;
+    presentInfo.pWaitSemaphores = &frame.renderingDoneSemaphore;
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &swapchain;
     presentInfo.pImageIndices = &swapchainImageIndex;
     presentInfo.pResults = nullptr;
 
     VkResult presentResult = deviceContext->vkQueuePresentKHR(presentationQueue, &presentInfo);
-    if(presentResult == VK_ERROR_OUT_OF_DATE_KHR){
-        std::cout << "vkQueuePresentKHR status:VK_ERROR_OUT_OF_DATE_KHR" << std::endl;
+    if(presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR){
+        std::cout << "vkQueuePresentKHR status:" << (presentResult == VK_ERROR_OUT_OF_DATE_KHR ? "VK_ERROR_OUT_OF_DATE_KHR" : "VK_SUBOPTIMAL_KHR") << std::endl;
         recreateSwapchain();
-    }else if(presentResult != VK_SUCCESS && presentResult != VK_SUBOPTIMAL_KHR){
+    }else if(presentResult != VK_SUCCESS){
         throw std::runtime_error("Failed to present swapchain!");
     }
-
-    VkResult acquireResult = deviceContext->vkAcquireNextImageKHR(deviceContext->device, swapchain, acquireTimeout, presentationSemaphore, VK_NULL_HANDLE, &swapchainImageIndex);
-    if(acquireResult == VK_ERROR_OUT_OF_DATE_KHR || acquireResult == VK_SUBOPTIMAL_KHR){
-        std::cout << "vkAcquireNextImageKHR status:" << (acquireResult == VK_ERROR_OUT_OF_DATE_KHR ? "VK_ERROR_OUT_OF_DATE_KHR" : "VK_SUBOPTIMAL_KHR") << std::endl;
-        recreateSwapchain();
-    }else if(acquireResult != VK_SUCCESS && acquireResult != VK_TIMEOUT && acquireResult != VK_NOT_READY){
-        std::string errorString = "";
-        switch(acquireResult){
-            case VK_ERROR_OUT_OF_HOST_MEMORY:
-                errorString = "VK_ERROR_OUT_OF_HOST_MEMORY";
-                break;
-            case VK_ERROR_OUT_OF_DEVICE_MEMORY:
-                errorString = "VK_ERROR_OUT_OF_DEVICE_MEMORY";
-                break;
-            case VK_ERROR_DEVICE_LOST:
-                errorString = "VK_ERROR_DEVICE_LOST";
-                break;
-            case VK_ERROR_OUT_OF_DATE_KHR: // This SHOULD never be hit, but just in case
-                errorString = "VK_ERROR_OUT_OF_DATE_KHR";
-                break;
-            case VK_ERROR_SURFACE_LOST_KHR:
-                errorString = "VK_ERROR_SURFACE_LOST_KHR";
-                break;   
-            default:
-                errorString += acquireResult;
-            }
-        throw std::runtime_error("Failed to acquire swapchain image!" + errorString);
-    }
-    assert(swapchainImageIndex != 0xFFFFFFFF);
 }
 
 void VulkanSwapchain::querySwapchain(){
@@ -526,9 +506,10 @@ void VulkanSwapchain::recreateSwapchain(){
     assert(deviceContext->vkDeviceWaitIdle(deviceContext->device) == VK_SUCCESS);
     VkSwapchainKHR oldSwapchain = swapchain;
     cleanupSwapchain();
-    createSemaphores();
     initializeSwapchain(surface, oldSwapchain);
     createRenderpass();
+
+    // Only rebuilds the pipeline when its viewport and scissor are not dynamic
     VkRect2D scissorRect = { { 0, 0 }, extent };
     pipelineState->setViewportState(extent, scissorRect);
 }
@@ -548,6 +529,9 @@ void VulkanSwapchain::setupFramebuffers(VkCommandBuffer cmdBuffer){
     assert(imageCount != 0);
 
     swapchainFramebuffers = std::vector<VkFramebuffer>(imageCount);
+    if (swapchainDepthImage == nullptr){
+        createAttachments();
+    }
 
     for(uint32_t index = 0; index < imageCount; index++){
         std::cout << "Swapchain Image #" << index << ": " << swapchainImages[index]->imageHandle << std::endl;
@@ -558,9 +542,9 @@ void VulkanSwapchain::setupFramebuffers(VkCommandBuffer cmdBuffer){
         // Framebuffer creation
         std::vector<VkImageView> attachments;
         attachments.push_back(swapchainImages[index]->imageViewHandle);
-        attachments.push_back(swapchainDepthImages[index]->imageViewHandle);
+        attachments.push_back(swapchainDepthImage->imageViewHandle);
         if(sampleCount != VK_SAMPLE_COUNT_1_BIT){
-            attachments.push_back(swapchainMultisampleImages[index]->imageViewHandle);
+            attachments.push_back(swapchainMultisampleImage->imageViewHandle);
         }
 
         VkFramebufferCreateInfo framebufferCreateInfo;
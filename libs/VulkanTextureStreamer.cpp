@@ -0,0 +1,621 @@
+#ifndef STB_IMAGE_IMPLEMENTATION
+    #define STB_IMAGE_IMPLEMENTATION
+    // Failure strings go through one global, which workers decoding at once would race on
+    #define STBI_NO_FAILURE_STRINGS
+    #include <stb/stb_image.h>
+#endif
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include "VulkanBuffer.h"
+#include "VulkanResidencyManager.h"
+#include "VulkanTextureStreamer.h"
+
+VulkanTextureStreamer::VulkanTextureStreamer(VulkanFramePacer * __framePacer, VkDeviceSize __memoryBudget, VkDeviceSize __uploadBytesPerUpdate, uint32_t __workerCount){
+    framePacer              = __framePacer;
+    assert(framePacer != nullptr);
+    deviceContext           = framePacer->deviceContext;
+    memoryBudget            = __memoryBudget;
+    uploadBytesPerUpdate    = __uploadBytesPerUpdate;
+    format                  = VK_FORMAT_R8G8B8A8_UNORM;
+    lowMipExtent            = 64;
+    mipRetainFrames         = 120;
+    streamedBytes           = 0;
+    decodedBytes            = 0;
+    outstandingCount        = 0;
+    stopping                = false;
+
+    // Mid grey, uploaded up front so it can be bound from the first frame
+    const uint8_t placeholderTexel[4] = {128, 128, 128, 255};
+    placeholderImage = new VulkanImage(deviceContext, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_TYPE_2D, format, {1, 1, 1});
+    placeholderImage->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+    placeholderImage->loadImageData(placeholderTexel, sizeof(placeholderTexel), {1, 1, 1});
+    deviceContext->stagingRing->wait(deviceContext->stagingRing->submit());
+
+    // Decoding is all CPU work, so use every core unless told otherwise
+    uint32_t workerCount = __workerCount;
+    if (workerCount == 0){
+        workerCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+    }
+    for (uint32_t workerIndex = 0; workerIndex < workerCount; workerIndex++){
+        workers.push_back(std::thread(&VulkanTextureStreamer::workerLoop, this));
+    }
+}
+
+VulkanTextureStreamer::~VulkanTextureStreamer(){
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueCondition.notify_all();
+    budgetCondition.notify_all();
+    for (auto& worker : workers){
+        worker.join();
+    }
+
+    // The device has to be idle by now, like for any other image
+    for (auto& texture : textures){
+        deviceContext->residencyManager->unregisterResource(texture.residencyId);
+        if (texture.pixels != nullptr){
+            stbi_image_free(texture.pixels);
+        }
+        if (texture.ktxTexture != nullptr){
+            delete texture.ktxTexture;
+        }else{
+            delete texture.image;
+        }
+        delete texture.loadingImage;
+    }
+    for (auto& retiredImage : retiredImages){
+        delete retiredImage.first;
+    }
+    delete placeholderImage;
+}
+
+void VulkanTextureStreamer::decodeTexture(VulkanStreamedTexture& texture){
+    // The header gives the decoded size, so the budget is reserved before decoding
+    int x, y, numChannels;
+    bool readable = stbi_info(texture.fileName.c_str(), &x, &y, &numChannels) != 0;
+    VkDeviceSize decodedSize = readable ? (VkDeviceSize)x * y * 4 : 0;
+
+    if (readable && !reserveBudget(decodedSize)){
+        return;
+    }
+
+    // Decoded to RGBA whatever the file holds, the size above counts on it
+    unsigned char * pixels = readable ? stbi_load(texture.fileName.c_str(), &x, &y, &numChannels, STBI_rgb_alpha) : nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (pixels == nullptr){
+            std::cout << "Unable to load texture " << texture.fileName << std::endl;
+            decodedBytes        -= decodedSize;
+            texture.state       = VULKAN_TEXTURE_STATE_FAILED;
+            outstandingCount--;
+        }else{
+            texture.width       = (uint32_t)x;
+            texture.height      = (uint32_t)y;
+            texture.pixels      = pixels;
+            texture.decodedSize = decodedSize;
+            texture.state       = VULKAN_TEXTURE_STATE_DECODED;
+            decodedQueue.push_back(&texture);
+        }
+    }
+    if (pixels == nullptr){
+        budgetCondition.notify_all();
+    }
+    decodedCondition.notify_all();
+}
+
+void VulkanTextureStreamer::evictTexture(VulkanStreamedTexture * texture){
+    // Called by the residency manager from the render thread, once no frame in flight has bound the image
+    std::lock_guard<std::mutex> lock(queueMutex);
+    texture->residencyId = 0;
+    if (texture->ktxTexture != nullptr){
+        delete texture->ktxTexture;
+        texture->ktxTexture = nullptr;
+    }else{
+        delete texture->image;
+    }
+    texture->image = nullptr;
+
+    // Streamed textures start over from lowMip; the level index is kept, so the file isn't parsed again
+    if (texture->mipStreamed){
+        streamedBytes           -= texture->residentBytes;
+        texture->residentBytes  = 0;
+        texture->residentMip    = texture->lowMip;
+        texture->loadingMip     = texture->lowMip;
+        streamingTextures.erase(std::find(streamingTextures.begin(), streamingTextures.end(), texture));
+    }
+    texture->state = VULKAN_TEXTURE_STATE_EVICTED;
+}
+
+void VulkanTextureStreamer::finish(){
+    // Loading screens and tools; frames keep streaming through update instead
+    while (true){
+        update();
+        size_t uploadingCount = uploadingTextures.size();
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            if (outstandingCount == 0){
+                return;
+            }
+
+            // Wait for the workers, unless every outstanding texture is already uploading
+            decodedCondition.wait(lock, [&]{ return !decodedQueue.empty() || outstandingCount == uploadingCount; });
+            if (!decodedQueue.empty()){
+                continue;
+            }
+        }
+        deviceContext->stagingRing->wait(uploadingTextures.back()->uploadToken);
+    }
+}
+
+uint32_t VulkanTextureStreamer::getFootprintMip(VkExtent2D extent, float screenPixels){
+    // Each level has a quarter of the texels, so pick the one closest to a texel per pixel
+    uint32_t coarsestMip = VulkanImage::mipLevelCount({extent.width, extent.height, 1}) - 1;
+    if (screenPixels < 1.0f){
+        return coarsestMip;
+    }
+    float texelsPerPixel = (float)extent.width * (float)extent.height / screenPixels;
+    if (texelsPerPixel <= 1.0f){
+        return 0;
+    }
+    return (std::min)((uint32_t)(0.5f * std::log2(texelsPerPixel)), coarsestMip);
+}
+
+VulkanImage * VulkanTextureStreamer::getImage(VulkanTextureHandle texture){
+    // Getting the image is binding it, so this is where resident textures are marked as used
+    assert(texture < textures.size());
+    VulkanStreamedTexture& streamedTexture = textures[texture];
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (streamedTexture.state == VULKAN_TEXTURE_STATE_RESIDENT){
+            deviceContext->residencyManager->touch(streamedTexture.residencyId);
+            return streamedTexture.image;
+        }
+        if (streamedTexture.state != VULKAN_TEXTURE_STATE_EVICTED){
+            return placeholderImage;
+        }
+
+        // Evicted textures are wanted again, so they go back in the queue
+        streamedTexture.state = VULKAN_TEXTURE_STATE_QUEUED;
+        decodeQueue.push_back(&streamedTexture);
+        outstandingCount++;
+    }
+    queueCondition.notify_one();
+    return placeholderImage;
+}
+
+VkImageView VulkanTextureStreamer::getImageView(VulkanTextureHandle texture){
+    return getImage(texture)->imageViewHandle;
+}
+
+uint32_t VulkanTextureStreamer::getResidentMip(VulkanTextureHandle texture){
+    // Finest level that can be sampled, counted from the top of the file's chain. The view
+    // starts there already; this is for clamping samplers or shaders that index the full chain.
+    std::lock_guard<std::mutex> lock(queueMutex);
+    assert(texture < textures.size());
+    const VulkanStreamedTexture& streamedTexture = textures[texture];
+    return streamedTexture.mipStreamed && streamedTexture.state == VULKAN_TEXTURE_STATE_RESIDENT ? streamedTexture.residentMip : 0;
+}
+
+VulkanTextureState VulkanTextureStreamer::getState(VulkanTextureHandle texture){
+    std::lock_guard<std::mutex> lock(queueMutex);
+    assert(texture < textures.size());
+    return textures[texture].state;
+}
+
+bool VulkanTextureStreamer::isResident(VulkanTextureHandle texture){
+    return getState(texture) == VULKAN_TEXTURE_STATE_RESIDENT;
+}
+
+void VulkanTextureStreamer::readMipLevels(VulkanStreamedTexture& texture){
+    // The level index is read once; reloads only read levels
+    bool firstLoad = texture.levels.empty();
+    bool loadWhole = texture.loadWhole;
+    std::string failure;
+    if (firstLoad && !loadWhole){
+        VulkanKtx2Header header;
+        if (!VulkanKtxTexture::readHeader(texture.fileName, header, texture.levels)){
+            failure = "not a KTX2 file";
+        }else if (header.supercompressionScheme != 0 || header.vkFormat == VK_FORMAT_UNDEFINED){
+            failure = "supercompressed";
+        }else if (header.pixelHeight == 0 || header.pixelDepth > 0 || header.layerCount > 0 || header.faceCount > 1 || header.levelCount == 0){
+            // Rebuilding arrays, cube maps or volumes per level change isn't worth it, and a
+            // generated chain has no stored levels to stream, so these are loaded whole
+            loadWhole = true;
+        }else{
+            texture.width       = header.pixelWidth;
+            texture.height      = header.pixelHeight;
+            texture.fileFormat  = (VkFormat)header.vkFormat;
+            texture.format      = texture.fileFormat;
+            if (!VulkanKtxTexture::isFormatEnabled(deviceContext, texture.fileFormat)){
+                texture.format = VulkanKtxTexture::getTranscodeFormat(texture.fileFormat);
+                if (texture.format == VK_FORMAT_UNDEFINED){
+                    failure = "format " + std::to_string(texture.fileFormat) + " is not supported on this device";
+                }
+            }
+
+            // Start from the largest level within lowMipExtent, or the smallest the file has
+            texture.lowMip = (uint32_t)texture.levels.size() - 1;
+            for (uint32_t levelIndex = 0; levelIndex < texture.levels.size(); levelIndex++){
+                if ((std::max)(texture.width >> levelIndex, texture.height >> levelIndex) <= lowMipExtent){
+                    texture.lowMip = levelIndex;
+                    break;
+                }
+            }
+            texture.loadingMip = texture.lowMip;
+        }
+    }
+
+    if (loadWhole){
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            texture.mipStreamed = false;
+            texture.loadWhole   = true;
+            texture.state       = VULKAN_TEXTURE_STATE_DECODED;
+            decodedQueue.push_back(&texture);
+        }
+        decodedCondition.notify_all();
+        return;
+    }
+
+    // Levels are packed one after the other, each offset a multiple of the block size and of 4
+    std::vector<VkBufferImageCopy> mipCopies;
+    VkDeviceSize dataSize = 0;
+    if (failure.empty()){
+        VkDeviceSize alignment = VulkanImage::bytesPerBlock(texture.format);
+        while (alignment % 4 != 0){
+            alignment += VulkanImage::bytesPerBlock(texture.format);
+        }
+        for (uint32_t levelIndex = texture.loadingMip; levelIndex < texture.levels.size(); levelIndex++){
+            VkBufferImageCopy levelCopy;
+            levelCopy.bufferOffset          = (dataSize + alignment - 1) / alignment * alignment;
+            levelCopy.bufferRowLength       = 0;
+            levelCopy.bufferImageHeight     = 0;
+            levelCopy.imageSubresource      = {VulkanImage::formatAspect(texture.format), levelIndex - texture.loadingMip, 0, 1};
+            levelCopy.imageOffset           = {0, 0, 0};
+            levelCopy.imageExtent           = {(std::max)(texture.width >> levelIndex, 1u), (std::max)(texture.height >> levelIndex, 1u), 1};
+            mipCopies.push_back(levelCopy);
+            dataSize = levelCopy.bufferOffset + VulkanImage::imageDataSize(texture.format, levelCopy.imageExtent);
+        }
+        if (!reserveBudget(dataSize)){
+            return;
+        }
+    }
+
+    std::vector<uint8_t> mipData;
+    if (failure.empty()){
+        mipData.resize(dataSize);
+        std::ifstream textureFile(texture.fileName, std::ios::binary);
+        std::vector<uint8_t> blocks;
+        for (const auto& levelCopy : mipCopies){
+            const VulkanKtx2Level& level = texture.levels[texture.loadingMip + levelCopy.imageSubresource.mipLevel];
+            VkDeviceSize levelSize  = VulkanImage::imageDataSize(texture.fileFormat, levelCopy.imageExtent);
+            bool transcoding        = texture.format != texture.fileFormat;
+            if (transcoding){
+                blocks.resize(levelSize);
+            }
+            uint8_t * levelData = transcoding ? &blocks[0] : &mipData[levelCopy.bufferOffset];
+            if (level.byteLength < levelSize || !textureFile.seekg(level.byteOffset) || !textureFile.read(reinterpret_cast<char *>(levelData), levelSize)){
+                failure = "truncated mip level";
+                break;
+            }
+            if (transcoding){
+                VulkanKtxTexture::transcode(texture.fileFormat, levelData, levelCopy.imageExtent.width, levelCopy.imageExtent.height, &mipData[levelCopy.bufferOffset]);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (!failure.empty()){
+            std::cout << "Unable to stream texture " << texture.fileName << ": " << failure << std::endl;
+            decodedBytes -= mipData.size();
+            mipData.clear();
+        }
+        texture.mipData.swap(mipData);
+        texture.mipCopies.swap(mipCopies);
+        texture.decodedSize = texture.mipData.size();
+        // Textures still resident are reloading at another level; the rest are loading from scratch
+        bool resident = texture.state == VULKAN_TEXTURE_STATE_RESIDENT;
+        if (!failure.empty() && !resident){
+            texture.state = VULKAN_TEXTURE_STATE_FAILED;
+            outstandingCount--;
+        }else{
+            // A reload that failed still goes back, with no data, so update stops waiting on it
+            if (!resident){
+                texture.state = VULKAN_TEXTURE_STATE_DECODED;
+            }
+            decodedQueue.push_back(&texture);
+        }
+    }
+    if (!failure.empty()){
+        budgetCondition.notify_all();
+    }
+    decodedCondition.notify_all();
+}
+
+void VulkanTextureStreamer::requestFootprint(VulkanTextureHandle texture, float screenPixels){
+    // CPU side feedback: screenPixels is how many pixels the texture covers this frame
+    if (isResident(texture)){
+        const VulkanStreamedTexture& streamedTexture = textures[texture];
+        requestMip(texture, getFootprintMip({streamedTexture.width, streamedTexture.height}, screenPixels));
+    }
+}
+
+void VulkanTextureStreamer::requestMip(VulkanTextureHandle texture, uint32_t mipLevel){
+    // The finest level asked for between updates wins; requestedMip is only touched by the render thread
+    if (isResident(texture) && textures[texture].mipStreamed){
+        VulkanStreamedTexture& streamedTexture = textures[texture];
+        streamedTexture.requestedMip = (std::min)(streamedTexture.requestedMip, mipLevel);
+    }
+}
+
+VulkanTextureHandle VulkanTextureStreamer::requestTexture(const std::string& fileName){
+    // Requesting the same file twice shares the texture
+    auto lookup = textureLookup.find(fileName);
+    if (lookup != textureLookup.end()){
+        return lookup->second;
+    }
+
+    VulkanTextureHandle handle;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        handle = (VulkanTextureHandle)textures.size();
+
+        VulkanStreamedTexture texture;
+        texture.fileName    = fileName;
+        texture.state       = VULKAN_TEXTURE_STATE_QUEUED;
+        texture.width       = 0;
+        texture.height      = 0;
+        texture.pixels      = nullptr;
+        texture.decodedSize = 0;
+        texture.image       = nullptr;
+        texture.uploadToken = 0;
+        texture.residencyId = 0;
+
+        // Cooked textures carry their own mip chain, so their levels can stream
+        texture.mipStreamed         = fileName.size() > 5 && fileName.compare(fileName.size() - 5, 5, ".ktx2") == 0;
+        texture.fileFormat          = VK_FORMAT_UNDEFINED;
+        texture.format              = format;
+        texture.lowMip              = 0;
+        texture.residentMip         = 0;
+        texture.loadingMip          = 0;
+        texture.requestedMip        = 0;
+        texture.residentUsedFrame   = 0;
+        texture.residentBytes       = 0;
+        texture.loading             = false;
+        texture.loadingImage        = nullptr;
+        texture.loadWhole           = false;
+        texture.ktxTexture          = nullptr;
+        textures.push_back(texture);
+
+        decodeQueue.push_back(&textures.back());
+        outstandingCount++;
+    }
+    queueCondition.notify_one();
+
+    textureLookup.emplace(fileName, handle);
+    return handle;
+}
+
+void VulkanTextureStreamer::registerResidency(VulkanStreamedTexture * texture){
+    texture->residencyId = deviceContext->residencyManager->registerResource(texture->image->imageAllocation, [this, texture](){ evictTexture(texture); });
+}
+
+bool VulkanTextureStreamer::reserveBudget(VkDeviceSize dataSize){
+    // Always let one texture through, even one bigger than the whole budget
+    std::unique_lock<std::mutex> lock(queueMutex);
+    budgetCondition.wait(lock, [&]{ return stopping || decodedBytes == 0 || decodedBytes + dataSize <= memoryBudget; });
+    if (stopping){
+        return false;
+    }
+    decodedBytes += dataSize;
+    return true;
+}
+
+void VulkanTextureStreamer::update(){
+    VulkanStagingRing * stagingRing = deviceContext->stagingRing;
+    uint64_t frameNumber            = framePacer->getCurrentFrame().frameNumber;
+
+    // Textures whose batch has finished can be sampled from now on
+    std::vector<VulkanStreamedTexture *> residentTextures;
+    for (auto textureIterator = uploadingTextures.begin(); textureIterator != uploadingTextures.end();){
+        if (stagingRing->isComplete((*textureIterator)->uploadToken)){
+            residentTextures.push_back(*textureIterator);
+            textureIterator = uploadingTextures.erase(textureIterator);
+        }else{
+            ++textureIterator;
+        }
+    }
+
+    // Take as many decoded textures as this update may upload, at least one
+    std::vector<VulkanStreamedTexture *> readyTextures;
+    VkDeviceSize uploadBytes = 0;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto texture : residentTextures){
+            texture->state = VULKAN_TEXTURE_STATE_RESIDENT;
+            outstandingCount--;
+            registerResidency(texture);
+            if (texture->mipStreamed){
+                texture->residentMip        = texture->loadingMip;
+                texture->requestedMip       = (uint32_t)texture->levels.size();
+                texture->residentUsedFrame  = frameNumber;
+                texture->residentBytes      = texture->decodedSize;
+                streamedBytes               += texture->residentBytes;
+                streamingTextures.push_back(texture);
+            }
+        }
+
+        // Rebuilt images replace the old ones, which frames already recorded may still sample
+        for (auto texture : streamingTextures){
+            if (texture->loadingImage != nullptr && stagingRing->isComplete(texture->uploadToken)){
+                retiredImages.push_back(std::make_pair(texture->image, frameNumber));
+                texture->image              = texture->loadingImage;
+                texture->loadingImage       = nullptr;
+                texture->loading            = false;
+                texture->residentMip        = texture->loadingMip;
+                texture->residentUsedFrame  = frameNumber;
+                streamedBytes               += texture->decodedSize;
+                streamedBytes               -= texture->residentBytes;
+                texture->residentBytes      = texture->decodedSize;
+                registerResidency(texture);
+            }
+        }
+
+        while (!decodedQueue.empty() && (readyTextures.empty() || uploadBytes + decodedQueue.front()->decodedSize <= uploadBytesPerUpdate)){
+            uploadBytes += decodedQueue.front()->decodedSize;
+            readyTextures.push_back(decodedQueue.front());
+            decodedQueue.pop_front();
+        }
+    }
+    while (!retiredImages.empty() && framePacer->isFrameComplete(retiredImages.front().second)){
+        delete retiredImages.front().first;
+        retiredImages.pop_front();
+    }
+    updateMipResidency();
+    if (readyTextures.empty()){
+        return;
+    }
+
+    // Every copy lands in the ring's open batch, so they go out in a single submit
+    for (auto texture : readyTextures){
+        if (texture->mipStreamed){
+            if (texture->mipData.empty()){
+                // A reload that couldn't be read, the resident levels stay
+                texture->loading = false;
+                registerResidency(texture);
+                continue;
+            }
+
+            // The image starts at loadingMip, so its view can't reach levels that aren't loaded
+            VkExtent3D extent = {(std::max)(texture->width >> texture->loadingMip, 1u), (std::max)(texture->height >> texture->loadingMip, 1u), 1};
+            VulkanImage * image = new VulkanImage(deviceContext, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_TYPE_2D, texture->format, extent,
+                                                  0, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, (uint32_t)texture->levels.size() - texture->loadingMip);
+            image->createImageView(VK_IMAGE_VIEW_TYPE_2D, VulkanImage::formatAspect(texture->format));
+            texture->uploadToken = image->loadImageMipChain(&texture->mipData[0], (uint32_t)texture->mipData.size(), texture->mipCopies);
+            std::vector<uint8_t>().swap(texture->mipData);
+
+            // First loads wait with the other new textures, reloads are picked up above
+            if (texture->image == nullptr){
+                texture->image = image;
+                uploadingTextures.push_back(texture);
+            }else{
+                texture->loadingImage = image;
+            }
+            continue;
+        }
+
+        if (texture->loadWhole){
+            // VulkanKtxTexture reads the file and stages every level through the same ring
+            try{
+                texture->ktxTexture = new VulkanKtxTexture(deviceContext, texture->fileName);
+            }catch(const std::runtime_error& err){
+                std::cout << "Unable to load texture " << texture->fileName << ": " << err.what() << std::endl;
+                continue;
+            }
+            texture->width          = texture->ktxTexture->header.pixelWidth;
+            texture->height         = (std::max)(texture->ktxTexture->header.pixelHeight, 1u);
+            texture->image          = texture->ktxTexture->image;
+            texture->uploadToken    = texture->ktxTexture->uploadToken;
+            uploadingTextures.push_back(texture);
+            continue;
+        }
+
+        VkExtent3D extent = {texture->width, texture->height, 1};
+        texture->image = new VulkanImage(deviceContext, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_TYPE_2D, format, extent,
+                                         0, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, VulkanImage::mipLevelCount(extent));
+        texture->image->createImageView(VK_IMAGE_VIEW_TYPE_2D, VK_IMAGE_ASPECT_COLOR_BIT);
+        texture->uploadToken = texture->image->loadImageDataWithMips(texture->pixels, (uint32_t)texture->decodedSize);
+
+        // Staging took a copy, so the decoded pixels can go
+        stbi_image_free(texture->pixels);
+        texture->pixels = nullptr;
+        uploadingTextures.push_back(texture);
+    }
+    stagingRing->submit();
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto texture : readyTextures){
+            if (texture->state == VULKAN_TEXTURE_STATE_DECODED && texture->loadWhole && texture->ktxTexture == nullptr){
+                texture->state = VULKAN_TEXTURE_STATE_FAILED;
+                outstandingCount--;
+            }else if (texture->state == VULKAN_TEXTURE_STATE_DECODED){
+                texture->state = VULKAN_TEXTURE_STATE_UPLOADING;
+            }
+        }
+        decodedBytes -= uploadBytes;
+    }
+    budgetCondition.notify_all();
+}
+
+void VulkanTextureStreamer::updateMipResidency(){
+    uint64_t frameNumber = framePacer->getCurrentFrame().frameNumber;
+
+    // Finer levels load as soon as they're asked for, coarser ones only once the finer
+    // ones went unused for mipRetainFrames, so a texture at a level boundary doesn't thrash
+    std::vector<VulkanStreamedTexture *> reloadTextures;
+    for (auto texture : streamingTextures){
+        if (texture->loading){
+            continue;
+        }
+
+        // Without feedback the texture falls back to lowMip, which is never dropped
+        uint32_t wantedMip      = (std::min)(texture->requestedMip, texture->lowMip);
+        texture->requestedMip   = (uint32_t)texture->levels.size();
+        if (wantedMip <= texture->residentMip){
+            texture->residentUsedFrame = frameNumber;
+        }
+        if (wantedMip < texture->residentMip || (wantedMip > texture->residentMip && frameNumber - texture->residentUsedFrame > mipRetainFrames)){
+            // The image is replaced when the reload lands, so it can't be evicted from under it meanwhile
+            deviceContext->residencyManager->unregisterResource(texture->residencyId);
+            texture->residencyId = 0;
+            texture->loadingMip = wantedMip;
+            texture->loading    = true;
+            reloadTextures.push_back(texture);
+        }
+    }
+    if (reloadTextures.empty()){
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        for (auto texture : reloadTextures){
+            decodeQueue.push_back(texture);
+        }
+    }
+    queueCondition.notify_all();
+}
+
+void VulkanTextureStreamer::workerLoop(){
+    while (true){
+        VulkanStreamedTexture * texture = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]{ return stopping || !decodeQueue.empty(); });
+            if (stopping){
+                return;
+            }
+            texture = decodeQueue.front();
+            decodeQueue.pop_front();
+
+            // Resident textures being reloaded at another level stay sampleable meanwhile
+            if (texture->state == VULKAN_TEXTURE_STATE_QUEUED){
+                texture->state = VULKAN_TEXTURE_STATE_DECODING;
+            }
+        }
+
+        // Evicted KTX2 files loaded whole go back through readMipLevels, which hands them to update
+        if (texture->mipStreamed || texture->loadWhole){
+            readMipLevels(*texture);
+        }else{
+            decodeTexture(*texture);
+        }
+    }
+}
@@ -0,0 +1,562 @@
+#include <algorithm>
+#include <cassert>
+#include "VulkanBarrierBatcher.h"
+#include "VulkanBuffer.h"
+#include "VulkanResidencyManager.h"
+#include "VulkanVirtualTexture.h"
+
+static const uint32_t noTile = (std::numeric_limits<uint32_t>::max)();
+
+// Offsets of packed texel data, a multiple of the block size and of 4 as buffer copies need
+static VkDeviceSize copyAlignment(VkFormat format){
+    VkDeviceSize alignment = VulkanImage::bytesPerBlock(format);
+    while (alignment % 4 != 0){
+        alignment += VulkanImage::bytesPerBlock(format);
+    }
+    return alignment;
+}
+
+VulkanTileCache::VulkanTileCache(VulkanFramePacer * __framePacer, uint32_t __tileCount, uint32_t __uploadTilesPerFrame){
+    framePacer          = __framePacer;
+    assert(framePacer != nullptr);
+    deviceContext       = framePacer->deviceContext;
+    tileCount           = __tileCount;
+    tileSize            = 0;
+    uploadTilesPerFrame = __uploadTilesPerFrame;
+    tileMemory          = {};
+    poolRequirements    = {};
+    residencyId         = 0;
+    assert(tileCount > 0);
+
+    if (!deviceContext->enabledFeatures.sparseBinding || !deviceContext->enabledFeatures.sparseResidencyImage2D){
+        throw std::runtime_error("Sparse residency is not enabled on this device!");
+    }
+
+    // Binds go to the first family that can do them, usually the graphics family
+    sparseQueueFamilyIndex = deviceContext->getUsableDeviceQueueFamily(VK_QUEUE_SPARSE_BINDING_BIT);
+    assert(sparseQueueFamilyIndex != (std::numeric_limits<uint32_t>::max)());
+    deviceContext->vkGetDeviceQueue(deviceContext->device, sparseQueueFamilyIndex, 0, &sparseQueue);
+
+    VkSemaphoreCreateInfo semaphoreInfo;
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = nullptr;
+    semaphoreInfo.flags = 0;
+
+    // A frame slot's semaphore is free again once the slot's previous frame has finished
+    bindSemaphores.resize(framePacer->framesInFlight);
+    for (auto& bindSemaphore : bindSemaphores){
+        assert(deviceContext->vkCreateSemaphore(deviceContext->device, &semaphoreInfo, nullptr, &bindSemaphore) == VK_SUCCESS);
+    }
+
+    // Hand out the lowest tiles first
+    tiles.resize(tileCount);
+    for (uint32_t tile = tileCount; tile > 0; tile--){
+        tiles[tile - 1].texture = nullptr;
+        freeTiles.push_back(tile - 1);
+    }
+}
+
+VulkanTileCache::~VulkanTileCache(){
+    // Textures use the pool's memory, so they go first
+    assert(textures.empty());
+
+    for (auto bindSemaphore : bindSemaphores){
+        deviceContext->vkDestroySemaphore(deviceContext->device, bindSemaphore, nullptr);
+    }
+    deviceContext->residencyManager->unregisterResource(residencyId);
+    if (tileMemory.block != nullptr){
+        deviceContext->freeMemory(tileMemory);
+    }
+}
+
+bool VulkanTileCache::allocatePool(){
+    tileMemory = deviceContext->allocateMemory(poolRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0, VULKAN_ALLOCATION_TYPE_OPTIMAL);
+    if (tileMemory.block == nullptr){
+        return false;
+    }
+
+    // Textures were checked against this memory type, so the pool never moves to another one
+    poolRequirements.memoryTypeBits = 1u << tileMemory.memoryTypeIndex;
+    residencyId = deviceContext->residencyManager->registerResource(tileMemory, [this](){ evictPool(); });
+    return true;
+}
+
+void VulkanTileCache::evictPool(){
+    // No frame in flight requested a page, so every bound tile can be unbound at once
+    std::map<VulkanVirtualTexture *, std::vector<VkSparseImageMemoryBind>> textureBinds;
+    for (auto tile : lruTiles){
+        VulkanVirtualTexture * texture = tiles[tile].texture;
+        texture->pageTiles[texture->getPageIndex(tiles[tile].page)] = noTile;
+
+        VkSparseImageMemoryBind pageUnbind;
+        pageUnbind.subresource  = {VulkanImage::formatAspect(texture->format), tiles[tile].page.mipLevel, 0};
+        pageUnbind.extent       = texture->getPageRegion(tiles[tile].page, pageUnbind.offset);
+        pageUnbind.memory       = VK_NULL_HANDLE;
+        pageUnbind.memoryOffset = 0;
+        pageUnbind.flags        = 0;
+        textureBinds[texture].push_back(pageUnbind);
+        tiles[tile].texture = nullptr;
+    }
+    lruTiles.clear();
+    freeTiles.clear();
+    for (uint32_t tile = tileCount; tile > 0; tile--){
+        freeTiles.push_back(tile - 1);
+    }
+
+    // The memory can't go back until the unbinds are done, so wait for them like the mip tail bind
+    if (!textureBinds.empty()){
+        std::vector<VkSparseImageMemoryBindInfo> imageBinds;
+        for (const auto& textureBind : textureBinds){
+            VkSparseImageMemoryBindInfo imageBind;
+            imageBind.image     = textureBind.first->image->imageHandle;
+            imageBind.bindCount = textureBind.second.size();
+            imageBind.pBinds    = &textureBind.second[0];
+            imageBinds.push_back(imageBind);
+        }
+
+        VkFenceCreateInfo fenceInfo;
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.pNext = nullptr;
+        fenceInfo.flags = 0;
+        VkFence unbindFence;
+        assert(deviceContext->vkCreateFence(deviceContext->device, &fenceInfo, nullptr, &unbindFence) == VK_SUCCESS);
+        bindSparse(imageBinds, std::vector<VkSparseImageOpaqueMemoryBindInfo>(), VK_NULL_HANDLE, unbindFence);
+        assert(deviceContext->vkWaitForFences(deviceContext->device, 1, &unbindFence, VK_TRUE, (std::numeric_limits<uint64_t>::max)()) == VK_SUCCESS);
+        deviceContext->vkDestroyFence(deviceContext->device, unbindFence, nullptr);
+    }
+
+    deviceContext->freeMemory(tileMemory);
+    residencyId = 0;
+}
+
+void VulkanTileCache::bindSparse(const std::vector<VkSparseImageMemoryBindInfo>& imageBinds, const std::vector<VkSparseImageOpaqueMemoryBindInfo>& opaqueBinds, VkSemaphore signalSemaphore, VkFence fence){
+    VkBindSparseInfo bindInfo;
+    bindInfo.sType                  = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+    bindInfo.pNext                  = nullptr;
+    bindInfo.waitSemaphoreCount     = 0;
+    bindInfo.pWaitSemaphores        = nullptr;
+    bindInfo.bufferBindCount        = 0;
+    bindInfo.pBufferBinds           = nullptr;
+    bindInfo.imageOpaqueBindCount   = opaqueBinds.size();
+    bindInfo.pImageOpaqueBinds      = opaqueBinds.empty() ? nullptr : &opaqueBinds[0];
+    bindInfo.imageBindCount         = imageBinds.size();
+    bindInfo.pImageBinds            = imageBinds.empty() ? nullptr : &imageBinds[0];
+    bindInfo.signalSemaphoreCount   = signalSemaphore != VK_NULL_HANDLE ? 1 : 0;
+    bindInfo.pSignalSemaphores      = signalSemaphore != VK_NULL_HANDLE ? &signalSemaphore : nullptr;
+
+    assert(deviceContext->vkQueueBindSparse(sparseQueue, 1, &bindInfo, fence) == VK_SUCCESS);
+}
+
+uint32_t VulkanTileCache::getFreeTileCount(){
+    return freeTiles.size();
+}
+
+void VulkanTileCache::registerTexture(VulkanVirtualTexture * texture, const VkMemoryRequirements& memoryRequirements){
+    if (tileSize == 0){
+        // One allocation holds every tile, each one sparse block
+        tileSize                = memoryRequirements.alignment;
+        poolRequirements        = memoryRequirements;
+        poolRequirements.size   = tileSize * tileCount;
+        if (!allocatePool()){
+            throw std::runtime_error("Unable to allocate the virtual texture tile pool!");
+        }
+        std::cout << "Virtual texture tile pool: " << std::dec << tileCount << " tiles of " << tileSize << " bytes" << std::endl;
+    }
+
+    // Every texture binds the same memory, so it has to be able to use it
+    if (memoryRequirements.alignment != tileSize || (memoryRequirements.memoryTypeBits & (1u << tileMemory.memoryTypeIndex)) == 0){
+        throw std::runtime_error("Virtual texture can't use the tile pool's memory!");
+    }
+    textures.push_back(texture);
+}
+
+void VulkanTileCache::touchTile(uint32_t tile, uint64_t frameNumber){
+    tiles[tile].lastUsedFrame = frameNumber;
+    lruTiles.splice(lruTiles.end(), lruTiles, tiles[tile].lruPosition);
+}
+
+void VulkanTileCache::unregisterTexture(VulkanVirtualTexture * texture){
+    // The image goes away with its bindings, so its tiles are free without an unbind
+    for (uint32_t tile = 0; tile < tileCount; tile++){
+        if (tiles[tile].texture == texture){
+            lruTiles.erase(tiles[tile].lruPosition);
+            tiles[tile].texture = nullptr;
+            freeTiles.push_back(tile);
+        }
+    }
+    textures.erase(std::find(textures.begin(), textures.end(), texture));
+}
+
+void VulkanTileCache::update(){
+    VulkanFrame& frame = framePacer->getCurrentFrame();
+
+    // Requested pages that are resident move to the back of the LRU list, the rest need a tile
+    struct PageLoad{
+        VulkanVirtualTexture *  texture;
+        VulkanVirtualPage       page;
+    };
+    std::vector<PageLoad> pageLoads;
+    bool pagesRequested = false;
+    for (auto texture : textures){
+        pagesRequested = pagesRequested || !texture->requestedPages.empty();
+        for (const auto& page : texture->requestedPages){
+            uint32_t tile = texture->pageTiles[texture->getPageIndex(page)];
+            if (tile != noTile){
+                touchTile(tile, frame.frameNumber);
+            }else{
+                pageLoads.push_back({texture, page});
+            }
+        }
+        texture->requestedPages.clear();
+    }
+    if (pagesRequested){
+        deviceContext->residencyManager->touch(residencyId);
+    }
+    if (pageLoads.empty()){
+        return;
+    }
+
+    // An evicted pool comes back once pages are wanted again; without the memory they stay missing
+    if (tileMemory.block == nullptr && !allocatePool()){
+        return;
+    }
+
+    // Coarser levels first, each is the fallback for the levels below it
+    std::stable_sort(pageLoads.begin(), pageLoads.end(), [](const PageLoad& pageLoadA, const PageLoad& pageLoadB){ return pageLoadA.page.mipLevel > pageLoadB.page.mipLevel; });
+
+    // Free tiles first, then the least recently used ones no frame in flight can still sample.
+    // An evicted page is unbound in the same batch, ahead of the page taking its tile
+    std::map<VulkanVirtualTexture *, std::vector<VkSparseImageMemoryBind>> textureBinds;
+    std::vector<PageLoad> boundLoads;
+    for (const auto& pageLoad : pageLoads){
+        if (boundLoads.size() == uploadTilesPerFrame){
+            break;
+        }
+
+        uint32_t tile;
+        if (!freeTiles.empty()){
+            tile = freeTiles.back();
+            freeTiles.pop_back();
+            tiles[tile].lruPosition = lruTiles.insert(lruTiles.end(), tile);
+        }else{
+            tile = lruTiles.front();
+            VulkanTile& evictedTile = tiles[tile];
+            if (!framePacer->isFrameComplete(evictedTile.lastUsedFrame)){
+                // Everything in the pool is still on screen, the rest waits for a later frame
+                break;
+            }
+
+            VulkanVirtualTexture * evictedTexture = evictedTile.texture;
+            evictedTexture->pageTiles[evictedTexture->getPageIndex(evictedTile.page)] = noTile;
+
+            VkSparseImageMemoryBind pageUnbind;
+            pageUnbind.subresource  = {VulkanImage::formatAspect(evictedTexture->format), evictedTile.page.mipLevel, 0};
+            pageUnbind.extent       = evictedTexture->getPageRegion(evictedTile.page, pageUnbind.offset);
+            pageUnbind.memory       = VK_NULL_HANDLE;
+            pageUnbind.memoryOffset = 0;
+            pageUnbind.flags        = 0;
+            textureBinds[evictedTexture].push_back(pageUnbind);
+        }
+
+        VkSparseImageMemoryBind pageBind;
+        pageBind.subresource    = {VulkanImage::formatAspect(pageLoad.texture->format), pageLoad.page.mipLevel, 0};
+        pageBind.extent         = pageLoad.texture->getPageRegion(pageLoad.page, pageBind.offset);
+        pageBind.memory         = tileMemory.memory;
+        pageBind.memoryOffset   = tileMemory.offset + tile * tileSize;
+        pageBind.flags          = 0;
+        textureBinds[pageLoad.texture].push_back(pageBind);
+
+        tiles[tile].texture = pageLoad.texture;
+        tiles[tile].page    = pageLoad.page;
+        touchTile(tile, frame.frameNumber);
+        pageLoad.texture->pageTiles[pageLoad.texture->getPageIndex(pageLoad.page)] = tile;
+        boundLoads.push_back(pageLoad);
+    }
+    if (boundLoads.empty()){
+        return;
+    }
+
+    // Binds aren't ordered with command buffers, so the frame waits on them before its copies
+    std::vector<VkSparseImageMemoryBindInfo> imageBinds;
+    for (const auto& textureBind : textureBinds){
+        VkSparseImageMemoryBindInfo imageBind;
+        imageBind.image     = textureBind.first->image->imageHandle;
+        imageBind.bindCount = textureBind.second.size();
+        imageBind.pBinds    = &textureBind.second[0];
+        imageBinds.push_back(imageBind);
+    }
+    bindSparse(imageBinds, std::vector<VkSparseImageOpaqueMemoryBindInfo>(), bindSemaphores[frame.frameIndex], VK_NULL_HANDLE);
+    framePacer->addWaitSemaphore(bindSemaphores[frame.frameIndex], VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    // Pages are loaded straight into the frame's transient buffer and copied from there
+    std::map<VulkanVirtualTexture *, std::vector<VkBufferImageCopy>> textureCopies;
+    for (const auto& pageLoad : boundLoads){
+        VkBufferImageCopy pageCopy;
+        pageCopy.bufferRowLength    = 0;
+        pageCopy.bufferImageHeight  = 0;
+        pageCopy.imageSubresource   = {VulkanImage::formatAspect(pageLoad.texture->format), pageLoad.page.mipLevel, 0, 1};
+        pageCopy.imageExtent        = pageLoad.texture->getPageRegion(pageLoad.page, pageCopy.imageOffset);
+
+        VulkanTransientAllocation pageData = framePacer->allocateTransient(VulkanImage::imageDataSize(pageLoad.texture->format, pageCopy.imageExtent), copyAlignment(pageLoad.texture->format));
+        pageLoad.texture->loader(pageLoad.page.mipLevel, pageCopy.imageOffset, pageCopy.imageExtent, pageData.mappedData);
+        pageCopy.bufferOffset       = pageData.offset;
+        textureCopies[pageLoad.texture].push_back(pageCopy);
+    }
+
+    // Levels keep their resident pages through the transitions, only the new pages are written
+    VulkanBarrierBatcher barrierBatcher(deviceContext, frame.commandBuffer);
+    for (const auto& textureCopy : textureCopies){
+        for (const auto& pageCopy : textureCopy.second){
+            VkImageSubresourceRange copyRange = {pageCopy.imageSubresource.aspectMask, pageCopy.imageSubresource.mipLevel, 1, 0, 1};
+            barrierBatcher.transition(*textureCopy.first->image, copyRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        }
+    }
+    barrierBatcher.flush();
+    for (const auto& textureCopy : textureCopies){
+        deviceContext->vkCmdCopyBufferToImage(frame.commandBuffer, framePacer->transientBuffer, textureCopy.first->image->imageHandle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                              textureCopy.second.size(), &textureCopy.second[0]);
+    }
+    for (const auto& textureCopy : textureCopies){
+        for (const auto& pageCopy : textureCopy.second){
+            VkImageSubresourceRange copyRange = {pageCopy.imageSubresource.aspectMask, pageCopy.imageSubresource.mipLevel, 1, 0, 1};
+            barrierBatcher.transition(*textureCopy.first->image, copyRange, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                      VulkanBarrierBatcher::getLayoutStages(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL), VulkanBarrierBatcher::getLayoutAccess(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+        }
+    }
+    barrierBatcher.flush();
+}
+
+VulkanVirtualTexture::VulkanVirtualTexture(VulkanTileCache * __tileCache, VkFormat __format, VkExtent2D __extent, const VulkanTileLoader& __loader, uint32_t __mipLevels, VkImageUsageFlags __usage){
+    tileCache       = __tileCache;
+    assert(tileCache != nullptr);
+    format          = __format;
+    extent          = __extent;
+    loader          = __loader;
+    mipLevels       = __mipLevels != 0 ? __mipLevels : VulkanImage::mipLevelCount({extent.width, extent.height, 1});
+    mipTailMemory   = {};
+
+    VulkanDevice * deviceContext    = tileCache->deviceContext;
+    VkImageUsageFlags usage         = __usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    VkImageCreateFlags flags        = VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT;
+    VkImageAspectFlags aspect       = VulkanImage::formatAspect(format);
+
+    // Sparse residency is per format, usage and tiling
+    uint32_t formatPropertyCount = 0;
+    deviceContext->instance->vkGetPhysicalDeviceSparseImageFormatProperties(deviceContext->getPhysicalDevice(), format, VK_IMAGE_TYPE_2D, VK_SAMPLE_COUNT_1_BIT, usage,
+                                                                             VK_IMAGE_TILING_OPTIMAL, &formatPropertyCount, nullptr);
+    if (formatPropertyCount == 0){
+        throw std::runtime_error("Format " + std::to_string(format) + " can't be sparse resident on this device!");
+    }
+
+    // Create the image unbound, wrapped so uploads and barriers track its layouts like any other
+    VkImageCreateInfo imageInfo;
+    imageInfo.sType                     = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.pNext                     = nullptr;
+    imageInfo.flags                     = flags;
+    imageInfo.imageType                 = VK_IMAGE_TYPE_2D;
+    imageInfo.format                    = format;
+    imageInfo.extent                    = {extent.width, extent.height, 1};
+    imageInfo.mipLevels                 = mipLevels;
+    imageInfo.arrayLayers               = 1;
+    imageInfo.samples                   = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling                    = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage                     = usage;
+    imageInfo.sharingMode               = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.queueFamilyIndexCount     = 0;
+    imageInfo.pQueueFamilyIndices       = nullptr;
+    imageInfo.initialLayout             = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    VkImage imageHandle;
+    assert(deviceContext->vkCreateImage(deviceContext->device, &imageInfo, nullptr, &imageHandle) == VK_SUCCESS);
+    image = new VulkanImage(deviceContext, imageHandle, usage, VK_IMAGE_TYPE_2D, format, imageInfo.extent, flags, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_TILING_OPTIMAL, mipLevels);
+    image->createImageView(VK_IMAGE_VIEW_TYPE_2D, aspect);
+
+    VkMemoryRequirements memoryRequirements;
+    deviceContext->vkGetImageMemoryRequirements(deviceContext->device, imageHandle, &memoryRequirements);
+    uint32_t sparseRequirementCount = 0;
+    deviceContext->vkGetImageSparseMemoryRequirements(deviceContext->device, imageHandle, &sparseRequirementCount, nullptr);
+    assert(sparseRequirementCount != 0);
+    std::vector<VkSparseImageMemoryRequirements> sparseRequirements(sparseRequirementCount);
+    deviceContext->vkGetImageSparseMemoryRequirements(deviceContext->device, imageHandle, &sparseRequirementCount, &sparseRequirements[0]);
+
+    // Colour is paged; metadata, where the implementation needs it, only has a mip tail
+    const VkSparseImageMemoryRequirements * colorRequirements       = nullptr;
+    const VkSparseImageMemoryRequirements * metadataRequirements    = nullptr;
+    for (const auto& requirements : sparseRequirements){
+        if (requirements.formatProperties.aspectMask & aspect){
+            colorRequirements = &requirements;
+        }
+        if (requirements.formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT){
+            metadataRequirements = &requirements;
+        }
+    }
+    assert(colorRequirements != nullptr);
+    pageExtent      = colorRequirements->formatProperties.imageGranularity;
+    mipTailFirstLod = (std::min)(colorRequirements->imageMipTailFirstLod, mipLevels);
+
+    // Page table for the levels below the tail, finest level first
+    levelPageBase.push_back(0);
+    for (uint32_t level = 0; level < mipTailFirstLod; level++){
+        uint32_t levelWidth     = (std::max)(extent.width >> level, 1u);
+        uint32_t levelHeight    = (std::max)(extent.height >> level, 1u);
+        uint32_t pagesX         = (levelWidth + pageExtent.width - 1) / pageExtent.width;
+        uint32_t pagesY         = (levelHeight + pageExtent.height - 1) / pageExtent.height;
+        levelPagesX.push_back(pagesX);
+        levelPageBase.push_back(levelPageBase.back() + pagesX * pagesY);
+    }
+    pageTiles.assign(levelPageBase.back(), noTile);
+    pageRequestFrames.assign(levelPageBase.back(), (std::numeric_limits<uint64_t>::max)());
+
+    tileCache->registerTexture(this, memoryRequirements);
+
+    // The mip tail gets memory of its own, bound for the texture's whole lifetime
+    std::vector<VkSparseMemoryBind> tailBinds;
+    std::vector<const VkSparseImageMemoryRequirements *> tailRequirements;
+    if (mipTailFirstLod < mipLevels){
+        tailRequirements.push_back(colorRequirements);
+    }
+    if (metadataRequirements != nullptr){
+        tailRequirements.push_back(metadataRequirements);
+    }
+    if (!tailRequirements.empty()){
+        VkMemoryRequirements tailMemoryRequirements = memoryRequirements;
+        tailMemoryRequirements.size = 0;
+        for (auto requirements : tailRequirements){
+            tailMemoryRequirements.size += requirements->imageMipTailSize;
+        }
+        mipTailMemory = deviceContext->allocateMemory(tailMemoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0, VULKAN_ALLOCATION_TYPE_OPTIMAL);
+        if (mipTailMemory.block == nullptr){
+            throw std::runtime_error("Unable to allocate a virtual texture mip tail!");
+        }
+
+        VkDeviceSize memoryOffset = mipTailMemory.offset;
+        for (auto requirements : tailRequirements){
+            VkSparseMemoryBind tailBind;
+            tailBind.resourceOffset = requirements->imageMipTailOffset;
+            tailBind.size           = requirements->imageMipTailSize;
+            tailBind.memory         = mipTailMemory.memory;
+            tailBind.memoryOffset   = memoryOffset;
+            tailBind.flags          = requirements == metadataRequirements ? VK_SPARSE_MEMORY_BIND_METADATA_BIT : 0;
+            tailBinds.push_back(tailBind);
+            memoryOffset += tailBind.size;
+        }
+
+        // A one-off at creation, so wait for it rather than thread a semaphore to the upload
+        VkSparseImageOpaqueMemoryBindInfo opaqueBind;
+        opaqueBind.image        = imageHandle;
+        opaqueBind.bindCount    = tailBinds.size();
+        opaqueBind.pBinds       = &tailBinds[0];
+
+        VkFenceCreateInfo fenceInfo;
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.pNext = nullptr;
+        fenceInfo.flags = 0;
+        VkFence bindFence;
+        assert(deviceContext->vkCreateFence(deviceContext->device, &fenceInfo, nullptr, &bindFence) == VK_SUCCESS);
+        tileCache->bindSparse(std::vector<VkSparseImageMemoryBindInfo>(), std::vector<VkSparseImageOpaqueMemoryBindInfo>(1, opaqueBind), VK_NULL_HANDLE, bindFence);
+        assert(deviceContext->vkWaitForFences(deviceContext->device, 1, &bindFence, VK_TRUE, (std::numeric_limits<uint64_t>::max)()) == VK_SUCCESS);
+        deviceContext->vkDestroyFence(deviceContext->device, bindFence, nullptr);
+    }
+
+    // Tail levels are small, so they go through the staging ring whole, in one copy
+    if (mipTailFirstLod < mipLevels){
+        VkDeviceSize alignment = copyAlignment(format);
+        std::vector<uint8_t> tailData;
+        std::vector<VkBufferImageCopy> tailCopies;
+        for (uint32_t level = mipTailFirstLod; level < mipLevels; level++){
+            VkBufferImageCopy levelCopy;
+            levelCopy.bufferOffset      = (tailData.size() + alignment - 1) / alignment * alignment;
+            levelCopy.bufferRowLength   = 0;
+            levelCopy.bufferImageHeight = 0;
+            levelCopy.imageSubresource  = {aspect, level, 0, 1};
+            levelCopy.imageOffset       = {0, 0, 0};
+            levelCopy.imageExtent       = {(std::max)(extent.width >> level, 1u), (std::max)(extent.height >> level, 1u), 1};
+            tailData.resize(levelCopy.bufferOffset + VulkanImage::imageDataSize(format, levelCopy.imageExtent));
+            loader(level, levelCopy.imageOffset, levelCopy.imageExtent, &tailData[levelCopy.bufferOffset]);
+            tailCopies.push_back(levelCopy);
+        }
+        image->loadImageMipChain(&tailData[0], (uint32_t)tailData.size(), tailCopies);
+    }
+}
+
+VulkanVirtualTexture::~VulkanVirtualTexture(){
+    // The device has to be idle by now, like for any other image
+    VulkanDevice * deviceContext = tileCache->deviceContext;
+    tileCache->unregisterTexture(this);
+
+    // The wrapper only owns the view
+    VkImage imageHandle = image->imageHandle;
+    delete image;
+    deviceContext->vkDestroyImage(deviceContext->device, imageHandle, nullptr);
+    if (mipTailMemory.block != nullptr){
+        deviceContext->freeMemory(mipTailMemory);
+    }
+}
+
+uint32_t VulkanVirtualTexture::getPageIndex(const VulkanVirtualPage& page){
+    assert(page.mipLevel < mipTailFirstLod);
+    assert(page.x < levelPagesX[page.mipLevel]);
+    uint32_t pageIndex = levelPageBase[page.mipLevel] + page.y * levelPagesX[page.mipLevel] + page.x;
+    assert(pageIndex < levelPageBase[page.mipLevel + 1]);
+    return pageIndex;
+}
+
+VkExtent3D VulkanVirtualTexture::getPageRegion(const VulkanVirtualPage& page, VkOffset3D& offset){
+    // Pages on the right and bottom edges stop at the edge of the level
+    uint32_t levelWidth     = (std::max)(extent.width >> page.mipLevel, 1u);
+    uint32_t levelHeight    = (std::max)(extent.height >> page.mipLevel, 1u);
+    offset = {(int32_t)(page.x * pageExtent.width), (int32_t)(page.y * pageExtent.height), 0};
+    return {(std::min)(pageExtent.width, levelWidth - offset.x), (std::min)(pageExtent.height, levelHeight - offset.y), 1};
+}
+
+uint32_t VulkanVirtualTexture::getResidentLod(const VulkanVirtualPage& page){
+    // Finest level with texels over the page, walking up its parents to the tail
+    VulkanVirtualPage parentPage = page;
+    for (; parentPage.mipLevel < mipTailFirstLod; parentPage.mipLevel++, parentPage.x /= 2, parentPage.y /= 2){
+        if (pageTiles[getPageIndex(parentPage)] != noTile){
+            return parentPage.mipLevel;
+        }
+    }
+    return mipTailFirstLod;
+}
+
+bool VulkanVirtualTexture::isPageResident(const VulkanVirtualPage& page){
+    return page.mipLevel >= mipTailFirstLod || pageTiles[getPageIndex(page)] != noTile;
+}
+
+void VulkanVirtualTexture::requestPage(const VulkanVirtualPage& page){
+    // Every coarser page over it comes along, so the fallback is never missing
+    uint64_t frameNumber = tileCache->framePacer->getCurrentFrame().frameNumber;
+    VulkanVirtualPage parentPage = page;
+    for (; parentPage.mipLevel < mipTailFirstLod; parentPage.mipLevel++, parentPage.x /= 2, parentPage.y /= 2){
+        uint32_t pageIndex = getPageIndex(parentPage);
+        if (pageRequestFrames[pageIndex] == frameNumber){
+            // Already requested this frame, and so are its parents
+            break;
+        }
+        pageRequestFrames[pageIndex] = frameNumber;
+        requestedPages.push_back(parentPage);
+    }
+}
+
+void VulkanVirtualTexture::requestRegion(uint32_t mipLevel, VkRect2D region){
+    // Region is in texels of mipLevel, clamped to the level
+    if (mipLevel >= mipTailFirstLod || region.extent.width == 0 || region.extent.height == 0){
+        return;
+    }
+    uint32_t levelWidth     = (std::max)(extent.width >> mipLevel, 1u);
+    uint32_t levelHeight    = (std::max)(extent.height >> mipLevel, 1u);
+    uint32_t firstX         = (uint32_t)(std::max)(region.offset.x, 0);
+    uint32_t firstY         = (uint32_t)(std::max)(region.offset.y, 0);
+    if (firstX >= levelWidth || firstY >= levelHeight){
+        return;
+    }
+    uint32_t lastX = (std::min)((uint32_t)region.offset.x + region.extent.width, levelWidth) - 1;
+    uint32_t lastY = (std::min)((uint32_t)region.offset.y + region.extent.height, levelHeight) - 1;
+
+    for (uint32_t pageY = firstY / pageExtent.height; pageY <= lastY / pageExtent.height; pageY++){
+        for (uint32_t pageX = firstX / pageExtent.width; pageX <= lastX / pageExtent.width; pageX++){
+            requestPage({mipLevel, pageX, pageY});
+        }
+    }
+}
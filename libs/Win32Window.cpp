@@ -104,9 +104,8 @@ LRESULT CALLBACK Win32Window::handleMessage(HWND hWnd, UINT uMsg, WPARAM wParam,
         case WM_DESTROY: 
             // Clean up window-specific data objects. 
             std::cout << "Callback: WM_DESTROY" << std::endl;
-            DestroyWindow(hWnd);
+            // WM_QUIT ends the demo's message loop, which shuts down and saves the pipeline cache
             PostQuitMessage(0);
-            exit(0);
             break; 
         case WM_SIZE:
             std::cout << "Callback: WM_SIZE" << std::endl;
@@ -46,6 +46,18 @@ XcbWindow::XcbWindow(const uint32_t _windowWidth,
         screen->root_visual,
         XCB_CW_EVENT_MASK | XCB_CW_BACK_PIXEL, value_list);
 
+    // Have the window manager send WM_DELETE_WINDOW on close instead of killing the connection,
+    // so demos can leave their loop and shut down cleanly
+    xcb_intern_atom_cookie_t protocolsCookie    = xcb_intern_atom(connection, 1, 12, "WM_PROTOCOLS");
+    xcb_intern_atom_cookie_t deleteWindowCookie = xcb_intern_atom(connection, 0, 16, "WM_DELETE_WINDOW");
+    xcb_intern_atom_reply_t * protocolsReply    = xcb_intern_atom_reply(connection, protocolsCookie, nullptr);
+    xcb_intern_atom_reply_t * deleteWindowReply = xcb_intern_atom_reply(connection, deleteWindowCookie, nullptr);
+    assert(protocolsReply != nullptr && deleteWindowReply != nullptr);
+    deleteWindowAtom = deleteWindowReply->atom;
+    xcb_change_property(connection, XCB_PROP_MODE_REPLACE, windowHandle, protocolsReply->atom, XCB_ATOM_ATOM, 32, 1, &deleteWindowAtom);
+    free(protocolsReply);
+    free(deleteWindowReply);
+
     // Map
     xcb_map_window(connection, windowHandle);
     xcb_flush(connection);
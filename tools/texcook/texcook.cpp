@@ -0,0 +1,790 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cctype>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define TEXCOOK_SSE2
+#endif
+#ifndef STB_IMAGE_IMPLEMENTATION
+    #define STB_IMAGE_IMPLEMENTATION
+    #include <stb/stb_image.h>
+#endif
+#include "VulkanKtxTexture.h"
+
+#define MILLISECONDS_TO_SECONDS 1000
+
+// Data Format Descriptor values from the Khronos Data Format specification
+#define KHR_DF_MODEL_RGBSDA         1
+#define KHR_DF_MODEL_BC1A           128
+#define KHR_DF_MODEL_BC3            130
+#define KHR_DF_MODEL_BC4            131
+#define KHR_DF_MODEL_BC5            132
+#define KHR_DF_MODEL_BC7            134
+#define KHR_DF_PRIMARIES_BT709      1
+#define KHR_DF_TRANSFER_LINEAR      1
+#define KHR_DF_TRANSFER_SRGB        2
+#define KHR_DF_CHANNEL_ALPHA        15
+#define KHR_DF_SAMPLE_LINEAR        0x10
+
+enum CookFormat{
+    COOK_FORMAT_BC1     = 0,    // Opaque colour
+    COOK_FORMAT_BC3     = 1,    // Colour and alpha
+    COOK_FORMAT_BC4     = 2,    // One channel, masks and heights
+    COOK_FORMAT_BC5     = 3,    // Two channels, tangent space normals
+    COOK_FORMAT_BC7     = 4,    // Colour and alpha at higher quality
+    COOK_FORMAT_RGBA8   = 5     // Uncompressed
+};
+
+struct CookOptions{
+    CookFormat                  format;
+    bool                        srgb;           // Colour is sRGB encoded, so filter in linear space
+    uint32_t                    threadCount;
+    std::string                 outputDirectory;
+};
+
+// One mip level, 8 bits per channel as it will be stored
+struct CookLevel{
+    uint32_t                    width;
+    uint32_t                    height;
+    std::vector<uint8_t>        texels;         // RGBA
+    std::vector<uint8_t>        blocks;         // Encoded
+};
+
+///////////////////////////////////////
+// Threading
+///////////////////////////////////////
+
+static void parallelFor(uint32_t count, uint32_t threadCount, const std::function<void(uint32_t)>& body){
+    // Workers pull indices until none are left, so uneven work still spreads over every core
+    std::atomic<uint32_t> nextIndex(0);
+    auto worker = [&](){
+        for (uint32_t index = nextIndex++; index < count; index = nextIndex++){
+            body(index);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 1; thread < (std::min)(threadCount, count); thread++){
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads){
+        thread.join();
+    }
+}
+
+///////////////////////////////////////
+// Loading
+///////////////////////////////////////
+
+static bool endsWith(std::string value, const std::string& suffix){
+    std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    return value.size() >= suffix.size() && value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static bool loadTiff(const std::string& fileName, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba){
+    // Baseline TIFF only: uncompressed, 8 bits per sample, interleaved strips
+    std::ifstream tiffFile(fileName, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(tiffFile)), std::istreambuf_iterator<char>());
+    if (data.size() < 8 || (data[0] != 'I' && data[0] != 'M')){
+        return false;
+    }
+    bool bigEndian = data[0] == 'M';
+    auto read16 = [&](size_t offset) -> uint32_t{
+        return bigEndian ? (uint32_t)((data[offset] << 8) | data[offset + 1]) : (uint32_t)(data[offset] | (data[offset + 1] << 8));
+    };
+    auto read32 = [&](size_t offset) -> uint32_t{
+        return bigEndian ? (read16(offset) << 16) | read16(offset + 2) : read16(offset) | (read16(offset + 2) << 16);
+    };
+    if (read16(2) != 42){
+        return false;
+    }
+
+    // Tag values are stored inline when they fit in 4 bytes
+    auto readValues = [&](size_t entryOffset) -> std::vector<uint32_t>{
+        uint32_t type           = read16(entryOffset + 2);
+        uint32_t count          = read32(entryOffset + 4);
+        uint32_t valueSize      = type == 3 ? 2 : 4;
+        size_t valueOffset      = count * valueSize <= 4 ? entryOffset + 8 : read32(entryOffset + 8);
+        std::vector<uint32_t> values;
+        for (uint32_t valueIndex = 0; valueIndex < count && valueOffset + (valueIndex + 1) * valueSize <= data.size(); valueIndex++){
+            values.push_back(valueSize == 2 ? read16(valueOffset + valueIndex * 2) : read32(valueOffset + valueIndex * 4));
+        }
+        return values;
+    };
+
+    uint32_t bitsPerSample = 8, compression = 1, photometric = 2, samplesPerPixel = 1, planarConfiguration = 1;
+    std::vector<uint32_t> stripOffsets, stripByteCounts;
+    width = height = 0;
+    size_t ifdOffset = read32(4);
+    uint32_t entryCount = read16(ifdOffset);
+    for (uint32_t entry = 0; entry < entryCount; entry++){
+        size_t entryOffset = ifdOffset + 2 + entry * 12;
+        std::vector<uint32_t> values = readValues(entryOffset);
+        if (values.empty()){
+            continue;
+        }
+        switch (read16(entryOffset)){
+            case 256: width                 = values[0]; break;
+            case 257: height                = values[0]; break;
+            case 258: bitsPerSample         = values[0]; break;
+            case 259: compression           = values[0]; break;
+            case 262: photometric           = values[0]; break;
+            case 273: stripOffsets          = values; break;
+            case 277: samplesPerPixel       = values[0]; break;
+            case 279: stripByteCounts       = values; break;
+            case 284: planarConfiguration   = values[0]; break;
+            default: break;
+        }
+    }
+    if (width == 0 || height == 0 || bitsPerSample != 8 || compression != 1 || planarConfiguration != 1 || (photometric != 1 && photometric != 2) ||
+        stripOffsets.size() != stripByteCounts.size()){
+        std::cout << fileName << ": only uncompressed 8-bit RGB and greyscale TIFFs are supported" << std::endl;
+        return false;
+    }
+
+    // Strips hold consecutive rows
+    std::vector<uint8_t> samples;
+    for (size_t strip = 0; strip < stripOffsets.size(); strip++){
+        if ((size_t)stripOffsets[strip] + stripByteCounts[strip] > data.size()){
+            return false;
+        }
+        samples.insert(samples.end(), data.begin() + stripOffsets[strip], data.begin() + stripOffsets[strip] + stripByteCounts[strip]);
+    }
+    if (samples.size() < (size_t)width * height * samplesPerPixel){
+        return false;
+    }
+
+    rgba.resize((size_t)width * height * 4);
+    for (size_t texel = 0; texel < (size_t)width * height; texel++){
+        const uint8_t * sample = &samples[texel * samplesPerPixel];
+        bool colour = photometric == 2 && samplesPerPixel >= 3;
+        rgba[texel * 4 + 0] = sample[0];
+        rgba[texel * 4 + 1] = colour ? sample[1] : sample[0];
+        rgba[texel * 4 + 2] = colour ? sample[2] : sample[0];
+        rgba[texel * 4 + 3] = samplesPerPixel == 4 || samplesPerPixel == 2 ? sample[samplesPerPixel - 1] : 255;
+    }
+    return true;
+}
+
+static bool loadImage(const std::string& fileName, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba){
+    if (endsWith(fileName, ".tif") || endsWith(fileName, ".tiff")){
+        return loadTiff(fileName, width, height, rgba);
+    }
+
+    int x, y, numChannels;
+    stbi_uc * imageData = stbi_load(fileName.c_str(), &x, &y, &numChannels, STBI_rgb_alpha);
+    if (imageData == nullptr){
+        return false;
+    }
+    width   = (uint32_t)x;
+    height  = (uint32_t)y;
+    rgba.assign(imageData, imageData + (size_t)x * y * 4);
+    stbi_image_free(imageData);
+    return true;
+}
+
+///////////////////////////////////////
+// Mip generation
+///////////////////////////////////////
+
+static float srgbToLinear(float value){
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float value){
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+}
+
+static void buildMipChain(std::vector<CookLevel>& levels, bool srgb, uint32_t threadCount){
+    // Colour channels are averaged in linear space; alpha and linear data as stored
+    float decodeTable[256];
+    for (uint32_t value = 0; value < 256; value++){
+        decodeTable[value] = srgb ? srgbToLinear(value / 255.0f) : value / 255.0f;
+    }
+
+    while (levels.back().width > 1 || levels.back().height > 1){
+        const CookLevel& source = levels.back();
+        CookLevel level;
+        level.width     = (std::max)(source.width / 2, 1u);
+        level.height    = (std::max)(source.height / 2, 1u);
+        level.texels.resize((size_t)level.width * level.height * 4);
+
+        parallelFor(level.height, threadCount, [&](uint32_t y){
+            uint32_t y0 = (std::min)(y * 2, source.height - 1);
+            uint32_t y1 = (std::min)(y * 2 + 1, source.height - 1);
+            for (uint32_t x = 0; x < level.width; x++){
+                uint32_t x0 = (std::min)(x * 2, source.width - 1);
+                uint32_t x1 = (std::min)(x * 2 + 1, source.width - 1);
+                const uint8_t * quad[4] = {&source.texels[((size_t)y0 * source.width + x0) * 4], &source.texels[((size_t)y0 * source.width + x1) * 4],
+                                           &source.texels[((size_t)y1 * source.width + x0) * 4], &source.texels[((size_t)y1 * source.width + x1) * 4]};
+                uint8_t * texel = &level.texels[((size_t)y * level.width + x) * 4];
+                for (uint32_t channel = 0; channel < 3; channel++){
+                    float sum = decodeTable[quad[0][channel]] + decodeTable[quad[1][channel]] + decodeTable[quad[2][channel]] + decodeTable[quad[3][channel]];
+                    float value = srgb ? linearToSrgb(sum / 4.0f) : sum / 4.0f;
+                    texel[channel] = (uint8_t)(std::min)(value * 255.0f + 0.5f, 255.0f);
+                }
+                texel[3] = (uint8_t)((quad[0][3] + quad[1][3] + quad[2][3] + quad[3][3] + 2) / 4);
+            }
+        });
+        levels.push_back(level);
+    }
+}
+
+///////////////////////////////////////
+// Block encoding
+///////////////////////////////////////
+
+// Picks the closest palette entry for each of the 16 texels of a block, returning the total error.
+// Texels are stored channel by channel so four texels go through the SSE2 path at once.
+static float selectIndices(const float texels[4][16], const float palette[][4], uint32_t paletteSize, uint32_t channelCount, uint8_t indices[16]){
+    float totalError = 0.0f;
+#ifdef TEXCOOK_SSE2
+    for (uint32_t group = 0; group < 16; group += 4){
+        __m128 bestError = _mm_set1_ps(FLT_MAX);
+        __m128 bestIndex = _mm_setzero_ps();
+        for (uint32_t entry = 0; entry < paletteSize; entry++){
+            __m128 error = _mm_setzero_ps();
+            for (uint32_t channel = 0; channel < channelCount; channel++){
+                __m128 difference = _mm_sub_ps(_mm_loadu_ps(&texels[channel][group]), _mm_set1_ps(palette[entry][channel]));
+                error = _mm_add_ps(error, _mm_mul_ps(difference, difference));
+            }
+            __m128 better = _mm_cmplt_ps(error, bestError);
+            bestError = _mm_min_ps(error, bestError);
+            bestIndex = _mm_or_ps(_mm_and_ps(better, _mm_set1_ps((float)entry)), _mm_andnot_ps(better, bestIndex));
+        }
+
+        float groupIndices[4];
+        float groupErrors[4];
+        _mm_storeu_ps(groupIndices, bestIndex);
+        _mm_storeu_ps(groupErrors, bestError);
+        for (uint32_t texel = 0; texel < 4; texel++){
+            indices[group + texel] = (uint8_t)groupIndices[texel];
+            totalError += groupErrors[texel];
+        }
+    }
+#else
+    for (uint32_t texel = 0; texel < 16; texel++){
+        float bestError = FLT_MAX;
+        for (uint32_t entry = 0; entry < paletteSize; entry++){
+            float error = 0.0f;
+            for (uint32_t channel = 0; channel < channelCount; channel++){
+                float difference = texels[channel][texel] - palette[entry][channel];
+                error += difference * difference;
+            }
+            if (error < bestError){
+                bestError = error;
+                indices[texel] = (uint8_t)entry;
+            }
+        }
+        totalError += bestError;
+    }
+#endif
+    return totalError;
+}
+
+static void findEndpoints(const float texels[4][16], uint32_t channelCount, float endpoint0[4], float endpoint1[4]){
+    // Endpoints span the texels along their principal axis, found by power iteration
+    float mean[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (uint32_t channel = 0; channel < channelCount; channel++){
+        for (uint32_t texel = 0; texel < 16; texel++){
+            mean[channel] += texels[channel][texel] / 16.0f;
+        }
+    }
+
+    float covariance[4][4] = {};
+    for (uint32_t texel = 0; texel < 16; texel++){
+        for (uint32_t row = 0; row < channelCount; row++){
+            for (uint32_t column = 0; column < channelCount; column++){
+                covariance[row][column] += (texels[row][texel] - mean[row]) * (texels[column][texel] - mean[column]);
+            }
+        }
+    }
+
+    float axis[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+    for (uint32_t iteration = 0; iteration < 8; iteration++){
+        float nextAxis[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        float length = 0.0f;
+        for (uint32_t row = 0; row < channelCount; row++){
+            for (uint32_t column = 0; column < channelCount; column++){
+                nextAxis[row] += covariance[row][column] * axis[column];
+            }
+            length += nextAxis[row] * nextAxis[row];
+        }
+        if (length < 1e-6f){
+            break;
+        }
+        for (uint32_t channel = 0; channel < channelCount; channel++){
+            axis[channel] = nextAxis[channel] / std::sqrt(length);
+        }
+    }
+
+    float minimum = FLT_MAX, maximum = -FLT_MAX;
+    for (uint32_t texel = 0; texel < 16; texel++){
+        float projection = 0.0f;
+        for (uint32_t channel = 0; channel < channelCount; channel++){
+            projection += (texels[channel][texel] - mean[channel]) * axis[channel];
+        }
+        minimum = (std::min)(minimum, projection);
+        maximum = (std::max)(maximum, projection);
+    }
+    for (uint32_t channel = 0; channel < channelCount; channel++){
+        endpoint0[channel] = (std::min)((std::max)(mean[channel] + axis[channel] * maximum, 0.0f), 255.0f);
+        endpoint1[channel] = (std::min)((std::max)(mean[channel] + axis[channel] * minimum, 0.0f), 255.0f);
+    }
+}
+
+static uint16_t packColor565(const float color[4]){
+    uint32_t red    = (uint32_t)(color[0] * 31.0f / 255.0f + 0.5f);
+    uint32_t green  = (uint32_t)(color[1] * 63.0f / 255.0f + 0.5f);
+    uint32_t blue   = (uint32_t)(color[2] * 31.0f / 255.0f + 0.5f);
+    return (uint16_t)((red << 11) | (green << 5) | blue);
+}
+
+static void unpackColor565(uint16_t color, float unpacked[4]){
+    uint32_t red    = (color >> 11) & 0x1F;
+    uint32_t green  = (color >> 5) & 0x3F;
+    uint32_t blue   = color & 0x1F;
+    unpacked[0]     = (float)((red << 3) | (red >> 2));
+    unpacked[1]     = (float)((green << 2) | (green >> 4));
+    unpacked[2]     = (float)((blue << 3) | (blue >> 2));
+    unpacked[3]     = 255.0f;
+}
+
+static float encodeColorEndpoints(const float texels[4][16], uint16_t color0, uint16_t color1, uint8_t indices[16]){
+    // Four-colour mode: both endpoints and two thirds between them
+    float palette[4][4];
+    unpackColor565(color0, palette[0]);
+    unpackColor565(color1, palette[1]);
+    for (uint32_t channel = 0; channel < 3; channel++){
+        palette[2][channel] = (float)(((uint32_t)(2 * palette[0][channel] + palette[1][channel]) + 1) / 3);
+        palette[3][channel] = (float)(((uint32_t)(palette[0][channel] + 2 * palette[1][channel]) + 1) / 3);
+    }
+    return selectIndices(texels, palette, 4, 3, indices);
+}
+
+static void encodeBC1(const float texels[4][16], uint8_t * block){
+    float endpoint0[4], endpoint1[4];
+    findEndpoints(texels, 3, endpoint0, endpoint1);
+    uint16_t color0 = packColor565(endpoint0);
+    uint16_t color1 = packColor565(endpoint1);
+
+    uint8_t indices[16];
+    float error = encodeColorEndpoints(texels, color0, color1, indices);
+
+    // One least-squares pass over the endpoints, given the chosen indices
+    static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    float alphaAlpha = 0.0f, alphaBeta = 0.0f, betaBeta = 0.0f;
+    float alphaTexel[3] = {0.0f, 0.0f, 0.0f}, betaTexel[3] = {0.0f, 0.0f, 0.0f};
+    for (uint32_t texel = 0; texel < 16; texel++){
+        float alpha = weights[indices[texel]];
+        float beta  = 1.0f - alpha;
+        alphaAlpha += alpha * alpha;
+        alphaBeta  += alpha * beta;
+        betaBeta   += beta * beta;
+        for (uint32_t channel = 0; channel < 3; channel++){
+            alphaTexel[channel] += alpha * texels[channel][texel];
+            betaTexel[channel]  += beta * texels[channel][texel];
+        }
+    }
+    float determinant = alphaAlpha * betaBeta - alphaBeta * alphaBeta;
+    if (std::fabs(determinant) > 1e-6f){
+        float refined0[4], refined1[4];
+        for (uint32_t channel = 0; channel < 3; channel++){
+            refined0[channel] = (std::min)((std::max)((alphaTexel[channel] * betaBeta - betaTexel[channel] * alphaBeta) / determinant, 0.0f), 255.0f);
+            refined1[channel] = (std::min)((std::max)((betaTexel[channel] * alphaAlpha - alphaTexel[channel] * alphaBeta) / determinant, 0.0f), 255.0f);
+        }
+        uint16_t refinedColor0 = packColor565(refined0);
+        uint16_t refinedColor1 = packColor565(refined1);
+        uint8_t refinedIndices[16];
+        if (encodeColorEndpoints(texels, refinedColor0, refinedColor1, refinedIndices) < error){
+            color0 = refinedColor0;
+            color1 = refinedColor1;
+            memcpy(indices, refinedIndices, sizeof(indices));
+        }
+    }
+
+    // Four-colour mode needs the larger endpoint first; swapping mirrors the indices
+    static const uint8_t swappedIndices[4] = {1, 0, 3, 2};
+    if (color0 < color1){
+        std::swap(color0, color1);
+        for (auto& index : indices){
+            index = swappedIndices[index];
+        }
+    }else if (color0 == color1){
+        memset(indices, 0, sizeof(indices));
+    }
+
+    uint32_t packedIndices = 0;
+    for (uint32_t texel = 0; texel < 16; texel++){
+        packedIndices |= (uint32_t)indices[texel] << (texel * 2);
+    }
+    block[0] = (uint8_t)(color0 & 0xFF);
+    block[1] = (uint8_t)(color0 >> 8);
+    block[2] = (uint8_t)(color1 & 0xFF);
+    block[3] = (uint8_t)(color1 >> 8);
+    for (uint32_t byte = 0; byte < 4; byte++){
+        block[4 + byte] = (uint8_t)(packedIndices >> (byte * 8));
+    }
+}
+
+static void encodeBC4(const float values[16], uint8_t * block){
+    // Eight-value mode, from the brightest value down to the darkest
+    float minimum = 255.0f, maximum = 0.0f;
+    for (uint32_t texel = 0; texel < 16; texel++){
+        minimum = (std::min)(minimum, values[texel]);
+        maximum = (std::max)(maximum, values[texel]);
+    }
+    uint32_t value0 = (uint32_t)(maximum + 0.5f);
+    uint32_t value1 = (uint32_t)(minimum + 0.5f);
+
+    uint8_t indices[16] = {};
+    if (value0 > value1){
+        float palette[8][4];
+        palette[0][0] = (float)value0;
+        palette[1][0] = (float)value1;
+        for (uint32_t step = 1; step < 7; step++){
+            palette[step + 1][0] = (float)(((7 - step) * value0 + step * value1) / 7);
+        }
+        float channelTexels[4][16];
+        memcpy(channelTexels[0], values, sizeof(channelTexels[0]));
+        selectIndices(channelTexels, palette, 8, 1, indices);
+    }
+
+    uint64_t packedIndices = 0;
+    for (uint32_t texel = 0; texel < 16; texel++){
+        packedIndices |= (uint64_t)indices[texel] << (texel * 3);
+    }
+    block[0] = (uint8_t)value0;
+    block[1] = (uint8_t)value1;
+    for (uint32_t byte = 0; byte < 6; byte++){
+        block[2 + byte] = (uint8_t)(packedIndices >> (byte * 8));
+    }
+}
+
+static void writeBits(uint8_t * block, uint32_t& bitPosition, uint32_t value, uint32_t bitCount){
+    for (uint32_t bit = 0; bit < bitCount; bit++, bitPosition++){
+        block[bitPosition / 8] |= (uint8_t)(((value >> bit) & 1) << (bitPosition % 8));
+    }
+}
+
+static void encodeBC7(const float texels[4][16], uint8_t * block){
+    // Mode 6: one subset, 7-bit RGBA endpoints with a shared low bit each, 4-bit indices
+    static const uint32_t weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+    float endpoints[2][4];
+    findEndpoints(texels, 4, endpoints[0], endpoints[1]);
+
+    uint32_t quantized[2][4];
+    uint32_t pBits[2];
+    for (uint32_t endpoint = 0; endpoint < 2; endpoint++){
+        float bestError = FLT_MAX;
+        for (uint32_t pBit = 0; pBit < 2; pBit++){
+            uint32_t candidate[4];
+            float error = 0.0f;
+            for (uint32_t channel = 0; channel < 4; channel++){
+                float value = (endpoints[endpoint][channel] - pBit) / 2.0f + 0.5f;
+                candidate[channel] = (uint32_t)(std::min)((std::max)(value, 0.0f), 127.0f);
+                float difference = (float)((candidate[channel] << 1) | pBit) - endpoints[endpoint][channel];
+                error += difference * difference;
+            }
+            if (error < bestError){
+                bestError = error;
+                pBits[endpoint] = pBit;
+                memcpy(quantized[endpoint], candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    float palette[16][4];
+    for (uint32_t entry = 0; entry < 16; entry++){
+        for (uint32_t channel = 0; channel < 4; channel++){
+            uint32_t value0 = (quantized[0][channel] << 1) | pBits[0];
+            uint32_t value1 = (quantized[1][channel] << 1) | pBits[1];
+            palette[entry][channel] = (float)(((64 - weights[entry]) * value0 + weights[entry] * value1 + 32) >> 6);
+        }
+    }
+    uint8_t indices[16];
+    selectIndices(texels, palette, 16, 4, indices);
+
+    // The first index has an implied zero top bit; swapping the endpoints mirrors the indices
+    if (indices[0] >= 8){
+        std::swap(quantized[0], quantized[1]);
+        std::swap(pBits[0], pBits[1]);
+        for (auto& index : indices){
+            index = (uint8_t)(15 - index);
+        }
+    }
+
+    memset(block, 0, 16);
+    uint32_t bitPosition = 0;
+    writeBits(block, bitPosition, 1 << 6, 7);
+    for (uint32_t channel = 0; channel < 4; channel++){
+        writeBits(block, bitPosition, quantized[0][channel], 7);
+        writeBits(block, bitPosition, quantized[1][channel], 7);
+    }
+    writeBits(block, bitPosition, pBits[0], 1);
+    writeBits(block, bitPosition, pBits[1], 1);
+    writeBits(block, bitPosition, indices[0], 3);
+    for (uint32_t texel = 1; texel < 16; texel++){
+        writeBits(block, bitPosition, indices[texel], 4);
+    }
+    assert(bitPosition == 128);
+}
+
+static uint32_t getBlockSize(CookFormat format){
+    return (format == COOK_FORMAT_BC1 || format == COOK_FORMAT_BC4) ? 8 : 16;
+}
+
+static void encodeLevel(CookLevel& level, CookFormat format, uint32_t threadCount){
+    if (format == COOK_FORMAT_RGBA8){
+        level.blocks = level.texels;
+        return;
+    }
+
+    uint32_t blockSize  = getBlockSize(format);
+    uint32_t blocksWide = (level.width + 3) / 4;
+    uint32_t blocksHigh = (level.height + 3) / 4;
+    level.blocks.resize((size_t)blocksWide * blocksHigh * blockSize);
+
+    parallelFor(blocksHigh, threadCount, [&](uint32_t blockY){
+        for (uint32_t blockX = 0; blockX < blocksWide; blockX++){
+            // Gather the block channel by channel, repeating edge texels into partial blocks
+            float texels[4][16];
+            for (uint32_t texel = 0; texel < 16; texel++){
+                uint32_t x = (std::min)(blockX * 4 + texel % 4, level.width - 1);
+                uint32_t y = (std::min)(blockY * 4 + texel / 4, level.height - 1);
+                for (uint32_t channel = 0; channel < 4; channel++){
+                    texels[channel][texel] = level.texels[((size_t)y * level.width + x) * 4 + channel];
+                }
+            }
+
+            uint8_t * block = &level.blocks[((size_t)blockY * blocksWide + blockX) * blockSize];
+            switch (format){
+                case COOK_FORMAT_BC1:
+                    encodeBC1(texels, block);
+                    break;
+                case COOK_FORMAT_BC3:
+                    encodeBC4(texels[3], block);
+                    encodeBC1(texels, block + 8);
+                    break;
+                case COOK_FORMAT_BC4:
+                    encodeBC4(texels[0], block);
+                    break;
+                case COOK_FORMAT_BC5:
+                    encodeBC4(texels[0], block);
+                    encodeBC4(texels[1], block + 8);
+                    break;
+                default:
+                    encodeBC7(texels, block);
+                    break;
+            }
+        }
+    });
+}
+
+///////////////////////////////////////
+// KTX2 output
+///////////////////////////////////////
+
+static VkFormat getVulkanFormat(CookFormat format, bool srgb){
+    switch (format){
+        case COOK_FORMAT_BC1:   return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        case COOK_FORMAT_BC3:   return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+        case COOK_FORMAT_BC4:   return VK_FORMAT_BC4_UNORM_BLOCK;
+        case COOK_FORMAT_BC5:   return VK_FORMAT_BC5_UNORM_BLOCK;
+        case COOK_FORMAT_BC7:   return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        default:                return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    }
+}
+
+static std::vector<uint32_t> buildDataFormatDescriptor(CookFormat format, bool srgb){
+    // Basic descriptor block: which channels live where in each texel block
+    struct Sample{ uint32_t channel; uint32_t bitOffset; uint32_t bitLength; };
+    static const Sample bc1Samples[]    = {{0, 0, 64}};
+    static const Sample bc3Samples[]    = {{KHR_DF_CHANNEL_ALPHA, 0, 64}, {0, 64, 64}};
+    static const Sample bc5Samples[]    = {{0, 0, 64}, {1, 64, 64}};
+    static const Sample bc7Samples[]    = {{0, 0, 128}};
+    static const Sample rgba8Samples[]  = {{0, 0, 8}, {1, 8, 8}, {2, 16, 8}, {KHR_DF_CHANNEL_ALPHA, 24, 8}};
+    const Sample * samples  = rgba8Samples;
+    uint32_t sampleCount    = 4;
+    uint32_t colorModel     = KHR_DF_MODEL_RGBSDA;
+    switch (format){
+        case COOK_FORMAT_BC1:   colorModel = KHR_DF_MODEL_BC1A; samples = bc1Samples; sampleCount = 1; break;
+        case COOK_FORMAT_BC3:   colorModel = KHR_DF_MODEL_BC3;  samples = bc3Samples; sampleCount = 2; break;
+        case COOK_FORMAT_BC4:   colorModel = KHR_DF_MODEL_BC4;  samples = bc1Samples; sampleCount = 1; break;
+        case COOK_FORMAT_BC5:   colorModel = KHR_DF_MODEL_BC5;  samples = bc5Samples; sampleCount = 2; break;
+        case COOK_FORMAT_BC7:   colorModel = KHR_DF_MODEL_BC7;  samples = bc7Samples; sampleCount = 1; break;
+        default: break;
+    }
+    bool blockCompressed    = format != COOK_FORMAT_RGBA8;
+    uint32_t blockBytes     = blockCompressed ? getBlockSize(format) : 4;
+    uint32_t blockSize      = 24 + 16 * sampleCount;
+
+    std::vector<uint32_t> descriptor;
+    descriptor.push_back(4 + blockSize);                                                            // dfdTotalSize
+    descriptor.push_back(0);                                                                        // Khronos vendor, basic block
+    descriptor.push_back(2 | (blockSize << 16));                                                    // Version 1.3, block size
+    descriptor.push_back(colorModel | (KHR_DF_PRIMARIES_BT709 << 8) | ((srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16));
+    descriptor.push_back(blockCompressed ? (3 | (3 << 8)) : 0);                                     // Texel block dimensions minus one
+    descriptor.push_back(blockBytes);                                                               // Bytes in plane 0
+    descriptor.push_back(0);
+    for (uint32_t sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++){
+        const Sample& sample = samples[sampleIndex];
+        uint32_t qualifiers = (srgb && sample.channel == KHR_DF_CHANNEL_ALPHA) ? KHR_DF_SAMPLE_LINEAR : 0;
+        descriptor.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | ((sample.channel | qualifiers) << 24));
+        descriptor.push_back(0);                                                                    // Sample position
+        descriptor.push_back(0);                                                                    // Lower
+        descriptor.push_back(blockCompressed ? 0xFFFFFFFF : 0xFF);                                  // Upper
+    }
+    return descriptor;
+}
+
+static bool writeKtx2(const std::string& fileName, const std::vector<CookLevel>& levels, CookFormat format, bool srgb){
+    std::vector<uint32_t> descriptor = buildDataFormatDescriptor(format, srgb);
+    uint32_t levelCount = (uint32_t)levels.size();
+
+    VulkanKtx2Header header;
+    static const uint8_t identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    memcpy(header.identifier, identifier, sizeof(identifier));
+    header.vkFormat                 = getVulkanFormat(format, srgb);
+    header.typeSize                 = 1;
+    header.pixelWidth               = levels[0].width;
+    header.pixelHeight              = levels[0].height;
+    header.pixelDepth               = 0;
+    header.layerCount               = 0;
+    header.faceCount                = 1;
+    header.levelCount               = levelCount;
+    header.supercompressionScheme   = 0;
+    header.dfdByteOffset            = (uint32_t)(sizeof(VulkanKtx2Header) + levelCount * sizeof(VulkanKtx2Level));
+    header.dfdByteLength            = (uint32_t)(descriptor.size() * sizeof(uint32_t));
+    header.kvdByteOffset            = 0;
+    header.kvdByteLength            = 0;
+    header.sgdByteOffset            = 0;
+    header.sgdByteLength            = 0;
+
+    // Level data is stored smallest first, each level aligned to the block size
+    uint64_t alignment = format == COOK_FORMAT_RGBA8 ? 4 : getBlockSize(format);
+    uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+    std::vector<VulkanKtx2Level> levelIndex(levelCount);
+    for (uint32_t level = levelCount; level-- > 0;){
+        offset = ((offset + alignment - 1) / alignment) * alignment;
+        levelIndex[level].byteOffset                = offset;
+        levelIndex[level].byteLength                = levels[level].blocks.size();
+        levelIndex[level].uncompressedByteLength    = levels[level].blocks.size();
+        offset += levels[level].blocks.size();
+    }
+
+    std::ofstream ktxFile(fileName, std::ios::binary | std::ios::trunc);
+    if (!ktxFile.is_open()){
+        return false;
+    }
+    ktxFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    ktxFile.write(reinterpret_cast<const char *>(&levelIndex[0]), levelCount * sizeof(VulkanKtx2Level));
+    ktxFile.write(reinterpret_cast<const char *>(&descriptor[0]), descriptor.size() * sizeof(uint32_t));
+    for (uint32_t level = levelCount; level-- > 0;){
+        static const char padding[16] = {};
+        ktxFile.write(padding, (std::streamsize)(levelIndex[level].byteOffset - (uint64_t)ktxFile.tellp()));
+        ktxFile.write(reinterpret_cast<const char *>(&levels[level].blocks[0]), (std::streamsize)levels[level].blocks.size());
+    }
+    return ktxFile.good();
+}
+
+static bool cookTexture(const std::string& inputFileName, const CookOptions& options, uint32_t threadCount){
+    std::vector<CookLevel> levels(1);
+    if (!loadImage(inputFileName, levels[0].width, levels[0].height, levels[0].texels)){
+        std::cout << "Unable to load " << inputFileName << std::endl;
+        return false;
+    }
+    bool srgb = options.srgb && options.format != COOK_FORMAT_BC4 && options.format != COOK_FORMAT_BC5;
+
+    buildMipChain(levels, srgb, threadCount);
+    for (auto& level : levels){
+        encodeLevel(level, options.format, threadCount);
+    }
+
+    // Same name with a .ktx2 extension, in the output directory when one was given
+    std::string outputFileName = inputFileName.substr(0, inputFileName.find_last_of('.')) + ".ktx2";
+    if (!options.outputDirectory.empty()){
+        size_t nameStart = outputFileName.find_last_of("/\\");
+        outputFileName = options.outputDirectory + "/" + (nameStart == std::string::npos ? outputFileName : outputFileName.substr(nameStart + 1));
+    }
+    if (!writeKtx2(outputFileName, levels, options.format, srgb)){
+        std::cout << "Unable to write " << outputFileName << std::endl;
+        return false;
+    }
+
+    std::cout << "Cooked " << inputFileName << " -> " << outputFileName << " (" << std::dec << levels[0].width << "x" << levels[0].height << ", " << levels.size() << " levels)" << std::endl;
+    return true;
+}
+
+// Offline texture cooker: loads PNG, TGA, JPEG, BMP or baseline TIFF images, builds their
+// mip chains and writes block-compressed KTX2 files that VulkanKtxTexture uploads directly.
+// Usage: texcook [--format bc1|bc3|bc4|bc5|bc7|rgba8] [--linear] [--threads N] [--output-dir DIR] image...
+int main(int argc, char **argv){
+    CookOptions options;
+    options.format      = COOK_FORMAT_BC7;
+    options.srgb        = true;
+    options.threadCount = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+    std::vector<std::string> inputFileNames;
+    for (int argument = 1; argument < argc; argument++){
+        std::string value = argv[argument];
+        if (value == "--format" && argument + 1 < argc){
+            std::string formatName = argv[++argument];
+            const char * formatNames[] = {"bc1", "bc3", "bc4", "bc5", "bc7", "rgba8"};
+            uint32_t formatIndex = 0;
+            while (formatIndex < 6 && formatName != formatNames[formatIndex]){
+                formatIndex++;
+            }
+            if (formatIndex == 6){
+                std::cout << "Unknown format " << formatName << ", ASTC is not supported yet" << std::endl;
+                return 1;
+            }
+            options.format = (CookFormat)formatIndex;
+        }else if (value == "--linear"){
+            options.srgb = false;
+        }else if (value == "--threads" && argument + 1 < argc){
+            options.threadCount = (std::max)((uint32_t)std::stoul(argv[++argument]), 1u);
+        }else if (value == "--output-dir" && argument + 1 < argc){
+            options.outputDirectory = argv[++argument];
+        }else{
+            inputFileNames.push_back(value);
+        }
+    }
+    if (inputFileNames.empty()){
+        std::cout << "Usage: texcook [--format bc1|bc3|bc4|bc5|bc7|rgba8] [--linear] [--threads N] [--output-dir DIR] image..." << std::endl;
+        return 1;
+    }
+
+    // Whole textures per core when there are enough of them, otherwise split each one by block rows
+    auto start = std::chrono::high_resolution_clock::now();
+    std::atomic<uint32_t> failureCount(0);
+    if (inputFileNames.size() >= options.threadCount){
+        parallelFor((uint32_t)inputFileNames.size(), options.threadCount, [&](uint32_t inputIndex){
+            if (!cookTexture(inputFileNames[inputIndex], options, 1)){
+                failureCount++;
+            }
+        });
+    }else{
+        for (const auto& inputFileName : inputFileNames){
+            if (!cookTexture(inputFileName, options, options.threadCount)){
+                failureCount++;
+            }
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double seconds = (double)std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count() / MILLISECONDS_TO_SECONDS;
+    std::cout << "Cooked " << std::dec << inputFileNames.size() - failureCount << " of " << inputFileNames.size() << " textures in " << seconds << "s on " << options.threadCount << " threads" << std::endl;
+
+    return failureCount == 0 ? 0 : 1;
+}